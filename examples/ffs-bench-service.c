@@ -0,0 +1,1181 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+/*
+ * Benchmark service for function fs data path.
+ *
+ * Function has one bulk IN and one bulk OUT endpoint (see ffs-bench.sample)
+ * and acts as data source (IN), sink (OUT), both at once or loopback
+ * which sends back everything received. Throughput is printed
+ * periodically, latency percentiles and CPU time per GB when
+ * service exits.
+ *
+ * Usage: ffs-bench-service [-m source|sink|both|loop]
+ *			    [-p zeros|counter|random] [-s transfer size]
+ *			    [-q queue depth] [-b rw|aio|uring] [-v]
+ *			    [-i report interval] [-d duration]
+ */
+
+#define _GNU_SOURCE /* for endian.h and pthread_setname_np() */
+
+#include <endian.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "libaio.h"
+#define IOCB_FLAG_RESFD         (1 << 0)
+
+#include <linux/usb/functionfs.h>
+#include <gadgetd/ffs-daemon.h>
+#include <gadgetd/ffs-buf-pool.h>
+#include <gadgetd/ffs-ep0.h>
+#ifdef HAVE_LIBURING
+#include <gadgetd/ffs-ep-queue.h>
+#endif
+
+#define EP_IN		1
+#define EP_OUT		2
+
+#define DEFAULT_XFER	65536
+#define DEFAULT_DEPTH	8
+#define MAX_DEPTH	256
+#define MAX_PACKET	512
+
+/* Latency histogram: 16 linear buckets for each power of 2 microseconds */
+#define HIST_SUB_BITS	4
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	(HIST_SUB * 28)
+
+enum mode {
+	MODE_SOURCE,
+	MODE_SINK,
+	MODE_BOTH,
+	MODE_LOOP
+};
+
+enum pattern {
+	PATTERN_ZEROS,
+	PATTERN_COUNTER,
+	PATTERN_RANDOM
+};
+
+enum dir {
+	DIR_IN,
+	DIR_OUT,
+	DIR_NUM
+};
+
+struct dir_stats {
+	uint64_t bytes;
+	uint64_t transfers;
+	uint64_t errors;
+	/* counter pattern mismatches, OUT only */
+	uint64_t bad_data;
+	/* bytes at previous report */
+	uint64_t reported;
+	uint64_t hist[HIST_BUCKETS];
+};
+
+struct bench;
+
+struct backend {
+	const char *name;
+	int (*init)(struct bench *b);
+	/* (re)starts idle transfers, called when function is enabled */
+	void (*kick)(struct bench *b);
+	void (*cleanup)(struct bench *b);
+};
+
+struct bench {
+	int ep[3];
+	struct gd_ep0 *e;
+	int ready;
+
+	enum mode mode;
+	enum pattern pattern;
+	size_t xfer_len;
+	unsigned depth;
+	int verify;
+	int interval;
+	int duration;
+	const struct backend *backend;
+	void *priv;
+
+	/* next word of counter pattern, sent and expected */
+	uint32_t tx_counter;
+	uint32_t rx_counter;
+
+	struct dir_stats stats[DIR_NUM];
+	struct timespec start;
+	int elapsed;
+};
+
+static const char *const dir_names[DIR_NUM] = {
+	[DIR_IN] = "in",
+	[DIR_OUT] = "out",
+};
+
+/******************** Helpers *******************************/
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int uses_dir(struct bench *b, enum dir d)
+{
+	switch (b->mode) {
+	case MODE_SOURCE:
+		return d == DIR_IN;
+	case MODE_SINK:
+		return d == DIR_OUT;
+	default:
+		return 1;
+	}
+}
+
+static void hist_add(uint64_t *hist, uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	unsigned bucket;
+	int k;
+
+	if (us < HIST_SUB) {
+		bucket = us;
+	} else {
+		k = 63 - __builtin_clzll(us);
+		bucket = (k - HIST_SUB_BITS + 1) * HIST_SUB +
+			((us >> (k - HIST_SUB_BITS)) & (HIST_SUB - 1));
+	}
+
+	if (bucket >= HIST_BUCKETS)
+		bucket = HIST_BUCKETS - 1;
+	++hist[bucket];
+}
+
+/* Returns lower bound of bucket in microseconds */
+static uint64_t hist_value(unsigned bucket)
+{
+	unsigned k;
+
+	if (bucket < HIST_SUB)
+		return bucket;
+
+	k = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+	return (1ULL << k) + ((uint64_t)(bucket % HIST_SUB) <<
+			      (k - HIST_SUB_BITS));
+}
+
+static uint64_t hist_percentile(const uint64_t *hist, double p)
+{
+	uint64_t total = 0, sum = 0;
+	unsigned i;
+
+	for (i = 0; i < HIST_BUCKETS; ++i)
+		total += hist[i];
+	if (!total)
+		return 0;
+
+	for (i = 0; i < HIST_BUCKETS; ++i) {
+		sum += hist[i];
+		if (sum >= total * p)
+			break;
+	}
+
+	return hist_value(i < HIST_BUCKETS ? i : HIST_BUCKETS - 1);
+}
+
+/* Called for each finished transfer, possibly from several threads */
+static void account(struct bench *b, enum dir d, ssize_t ret, uint64_t ns)
+{
+	struct dir_stats *s = &b->stats[d];
+
+	if (ret < 0) {
+		__atomic_add_fetch(&s->errors, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	__atomic_add_fetch(&s->bytes, ret, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&s->transfers, 1, __ATOMIC_RELAXED);
+	/* Each direction is completed by one thread only */
+	hist_add(s->hist, ns);
+}
+
+/******************** Data patterns *******************************/
+
+static void fill_random(void *buf, size_t len)
+{
+	static uint64_t state = 0x9e3779b97f4a7c15ULL;
+	uint64_t *p = buf;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(*p); ++i) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		p[i] = state;
+	}
+}
+
+/* Prepares buffer before first use */
+static void init_buf(struct bench *b, void *buf)
+{
+	if (b->pattern == PATTERN_RANDOM)
+		fill_random(buf, b->xfer_len);
+	else
+		memset(buf, 0, b->xfer_len);
+}
+
+/* Prepares buffer before each IN transfer of source */
+static void fill_buf(struct bench *b, void *buf)
+{
+	uint32_t *p = buf;
+	size_t i;
+
+	if (b->pattern != PATTERN_COUNTER)
+		return;
+
+	for (i = 0; i < b->xfer_len / sizeof(*p); ++i)
+		p[i] = htole32(b->tx_counter++);
+}
+
+static void check_buf(struct bench *b, const void *buf, size_t len)
+{
+	const uint32_t *p = buf;
+	size_t i;
+
+	if (!b->verify || b->pattern != PATTERN_COUNTER)
+		return;
+
+	for (i = 0; i < len / sizeof(*p); ++i) {
+		if (le32toh(p[i]) != b->rx_counter) {
+			++b->stats[DIR_OUT].bad_data;
+			/* resynchronize to detect next error */
+			b->rx_counter = le32toh(p[i]);
+		}
+		++b->rx_counter;
+	}
+}
+
+/******************** read/write backend *******************************/
+
+/*
+ * One thread for each direction (one thread for loopback) doing
+ * blocking transfers, so queue depth is always 1.
+ */
+
+struct rw_thread {
+	struct bench *b;
+	enum dir dir;
+	pthread_t thread;
+	int started;
+	void *buf;
+};
+
+struct rw_priv {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* incremented on each ENABLE */
+	unsigned generation;
+	struct rw_thread threads[DIR_NUM];
+};
+
+static void unlock_mutex(void *lock)
+{
+	pthread_mutex_unlock(lock);
+}
+
+/* Sleeps after failed transfer until function is enabled again */
+static void rw_pause(struct rw_priv *p, unsigned *generation)
+{
+	pthread_mutex_lock(&p->lock);
+	pthread_cleanup_push(unlock_mutex, &p->lock);
+	while (p->generation == *generation)
+		pthread_cond_wait(&p->cond, &p->lock);
+	*generation = p->generation;
+	pthread_cleanup_pop(1);
+}
+
+static ssize_t rw_transfer(struct bench *b, enum dir d, void *buf, size_t len)
+{
+	uint64_t t0;
+	ssize_t ret;
+
+	t0 = now_ns();
+	do {
+		if (d == DIR_IN)
+			ret = write(b->ep[EP_IN], buf, len);
+		else
+			ret = read(b->ep[EP_OUT], buf, len);
+	} while (ret < 0 && errno == EINTR);
+
+	account(b, d, ret, now_ns() - t0);
+	return ret;
+}
+
+static void *rw_loop(void *data)
+{
+	struct rw_thread *t = data;
+	struct bench *b = t->b;
+	struct rw_priv *p = b->priv;
+	unsigned generation;
+	ssize_t ret;
+
+	pthread_mutex_lock(&p->lock);
+	generation = p->generation;
+	pthread_mutex_unlock(&p->lock);
+
+	/* wait for ENABLE if we have been started on BIND */
+	if (!__atomic_load_n(&b->ready, __ATOMIC_ACQUIRE))
+		rw_pause(p, &generation);
+
+	for (;;) {
+		if (b->mode == MODE_LOOP) {
+			ret = rw_transfer(b, DIR_OUT, t->buf, b->xfer_len);
+			/* zero length packet is not sent back */
+			if (ret > 0)
+				ret = rw_transfer(b, DIR_IN, t->buf, ret);
+		} else if (t->dir == DIR_IN) {
+			fill_buf(b, t->buf);
+			ret = rw_transfer(b, DIR_IN, t->buf, b->xfer_len);
+		} else {
+			ret = rw_transfer(b, DIR_OUT, t->buf, b->xfer_len);
+			if (ret > 0)
+				check_buf(b, t->buf, ret);
+		}
+
+		if (ret < 0)
+			rw_pause(p, &generation);
+	}
+
+	return NULL;
+}
+
+static int rw_init(struct bench *b)
+{
+	struct rw_priv *p;
+	struct rw_thread *t;
+	int ret;
+	int d;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->cond, NULL);
+	b->priv = p;
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		/* loopback is served by one thread */
+		if (!uses_dir(b, d) || (b->mode == MODE_LOOP && d == DIR_IN))
+			continue;
+
+		t = &p->threads[d];
+		t->b = b;
+		t->dir = d;
+		if (posix_memalign(&t->buf, 4096, b->xfer_len))
+			return -ENOMEM;
+		init_buf(b, t->buf);
+
+		ret = pthread_create(&t->thread, NULL, rw_loop, t);
+		if (ret)
+			return -ret;
+		t->started = 1;
+		pthread_setname_np(t->thread, d == DIR_IN ? "bench-in" :
+				   "bench-out");
+	}
+
+	return 0;
+}
+
+static void rw_kick(struct bench *b)
+{
+	struct rw_priv *p = b->priv;
+
+	pthread_mutex_lock(&p->lock);
+	++(p->generation);
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void rw_cleanup(struct bench *b)
+{
+	struct rw_priv *p = b->priv;
+	int d;
+
+	if (!p)
+		return;
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		/* threads may block on endpoint */
+		if (p->threads[d].started) {
+			pthread_cancel(p->threads[d].thread);
+			pthread_join(p->threads[d].thread, NULL);
+		}
+		free(p->threads[d].buf);
+	}
+
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->lock);
+	free(p);
+}
+
+/******************** libaio backend *******************************/
+
+/*
+ * Each slot has one buffer and one request in flight. In loopback
+ * slot alternates between OUT and IN transfer of the same buffer.
+ */
+
+struct aio_slot {
+	struct iocb iocb;
+	enum dir dir;
+	void *buf;
+	int busy;
+	uint64_t t_submit;
+};
+
+struct aio_priv {
+	io_context_t ctx;
+	int evfd;
+	struct gd_buf_pool *pool;
+	unsigned n_slots;
+	struct aio_slot slots[2 * MAX_DEPTH];
+};
+
+static int aio_submit(struct bench *b, struct aio_slot *s, enum dir d,
+		      size_t len)
+{
+	struct aio_priv *p = b->priv;
+	struct iocb *iocb = &s->iocb;
+	int ret;
+
+	if (d == DIR_IN)
+		io_prep_pwrite(iocb, b->ep[EP_IN], s->buf, len, 0);
+	else
+		io_prep_pread(iocb, b->ep[EP_OUT], s->buf, len, 0);
+	iocb->u.c.flags |= IOCB_FLAG_RESFD;
+	iocb->u.c.resfd = p->evfd;
+
+	s->dir = d;
+	s->t_submit = now_ns();
+	ret = io_submit(p->ctx, 1, &iocb);
+	if (ret < 0)
+		return ret;
+
+	s->busy = 1;
+	return 0;
+}
+
+/* Submits slot again after completion, slot stays idle on failure */
+static void aio_next(struct bench *b, struct aio_slot *s, long res)
+{
+	switch (b->mode) {
+	case MODE_LOOP:
+		if (s->dir == DIR_OUT && res > 0)
+			aio_submit(b, s, DIR_IN, res);
+		else
+			aio_submit(b, s, DIR_OUT, b->xfer_len);
+		break;
+
+	default:
+		if (s->dir == DIR_IN) {
+			fill_buf(b, s->buf);
+		} else if (res > 0) {
+			check_buf(b, s->buf, res);
+		}
+		aio_submit(b, s, s->dir, b->xfer_len);
+		break;
+	}
+}
+
+static int aio_complete(struct gd_ep0 *e, int fd, uint32_t events,
+			void *data)
+{
+	struct bench *b = data;
+	struct aio_priv *p = b->priv;
+	struct io_event ev[2 * MAX_DEPTH];
+	struct aio_slot *s;
+	uint64_t cnt;
+	int i, n;
+
+	if (read(p->evfd, &cnt, sizeof(cnt)) < 0)
+		return errno == EAGAIN ? 0 : -errno;
+
+	n = io_getevents(p->ctx, 0, p->n_slots, ev, NULL);
+	for (i = 0; i < n; ++i) {
+		s = (struct aio_slot *)ev[i].obj;
+		s->busy = 0;
+		account(b, s->dir, (long)ev[i].res, now_ns() - s->t_submit);
+
+		/* function has been disabled, wait for ENABLE */
+		if ((long)ev[i].res < 0 || !b->ready)
+			continue;
+
+		aio_next(b, s, ev[i].res);
+	}
+
+	return 0;
+}
+
+static int aio_init(struct bench *b)
+{
+	struct aio_priv *p;
+	struct aio_slot *s;
+	unsigned i;
+	int d;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+	b->priv = p;
+	p->evfd = -1;
+
+	p->evfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (p->evfd < 0)
+		return -errno;
+
+	/* depth slots for each direction, loopback has one set */
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (!uses_dir(b, d) || (b->mode == MODE_LOOP && d == DIR_IN))
+			continue;
+		for (i = 0; i < b->depth; ++i) {
+			s = &p->slots[p->n_slots++];
+			s->dir = d;
+		}
+	}
+
+	p->pool = gd_buf_pool_new(MAX_PACKET, b->xfer_len / MAX_PACKET,
+				  p->n_slots, GD_BUF_POOL_HUGEPAGE);
+	if (!p->pool)
+		return -errno;
+
+	for (i = 0; i < p->n_slots; ++i) {
+		p->slots[i].buf = gd_buf_pool_get(p->pool);
+		init_buf(b, p->slots[i].buf);
+	}
+
+	if (io_setup(p->n_slots, &p->ctx) < 0)
+		return -errno;
+
+	return gd_ep0_add_fd(b->e, p->evfd, EPOLLIN, aio_complete, b);
+}
+
+static void aio_kick(struct bench *b)
+{
+	struct aio_priv *p = b->priv;
+	struct aio_slot *s;
+	unsigned i;
+
+	for (i = 0; i < p->n_slots; ++i) {
+		s = &p->slots[i];
+		if (s->busy)
+			continue;
+
+		/* loopback slot which failed on IN starts again with OUT */
+		if (b->mode == MODE_LOOP)
+			s->dir = DIR_OUT;
+		else if (s->dir == DIR_IN)
+			fill_buf(b, s->buf);
+
+		if (aio_submit(b, s, s->dir, b->xfer_len) < 0)
+			perror("unable to submit request");
+	}
+}
+
+static void aio_cleanup(struct bench *b)
+{
+	struct aio_priv *p = b->priv;
+	unsigned i;
+
+	if (!p)
+		return;
+
+	if (p->ctx)
+		io_destroy(p->ctx);
+	if (p->evfd >= 0)
+		close(p->evfd);
+
+	if (p->pool) {
+		for (i = 0; i < p->n_slots; ++i)
+			if (p->slots[i].buf)
+				gd_buf_pool_put(p->pool, p->slots[i].buf);
+		gd_buf_pool_free(p->pool);
+	}
+
+	free(p);
+}
+
+/******************** io_uring backend *******************************/
+
+#ifdef HAVE_LIBURING
+
+/*
+ * Requests of both endpoints live in gd_ep_queue. In loopback
+ * OUT request i passes its buffer to IN request i and waits
+ * until it is sent back.
+ */
+
+struct uring_priv {
+	struct gd_ep_queue *q;
+	/* index of endpoint in queue for each direction, -1 if unused */
+	int qep[DIR_NUM];
+	enum dir qdir[DIR_NUM];
+	int busy[DIR_NUM][MAX_DEPTH];
+	uint64_t t_submit[DIR_NUM][MAX_DEPTH];
+};
+
+static unsigned uring_slot(struct uring_priv *p, struct gd_ep_request *req)
+{
+	unsigned i;
+
+	for (i = 0; gd_ep_queue_request(p->q, req->ep, i) != req; ++i)
+		;
+	return i;
+}
+
+static int uring_submit(struct bench *b, enum dir d, unsigned i)
+{
+	struct uring_priv *p = b->priv;
+	int ret;
+
+	p->t_submit[d][i] = now_ns();
+	ret = gd_ep_queue_submit(p->q, gd_ep_queue_request(p->q, p->qep[d], i));
+	if (ret == 0)
+		p->busy[d][i] = 1;
+
+	return ret;
+}
+
+static int uring_complete(struct gd_ep_queue *q, struct gd_ep_request *req,
+			  void *data)
+{
+	struct bench *b = data;
+	struct uring_priv *p = b->priv;
+	struct gd_ep_request *in;
+	enum dir d = p->qdir[req->ep];
+	unsigned i = uring_slot(p, req);
+	uint64_t now = now_ns();
+	void *buf;
+
+	p->busy[d][i] = 0;
+	account(b, d, req->result, now - p->t_submit[d][i]);
+
+	if (req->result < 0 || !b->ready)
+		return GD_EP_REQ_HOLD;
+
+	if (b->mode == MODE_LOOP) {
+		if (d == DIR_OUT && req->result > 0) {
+			/* send received data back in the same buffer */
+			in = gd_ep_queue_request(q, p->qep[DIR_IN], i);
+			buf = in->buf;
+			in->buf = req->buf;
+			req->buf = buf;
+			in->length = req->result;
+			uring_submit(b, DIR_IN, i);
+		} else {
+			uring_submit(b, DIR_OUT, i);
+		}
+		return GD_EP_REQ_HOLD;
+	}
+
+	if (d == DIR_IN)
+		fill_buf(b, req->buf);
+	else
+		check_buf(b, req->buf, req->result);
+
+	req->length = b->xfer_len;
+	p->busy[d][i] = 1;
+	p->t_submit[d][i] = now;
+	return GD_EP_REQ_REQUEUE;
+}
+
+static int uring_dispatch(struct gd_ep0 *e, int fd, uint32_t events,
+			  void *data)
+{
+	struct bench *b = data;
+	struct uring_priv *p = b->priv;
+	int ret;
+
+	ret = gd_ep_queue_dispatch(p->q);
+	return ret < 0 ? ret : 0;
+}
+
+static int uring_init(struct bench *b)
+{
+	struct gd_ep_queue_config eps[DIR_NUM];
+	struct gd_ep_request *req;
+	struct uring_priv *p;
+	unsigned i;
+	int n = 0;
+	int d;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+	b->priv = p;
+
+	memset(eps, 0, sizeof(eps));
+	for (d = 0; d < DIR_NUM; ++d) {
+		p->qep[d] = -1;
+		if (!uses_dir(b, d))
+			continue;
+
+		eps[n].fd = b->ep[d == DIR_IN ? EP_IN : EP_OUT];
+		eps[n].direction = d == DIR_IN ? GD_EP_IN : GD_EP_OUT;
+		eps[n].depth = b->depth;
+		eps[n].buf_len = b->xfer_len;
+		p->qdir[n] = d;
+		p->qep[d] = n++;
+	}
+
+	p->q = gd_ep_queue_new(eps, n, uring_complete, b);
+	if (!p->q)
+		return -errno;
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (p->qep[d] < 0)
+			continue;
+		for (i = 0; i < b->depth; ++i) {
+			req = gd_ep_queue_request(p->q, p->qep[d], i);
+			init_buf(b, req->buf);
+		}
+	}
+
+	return gd_ep0_add_fd(b->e, gd_ep_queue_fd(p->q), EPOLLIN,
+			     uring_dispatch, b);
+}
+
+static void uring_kick(struct bench *b)
+{
+	struct uring_priv *p = b->priv;
+	struct gd_ep_request *req;
+	unsigned i;
+	int d;
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (p->qep[d] < 0)
+			continue;
+		/* loopback IN requests are submitted by OUT completions */
+		if (b->mode == MODE_LOOP && d == DIR_IN)
+			continue;
+
+		for (i = 0; i < b->depth; ++i) {
+			/* loopback request is busy until IN is done */
+			if (p->busy[d][i] ||
+			    (b->mode == MODE_LOOP && p->busy[DIR_IN][i]))
+				continue;
+
+			req = gd_ep_queue_request(p->q, p->qep[d], i);
+			req->length = b->xfer_len;
+			if (d == DIR_IN)
+				fill_buf(b, req->buf);
+
+			if (uring_submit(b, d, i) < 0)
+				perror("unable to submit request");
+		}
+	}
+}
+
+static void uring_cleanup(struct bench *b)
+{
+	struct uring_priv *p = b->priv;
+
+	if (!p)
+		return;
+
+	gd_ep_queue_free(p->q);
+	free(p);
+}
+
+#endif /* HAVE_LIBURING */
+
+static const struct backend backends[] = {
+	{ "rw", rw_init, rw_kick, rw_cleanup },
+	{ "aio", aio_init, aio_kick, aio_cleanup },
+#ifdef HAVE_LIBURING
+	{ "uring", uring_init, uring_kick, uring_cleanup },
+#endif
+	{ NULL }
+};
+
+/******************** Reports *******************************/
+
+static void report_interval(struct bench *b)
+{
+	struct dir_stats *s;
+	uint64_t bytes;
+	int d;
+
+	printf("%5ds", ++b->elapsed * b->interval);
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (!uses_dir(b, d))
+			continue;
+
+		s = &b->stats[d];
+		bytes = __atomic_load_n(&s->bytes, __ATOMIC_RELAXED);
+		printf("  %s %8.2f MB/s", dir_names[d],
+		       (bytes - s->reported) / 1e6 / b->interval);
+		s->reported = bytes;
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static void report_summary(struct bench *b)
+{
+	struct dir_stats *s;
+	struct timespec end;
+	struct rusage ru;
+	double secs, cpu, total = 0;
+	int d;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = end.tv_sec - b->start.tv_sec +
+		(end.tv_nsec - b->start.tv_nsec) / 1e9;
+
+	printf("backend %s, transfer %zu bytes, depth %u, %.1f s\n",
+	       b->backend->name, b->xfer_len, b->depth, secs);
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (!uses_dir(b, d))
+			continue;
+
+		s = &b->stats[d];
+		total += s->bytes;
+		printf("%-3s %12llu bytes %10llu transfers %6llu errors"
+		       " %8.2f MB/s\n", dir_names[d],
+		       (unsigned long long)s->bytes,
+		       (unsigned long long)s->transfers,
+		       (unsigned long long)s->errors,
+		       secs > 0 ? s->bytes / 1e6 / secs : 0);
+		printf("    latency us: p50 %llu p90 %llu p99 %llu p99.9 %llu\n",
+		       (unsigned long long)hist_percentile(s->hist, 0.5),
+		       (unsigned long long)hist_percentile(s->hist, 0.9),
+		       (unsigned long long)hist_percentile(s->hist, 0.99),
+		       (unsigned long long)hist_percentile(s->hist, 0.999));
+		if (d == DIR_OUT && b->verify)
+			printf("    bad data: %llu\n",
+			       (unsigned long long)s->bad_data);
+	}
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0) {
+		cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+			ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+		printf("cpu %.2f s", cpu);
+		if (total > 0)
+			printf(", %.3f s/GB", cpu / (total / 1e9));
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+/******************** Event loop *******************************/
+
+static void handle_event(struct gd_ep0 *e,
+			 enum usb_functionfs_event_type type, void *data)
+{
+	struct bench *b = data;
+
+	switch (type) {
+	case FUNCTIONFS_ENABLE:
+		__atomic_store_n(&b->ready, 1, __ATOMIC_RELEASE);
+		b->backend->kick(b);
+		break;
+
+	case FUNCTIONFS_DISABLE:
+	case FUNCTIONFS_UNBIND:
+		__atomic_store_n(&b->ready, 0, __ATOMIC_RELEASE);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static int handle_timer(struct gd_ep0 *e, int fd, uint32_t events,
+			void *data)
+{
+	struct bench *b = data;
+	uint64_t cnt;
+
+	if (read(fd, &cnt, sizeof(cnt)) < 0)
+		return 0;
+
+	report_interval(b);
+	if (b->duration && b->elapsed * b->interval >= b->duration)
+		gd_ep0_stop(e);
+
+	return 0;
+}
+
+static int handle_signal(struct gd_ep0 *e, int fd, uint32_t events,
+			 void *data)
+{
+	struct signalfd_siginfo si;
+
+	if (read(fd, &si, sizeof(si)) == sizeof(si))
+		gd_ep0_stop(e);
+
+	return 0;
+}
+
+static int add_timer(struct bench *b)
+{
+	struct itimerspec its;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (fd < 0)
+		return -errno;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = b->interval;
+	its.it_interval.tv_sec = b->interval;
+	if (timerfd_settime(fd, 0, &its, NULL) < 0 ||
+	    gd_ep0_add_fd(b->e, fd, EPOLLIN, handle_timer, b) < 0) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	return fd;
+}
+
+static int add_signals(struct bench *b)
+{
+	sigset_t mask;
+	int fd;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	/* blocked before threads are created, so they inherit it */
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+	if (fd < 0)
+		return -errno;
+
+	if (gd_ep0_add_fd(b->e, fd, EPOLLIN, handle_signal, b) < 0) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	return fd;
+}
+
+/******************** Options *******************************/
+
+static int lookup(const char *const *names, const char *arg)
+{
+	int i;
+
+	for (i = 0; names[i]; ++i)
+		if (strcmp(names[i], arg) == 0)
+			return i;
+
+	return -1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-m source|sink|both|loop]"
+		" [-p zeros|counter|random]\n"
+		"\t[-s transfer size] [-q queue depth]"
+		" [-b rw|aio|uring] [-v]\n"
+		"\t[-i report interval] [-d duration]\n", name);
+}
+
+static int parse_args(struct bench *b, int argc, char *argv[])
+{
+	static const char *const modes[] = {
+		"source", "sink", "both", "loop", NULL
+	};
+	static const char *const patterns[] = {
+		"zeros", "counter", "random", NULL
+	};
+	int opt, i;
+
+	b->mode = MODE_LOOP;
+	b->pattern = PATTERN_COUNTER;
+	b->xfer_len = DEFAULT_XFER;
+	b->depth = DEFAULT_DEPTH;
+	b->interval = 1;
+	b->backend = &backends[0];
+
+	while ((opt = getopt(argc, argv, "m:p:s:q:b:vi:d:")) != -1) {
+		switch (opt) {
+		case 'm':
+			i = lookup(modes, optarg);
+			if (i < 0)
+				return -EINVAL;
+			b->mode = i;
+			break;
+		case 'p':
+			i = lookup(patterns, optarg);
+			if (i < 0)
+				return -EINVAL;
+			b->pattern = i;
+			break;
+		case 's':
+			b->xfer_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			b->depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			for (i = 0; backends[i].name; ++i)
+				if (strcmp(backends[i].name, optarg) == 0)
+					break;
+			if (!backends[i].name) {
+				fprintf(stderr, "backend %s not available\n",
+					optarg);
+				return -EINVAL;
+			}
+			b->backend = &backends[i];
+			break;
+		case 'v':
+			b->verify = 1;
+			break;
+		case 'i':
+			b->interval = atoi(optarg);
+			break;
+		case 'd':
+			b->duration = atoi(optarg);
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	/* buffers are made of whole packets and counter words */
+	if (b->xfer_len < MAX_PACKET || b->xfer_len % MAX_PACKET ||
+	    !b->depth || b->depth > MAX_DEPTH || b->interval <= 0 ||
+	    b->duration < 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench b;
+	enum usb_functionfs_event_type ev;
+	int timer_fd = -1, sig_fd = -1;
+	int i, ret;
+
+	memset(&b, 0, sizeof(b));
+
+	if (parse_args(&b, argc, argv) < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	ret = gd_nmb_of_ep(0);
+	if (ret != 3) {
+		fprintf(stderr, "Incompatible number of ep received\n");
+		return 1;
+	}
+
+	for (i = 0; i < 3; ++i) {
+		b.ep[i] = gd_get_ep_by_nmb(i);
+		if (b.ep[i] < 0) {
+			perror("Unable to get descriptors");
+			return 1;
+		}
+	}
+
+	if (gd_lock_memory(0) < 0)
+		perror("Unable to lock memory");
+
+	ev = gd_get_activation_event(0);
+	b.ready = ev == FUNCTIONFS_ENABLE || ev == FUNCTIONFS_SETUP;
+
+	b.e = gd_ep0_new(b.ep[0]);
+	if (!b.e) {
+		perror("unable to create ep0 loop");
+		return 1;
+	}
+
+	for (ev = FUNCTIONFS_BIND; ev <= FUNCTIONFS_RESUME; ++ev)
+		gd_ep0_set_event_handler(b.e, ev, handle_event, &b);
+
+	sig_fd = add_signals(&b);
+	timer_fd = add_timer(&b);
+	if (sig_fd < 0 || timer_fd < 0) {
+		fprintf(stderr, "unable to set up event loop\n");
+		ret = 1;
+		goto out;
+	}
+
+	ret = b.backend->init(&b);
+	if (ret < 0) {
+		fprintf(stderr, "unable to init %s backend: %s\n",
+			b.backend->name, strerror(-ret));
+		ret = 1;
+		goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &b.start);
+	if (b.ready)
+		b.backend->kick(&b);
+
+	ret = gd_ep0_run(b.e);
+	if (ret < 0)
+		fprintf(stderr, "ep0 loop failed: %s\n", strerror(-ret));
+	ret = ret < 0;
+
+	report_summary(&b);
+out:
+	b.backend->cleanup(&b);
+	gd_ep0_free(b.e);
+	if (timer_fd >= 0)
+		close(timer_fd);
+	if (sig_fd >= 0)
+		close(sig_fd);
+
+	for (i = 0; i < 3; ++i)
+		close(b.ep[i]);
+
+	return ret;
+}
@@ -0,0 +1,244 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+/*
+ * Compares gd_bridge with plain read/write loop.
+ *
+ * By default endpoints are replaced with a pipe fed by producer thread
+ * and a socket drained by consumer thread, so only cost of moving data
+ * through the service is measured. Socket supports splice, unlike
+ * function fs endpoint, so "bridge splice" result is what splice could
+ * give, not what bridge does with real endpoints.
+ *
+ * If IN endpoint file of running function fs is given, data is sent
+ * to host instead of socket, host has to read it, eg. with
+ * ffs-host-bench. Then "bridge splice" shows fallback from splice to
+ * copy mode as it happens in real service.
+ *
+ * Usage: ffs-bridge-bench [MiB to transfer] [buffer length] [ep file]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <gadgetd/ffs-bridge.h>
+
+#define DEFAULT_MIB	1024
+#define DEFAULT_BUF_LEN	65536
+
+struct bench {
+	/* producer writes here */
+	int src[2];
+	/* consumer reads from here */
+	int dst[2];
+	size_t total;
+	size_t buf_len;
+};
+
+static void *producer(void *data)
+{
+	struct bench *b = data;
+	size_t left = b->total;
+	char *buf;
+	ssize_t ret;
+
+	buf = calloc(1, b->buf_len);
+	if (!buf)
+		goto out;
+
+	while (left > 0) {
+		ret = write(b->src[1], buf,
+			    left < b->buf_len ? left : b->buf_len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("producer");
+			break;
+		}
+		left -= ret;
+	}
+
+	free(buf);
+out:
+	close(b->src[1]);
+	return NULL;
+}
+
+static void *consumer(void *data)
+{
+	struct bench *b = data;
+	char *buf;
+	ssize_t ret;
+
+	buf = malloc(b->buf_len);
+	if (!buf)
+		return NULL;
+
+	do {
+		ret = read(b->dst[1], buf, b->buf_len);
+	} while (ret > 0 || (ret < 0 && errno == EINTR));
+
+	free(buf);
+	return NULL;
+}
+
+static int copy_loop(struct bench *b)
+{
+	char *buf;
+	ssize_t len, ret;
+	int r = 0;
+
+	buf = malloc(b->buf_len);
+	if (!buf)
+		return -ENOMEM;
+
+	while ((len = read(b->src[0], buf, b->buf_len)) > 0) {
+		ret = write(b->dst[0], buf, len);
+		if (ret != len) {
+			r = -EIO;
+			break;
+		}
+	}
+
+	free(buf);
+	return r;
+}
+
+static int bridge(struct bench *b, int flags, int *spliced)
+{
+	struct gd_bridge_config cfg = {
+		.ep_in = b->dst[0],
+		.ep_out = -1,
+		.rd_fd = b->src[0],
+		.wr_fd = -1,
+		.buf_len = b->buf_len,
+		.flags = flags,
+	};
+	struct gd_bridge_stats stats;
+	int ret;
+
+	ret = gd_bridge_run(&cfg, &stats);
+	*spliced = stats.to_host_spliced;
+	return ret;
+}
+
+static void run(const char *name, size_t total, size_t buf_len,
+		const char *ep, int mode)
+{
+	struct bench b;
+	pthread_t prod, cons;
+	struct timespec start, end;
+	double secs;
+	int spliced = 0;
+	int ret;
+
+	b.total = total;
+	b.buf_len = buf_len;
+
+	if (pipe(b.src) < 0) {
+		perror("unable to create pipe");
+		exit(1);
+	}
+
+	if (ep) {
+		/* host is the consumer */
+		b.dst[0] = open(ep, O_WRONLY);
+		b.dst[1] = -1;
+		if (b.dst[0] < 0) {
+			perror("unable to open endpoint");
+			exit(1);
+		}
+	} else if (socketpair(AF_UNIX, SOCK_STREAM, 0, b.dst) < 0) {
+		perror("unable to create socket");
+		exit(1);
+	}
+
+	pthread_create(&prod, NULL, producer, &b);
+	if (!ep)
+		pthread_create(&cons, NULL, consumer, &b);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (mode < 0)
+		ret = copy_loop(&b);
+	else
+		ret = bridge(&b, mode, &spliced);
+	if (!ep) {
+		shutdown(b.dst[0], SHUT_WR);
+		pthread_join(cons, NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_join(prod, NULL);
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%-14s %8.1f MiB/s%s%s\n", name,
+	       total / secs / (1024 * 1024),
+	       mode >= 0 && !spliced ? " (copied)" : "",
+	       ret < 0 ? " (failed)" : "");
+
+	close(b.src[0]);
+	close(b.dst[0]);
+	if (b.dst[1] >= 0)
+		close(b.dst[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t total = (size_t)DEFAULT_MIB * 1024 * 1024;
+	size_t buf_len = DEFAULT_BUF_LEN;
+	const char *ep = NULL;
+
+	if (argc > 1)
+		total = strtoul(argv[1], NULL, 10) * 1024 * 1024;
+	if (argc > 2)
+		buf_len = strtoul(argv[2], NULL, 10);
+	if (argc > 3)
+		ep = argv[3];
+
+	if (!total || !buf_len) {
+		fprintf(stderr, "Usage: %s [MiB] [buffer length] [ep file]\n",
+			argv[0]);
+		return 1;
+	}
+
+	printf("Transferring %zu MiB with %zu byte buffers\n",
+	       total / (1024 * 1024), buf_len);
+
+	run("copy loop", total, buf_len, ep, -1);
+	run("bridge copy", total, buf_len, ep, GD_BRIDGE_NO_SPLICE);
+	run("bridge splice", total, buf_len, ep, 0);
+
+	return 0;
+}
@@ -0,0 +1,812 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+/*
+ * Host side throughput benchmark for bulk functions, eg. ffs-bench-service.
+ *
+ * Keeps a number of asynchronous transfers in flight on first bulk IN
+ * and/or OUT endpoint of the interface. For each transfer size
+ * it warms up, measures for given time and prints results as JSON.
+ *
+ * Usage: ffs-host-bench [-d vid:pid | -p bus-port.port...] [-I interface]
+ *			 [-m in|out|both] [-s sizes] [-n in flight]
+ *			 [-w warm up seconds] [-t measure seconds] [-c] [-v]
+ *
+ * Sizes are list like 4096,65536 or range like 512-1048576
+ * which is swept in powers of 2.
+ */
+
+#define _GNU_SOURCE /* for endian.h */
+
+#include <endian.h>
+#include <errno.h>
+#include <libusb.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define VENDOR	0x1d6b
+#define PRODUCT	0x0105
+
+#define DEFAULT_SIZES	"512-1048576"
+#define DEFAULT_DEPTH	8
+#define MAX_SIZES	32
+#define MAX_PORTS	8
+#define TIMEOUT		1000
+
+#define HIST_SUB_BITS	4
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	(HIST_SUB * 28)
+
+enum dir {
+	DIR_IN,
+	DIR_OUT,
+	DIR_NUM
+};
+
+enum phase {
+	PHASE_WARMUP,
+	PHASE_MEASURE,
+	PHASE_DONE
+};
+
+struct stream_stats {
+	uint64_t bytes;
+	uint64_t transfers;
+	uint64_t errors;
+	uint64_t bad_data;
+	uint64_t hist[HIST_BUCKETS];
+};
+
+struct stream;
+
+struct xfer {
+	struct stream *stream;
+	struct libusb_transfer *t;
+	unsigned char *buf;
+	/* buf has been mapped by libusb_dev_mem_alloc() */
+	int dev_mem;
+	uint64_t t_submit;
+	int busy;
+};
+
+struct stream {
+	struct bench *b;
+	enum dir dir;
+	unsigned char ep;
+	struct xfer *xfers;
+	int in_flight;
+	/* transfer failed in a way which makes resubmission pointless */
+	int failed;
+	uint32_t counter;
+	/* counter of received data is taken from first word */
+	int synced;
+	struct stream_stats stats;
+};
+
+struct bench {
+	libusb_context *ctx;
+	libusb_device_handle *handle;
+	int attached;
+	int iface;
+
+	/* device selection */
+	int vid, pid;
+	int bus;
+	uint8_t ports[MAX_PORTS];
+	int n_ports;
+
+	int use[DIR_NUM];
+	size_t sizes[MAX_SIZES];
+	int n_sizes;
+	unsigned depth;
+	int warmup;
+	int duration;
+	int counter;
+	int verify;
+
+	size_t size;
+	enum phase phase;
+	int stop;
+	struct stream streams[DIR_NUM];
+};
+
+static const char *const dir_names[DIR_NUM] = {
+	[DIR_IN] = "in",
+	[DIR_OUT] = "out",
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double cpu_seconds(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) < 0)
+		return 0;
+
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+		ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/******************** Latency histogram *******************************/
+
+static void hist_add(uint64_t *hist, uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	unsigned bucket;
+	int k;
+
+	if (us < HIST_SUB) {
+		bucket = us;
+	} else {
+		k = 63 - __builtin_clzll(us);
+		bucket = (k - HIST_SUB_BITS + 1) * HIST_SUB +
+			((us >> (k - HIST_SUB_BITS)) & (HIST_SUB - 1));
+	}
+
+	if (bucket >= HIST_BUCKETS)
+		bucket = HIST_BUCKETS - 1;
+	++hist[bucket];
+}
+
+static uint64_t hist_percentile(const uint64_t *hist, double p)
+{
+	uint64_t total = 0, sum = 0;
+	unsigned i, k;
+
+	for (i = 0; i < HIST_BUCKETS; ++i)
+		total += hist[i];
+	if (!total)
+		return 0;
+
+	for (i = 0; i < HIST_BUCKETS - 1; ++i) {
+		sum += hist[i];
+		if (sum >= total * p)
+			break;
+	}
+
+	if (i < HIST_SUB)
+		return i;
+
+	k = i / HIST_SUB + HIST_SUB_BITS - 1;
+	return (1ULL << k) + ((uint64_t)(i % HIST_SUB) << (k - HIST_SUB_BITS));
+}
+
+/******************** Transfers *******************************/
+
+static int submit(struct xfer *x);
+
+static void check_data(struct stream *s, const unsigned char *buf, int len)
+{
+	const uint32_t *p = (const uint32_t *)buf;
+	int i;
+
+	if (!s->synced && len >= (int)sizeof(*p)) {
+		s->counter = le32toh(p[0]);
+		s->synced = 1;
+	}
+
+	for (i = 0; i < len / (int)sizeof(*p); ++i) {
+		if (le32toh(p[i]) != s->counter) {
+			++s->stats.bad_data;
+			s->counter = le32toh(p[i]);
+		}
+		++s->counter;
+	}
+}
+
+static void fill_data(struct stream *s, unsigned char *buf, size_t len)
+{
+	uint32_t *p = (uint32_t *)buf;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(*p); ++i)
+		p[i] = htole32(s->counter++);
+}
+
+static void LIBUSB_CALL transfer_done(struct libusb_transfer *t)
+{
+	struct xfer *x = t->user_data;
+	struct stream *s = x->stream;
+	struct bench *b = s->b;
+
+	x->busy = 0;
+	--(s->in_flight);
+
+	switch (t->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		if (s->dir == DIR_IN && b->verify)
+			check_data(s, t->buffer, t->actual_length);
+		if (b->phase != PHASE_MEASURE)
+			break;
+		s->stats.bytes += t->actual_length;
+		++s->stats.transfers;
+		hist_add(s->stats.hist, now_ns() - x->t_submit);
+		break;
+
+	case LIBUSB_TRANSFER_CANCELLED:
+		return;
+
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		b->stop = 1;
+		/* fall through */
+	case LIBUSB_TRANSFER_STALL:
+		s->failed = 1;
+		/* fall through */
+	default:
+		++s->stats.errors;
+		break;
+	}
+
+	if (b->phase != PHASE_DONE && !b->stop && !s->failed)
+		submit(x);
+}
+
+static int submit(struct xfer *x)
+{
+	struct stream *s = x->stream;
+	struct bench *b = s->b;
+	int ret;
+
+	if (s->dir == DIR_OUT && b->counter)
+		fill_data(s, x->buf, b->size);
+
+	libusb_fill_bulk_transfer(x->t, b->handle, s->ep, x->buf, b->size,
+				  transfer_done, x, TIMEOUT);
+	x->t_submit = now_ns();
+
+	ret = libusb_submit_transfer(x->t);
+	if (ret) {
+		fprintf(stderr, "unable to submit transfer: %s\n",
+			libusb_error_name(ret));
+		s->failed = 1;
+		return ret;
+	}
+
+	x->busy = 1;
+	++(s->in_flight);
+	return 0;
+}
+
+static int alloc_buf(struct bench *b, struct xfer *x)
+{
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+	/* memory mapped from usbfs avoids copying data in kernel */
+	x->buf = libusb_dev_mem_alloc(b->handle, b->size);
+	if (x->buf) {
+		x->dev_mem = 1;
+		return 0;
+	}
+#endif
+	if (posix_memalign((void **)&x->buf, 4096, b->size)) {
+		x->buf = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void free_buf(struct bench *b, struct xfer *x)
+{
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+	if (x->dev_mem) {
+		libusb_dev_mem_free(b->handle, x->buf, b->size);
+		return;
+	}
+#endif
+	free(x->buf);
+}
+
+static void free_stream(struct stream *s)
+{
+	unsigned i;
+
+	if (!s->xfers)
+		return;
+
+	for (i = 0; i < s->b->depth; ++i) {
+		if (s->xfers[i].t)
+			libusb_free_transfer(s->xfers[i].t);
+		if (s->xfers[i].buf)
+			free_buf(s->b, &s->xfers[i]);
+	}
+
+	free(s->xfers);
+	s->xfers = NULL;
+}
+
+static int alloc_stream(struct stream *s)
+{
+	unsigned i;
+
+	s->xfers = calloc(s->b->depth, sizeof(*s->xfers));
+	if (!s->xfers)
+		return -ENOMEM;
+
+	for (i = 0; i < s->b->depth; ++i) {
+		s->xfers[i].stream = s;
+		s->xfers[i].t = libusb_alloc_transfer(0);
+		if (!s->xfers[i].t || alloc_buf(s->b, &s->xfers[i]) < 0) {
+			free_stream(s);
+			return -ENOMEM;
+		}
+		memset(s->xfers[i].buf, 0, s->b->size);
+	}
+
+	return 0;
+}
+
+static void cancel_all(struct bench *b)
+{
+	unsigned i;
+	int d;
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (!b->streams[d].xfers)
+			continue;
+		for (i = 0; i < b->depth; ++i)
+			if (b->streams[d].xfers[i].busy)
+				libusb_cancel_transfer(b->streams[d].xfers[i].t);
+	}
+}
+
+static int in_flight(struct bench *b)
+{
+	return b->streams[DIR_IN].in_flight + b->streams[DIR_OUT].in_flight;
+}
+
+/******************** Measurement *******************************/
+
+static void print_stream(struct stream *s, double secs)
+{
+	struct stream_stats *st = &s->stats;
+
+	printf("\"%s\": {\"bytes\": %llu, \"transfers\": %llu, "
+	       "\"errors\": %llu, ", dir_names[s->dir],
+	       (unsigned long long)st->bytes,
+	       (unsigned long long)st->transfers,
+	       (unsigned long long)st->errors);
+	if (s->dir == DIR_IN && s->b->verify)
+		printf("\"bad_data\": %llu, ",
+		       (unsigned long long)st->bad_data);
+	printf("\"mb_per_s\": %.2f, \"latency_us\": {\"p50\": %llu, "
+	       "\"p90\": %llu, \"p99\": %llu, \"p99.9\": %llu}}",
+	       secs > 0 ? st->bytes / 1e6 / secs : 0,
+	       (unsigned long long)hist_percentile(st->hist, 0.5),
+	       (unsigned long long)hist_percentile(st->hist, 0.9),
+	       (unsigned long long)hist_percentile(st->hist, 0.99),
+	       (unsigned long long)hist_percentile(st->hist, 0.999));
+}
+
+static int run_size(struct bench *b, size_t size, int first)
+{
+	struct timeval tv = { 0, 100000 };
+	uint64_t now, t_start = 0, t_stop = 0, t_warm;
+	double cpu = 0, secs, total = 0;
+	struct stream *s;
+	unsigned i;
+	int d, ret = 0;
+
+	b->size = size;
+	b->phase = PHASE_WARMUP;
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		s = &b->streams[d];
+		memset(&s->stats, 0, sizeof(s->stats));
+		s->failed = 0;
+		/* transfers cancelled at end of previous size lost data */
+		s->synced = 0;
+		if (!b->use[d])
+			continue;
+
+		ret = alloc_stream(s);
+		if (ret < 0)
+			goto out;
+	}
+
+	t_warm = now_ns() + (uint64_t)b->warmup * 1000000000ULL;
+	for (d = 0; d < DIR_NUM; ++d)
+		for (i = 0; b->use[d] && i < b->depth; ++i)
+			submit(&b->streams[d].xfers[i]);
+
+	while (!b->stop && (b->phase != PHASE_DONE || in_flight(b) > 0)) {
+		ret = libusb_handle_events_timeout_completed(b->ctx, &tv, NULL);
+		if (ret && ret != LIBUSB_ERROR_INTERRUPTED) {
+			fprintf(stderr, "event handling failed: %s\n",
+				libusb_error_name(ret));
+			b->stop = 1;
+			break;
+		}
+
+		now = now_ns();
+		if (b->phase == PHASE_WARMUP && now >= t_warm) {
+			b->phase = PHASE_MEASURE;
+			t_start = now;
+			cpu = cpu_seconds();
+		} else if (b->phase == PHASE_MEASURE &&
+			   now >= t_start + b->duration * 1000000000ULL) {
+			b->phase = PHASE_DONE;
+			t_stop = now;
+			cpu = cpu_seconds() - cpu;
+			cancel_all(b);
+		}
+
+		/* nothing left to wait for if both streams failed */
+		if (in_flight(b) == 0 && b->phase != PHASE_DONE)
+			break;
+	}
+
+	if (b->phase != PHASE_DONE) {
+		cancel_all(b);
+		while (in_flight(b) > 0 &&
+		       libusb_handle_events_timeout_completed(b->ctx, &tv,
+							      NULL) == 0)
+			;
+		fprintf(stderr, "size %zu: measurement interrupted\n", size);
+		ret = -EIO;
+		goto out;
+	}
+
+	secs = (t_stop - t_start) / 1e9;
+	printf("%s    {\"size\": %zu, \"seconds\": %.3f, ",
+	       first ? "" : ",\n", size, secs);
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (!b->use[d])
+			continue;
+		print_stream(&b->streams[d], secs);
+		printf(", ");
+		total += b->streams[d].stats.bytes;
+	}
+	printf("\"cpu_s_per_gb\": %.3f}", total > 0 ? cpu / (total / 1e9) : 0);
+	fflush(stdout);
+
+out:
+	for (d = 0; d < DIR_NUM; ++d)
+		free_stream(&b->streams[d]);
+	return ret;
+}
+
+/******************** Device *******************************/
+
+static int match_device(struct bench *b, libusb_device *dev)
+{
+	struct libusb_device_descriptor desc;
+	uint8_t ports[MAX_PORTS];
+	int n;
+
+	if (b->n_ports) {
+		if (libusb_get_bus_number(dev) != b->bus)
+			return 0;
+		n = libusb_get_port_numbers(dev, ports, MAX_PORTS);
+		return n == b->n_ports && !memcmp(ports, b->ports, n);
+	}
+
+	if (libusb_get_device_descriptor(dev, &desc))
+		return 0;
+
+	return desc.idVendor == b->vid && desc.idProduct == b->pid;
+}
+
+/* Finds first bulk endpoint of each direction in the interface */
+static int find_endpoints(struct bench *b, libusb_device *dev)
+{
+	struct libusb_config_descriptor *config;
+	const struct libusb_interface_descriptor *alt;
+	const struct libusb_endpoint_descriptor *ep;
+	int d, i, ret;
+
+	ret = libusb_get_active_config_descriptor(dev, &config);
+	if (ret)
+		return ret;
+
+	if (b->iface >= config->bNumInterfaces) {
+		ret = LIBUSB_ERROR_NOT_FOUND;
+		goto out;
+	}
+
+	alt = &config->interface[b->iface].altsetting[0];
+	for (i = 0; i < alt->bNumEndpoints; ++i) {
+		ep = &alt->endpoint[i];
+		if ((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) !=
+		    LIBUSB_TRANSFER_TYPE_BULK)
+			continue;
+
+		d = ep->bEndpointAddress & LIBUSB_ENDPOINT_IN ? DIR_IN : DIR_OUT;
+		if (!b->streams[d].ep)
+			b->streams[d].ep = ep->bEndpointAddress;
+	}
+
+	for (d = 0; d < DIR_NUM; ++d) {
+		if (b->use[d] && !b->streams[d].ep) {
+			fprintf(stderr, "no bulk %s endpoint\n", dir_names[d]);
+			ret = LIBUSB_ERROR_NOT_FOUND;
+		}
+	}
+
+out:
+	libusb_free_config_descriptor(config);
+	return ret;
+}
+
+static int open_device(struct bench *b)
+{
+	libusb_device **list;
+	libusb_device *found = NULL;
+	ssize_t cnt;
+	int i, ret;
+
+	cnt = libusb_get_device_list(b->ctx, &list);
+	if (cnt < 0)
+		return cnt;
+
+	for (i = 0; i < cnt; ++i) {
+		if (match_device(b, list[i])) {
+			found = list[i];
+			break;
+		}
+	}
+
+	if (!found) {
+		fprintf(stderr, "no devices found\n");
+		ret = LIBUSB_ERROR_NO_DEVICE;
+		goto out;
+	}
+
+	ret = find_endpoints(b, found);
+	if (ret)
+		goto out;
+
+	ret = libusb_open(found, &b->handle);
+	if (ret)
+		goto out;
+
+	if (libusb_kernel_driver_active(b->handle, b->iface) == 1) {
+		ret = libusb_detach_kernel_driver(b->handle, b->iface);
+		if (ret)
+			goto err_close;
+		b->attached = 1;
+	}
+
+	ret = libusb_claim_interface(b->handle, b->iface);
+	if (ret)
+		goto err_attach;
+
+	goto out;
+
+err_attach:
+	if (b->attached)
+		libusb_attach_kernel_driver(b->handle, b->iface);
+err_close:
+	libusb_close(b->handle);
+	b->handle = NULL;
+out:
+	libusb_free_device_list(list, 1);
+	return ret;
+}
+
+static void close_device(struct bench *b)
+{
+	libusb_release_interface(b->handle, b->iface);
+	if (b->attached)
+		libusb_attach_kernel_driver(b->handle, b->iface);
+	libusb_close(b->handle);
+}
+
+/******************** Options *******************************/
+
+static int parse_sizes(struct bench *b, const char *arg)
+{
+	unsigned long first, last;
+	char *end;
+
+	b->n_sizes = 0;
+	while (*arg) {
+		first = strtoul(arg, &end, 0);
+		if (end == arg || !first)
+			return -EINVAL;
+
+		last = first;
+		if (*end == '-') {
+			arg = end + 1;
+			last = strtoul(arg, &end, 0);
+			if (end == arg || last < first)
+				return -EINVAL;
+		}
+
+		for (; first <= last; first *= 2) {
+			if (b->n_sizes == MAX_SIZES)
+				return -EINVAL;
+			b->sizes[b->n_sizes++] = first;
+		}
+
+		if (*end == ',')
+			++end;
+		else if (*end)
+			return -EINVAL;
+		arg = end;
+	}
+
+	return b->n_sizes ? 0 : -EINVAL;
+}
+
+/* Parses path like 1-2.3 as shown in sysfs */
+static int parse_path(struct bench *b, const char *arg)
+{
+	unsigned long val;
+	char *end;
+
+	b->bus = strtoul(arg, &end, 10);
+	if (end == arg || *end != '-')
+		return -EINVAL;
+
+	b->n_ports = 0;
+	do {
+		arg = end + 1;
+		val = strtoul(arg, &end, 10);
+		if (end == arg || val > 255 || b->n_ports == MAX_PORTS)
+			return -EINVAL;
+		b->ports[b->n_ports++] = val;
+	} while (*end == '.');
+
+	return *end ? -EINVAL : 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-d vid:pid | -p bus-port.port...]"
+		" [-I interface]\n"
+		"\t[-m in|out|both] [-s sizes] [-n in flight]\n"
+		"\t[-w warm up seconds] [-t measure seconds] [-c] [-v]\n",
+		name);
+}
+
+static int parse_args(struct bench *b, int argc, char *argv[])
+{
+	int opt;
+
+	b->vid = VENDOR;
+	b->pid = PRODUCT;
+	b->use[DIR_IN] = b->use[DIR_OUT] = 1;
+	b->depth = DEFAULT_DEPTH;
+	b->warmup = 1;
+	b->duration = 5;
+	parse_sizes(b, DEFAULT_SIZES);
+
+	while ((opt = getopt(argc, argv, "d:p:I:m:s:n:w:t:cv")) != -1) {
+		switch (opt) {
+		case 'd':
+			if (sscanf(optarg, "%x:%x", &b->vid, &b->pid) != 2)
+				return -EINVAL;
+			break;
+		case 'p':
+			if (parse_path(b, optarg) < 0)
+				return -EINVAL;
+			break;
+		case 'I':
+			b->iface = atoi(optarg);
+			break;
+		case 'm':
+			b->use[DIR_IN] = strcmp(optarg, "out") != 0;
+			b->use[DIR_OUT] = strcmp(optarg, "in") != 0;
+			if (strcmp(optarg, "in") && strcmp(optarg, "out") &&
+			    strcmp(optarg, "both"))
+				return -EINVAL;
+			break;
+		case 's':
+			if (parse_sizes(b, optarg) < 0)
+				return -EINVAL;
+			break;
+		case 'n':
+			b->depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			b->warmup = atoi(optarg);
+			break;
+		case 't':
+			b->duration = atoi(optarg);
+			break;
+		case 'c':
+			b->counter = 1;
+			break;
+		case 'v':
+			b->verify = 1;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	if (!b->depth || b->warmup < 0 || b->duration <= 0 || b->iface < 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench b;
+	int d, i, ret;
+
+	memset(&b, 0, sizeof(b));
+	for (d = 0; d < DIR_NUM; ++d) {
+		b.streams[d].b = &b;
+		b.streams[d].dir = d;
+	}
+
+	if (parse_args(&b, argc, argv) < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	ret = libusb_init(&b.ctx);
+	if (ret) {
+		fprintf(stderr, "cannot init libusb: %s\n",
+			libusb_error_name(ret));
+		return 1;
+	}
+
+	ret = open_device(&b);
+	if (ret) {
+		fprintf(stderr, "cannot open device: %s\n",
+			libusb_error_name(ret));
+		libusb_exit(b.ctx);
+		return 1;
+	}
+
+	printf("{\n  \"depth\": %u, \"warmup_s\": %d, \"measure_s\": %d,\n",
+	       b.depth, b.warmup, b.duration);
+	for (d = 0; d < DIR_NUM; ++d)
+		if (b.use[d])
+			printf("  \"ep_%s\": \"0x%02x\",\n", dir_names[d],
+			       b.streams[d].ep);
+	printf("  \"results\": [\n");
+
+	ret = 0;
+	for (i = 0; i < b.n_sizes && !b.stop; ++i) {
+		ret = run_size(&b, b.sizes[i], i == 0);
+		if (ret < 0)
+			break;
+	}
+
+	printf("\n  ]\n}\n");
+
+	close_device(&b);
+	libusb_exit(b.ctx);
+
+	return ret < 0;
+}
@@ -37,7 +37,7 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <sys/eventfd.h>
@@ -47,8 +47,19 @@
 
 #include <linux/usb/functionfs.h>
 #include <gadgetd/ffs-daemon.h>
+#include <gadgetd/ffs-buf-pool.h>
+#include <gadgetd/ffs-ep0.h>
 
+/* wMaxPacketSize of high speed bulk endpoints from service file,
+   used if endpoint descriptor is not available yet */
+#define MAX_PACKET	512
 #define BUF_LEN		8192
+/* requests kept in flight on each endpoint */
+#define NREQ		4
+
+/* Vendor request answered with static reply */
+#define VENDOR_REQ_TYPE	(USB_DIR_IN | USB_TYPE_VENDOR | USB_RECIP_INTERFACE)
+#define VENDOR_REQ_NAME	0x01
 
 /******************** Descriptors and Strings *******************************/
 
@@ -59,7 +70,62 @@
 
 /******************** Endpoints handling *******************************/
 
-static void display_event(struct usb_functionfs_event *event)
+struct service {
+	int ep[3];
+	io_context_t io_ctx;
+	int evfd;
+	struct iocb iocb_in[NREQ], iocb_out[NREQ];
+	void *buf_in[NREQ], *buf_out[NREQ];
+	bool req_in[NREQ], req_out[NREQ];
+	bool ready;
+};
+
+static void queue_requests(struct service *s)
+{
+	struct iocb *iocb;
+	int i, ret;
+
+	for (i = 0; i < NREQ; ++i) {
+		if (s->req_in[i]) /* IN transfer already requested */
+			continue;
+
+		iocb = &s->iocb_in[i];
+		/* prepare request */
+		io_prep_pwrite(iocb, s->ep[1], s->buf_in[i], BUF_LEN, 0);
+		/* enable eventfs notification */
+		iocb->u.c.flags |= IOCB_FLAG_RESFD;
+		iocb->u.c.resfd = s->evfd;
+		/* submit table of requests */
+		ret = io_submit(s->io_ctx, 1, &iocb);
+		if (ret >= 0) { /* if ret > 0 request is queued */
+			s->req_in[i] = true;
+			printf("submit: in\n");
+		} else
+			perror("unable to submit request");
+	}
+
+	for (i = 0; i < NREQ; ++i) {
+		if (s->req_out[i]) /* OUT transfer already requested */
+			continue;
+
+		iocb = &s->iocb_out[i];
+		/* prepare request */
+		io_prep_pread(iocb, s->ep[2], s->buf_out[i], BUF_LEN, 0);
+		/* enable eventfs notification */
+		iocb->u.c.flags |= IOCB_FLAG_RESFD;
+		iocb->u.c.resfd = s->evfd;
+		/* submit table of requests */
+		ret = io_submit(s->io_ctx, 1, &iocb);
+		if (ret >= 0) { /* if ret > 0 request is queued */
+			s->req_out[i] = true;
+			printf("submit: out\n");
+		} else
+			perror("unable to submit request");
+	}
+}
+
+static void handle_event(struct gd_ep0 *e,
+			 enum usb_functionfs_event_type type, void *data)
 {
 	static const char *const names[] = {
 		[FUNCTIONFS_BIND] = "BIND",
@@ -70,70 +136,72 @@ static void display_event(struct usb_functionfs_event *event)
 		[FUNCTIONFS_SUSPEND] = "SUSPEND",
 		[FUNCTIONFS_RESUME] = "RESUME",
 	};
-	switch (event->type) {
-	case FUNCTIONFS_BIND:
-	case FUNCTIONFS_UNBIND:
+	struct service *s = data;
+
+	printf("Event %s\n", names[type]);
+
+	switch (type) {
 	case FUNCTIONFS_ENABLE:
+		s->ready = true;
+		/* connection speed may have changed */
+		gd_update_ep_descs();
+		queue_requests(s);
+		break;
+
 	case FUNCTIONFS_DISABLE:
-	case FUNCTIONFS_SETUP:
-	case FUNCTIONFS_SUSPEND:
-	case FUNCTIONFS_RESUME:
-		printf("Event %s\n", names[event->type]);
+		s->ready = false;
+		break;
+
+	default:
+		break;
 	}
 }
 
-static void handle_ep0(int ep0, bool *ready)
+static int handle_aio(struct gd_ep0 *e, int fd, uint32_t events, void *data)
 {
-	struct usb_functionfs_event event;
-	int ret;
-
-	struct pollfd pfds[1];
-	pfds[0].fd = ep0;
-	pfds[0].events = POLLIN;
+	struct service *s = data;
+	struct io_event ev[2 * NREQ];
+	uint64_t ev_cnt;
+	int i, ret;
 
-	ret = poll(pfds, 1, 0);
+	ret = read(s->evfd, &ev_cnt, sizeof(ev_cnt));
+	if (ret < 0) {
+		perror("unable to read eventfd");
+		return -errno;
+	}
 
-	if (ret && (pfds[0].revents & POLLIN)) {
-		ret = read(ep0, &event, sizeof(event));
-		if (!ret) {
-			perror("unable to read event from ep0");
-			return;
-		}
-		display_event(&event);
-		switch (event.type) {
-		case FUNCTIONFS_SETUP:
-			if (event.u.setup.bRequestType & USB_DIR_IN)
-				write(ep0, NULL, 0);
-			else
-				read(ep0, NULL, 0);
-			break;
-
-		case FUNCTIONFS_ENABLE:
-			*ready = true;
-			break;
-
-		case FUNCTIONFS_DISABLE:
-			*ready = false;
-			break;
-
-		default:
-			break;
+	/* we wait for at least one event */
+	ret = io_getevents(s->io_ctx, 1, 2 * NREQ, ev, NULL);
+	/* if we got event */
+	for (i = 0; i < ret; ++i) {
+		if (ev[i].obj->aio_fildes == s->ep[1]) {
+			printf("ev=in; ret=%lu\n", ev[i].res);
+			s->req_in[ev[i].obj - s->iocb_in] = false;
+		} else if (ev[i].obj->aio_fildes == s->ep[2]) {
+			printf("ev=out; ret=%lu\n", ev[i].res);
+			s->req_out[ev[i].obj - s->iocb_out] = false;
 		}
 	}
+
+	/* we are waiting for function ENABLE */
+	if (s->ready)
+		queue_requests(s);
+
+	return 0;
 }
 
 int main(int argc, char *argv[])
 {
+	static const char name[] = "ffs-service-example";
 	int i, ret;
-	int ep[3];
-	io_context_t io_ctx;
-	int evfd;
-	fd_set rfds;
-	char buf_in[BUF_LEN], buf_out[BUF_LEN];
-	struct iocb iocb_in, iocb_out;
-	int req_in = 0, req_out = 0;
-	bool ready;
-	enum usb_functionfs_event_type e;
+	struct service s;
+	struct gd_buf_pool *pool;
+	struct gd_ep0 *e;
+	struct gd_ep_desc desc;
+	int max_packet = MAX_PACKET;
+	enum usb_functionfs_event_type ev;
+
+	memset(&s, 0, sizeof(s));
 
 	/*
 	 * We don't need to open any file descriptors because they are
@@ -149,131 +217,100 @@ int main(int argc, char *argv[])
 	}
 
 	for (i = 0; i < 3; ++i) {
-		ep[i] = gd_get_ep_by_nmb(i);
-		if (ep[i] < 0) {
+		s.ep[i] = gd_get_ep_by_nmb(i);
+		if (s.ep[i] < 0) {
 			perror("Unable to get descriptors");
 			return 1;
 		}
 	}
 
+	if (gd_lock_memory(0) < 0)
+		perror("Unable to lock memory");
+
 	/* Check what was our activation event */
-	e = gd_get_activation_event(0);
-	switch (e) {
+	ev = gd_get_activation_event(0);
+	switch (ev) {
 	case FUNCTIONFS_BIND:
-		ready = false;
+		s.ready = false;
 		break;
 	case FUNCTIONFS_ENABLE:
 	case FUNCTIONFS_SETUP:
-		ready = true;
+		s.ready = true;
 		break;
 	default:
 		perror("Error or unsupported activation event");
 		return 1;
 	}
 
-	memset(&io_ctx, 0, sizeof(io_ctx));
-	/* setup aio context to handle up to 2 requests */
-	if (io_setup(2, &io_ctx) < 0) {
+	/* Use negotiated packet size if host has already enabled us */
+	if (gd_get_ep_desc(s.ep[1], &desc) == 0)
+		max_packet = desc.max_packet;
+
+	/* one buffer for each request, backed by huge pages if possible */
+	pool = gd_buf_pool_new(max_packet, BUF_LEN / max_packet, 2 * NREQ,
+			       GD_BUF_POOL_HUGEPAGE);
+	if (!pool) {
+		perror("unable to create buffer pool");
+		return 1;
+	}
+
+	for (i = 0; i < NREQ; ++i) {
+		s.buf_in[i] = gd_buf_pool_get(pool);
+		s.buf_out[i] = gd_buf_pool_get(pool);
+	}
+
+	/* setup aio context to handle all requests */
+	if (io_setup(2 * NREQ, &s.io_ctx) < 0) {
 		perror("unable to setup aio");
 		return 1;
 	}
 
-	evfd = eventfd(0, 0);
-	if (evfd < 0) {
+	s.evfd = eventfd(0, 0);
+	if (s.evfd < 0) {
 		perror("unable to open eventfd");
 		return 1;
 	}
 
-	/* If we are ready we skip initial select */
-	if (ready)
-		goto queue_requests;
+	/* ep0 events and aio completions are handled by one loop */
+	e = gd_ep0_new(s.ep[0]);
+	if (!e) {
+		perror("unable to create ep0 loop");
+		return 1;
+	}
 
-	while (1) {
-		FD_ZERO(&rfds);
-		FD_SET(ep[0], &rfds);
-		FD_SET(evfd, &rfds);
+	for (ev = FUNCTIONFS_BIND; ev <= FUNCTIONFS_RESUME; ++ev)
+		gd_ep0_set_event_handler(e, ev, handle_event, &s);
 
-		ret = select(((ep[0] > evfd) ? ep[0] : evfd)+1,
-			     &rfds, NULL, NULL, NULL);
+	/* other control requests are stalled */
+	gd_ep0_add_static_reply(e, VENDOR_REQ_TYPE, VENDOR_REQ_NAME,
+				name, sizeof(name));
 
-		if (ret < 0) {
-			if (errno == EINTR)
-				continue;
-			perror("select");
-			break;
-		}
+	if (gd_ep0_add_fd(e, s.evfd, EPOLLIN, handle_aio, &s) < 0) {
+		perror("unable to watch eventfd");
+		return 1;
+	}
 
-		if (FD_ISSET(ep[0], &rfds))
-			handle_ep0(ep[0], &ready);
+	/* If we are ready we don't wait for ENABLE */
+	if (s.ready)
+		queue_requests(&s);
 
-		/* we are waiting for function ENABLE */
-		if (!ready)
-			continue;
+	ret = gd_ep0_run(e);
+	if (ret < 0)
+		fprintf(stderr, "ep0 loop failed: %s\n", strerror(-ret));
 
-		/* if something was submitted we wait for event */
-		if (FD_ISSET(evfd, &rfds)) {
-			uint64_t ev_cnt;
-			ret = read(evfd, &ev_cnt, sizeof(ev_cnt));
-			if (ret < 0) {
-				perror("unable to read eventfd");
-				break;
-			}
-
-			struct io_event e[2];
-			/* we wait for one event */
-			ret = io_getevents(io_ctx, 1, 2, e, NULL);
-			/* if we got event */
-			for (i = 0; i < ret; ++i) {
-				if (e[i].obj->aio_fildes == ep[1]) {
-					printf("ev=in; ret=%lu\n", e[i].res);
-					req_in = 0;
-				} else if (e[i].obj->aio_fildes == ep[2]) {
-					printf("ev=out; ret=%lu\n", e[i].res);
-					req_out = 0;
-				}
-			}
-		}
-
-queue_requests:
-		if (!req_in) { /* if IN transfer not requested*/
-			struct iocb *iocb = &iocb_in;
-			/* prepare request */
-			io_prep_pwrite(iocb, ep[1], buf_in, BUF_LEN, 0);
-			/* enable eventfs notification */
-			iocb->u.c.flags |= IOCB_FLAG_RESFD;
-			iocb->u.c.resfd = evfd;
-			/* submit table of requests */
-			ret = io_submit(io_ctx, 1, &iocb);
-			if (ret >= 0) { /* if ret > 0 request is queued */
-				req_in = 1;
-				printf("submit: in\n");
-			} else
-				perror("unable to submit request");
-		}
+	/* free resources */
+	gd_ep0_free(e);
+	io_destroy(s.io_ctx);
+	close(s.evfd);
 
-		if (!req_out) { /* if OUT transfer not requested */
-			struct iocb *iocb = &iocb_out;
-			/* prepare request */
-			io_prep_pread(iocb, ep[2], buf_out, BUF_LEN, 0);
-			/* enable eventfs notification */
-			iocb->u.c.flags |= IOCB_FLAG_RESFD;
-			iocb->u.c.resfd = evfd;
-			/* submit table of requests */
-			ret = io_submit(io_ctx, 1, &iocb);
-			if (ret >= 0) { /* if ret > 0 request is queued */
-				req_out = 1;
-				printf("submit: out\n");
-			} else
-				perror("unable to submit request");
-		}
+	for (i = 0; i < NREQ; ++i) {
+		gd_buf_pool_put(pool, s.buf_in[i]);
+		gd_buf_pool_put(pool, s.buf_out[i]);
 	}
-
-	/* free resources */
-	io_destroy(io_ctx);
+	gd_buf_pool_free(pool);
 
 	for (i = 0; i < 3; ++i)
-		close(ep[i]);
+		close(s.ep[i]);
 
 	return 0;
 }
-
@@ -0,0 +1,226 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org/>
+ */
+
+/*
+ * Compares serial and parallel bind of gadgets to many UDCs
+ * using the executor of gadgetd BindMany method.
+ *
+ * One gadget with single ECM function is created for each UDC.
+ * For 1, 2, 4... UDCs all gadgets are bound and unbound in one
+ * batch, first by single thread and then by one thread per UDC.
+ * Results are printed as JSON, one line per measurement.
+ *
+ * Many UDCs are easily got with: modprobe dummy_hcd num=16
+ *
+ * Usage: udc-bind-bench [max UDCs] [repeats] [configfs mount point]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <usbg/usbg.h>
+
+#include <gadgetd-bind-executor.h>
+
+#define DEFAULT_REPEATS	5
+#define DEFAULT_CONFIGFS	"/sys/kernel/config"
+#define MAX_UDCS	64
+
+struct bench {
+	usbg_state *s;
+	usbg_udc *udcs[MAX_UDCS];
+	usbg_gadget *gadgets[MAX_UDCS];
+	int n;
+};
+
+static int create_gadgets(struct bench *b, int max)
+{
+	usbg_gadget_attrs attrs = {
+		.bcdUSB = 0x0200,
+		.idVendor = 0x1d6b,
+		.idProduct = 0x0104,
+	};
+	usbg_function *f;
+	usbg_config *c;
+	usbg_udc *u;
+	char name[32];
+	int ret;
+
+	usbg_for_each_udc(u, b->s) {
+		if (b->n == max)
+			break;
+
+		snprintf(name, sizeof(name), "bind-bench%d", b->n);
+		ret = usbg_create_gadget(b->s, name, &attrs, NULL,
+					 &b->gadgets[b->n]);
+		if (ret != USBG_SUCCESS)
+			goto err;
+
+		ret = usbg_create_function(b->gadgets[b->n], F_ECM, "bench",
+					   NULL, &f);
+		if (ret != USBG_SUCCESS)
+			goto err;
+
+		ret = usbg_create_config(b->gadgets[b->n], 1, "bench", NULL,
+					 NULL, &c);
+		if (ret != USBG_SUCCESS)
+			goto err;
+
+		ret = usbg_add_config_function(c, "ecm.bench", f);
+		if (ret != USBG_SUCCESS)
+			goto err;
+
+		b->udcs[b->n++] = u;
+	}
+
+	return 0;
+err:
+	fprintf(stderr, "unable to create %s: %s\n", name,
+		usbg_strerror(ret));
+	if (b->gadgets[b->n])
+		usbg_rm_gadget(b->gadgets[b->n], USBG_RM_RECURSE);
+	return -1;
+}
+
+static void remove_gadgets(struct bench *b)
+{
+	int i;
+
+	for (i = 0; i < b->n; ++i)
+		usbg_rm_gadget(b->gadgets[i], USBG_RM_RECURSE);
+}
+
+static gint64 run_batch(struct bench *b, int n, int enable, int threads,
+			gint64 *slowest)
+{
+	struct gd_bind_job jobs[MAX_UDCS];
+	gint64 start;
+	gint64 total;
+	int failed = 0;
+	int i;
+
+	for (i = 0; i < n; ++i) {
+		jobs[i].g = b->gadgets[i];
+		jobs[i].u = b->udcs[i];
+		jobs[i].enable = enable;
+	}
+
+	start = g_get_monotonic_time();
+	gd_bind_executor_run(jobs, n, threads);
+	total = g_get_monotonic_time() - start;
+
+	*slowest = 0;
+	for (i = 0; i < n; ++i) {
+		if (jobs[i].usbg_ret != USBG_SUCCESS)
+			++failed;
+		if (jobs[i].usec > *slowest)
+			*slowest = jobs[i].usec;
+	}
+
+	if (failed)
+		fprintf(stderr, "%d of %d %s failed\n", failed, n,
+			enable ? "binds" : "unbinds");
+
+	return total;
+}
+
+static void measure(struct bench *b, int n, int threads, int repeats)
+{
+	gint64 bind = 0, unbind = 0;
+	gint64 bind_max = 0, slowest;
+	int i;
+
+	for (i = 0; i < repeats; ++i) {
+		bind += run_batch(b, n, 1, threads, &slowest);
+		if (slowest > bind_max)
+			bind_max = slowest;
+		unbind += run_batch(b, n, 0, threads, &slowest);
+	}
+
+	printf("{\"udcs\": %d, \"threads\": %d, \"bind_us\": %" G_GINT64_FORMAT
+	       ", \"slowest_bind_us\": %" G_GINT64_FORMAT
+	       ", \"unbind_us\": %" G_GINT64_FORMAT "}\n",
+	       n, threads, bind / repeats, bind_max, unbind / repeats);
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench b;
+	const char *configfs = DEFAULT_CONFIGFS;
+	int repeats = DEFAULT_REPEATS;
+	int max = MAX_UDCS;
+	int n;
+	int ret;
+
+	if (argc > 1)
+		max = atoi(argv[1]);
+	if (argc > 2)
+		repeats = atoi(argv[2]);
+	if (argc > 3)
+		configfs = argv[3];
+
+	if (max <= 0 || max > MAX_UDCS || repeats <= 0) {
+		fprintf(stderr, "usage: %s [max UDCs <= %d] [repeats] [configfs]\n",
+			argv[0], MAX_UDCS);
+		return 1;
+	}
+
+	memset(&b, 0, sizeof(b));
+	ret = usbg_init(configfs, &b.s);
+	if (ret != USBG_SUCCESS) {
+		fprintf(stderr, "unable to init libusbg: %s\n",
+			usbg_strerror(ret));
+		return 1;
+	}
+
+	ret = 1;
+	if (create_gadgets(&b, max) < 0)
+		goto out;
+	if (b.n == 0) {
+		fprintf(stderr, "no UDC to bench\n");
+		goto out;
+	}
+
+	for (n = 1; ; n *= 2) {
+		if (n > b.n)
+			n = b.n;
+		measure(&b, n, 1, repeats);
+		if (n > 1)
+			measure(&b, n, n, repeats);
+		if (n == b.n)
+			break;
+	}
+
+	ret = 0;
+out:
+	gd_bind_executor_shutdown();
+	remove_gadgets(&b);
+	usbg_cleanup(b.s);
+	return ret;
+}
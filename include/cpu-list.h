@@ -0,0 +1,39 @@
+/*
+ * cpu-list.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CPU_LIST_H
+#define CPU_LIST_H
+
+/**
+ * @file cpu-list.h
+ * @brief Parser of cpu lists shared by gadgetd and libffs-daemon
+ *
+ * Users have to define _GNU_SOURCE for cpu_set_t.
+ */
+
+#include <sched.h>
+
+/**
+ * @brief Parse cpu list in kernel cpulist format, eg. "0-3,6"
+ * @param[in] list String to be parsed
+ * @param[out] set Cpu set filled with listed cpus
+ * @return 0 on success, -EINVAL if list is malformed, empty
+ * or contains cpu above CPU_SETSIZE
+ */
+int cpu_list_parse(const char *list, cpu_set_t *set);
+
+#endif /* CPU_LIST_H */
@@ -0,0 +1,42 @@
+/*
+ * gadgetd-ffs-function-iface.h
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_FFS_FUNCTION_IFACE_H
+#define GADGETD_FFS_FUNCTION_IFACE_H
+
+#include <glib-object.h>
+#include <gio/gio.h>
+#include <usbg/usbg.h>
+
+#include <gadgetd-function-object.h>
+
+G_BEGIN_DECLS
+
+struct _FunctionFfsAttrs;
+typedef struct _FunctionFfsAttrs FunctionFfsAttrs;
+
+typedef struct _FunctionFfsAttrsClass	FunctionFfsAttrsClass;
+
+#define FUNCTION_TYPE_FFS_ATTRS      (function_ffs_attrs_get_type ())
+#define FUNCTION_FFS_ATTRS(o)        (G_TYPE_CHECK_INSTANCE_CAST ((o), FUNCTION_TYPE_FFS_ATTRS, FunctionFfsAttrs))
+#define FUNCTION_IS_FFS_ATTRS(o)     (G_TYPE_CHECK_INSTANCE_TYPE ((o), FUNCTION_TYPE_FFS_ATTRS))
+
+GType function_ffs_attrs_get_type (void) G_GNUC_CONST;
+FunctionFfsAttrs *function_ffs_attrs_new(GadgetdFunctionObject *function_object);
+G_END_DECLS
+
+#endif /* GADGETD_FFS_FUNCTION_IFACE_H */
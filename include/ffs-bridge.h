@@ -0,0 +1,82 @@
+/*
+ * ffs-bridge.h
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FFS_BRIDGE_H
+#define FFS_BRIDGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Bridge which moves data between pair of bulk endpoints and
+  a socket, pipe or other file descriptor.
+
+  Data is moved with splice(2) through a pipe, so it is not copied
+  to user space. If splice is not supported by any of descriptors
+  bridge falls back to read/write with two buffers, so that reading
+  of next chunk overlaps with writing of previous one. Function fs
+  endpoints do not support splice on current kernels, so with real
+  endpoints data is copied after the first chunk.
+*/
+
+enum gd_bridge_flags {
+	/*
+	 * Terminate transfer to host with zero length packet when
+	 * source has been drained and chunk ends on packet boundary
+	 */
+	GD_BRIDGE_ZLP = 1 << 0,
+	/* Do not try splice, always copy data */
+	GD_BRIDGE_NO_SPLICE = 1 << 1,
+};
+
+struct gd_bridge_config {
+	/* IN endpoint (device to host) or -1 */
+	int ep_in;
+	/* OUT endpoint (host to device) or -1 */
+	int ep_out;
+	/* data read from this descriptor are sent to ep_in */
+	int rd_fd;
+	/* data received from ep_out are written to this descriptor */
+	int wr_fd;
+	/* wMaxPacketSize of ep_in, required for GD_BRIDGE_ZLP */
+	size_t max_packet;
+	/* maximum size of single transfer */
+	size_t buf_len;
+	int flags;
+};
+
+struct gd_bridge_stats {
+	/* bytes sent to ep_in */
+	uint64_t to_host;
+	/* bytes received from ep_out */
+	uint64_t from_host;
+	/* set if direction has been handled with splice until the end */
+	int to_host_spliced;
+	int from_host_spliced;
+};
+
+/*
+  Runs the bridge until rd_fd reaches end of file or error occurs
+  in any direction. Zero length packets received from host are
+  skipped and do not end the bridge.
+  Returns 0 on end of file or negative errno code.
+  If stats is not NULL it is filled with transfer statistics.
+ */
+int gd_bridge_run(const struct gd_bridge_config *cfg,
+		  struct gd_bridge_stats *stats);
+
+#endif /* FFS_BRIDGE_H */
@@ -0,0 +1,87 @@
+/*
+ * ffs-buf-pool.h
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FFS_BUF_POOL_H
+#define FFS_BUF_POOL_H
+
+#include <stddef.h>
+
+/*
+  Pool of transfer buffers.
+
+  All buffers are carved from one memory region, so the whole pool
+  may be registered once (eg. in io_uring) and buffers may be passed
+  between endpoint requests and user code without copying data.
+  Buffers are recycled through a lock-free list, so they may be
+  taken and returned by different threads.
+*/
+
+struct gd_buf_pool;
+
+enum gd_buf_pool_flags {
+	/* Try to back the pool with huge pages, fall back to normal pages */
+	GD_BUF_POOL_HUGEPAGE = 1 << 0,
+	/* Lock pool in memory, creating the pool fails if this is not possible */
+	GD_BUF_POOL_MLOCK = 1 << 1,
+};
+
+/*
+  Creates pool of n_bufs buffers. Each buffer can hold packets
+  packets of max_packet bytes, where max_packet should be
+  wMaxPacketSize of endpoint. Returns NULL on failure and sets errno.
+ */
+struct gd_buf_pool *gd_buf_pool_new(size_t max_packet, unsigned packets,
+				    unsigned n_bufs, int flags);
+
+/*
+  Frees the pool. All buffers must have been returned before.
+ */
+void gd_buf_pool_free(struct gd_buf_pool *pool);
+
+/*
+  Takes free buffer from pool. Returns NULL if pool is empty.
+ */
+void *gd_buf_pool_get(struct gd_buf_pool *pool);
+
+/*
+  Returns buffer taken by gd_buf_pool_get() to the pool.
+ */
+void gd_buf_pool_put(struct gd_buf_pool *pool, void *buf);
+
+/*
+  Returns size of each buffer.
+ */
+size_t gd_buf_pool_buf_len(struct gd_buf_pool *pool);
+
+/*
+  Returns number of buffers in the pool.
+ */
+unsigned gd_buf_pool_size(struct gd_buf_pool *pool);
+
+/*
+  Returns index of buffer in pool or negative errno code
+  if buffer does not belong to the pool.
+ */
+int gd_buf_pool_index(struct gd_buf_pool *pool, const void *buf);
+
+/*
+  Returns memory region which holds all buffers and stores its length
+  in len. Region may be registered for fixed buffer transfers.
+ */
+void *gd_buf_pool_region(struct gd_buf_pool *pool, size_t *len);
+
+#endif /* FFS_BUF_POOL_H */
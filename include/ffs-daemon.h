@@ -28,23 +28,57 @@
 /*
   Returns how many endpoint descriptors have been passed,
   including ep0 or negative errno code on failure.
+  Eventfd passed after endpoints is not counted.
 */
 int gd_nmb_of_ep(int unset_environment);
 
-/* Currently stab */
 /*
-  Return what is the type of given edpoint
+  Return transfer type (USB_ENDPOINT_XFER_*) of given endpoint
+  or negative errno code.
  */
 int gd_get_ep_type(int ep_fd);
 
-/* Currently stab */
 /*
   Return what is the number of given endpoint
   This functions does not depend on gadgetd conventions
   but check the real number of ep on function fs.
+  Returns negative errno code on failure.
  */
 int gd_get_ep_nmb(int ep_fd);
 
+struct gd_ep_desc {
+	/* bEndpointAddress assigned by UDC or negative errno code */
+	int address;
+	/* number of ep on function fs */
+	int nmb;
+	/* USB_DIR_IN or USB_DIR_OUT */
+	int direction;
+	/* USB_ENDPOINT_XFER_* */
+	int type;
+	/* wMaxPacketSize without high speed multiplier */
+	int max_packet;
+	/* transactions per microframe, 1 if not high bandwidth */
+	int mult;
+	/* bInterval */
+	int interval;
+};
+
+/*
+  Get descriptor of given endpoint for current connection speed.
+  Descriptors are read when gd_nmb_of_ep() is called and cached.
+  Endpoint descriptor is available only when function is enabled,
+  otherwise -ENODEV is returned.
+  Returns 0 on success or negative errno code.
+ */
+int gd_get_ep_desc(int ep_fd, struct gd_ep_desc *desc);
+
+/*
+  Read descriptors of all endpoints again. Should be called after
+  FUNCTIONFS_ENABLE because connection speed may have changed.
+  Returns 0 on success or negative errno code.
+ */
+int gd_update_ep_descs(void);
+
 /*
   Get your endpoint descriptor by given number.
   You should not call this function with
@@ -55,9 +89,26 @@ inline int gd_get_ep_by_nmb(int nmb)
 	return GD_ENDPOINT_FDS_START + nmb;
 }
 
+/*
+  Get eventfd which is signalled by function fs when aio request
+  on any endpoint completes or ep0 event arrives. It is passed only
+  if FUNCTIONFS_EVENTFD is set in ffs_flags of service file.
+  Descriptor is non-blocking. Valid after gd_nmb_of_ep() has been
+  called, returns -ENOENT if eventfd has not been passed.
+*/
+int gd_get_ffs_eventfd(void);
+
 /*
   Get event which activated this daemon.
 */
 enum usb_functionfs_event_type gd_get_activation_event(int unset_environment);
 
+/*
+  Locks all current and future pages of service in memory
+  if mlockall option has been set in service file.
+  Returns 1 if memory has been locked, 0 if it was not requested
+  or negative errno code on failure.
+*/
+int gd_lock_memory(int unset_environment);
+
 #endif /* FFS_DAEMON_H */
@@ -0,0 +1,114 @@
+/*
+ * ffs-dmabuf.h
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FFS_DMABUF_H
+#define FFS_DMABUF_H
+
+#include <stddef.h>
+
+/*
+  DMA-buf transfers on function fs endpoints.
+
+  Buffer is attached to endpoint once and then each transfer only
+  queues a request, data is never copied between user and kernel.
+  Completion of transfer is signalled by a fence which is returned
+  as sync file descriptor, so it may be polled together with other
+  descriptors.
+
+  Kernels without DMA-buf support in function fs return -ENOTSUP
+  from gd_dmabuf_attach(), gd_ep_queue (ffs-ep-queue.h) uses this to
+  fall back to ordinary transfers.
+*/
+
+struct gd_dmabuf;
+
+enum gd_dmabuf_source {
+	/* Try DMA heap first, then udmabuf */
+	GD_DMABUF_ANY,
+	/* /dev/dma_heap/system */
+	GD_DMABUF_HEAP,
+	/* memfd exported by /dev/udmabuf */
+	GD_DMABUF_UDMABUF
+};
+
+/*
+  Allocates DMA-buf of given length and maps it. Length is rounded
+  up to page size. Returns NULL on failure and sets errno.
+ */
+struct gd_dmabuf *gd_dmabuf_new(size_t len, enum gd_dmabuf_source src);
+
+/*
+  Unmaps and closes the buffer. It has to be detached before.
+ */
+void gd_dmabuf_free(struct gd_dmabuf *buf);
+
+/*
+  Returns DMA-buf file descriptor.
+ */
+int gd_dmabuf_fd(struct gd_dmabuf *buf);
+
+/*
+  Returns CPU mapping of the buffer.
+ */
+void *gd_dmabuf_data(struct gd_dmabuf *buf);
+
+/*
+  Returns length of the buffer.
+ */
+size_t gd_dmabuf_len(struct gd_dmabuf *buf);
+
+/*
+  Brackets CPU access to the buffer, so that caches are kept coherent
+  with device. write is non zero if CPU is going to modify the data.
+  Returns 0 on success or negative errno code.
+ */
+int gd_dmabuf_cpu_begin(struct gd_dmabuf *buf, int write);
+int gd_dmabuf_cpu_end(struct gd_dmabuf *buf, int write);
+
+/*
+  Attaches buffer to endpoint. Returns 0 on success, -ENOTSUP if kernel
+  does not support DMA-buf on function fs or other negative errno code.
+ */
+int gd_dmabuf_attach(int ep_fd, struct gd_dmabuf *buf);
+
+/*
+  Detaches buffer from endpoint. Transfers in progress are cancelled.
+  Returns 0 on success or negative errno code.
+ */
+int gd_dmabuf_detach(int ep_fd, struct gd_dmabuf *buf);
+
+/*
+  Queues transfer of first len bytes of attached buffer. Direction is
+  given by endpoint. Returns fence of transfer as sync file descriptor,
+  which has to be closed by caller, or negative errno code.
+ */
+int gd_dmabuf_transfer(int ep_fd, struct gd_dmabuf *buf, size_t len);
+
+/*
+  Returns 1 if fence has been signalled successfully, 0 if transfer
+  is still in progress or negative errno code if transfer failed.
+ */
+int gd_dmabuf_fence_status(int fence_fd);
+
+/*
+  Waits up to timeout miliseconds (-1 means forever) for fence.
+  Returns 0 on success, -ETIME on timeout or negative errno code
+  if transfer failed.
+ */
+int gd_dmabuf_fence_wait(int fence_fd, int timeout);
+
+#endif /* FFS_DMABUF_H */
@@ -0,0 +1,181 @@
+/*
+ * ffs-ep-queue.h
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FFS_EP_QUEUE_H
+#define FFS_EP_QUEUE_H
+
+#include <stddef.h>
+
+/*
+  Asynchronous endpoint I/O based on io_uring.
+
+  Each endpoint gets a fixed number of requests which are kept in flight.
+  Request buffers are registered in the ring and endpoint descriptors
+  are used as fixed files, so the kernel does not have to map them
+  for each transfer.
+*/
+
+struct gd_ep_queue;
+struct gd_buf_pool;
+
+enum gd_ep_direction {
+	/* device to host, requests are writes */
+	GD_EP_IN,
+	/* host to device, requests are reads */
+	GD_EP_OUT
+};
+
+enum gd_ep_queue_flags {
+	/*
+	 * Transfer data with DMA-bufs attached to IN endpoint (see
+	 * ffs-dmabuf.h) if kernel supports this, otherwise silently
+	 * use ordinary requests. Request buffers cannot be exchanged.
+	 * Completion of DMA-buf transfer does not tell how many bytes
+	 * have been received in short OUT transfer, so OUT endpoints
+	 * always use ordinary requests.
+	 */
+	GD_EP_QUEUE_DMABUF = 1 << 0,
+};
+
+struct gd_ep_queue_config {
+	/* endpoint file descriptor, eg. from gd_get_ep_by_nmb() */
+	int fd;
+	enum gd_ep_direction direction;
+	/* number of requests kept in flight */
+	unsigned depth;
+	/* size of buffer of each request */
+	size_t buf_len;
+	/* gd_ep_queue_flags */
+	int flags;
+};
+
+struct gd_ep_request {
+	/* index of endpoint in table given to gd_ep_queue_new() */
+	int ep;
+	void *buf;
+	/* number of bytes to transfer, buf_len by default */
+	size_t length;
+	/* number of bytes transferred or negative errno code */
+	int result;
+};
+
+/* Values returned by completion callback */
+enum gd_ep_request_action {
+	/* Submit the same request once again */
+	GD_EP_REQ_REQUEUE = 0,
+	/* Keep request idle, it may be submitted with gd_ep_queue_submit() */
+	GD_EP_REQ_HOLD = 1
+};
+
+/*
+  Called for each completed request. Returns gd_ep_request_action
+  or negative errno code to stop gd_ep_queue_run().
+  For IN endpoints buffer may be refilled and length changed before
+  the request is requeued.
+ */
+typedef int (*gd_ep_complete_fn)(struct gd_ep_queue *q,
+				 struct gd_ep_request *req,
+				 void *user_data);
+
+/*
+  Creates queue for given endpoints. Returns NULL on failure
+  and sets errno.
+ */
+struct gd_ep_queue *gd_ep_queue_new(const struct gd_ep_queue_config *eps,
+				    int n_eps, gd_ep_complete_fn complete,
+				    void *user_data);
+
+/*
+  Creates queue which takes request buffers from given pool.
+  Whole pool is registered, so in completion callback buffer of request
+  may be exchanged with any other buffer from this pool, eg. to pass
+  received data to another thread without copying it.
+  Buffers held by requests are returned to the pool by gd_ep_queue_free().
+  Pool must outlive the queue. GD_EP_QUEUE_DMABUF flag is ignored.
+ */
+struct gd_ep_queue *gd_ep_queue_new_with_pool(
+	const struct gd_ep_queue_config *eps, int n_eps,
+	struct gd_buf_pool *pool, gd_ep_complete_fn complete,
+	void *user_data);
+
+/*
+  Cancels all requests and frees the queue.
+  Endpoints should be disabled (gadget unbound or FUNCTIONFS_DISABLE
+  received) before, see gd_ep_queue_cancel(). Otherwise each request
+  which is not cancelled is waited for one second and then its buffer
+  is leaked, because kernel may still use it.
+ */
+void gd_ep_queue_free(struct gd_ep_queue *q);
+
+/*
+  Returns i-th request of given endpoint or NULL. May be used to fill
+  buffers of IN endpoint before gd_ep_queue_start().
+ */
+struct gd_ep_request *gd_ep_queue_request(struct gd_ep_queue *q, int ep,
+					  unsigned i);
+
+/*
+  Submits all idle requests of given endpoint, -1 means all endpoints.
+  Returns 0 on success or negative errno code.
+ */
+int gd_ep_queue_start(struct gd_ep_queue *q, int ep);
+
+/*
+  Submits single idle request. Returns 0 on success or negative errno code.
+ */
+int gd_ep_queue_submit(struct gd_ep_queue *q, struct gd_ep_request *req);
+
+/*
+  Cancels requests in flight of given endpoint, -1 means all endpoints.
+  Callback is called for each cancelled request with result -ECANCELED.
+  Function fs endpoints cannot be polled, so read or write which is
+  already blocked in endpoint is not cancelled. It completes only when
+  data is transferred or endpoint is disabled, typically with -ESHUTDOWN.
+ */
+int gd_ep_queue_cancel(struct gd_ep_queue *q, int ep);
+
+/*
+  Returns number of requests in flight.
+ */
+int gd_ep_queue_in_flight(struct gd_ep_queue *q);
+
+/*
+  Waits for completions and calls callback until gd_ep_queue_stop()
+  is called or callback returns an error.
+  Returns 0 or negative errno code.
+ */
+int gd_ep_queue_run(struct gd_ep_queue *q);
+
+/*
+  Makes gd_ep_queue_run() return after processing current completions.
+ */
+void gd_ep_queue_stop(struct gd_ep_queue *q);
+
+/*
+  Returns descriptor which becomes readable when completions are
+  available. It may be polled together with ep0 and then
+  gd_ep_queue_dispatch() should be called.
+ */
+int gd_ep_queue_fd(struct gd_ep_queue *q);
+
+/*
+  Processes available completions without blocking.
+  Returns number of processed completions or negative errno code.
+ */
+int gd_ep_queue_dispatch(struct gd_ep_queue *q);
+
+#endif /* FFS_EP_QUEUE_H */
@@ -0,0 +1,142 @@
+/*
+ * ffs-ep0.h
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FFS_EP0_H
+#define FFS_EP0_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/usb/functionfs.h>
+
+/*
+  Event loop for ep0 of function fs.
+
+  Events are read from ep0 in batches and passed to handlers
+  registered for each event type. Control requests are routed by
+  bRequestType and bRequest to registered handlers or answered with
+  static replies. Requests without handler are stalled.
+  Other descriptors (eg. from gd_ep_queue_fd()) may be watched
+  by the same loop.
+*/
+
+struct gd_ep0;
+
+/* Called for BIND, UNBIND, ENABLE, DISABLE, SUSPEND and RESUME */
+typedef void (*gd_ep0_event_fn)(struct gd_ep0 *e,
+				enum usb_functionfs_event_type type,
+				void *user_data);
+
+/*
+  Called for control request.
+  For IN requests handler should fill buf (up to len bytes, len is
+  wLength) and return number of bytes to send.
+  For OUT requests buf contains len bytes of data already received
+  from host and handler should return 0.
+  Negative return value stalls the request, which is possible
+  for OUT requests only if they have no data stage.
+ */
+typedef int (*gd_ep0_setup_fn)(struct gd_ep0 *e,
+			       const struct usb_ctrlrequest *setup,
+			       void *buf, size_t len, void *user_data);
+
+/*
+  Called when watched descriptor is ready. Returning negative
+  errno code stops gd_ep0_run().
+ */
+typedef int (*gd_ep0_fd_fn)(struct gd_ep0 *e, int fd, uint32_t events,
+			    void *user_data);
+
+/*
+  Creates event loop for given ep0. Returns NULL on failure
+  and sets errno.
+ */
+struct gd_ep0 *gd_ep0_new(int ep0_fd);
+
+/*
+  Frees the loop. Descriptors are not closed.
+ */
+void gd_ep0_free(struct gd_ep0 *e);
+
+/*
+  Sets handler for given event type, NULL removes the handler.
+  Returns 0 on success or negative errno code.
+ */
+int gd_ep0_set_event_handler(struct gd_ep0 *e,
+			     enum usb_functionfs_event_type type,
+			     gd_ep0_event_fn fn, void *user_data);
+
+/*
+  Registers handler for control requests with given bRequestType
+  and bRequest. Returns 0 on success or negative errno code.
+ */
+int gd_ep0_add_setup_handler(struct gd_ep0 *e, uint8_t bRequestType,
+			     uint8_t bRequest, gd_ep0_setup_fn fn,
+			     void *user_data);
+
+/*
+  Registers constant reply for IN control request with given
+  bRequestType and bRequest. Data is copied and sent without
+  calling any handler, truncated to wLength.
+  Returns 0 on success or negative errno code.
+ */
+int gd_ep0_add_static_reply(struct gd_ep0 *e, uint8_t bRequestType,
+			    uint8_t bRequest, const void *data, size_t len);
+
+/*
+  Removes handler or static reply for given request.
+  Returns 0 on success or negative errno code.
+ */
+int gd_ep0_remove_setup_handler(struct gd_ep0 *e, uint8_t bRequestType,
+				uint8_t bRequest);
+
+/*
+  Adds descriptor to the loop. Events are EPOLL* flags.
+  Returns 0 on success or negative errno code.
+ */
+int gd_ep0_add_fd(struct gd_ep0 *e, int fd, uint32_t events,
+		  gd_ep0_fd_fn fn, void *user_data);
+
+/*
+  Removes descriptor from the loop.
+  Returns 0 on success or negative errno code.
+ */
+int gd_ep0_remove_fd(struct gd_ep0 *e, int fd);
+
+/*
+  Waits for events and dispatches them until gd_ep0_stop()
+  is called or error occurs. Returns 0 or negative errno code.
+ */
+int gd_ep0_run(struct gd_ep0 *e);
+
+/*
+  Makes gd_ep0_run() return after processing current events.
+ */
+void gd_ep0_stop(struct gd_ep0 *e);
+
+/*
+  Returns epoll descriptor of the loop, which becomes readable
+  when gd_ep0_dispatch() has something to do.
+ */
+int gd_ep0_fd(struct gd_ep0 *e);
+
+/*
+  Processes ready events without blocking.
+  Returns 0 on success or negative errno code.
+ */
+int gd_ep0_dispatch(struct gd_ep0 *e);
+
+#endif /* FFS_EP0_H */
@@ -0,0 +1,132 @@
+/*
+ * ffs-workers.h
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FFS_WORKERS_H
+#define FFS_WORKERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Endpoint worker threads.
+
+  Each endpoint is served by its own thread, which may be pinned
+  to given CPUs. Function fs endpoints cannot be polled, so one
+  thread blocks on one endpoint. Endpoints of one group should be
+  given the same CPU list.
+
+  Data is passed between application and workers through lock-free
+  single producer single consumer queues. Only buffers from
+  gd_buf_pool (ffs-buf-pool.h) are passed, data is never copied.
+  Each queue has exactly one application thread on its side.
+*/
+
+struct gd_workers;
+struct gd_buf_pool;
+
+enum gd_worker_direction {
+	/* device to host, application sends buffers */
+	GD_WORKER_IN,
+	/* host to device, application receives buffers */
+	GD_WORKER_OUT
+};
+
+struct gd_worker_config {
+	/* endpoint file descriptor, eg. from gd_get_ep_by_nmb() */
+	int fd;
+	enum gd_worker_direction direction;
+	/* CPUs for worker thread, eg. "2" or "0-3,6", NULL if not pinned */
+	const char *cpus;
+	/* slots in handoff queue, rounded up to power of 2, 0 means 64 */
+	unsigned queue_len;
+	/* bytes requested by each read on OUT endpoint, 0 means buffer size */
+	size_t xfer_len;
+};
+
+struct gd_worker_msg {
+	/* buffer from pool, NULL if transfer failed */
+	void *buf;
+	/* number of bytes in buffer */
+	size_t len;
+	/* 0 or negative errno code of failed transfer */
+	int error;
+};
+
+struct gd_worker_stats {
+	uint64_t bytes;
+	uint64_t transfers;
+	uint64_t errors;
+	/* negative errno code of last failed transfer or 0 */
+	int last_error;
+};
+
+/*
+  Starts one worker for each endpoint. Buffers are taken from pool,
+  which must outlive the workers. Returns NULL on failure and sets errno.
+ */
+struct gd_workers *gd_workers_new(const struct gd_worker_config *eps,
+				  int n_eps, struct gd_buf_pool *pool);
+
+/*
+  Stops all workers. Buffers left in queues are returned to the pool.
+ */
+void gd_workers_free(struct gd_workers *w);
+
+/*
+  Passes buffer with len bytes to worker of IN endpoint, which returns
+  it to the pool after transfer. Returns 0 on success, -EAGAIN if queue
+  is full or error which paused the worker (see gd_workers_resume()).
+  Buffer is still owned by caller on failure.
+ */
+int gd_workers_send(struct gd_workers *w, int ep, void *buf, size_t len);
+
+/*
+  Takes data received by worker of OUT endpoint. Returns 0 on success
+  or -EAGAIN if queue is empty. Buffer of message has to be returned
+  with gd_workers_release().
+ */
+int gd_workers_recv(struct gd_workers *w, int ep, struct gd_worker_msg *msg);
+
+/*
+  Returns buffer to the pool and wakes workers which wait for it.
+ */
+void gd_workers_release(struct gd_workers *w, void *buf);
+
+/*
+  Returns descriptor which becomes readable when queue of endpoint
+  has messages (OUT) or has room again after being full (IN).
+  Call gd_workers_recv() or gd_workers_send() until -EAGAIN
+  before waiting for it again.
+ */
+int gd_workers_fd(struct gd_workers *w, int ep);
+
+/*
+  Worker is paused when transfer fails, eg. because function has been
+  disabled. Failed OUT transfer is reported as message. Queued IN data
+  is kept. This makes worker continue, typically after ENABLE event.
+  Returns 0 on success or negative errno code.
+ */
+int gd_workers_resume(struct gd_workers *w, int ep);
+
+/*
+  Fills stats with transfer statistics of endpoint.
+  Returns 0 on success or negative errno code.
+ */
+int gd_workers_stats(struct gd_workers *w, int ep,
+		     struct gd_worker_stats *stats);
+
+#endif /* FFS_WORKERS_H */
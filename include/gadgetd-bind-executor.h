@@ -0,0 +1,69 @@
+/*
+ * gadgetd-bind-executor.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_BIND_EXECUTOR_H
+#define GADGETD_BIND_EXECUTOR_H
+
+/**
+ * @file gadgetd-bind-executor.h
+ * @brief parallel bind and unbind of gadgets
+ * @details Write to UDC attribute of gadget runs bind of all its
+ * functions in kernel, which is independent for distinct gadgets
+ * and UDCs. Jobs of one batch are run on a thread pool, so time of
+ * batch is close to time of its slowest job.
+ *
+ * libusbg is not thread safe, jobs of one batch must not share
+ * gadget nor UDC. Caller checks that before run.
+ */
+
+#include <glib.h>
+#include <usbg/usbg.h>
+
+/**
+ * @brief Single bind or unbind
+ * @param g Gadget to bind or unbind
+ * @param u UDC to bind gadget to, ignored for unbind
+ * @param enable 1 to bind, 0 to unbind
+ * @param usbg_ret Result of operation, set by executor
+ * @param usec Time taken by operation, set by executor
+ */
+struct gd_bind_job {
+	usbg_gadget *g;
+	usbg_udc *u;
+	int enable;
+	int usbg_ret;
+	gint64 usec;
+};
+
+/**
+ * @brief Run jobs and wait until all of them are done
+ * @param jobs Array of jobs
+ * @param n_jobs Number of jobs
+ * @param max_threads Upper limit of threads, 0 or less for number of CPUs
+ * @return 0 if all jobs were run, gd_error otherwise.
+ * Result of each job is in its usbg_ret.
+ */
+int gd_bind_executor_run(struct gd_bind_job *jobs, int n_jobs,
+			 int max_threads);
+
+/**
+ * @brief Stop threads of executor
+ * @details Executor can be used again later
+ */
+void gd_bind_executor_shutdown(void);
+
+#endif /* GADGETD_BIND_EXECUTOR_H */
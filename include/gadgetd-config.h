@@ -24,21 +24,52 @@
 
 #include <usbg/usbg.h>
 
+#include <gadgetd-net-tuning.h>
+
 /**
  * @brief gadgetd config
  * @param configfs_mnt configfs mount point
+ * @param ffs_mount_root directory where FunctionFS instances are mounted
  * @param usb_config_str gadgetd configuration file
  * @param g_attrs USB gadget device attributes
  * @param g_strs USB gadget device strings
  * @param cfg_strs USB configuration strings
+ * @param net network function tuning, see gadgetd-net-tuning.h
+ * @param serial serial function tuning, see gadgetd-serial-tuning.h
+ * @param udc UDC hotplug handling and staged connect, see
+ * gadgetd-udc-monitor.h and gadgetd-udc-connect.h
  */
 
 struct gd_config {
 	char *configfs_mnt;
+	char *ffs_mount_root;
 	char *gd_config_file_path;
 	usbg_gadget_attrs *g_attrs;
 	usbg_config_strs *cfg_strs;
 	usbg_gadget_strs *g_strs;
+	struct {
+		int qmult;
+		int mtu;
+		int txqueuelen;
+		int gro;
+		int gso;
+		char *qdisc;
+		struct gd_net_steering steering;
+	} net;
+	struct {
+		int raw;
+		int vmin;
+		int vtime;
+		char *console;
+	} serial;
+	struct {
+		int hotplug;
+		char *default_gadget;
+		char *default_udc;
+		int bind_threads;
+		char *connect_wait;
+		int connect_timeout;
+	} udc;
 };
 
 extern struct gd_config config;
@@ -37,14 +37,19 @@ enum {
 	FUNC_GROUP_NET,
 	FUNC_GROUP_PHONET,
 	FUNC_GROUP_FFS,
+	FUNC_GROUP_MASS_STORAGE,
 } gd_function_group;
 
+struct gd_net_steering;
+
 struct gd_function {
 	struct gd_gadget *parent;
 	char *instance;
 	char *type;
 	int function_group;
 	usbg_function *f;
+	/* set only for FUNC_GROUP_NET, see gadgetd-net-tuning.h */
+	struct gd_net_steering *net_steering;
 };
 
 struct gd_udc {
@@ -85,5 +90,15 @@ int gd_create_function(struct gd_gadget *gadget, const gchar *type,
 		       const gchar *instance, struct gd_function **f,
 		       const gchar **error);
 
+/**
+ * @brief Removes function from gadget
+ * @details Function is also removed from all configs. Function
+ * structure should not be used after successful call.
+ * @param f Function to be removed
+ * @param error Place to store error string. Should not be freed
+ * @return 0 on success, gd_error on failure
+ */
+int gd_remove_function(struct gd_function *f, const gchar **error);
+
 #endif /* GADGETD_CORE_H */
 
@@ -31,6 +31,17 @@ enum ffs_service_options {
 };
 
 
+/* Flags of v2 descriptors header, missing in older kernel headers */
+#ifndef FUNCTIONFS_EVENTFD
+#define FUNCTIONFS_EVENTFD		32
+#endif
+#ifndef FUNCTIONFS_ALL_CTRL_RECIP
+#define FUNCTIONFS_ALL_CTRL_RECIP	64
+#endif
+#ifndef FUNCTIONFS_CONFIG0_SETUP
+#define FUNCTIONFS_CONFIG0_SETUP	128
+#endif
+
 enum ffs_usb_max_speed {
 #ifdef __FFS_LEGACY_API_SUPPORT
 	FFS_USB_FULL_SPEED = 1,
@@ -44,6 +55,27 @@ enum ffs_usb_max_speed {
 #endif
 };
 
+enum ffs_restart_policy {
+	FFS_RESTART_NO,
+	FFS_RESTART_ON_FAILURE,
+	FFS_RESTART_ALWAYS
+};
+
+enum ffs_ioprio_class {
+	FFS_IOPRIO_CLASS_NONE,
+	FFS_IOPRIO_CLASS_RT,
+	FFS_IOPRIO_CLASS_BE,
+	FFS_IOPRIO_CLASS_IDLE
+};
+
+/* Same encoding as used by ioprio_set() syscall */
+#define FFS_IOPRIO_CLASS_SHIFT		13
+#define FFS_IOPRIO_VALUE(class, data)	(((class) << FFS_IOPRIO_CLASS_SHIFT) | (data))
+
+/* Default restart backoff, in miliseconds */
+#define FFS_RESTART_DELAY_DEFAULT	100
+#define FFS_RESTART_MAX_DELAY_DEFAULT	30000
+
 struct ffs_desc_per_seed {
 	int desc_size;
 	int desc_count;
@@ -55,22 +87,60 @@ struct ffs_str_per_lang {
 	char **str;
 } __attribute__ ((__packed__));
 
-/* Currently only exec is done, rest is TODO */
+/* Fields set to -1 (or NULL) are not applied and inherited from gadgetd */
 struct gd_ffs_func_type {
 	struct gd_function_type reg_type;
 	char *exec_path;
+	/* arguments passed after exec_path, NULL terminated */
+	char **exec_args;
+	int exec_args_size;
 	char *work_dir;
 	char *chroot_dir;
 	uid_t user_id;
 	gid_t group_id;
 
+	/* process placement, applied in the child before exec */
+	int *cpu_affinity;
+	int cpu_affinity_size;
+	int sched_policy;
+	int sched_priority;
+	/* 0 keeps inherited nice value */
+	int nice;
+	/* 0 keeps inherited io priority */
+	int ioprio;
+	int mlock;
+	char *cgroup_dir;
+
 	int options;
 	enum usb_functionfs_event_type activation_event;
 
+	enum ffs_restart_policy restart_policy;
+	/* first restart delay, doubled after each consecutive failure */
+	int restart_delay;
+	int restart_max_delay;
+	/* max number of consecutive restarts, 0 means no limit */
+	int restart_limit;
+
+	/* FUNCTIONFS_* flags added to descriptors header */
+	int ffs_flags;
+
+	/* miliseconds without configured host after which running
+	   service is stopped, 0 disables idle stop */
+	int idle_stop;
+
+	/* number of idle instances kept mounted per gadget, 0 disables pool */
+	int pool_size;
+	/* idle instances of this type, list of struct gd_ffs_func */
+	GList *pool;
+	/* used to generate unique names of pooled instances */
+	int pool_seq;
+
 	int refcnt;
 
 	void *desc;
 	int desc_size;
+	/* speeds for which descriptors are given, FFS_USB_* flags */
+	int desc_mask;
 
 	void *str;
 	int str_size;
@@ -82,17 +152,49 @@ enum ffs_instance_state {
 	FFS_INSTANCE_READY,
 	FFS_INSTANCE_BOUND,
 	FFS_INSTANCE_ENABLED,
-	FFS_INSTANCE_RUNNING
+	FFS_INSTANCE_RUNNING,
+	/* mounted but without descriptors, waiting in pool */
+	FFS_INSTANCE_POOLED,
+	/* service asked to exit, waiting until it is reaped */
+	FFS_INSTANCE_STOPPING
 };
 
+/* time given to service to exit after SIGTERM, in ms */
+#define FFS_SERVICE_STOP_TIMEOUT 2000
+
 struct gd_ffs_func {
 	struct gd_function func;
 	char *mount_dir;
 	int ep0_fd;
+	/* signalled by kernel on aio completion if FUNCTIONFS_EVENTFD is set */
+	int event_fd;
 
 	struct gd_ffs_func_type *service;
 	enum ffs_instance_state state;
+	/* state entered when stopping service is reaped */
+	enum ffs_instance_state stop_state;
 	pid_t pid;
+
+	/* glib source ids, 0 if not active */
+	guint ep0_watch;
+	guint child_watch;
+	guint restart_timer;
+	guint idle_timer;
+	guint kill_timer;
+
+	/* instance is destroyed as soon as its service is reaped */
+	int destroy_pending;
+	/* service has been stopped because host was not using it */
+	int idle_stopped;
+	int idle_stop_count;
+
+	/* supervision statistics, times in microseconds */
+	int restart_count;
+	int restart_backoff;
+	gint64 start_time;
+	gint64 exit_time;
+	/* from end of backoff delay to new service being spawned */
+	gint64 restart_latency;
 };
 
 struct gd_ffs_func_type *gd_ref_gd_ffs_func_type(struct gd_ffs_func_type *srv);
@@ -101,13 +203,55 @@ void gd_unref_gd_ffs_func_type(struct gd_ffs_func_type *srv);
 
 /*
  * Creates instance of ffs service with given name
- * Service will be in state FFS_INSTANCE_MOUNTED
+ * Service will be in state FFS_INSTANCE_READY
  */
 int gd_ffs_prepare_instance(struct gd_ffs_func_type *srv, struct gd_ffs_func *func);
 
+/*
+ * Mounts functionfs for already created usbg function under
+ * ffs_mount_root. Instance goes to FFS_INSTANCE_POOLED state.
+ */
+int gd_ffs_mount_instance(struct gd_ffs_func_type *srv, struct gd_ffs_func *func);
+
+/*
+ * Opens ep0 of mounted instance and writes descriptors and strings.
+ * Instance goes to FFS_INSTANCE_READY state.
+ */
+int gd_ffs_open_instance(struct gd_ffs_func *func);
+
+/*
+ * Asks service to exit if running and closes ep0 so kernel drops
+ * descriptors. Instance stays mounted in FFS_INSTANCE_POOLED state
+ * and may be opened once again.
+ * Returns 1 if service has still to be reaped, instance is in
+ * FFS_INSTANCE_STOPPING until gd_ffs_service_reaped() is called.
+ * Returns 0 if instance is already pooled.
+ */
+int gd_ffs_stop_instance(struct gd_ffs_func *func);
+
+/*
+ * Kills service which has not exited in FFS_SERVICE_STOP_TIMEOUT
+ * after being asked to. Returns <0 if instance is not stopping.
+ */
+int gd_ffs_kill_instance(struct gd_ffs_func *func);
+
+/*
+ * Informs stopping instance that its service has been reaped.
+ * Instance goes to the state requested when service was stopped.
+ * Returns <0 if instance was not stopping.
+ */
+int gd_ffs_service_reaped(struct gd_ffs_func *func);
+
+/*
+ * Unmounts stopped instance and drops its reference to service
+ */
+void gd_ffs_release_instance(struct gd_ffs_func *func);
+
 /*
  * Informs instance that event has been received
  * This functions starts required service if event type is suitable to do so.
+ * Service which has been stopped due to idle is also started on ENABLE
+ * and RESUME.
  * Returns <0 if error occurred, 0 if event processed, pid of child if event
  * processed and service started
  */
@@ -115,7 +259,44 @@ int gd_ffs_received_event(struct gd_ffs_func *inst,
 			  enum usb_functionfs_event_type type);
 
 /*
- * Fills gd_ffs_func_type with given descriptors
+ * Informs instance that its service has exited with given wait status.
+ * Returns delay in miliseconds after which service should be restarted
+ * or <0 if service should not be restarted. In the latter case instance
+ * goes back to FFS_INSTANCE_READY and waits for activation event again.
+ */
+int gd_ffs_service_exited(struct gd_ffs_func *inst, int status);
+
+/*
+ * Starts service once again using the same ep0 descriptor.
+ * Endpoint files are reopened so the service gets fresh descriptors
+ * while function stays mounted and bound. Time taken to spawn it
+ * is stored as restart_latency, backoff delay is not included.
+ * Returns <0 if error occurred or pid of new child.
+ */
+int gd_ffs_restart_instance(struct gd_ffs_func *inst);
+
+/*
+ * Checks if UDC state read from sysfs means that function is not used
+ * by host. NULL means that gadget is not bound to any UDC.
+ */
+int gd_ffs_udc_state_idle(const char *udc_state);
+
+/*
+ * Stops running service because host has not been using the function.
+ * ep0 stays opened so gadgetd should watch it again after service is
+ * reaped, see gd_ffs_service_reaped(). Service is started once again
+ * on activation event or on first sign of host activity.
+ * Returns 0 on success, <0 if service was not running.
+ */
+int gd_ffs_idle_stop_instance(struct gd_ffs_func *inst, const char *udc_state);
+
+/* Returns printable name of instance state */
+const char *gd_ffs_instance_state_name(enum ffs_instance_state state);
+
+/*
+ * Fills gd_ffs_func_type with given descriptors.
+ * desc contains one entry for each speed set in desc_mask,
+ * ordered from full speed up. Content of desc is copied.
  */
 int gd_ffs_fill_desc(struct gd_ffs_func_type *srv, struct ffs_desc_per_seed *desc,
 		     int desc_mask);
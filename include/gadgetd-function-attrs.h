@@ -0,0 +1,63 @@
+/*
+ * gadgetd-function-attrs.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_FUNCTION_ATTRS_H
+#define GADGETD_FUNCTION_ATTRS_H
+
+/**
+ * @file gadgetd-function-attrs.h
+ * @brief generic access to configfs attributes of any function
+ * @details Attribute files are discovered in configfs directory of
+ * the first function of each type and the list is cached for the type.
+ * Subdirectories, like lun.0 of mass storage, are not included.
+ */
+
+#include <glib.h>
+
+#include <gadgetd-core.h>
+
+/**
+ * @brief Get configfs directory of function
+ * @param f Function
+ * @param buf Buffer for path
+ * @param len Size of buffer
+ * @return 0 on success, gd_error on failure
+ */
+int gd_function_configfs_path(struct gd_function *f, char *buf, size_t len);
+
+/**
+ * @brief Read all readable attributes of function
+ * @param f Function
+ * @param attrs Place to store "a{sv}", all values are strings
+ * @return 0 on success, gd_error on failure
+ */
+int gd_function_get_all_attrs(struct gd_function *f, GVariant **attrs);
+
+/**
+ * @brief Write many attributes of function
+ * @details All names and values are checked before first write.
+ * Values may be strings, booleans or integers, they are written
+ * in text form in order given in attrs.
+ * @param f Function
+ * @param attrs Attributes to be set, should be "a{sv}"
+ * @param error Place to store error string. Should not be freed
+ * @return 0 on success, gd_error on failure
+ */
+int gd_function_set_attrs(struct gd_function *f, GVariant *attrs,
+			  const gchar **error);
+
+#endif /* GADGETD_FUNCTION_ATTRS_H */
@@ -24,5 +24,25 @@
  */
 int gd_init_functions();
 
+struct gd_gadget;
+
+/**
+ * @brief Drop everything ffs functions keep for gadget
+ * @details Cancels pending refill of instance pools and destroys
+ * pooled instances of gadget. Must be called before gadget is freed.
+ * @param g Gadget which is going away
+ */
+void gd_ffs_gadget_cleanup(struct gd_gadget *g);
+
+/**
+ * @brief Get lowest speed at which all functions of gadget work best
+ * @details For ffs functions it is the highest speed for which
+ * descriptors have been given. Kernel functions work at any speed,
+ * so they require only full speed.
+ * @param g Gadget to check
+ * @return enum gd_usb_speed
+ */
+int gd_gadget_required_speed(struct gd_gadget *g);
+
 #endif /* GADGETD_FUNCTIONS_H */
 
@@ -0,0 +1,125 @@
+/*
+ * gadgetd-mass-storage.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_MASS_STORAGE_H
+#define GADGETD_MASS_STORAGE_H
+
+/**
+ * @file gadgetd-mass-storage.h
+ * @brief mass storage function LUN management
+ * @details Attributes are accessed directly in configfs directory of
+ * function. LUN 0 always exists. LUNs can be added and removed and
+ * stall can be changed only while gadget is not enabled, backing file
+ * can be changed at any time.
+ */
+
+#include <glib.h>
+
+#include <gadgetd-core.h>
+
+/* FSG_MAX_LUNS of kernel */
+#define GD_MS_MAX_LUNS 16
+
+/**
+ * @brief Add LUN to mass storage function
+ * @param f Mass storage function
+ * @param lun Number of new LUN, 1 to GD_MS_MAX_LUNS - 1
+ * @param error Place to store error string. Should not be freed
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_add_lun(struct gd_function *f, guint lun, const gchar **error);
+
+/**
+ * @brief Remove LUN from mass storage function
+ * @param f Mass storage function
+ * @details Fails with GD_ERROR_BUSY while gadget is enabled. Kernel
+ * would unbind the whole gadget on removal of LUN instead of failing.
+ * @param lun Number of LUN, LUN 0 can't be removed
+ * @param error Place to store error string. Should not be freed
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_rm_lun(struct gd_function *f, guint lun, const gchar **error);
+
+/**
+ * @brief List LUNs of mass storage function
+ * @param f Mass storage function
+ * @param luns Place to store sorted array of guint LUN numbers.
+ * Should be freed by caller with g_array_free()
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_list_luns(struct gd_function *f, GArray **luns);
+
+/**
+ * @brief Set attributes of LUN
+ * @details Known attributes are file (s), ro (b), removable (b),
+ * cdrom (b) and nofua (b). ro and cdrom can be changed only without
+ * medium, so medium is ejected first when file is also given.
+ * @param f Mass storage function
+ * @param lun Number of LUN
+ * @param attrs Attributes to be set, should be "a{sv}"
+ * @param error Place to store error string. Should not be freed
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_set_lun_attrs(struct gd_function *f, guint lun, GVariant *attrs,
+			const gchar **error);
+
+/**
+ * @brief Get attributes of LUN
+ * @param f Mass storage function
+ * @param lun Number of LUN
+ * @param attrs Place to store "a{sv}" with attributes
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_get_lun_attrs(struct gd_function *f, guint lun, GVariant **attrs);
+
+/**
+ * @brief Set function attributes
+ * @details Known attributes are stall (b) and num_buffers (u).
+ * num_buffers is available only when kernel has
+ * CONFIG_USB_GADGET_DEBUG_FILES.
+ * @param f Mass storage function
+ * @param attrs Attributes to be set, should be "a{sv}"
+ * @param error Place to store error string. Should not be freed
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_set_attrs(struct gd_function *f, GVariant *attrs,
+		    const gchar **error);
+
+/**
+ * @brief Get numeric function attribute
+ * @param f Mass storage function
+ * @param name stall or num_buffers
+ * @param val Place to store value
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_get_attr(struct gd_function *f, const gchar *name, gint *val);
+
+/**
+ * @brief Change medium of LUN
+ * @details Current medium is ejected even if host has locked it
+ * and new file is opened. Gadget stays connected, host sees
+ * only medium change.
+ * @param f Mass storage function
+ * @param lun Number of LUN
+ * @param file Path of new backing file, empty to leave LUN without medium
+ * @param error Place to store error string. Should not be freed
+ * @return 0 on success, gd_error on failure
+ */
+int gd_ms_swap_media(struct gd_function *f, guint lun, const gchar *file,
+		     const gchar **error);
+
+#endif /* GADGETD_MASS_STORAGE_H */
@@ -0,0 +1,113 @@
+/*
+ * gadgetd-net-tuning.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_NET_TUNING_H
+#define GADGETD_NET_TUNING_H
+
+/**
+ * @file gadgetd-net-tuning.h
+ * @brief tuning of network functions and their interfaces
+ * @details Settings are taken from net section of gadgetd config.
+ * Values below zero and NULL qdisc mean kernel defaults.
+ */
+
+#include <usbg/usbg.h>
+
+#include <gadgetd-core.h>
+
+/**
+ * @brief Packet steering of network function
+ * @param rps_cpus CPU list for receive packet steering, eg. "0-3,6"
+ * @param xps_cpus CPU list for transmit packet steering
+ * @param rps_flow_cnt size of flow table of each receive queue
+ * @param irq_cpus CPU list for interrupt of UDC
+ * @details NULL lists and negative numbers leave kernel settings untouched
+ */
+struct gd_net_steering {
+	char *rps_cpus;
+	char *xps_cpus;
+	int rps_flow_cnt;
+	char *irq_cpus;
+};
+
+/**
+ * @brief Check if function is one of usb network functions
+ * @param f Function to be checked
+ * @return true if function has a network interface
+ */
+int gd_net_is_net_function(usbg_function *f);
+
+/**
+ * @brief Apply settings which must be set before gadget is bound
+ * @details Sets qmult of all network functions of gadget
+ * @param g Gadget which is going to be enabled
+ * @return 0 on success, gd_error on failure
+ */
+int gd_net_prepare_gadget(usbg_gadget *g);
+
+/**
+ * @brief Tune network interface
+ * @details Sets MTU, txqueuelen, GRO, GSO and root qdisc.
+ * All settings are tried even if some of them fail.
+ * @param ifname Name of network interface
+ * @return 0 on success, gd_error of last failed setting otherwise
+ */
+int gd_net_tune_netdev(const char *ifname);
+
+/**
+ * @brief Get steering policy of function
+ * @details Policy set with gd_net_set_steering() or default one
+ * from gadgetd config
+ * @param f Network function
+ * @return Steering policy, must not be modified
+ */
+const struct gd_net_steering *gd_net_get_steering(struct gd_function *f);
+
+/**
+ * @brief Set steering policy of function
+ * @details Policy is stored in function and applied each time gadget
+ * is enabled. If gadget is enabled now, policy is also applied
+ * immediately. Empty or NULL list and negative rps_flow_cnt mean default
+ * from gadgetd config.
+ * @param f Network function
+ * @param rps_cpus CPU list for receive packet steering
+ * @param xps_cpus CPU list for transmit packet steering
+ * @param rps_flow_cnt size of flow table of each receive queue
+ * @param irq_cpus CPU list for interrupt of UDC
+ * @return 0 on success, gd_error on failure
+ */
+int gd_net_set_steering(struct gd_function *f, const char *rps_cpus,
+			const char *xps_cpus, int rps_flow_cnt,
+			const char *irq_cpus);
+
+/**
+ * @brief Free steering policy of function
+ * @param s Steering policy, may be NULL
+ */
+void gd_net_steering_free(struct gd_net_steering *s);
+
+/**
+ * @brief Tune interfaces of all network functions of bound gadget
+ * @details Applies netdev settings, packet steering of each function
+ * and interrupt affinity of UDC
+ * @param g Enabled gadget
+ * @param u UDC to which gadget is bound
+ * @return 0 on success, gd_error of last failure otherwise
+ */
+int gd_net_tune_gadget(struct gd_gadget *g, usbg_udc *u);
+
+#endif /* GADGETD_NET_TUNING_H */
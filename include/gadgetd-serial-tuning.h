@@ -0,0 +1,65 @@
+/*
+ * gadgetd-serial-tuning.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_SERIAL_TUNING_H
+#define GADGETD_SERIAL_TUNING_H
+
+/**
+ * @file gadgetd-serial-tuning.h
+ * @brief tuning of serial functions and their tty ports
+ * @details Settings are taken from serial section of gadgetd config.
+ * Values below zero and NULL console mean kernel defaults.
+ */
+
+#include <stddef.h>
+
+#include <gadgetd-core.h>
+
+/**
+ * @brief Get path of tty device of serial port
+ * @param port_num Port number of function
+ * @param path Buffer for path, eg. /dev/ttyGS0
+ * @param len Size of buffer
+ * @return 0 on success, gd_error on failure
+ */
+int gd_serial_tty_path(int port_num, char *path, size_t len);
+
+/**
+ * @brief Apply settings which must be set before gadget is bound
+ * @details Enables console on configured function
+ * @param g Gadget which is going to be enabled
+ * @return 0 on success, gd_error on failure
+ */
+int gd_serial_prepare_gadget(struct gd_gadget *g);
+
+/**
+ * @brief Apply termios profile to tty port
+ * @details Raw mode, VMIN and VTIME are set. u_serial implements
+ * neither TIOCGSERIAL nor TIOCSSERIAL, so there is no low latency flag.
+ * @param path Path of tty device
+ * @return 0 on success, gd_error of last failed setting otherwise
+ */
+int gd_serial_tune_tty(const char *path);
+
+/**
+ * @brief Tune ports of all serial functions of bound gadget
+ * @param g Enabled gadget
+ * @return 0 on success, gd_error of last failure otherwise
+ */
+int gd_serial_tune_gadget(struct gd_gadget *g);
+
+#endif /* GADGETD_SERIAL_TUNING_H */
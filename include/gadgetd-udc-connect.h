@@ -0,0 +1,68 @@
+/*
+ * gadgetd-udc-connect.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_UDC_CONNECT_H
+#define GADGETD_UDC_CONNECT_H
+
+/**
+ * @file gadgetd-udc-connect.h
+ * @brief staged connect of gadget to host
+ * @details Bind of gadget pulls D+ up at once, so host starts
+ * enumeration before ffs services are up, which ends in retries
+ * or reset. With udc_connect_wait set to "running", soft_connect
+ * of UDC is turned off just after bind and turned on again when
+ * services activated by FUNCTIONFS_BIND have been started or when
+ * udc_connect_timeout expires. Host waits 100 ms after attach
+ * before it resets the device, so short pull up during bind
+ * is not noticed.
+ *
+ * Kernel does not allow soft_connect before gadget is bound,
+ * that's why it can't be turned off earlier. Waiting only for
+ * FUNCTIONFS_BIND ("ready") is accepted but does nothing, because
+ * it is queued during bind itself.
+ */
+
+#include <gadgetd-core.h>
+#include <gadgetd-udc-state.h>
+
+/**
+ * @brief Hold gadget disconnected until its ffs services are running
+ * @details Does nothing if staging is disabled in config or if all
+ * instances are already in required state.
+ * @param udc Name of UDC to which gadget has just been bound
+ * @param g Gadget bound to UDC
+ * @param st State of UDC, connect is marked in its log, may be NULL
+ * @return 0 on success, gd_error if UDC can't be disconnected,
+ * gadget stays connected in such case
+ */
+int gd_udc_connect_hold(const char *udc, struct gd_gadget *g,
+			struct gd_udc_state *st);
+
+/**
+ * @brief Connect held gadgets which are ready
+ * @details Called after each change of ffs instance state
+ */
+void gd_udc_connect_check(void);
+
+/**
+ * @brief Forget held gadget without connecting it
+ * @details Used when gadget is unbound or UDC is gone
+ * @param udc Name of UDC
+ */
+void gd_udc_connect_cancel(const char *udc);
+
+#endif /* GADGETD_UDC_CONNECT_H */
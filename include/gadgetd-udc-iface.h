@@ -27,6 +27,8 @@
 
 G_BEGIN_DECLS
 
+struct gd_gadget;
+
 struct _GadgetdUDCDevice;
 typedef struct _GadgetdUDCDevice GadgetdUDCDevice;
 
@@ -38,6 +40,20 @@ typedef struct _GadgetdUDCDeviceClass	GadgetdUDCDeviceClass;
 
 GType gadgetd_udc_device_get_type (void) G_GNUC_CONST;
 GadgetdUDCDevice   *gadgetd_udc_device_new(GadgetdUdcObject *udc_object);
+void                gadgetd_udc_device_state_changed(GadgetdUDCDevice *udc_device);
+gint                gd_udc_prepare_enable(GadgetdUdcObject *udc_obj,
+					  const gchar *gadget_path,
+					  struct gd_gadget **gadget,
+					  const gchar **msg);
+gint                gd_udc_finish_enable(GadgetdUdcObject *udc_obj,
+					 struct gd_gadget *gd_gadget,
+					 const gchar *gadget_path,
+					 const gchar **msg);
+gint                gd_udc_enable_gadget(GadgetdUdcObject *udc_obj,
+					 const gchar *gadget_path,
+					 const gchar **msg);
+gint                gd_udc_disable_gadget(GadgetdUdcObject *udc_obj,
+					  const gchar **msg);
 G_END_DECLS
 
 #endif /* GADGETD_UDC_IFACE_H */
@@ -0,0 +1,46 @@
+/*
+ * gadgetd-udc-monitor.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_UDC_MONITOR_H
+#define GADGETD_UDC_MONITOR_H
+
+/**
+ * @file gadgetd-udc-monitor.h
+ * @brief UDC objects and their hotplug
+ * @details Kernel uevents of udc class are used to export UDCs which
+ * appear after start (module load, role switch of dual role controller)
+ * and to remove UDCs which are gone. Settings are taken from udc
+ * section of gadgetd config.
+ */
+
+#include <gadget-daemon.h>
+
+/**
+ * @brief Export UDC objects and start watching for UDC hotplug
+ * @details All UDCs from gd_udcs are exported even if
+ * hotplug is disabled or can't be watched.
+ * @param daemon Daemon on which UDC objects are exported
+ * @return 0 on success, gd_error if hotplug can't be watched
+ */
+int gd_udc_monitor_start(GadgetDaemon *daemon);
+
+/**
+ * @brief Stop watching for UDC hotplug
+ */
+void gd_udc_monitor_stop(void);
+
+#endif /* GADGETD_UDC_MONITOR_H */
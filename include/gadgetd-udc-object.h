@@ -24,6 +24,8 @@
 
 G_BEGIN_DECLS
 
+struct gd_udc_state;
+
 struct _GadgetdUdcObject;
 typedef struct _GadgetdUdcObject GadgetdUdcObject;
 
@@ -37,6 +39,7 @@ GadgetDaemon     *gadgetd_udc_object_get_daemon(GadgetdUdcObject *object);
 usbg_udc         *gadgetd_udc_object_get_udc(GadgetdUdcObject *object);
 gchar            *gadgetd_udc_object_get_enabled_gadget_path(GadgetdUdcObject *object);
 gint              gadgetd_udc_object_set_enabled_gadget_path(GadgetdUdcObject *object, const gchar *path);
+struct gd_udc_state *gadgetd_udc_object_get_state(GadgetdUdcObject *object);
 
 G_END_DECLS
 
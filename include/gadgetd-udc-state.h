@@ -0,0 +1,151 @@
+/*
+ * gadgetd-udc-state.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GADGETD_UDC_STATE_H
+#define GADGETD_UDC_STATE_H
+
+/**
+ * @file gadgetd-udc-state.h
+ * @brief connection state of UDC
+ * @details state attribute of UDC is watched with poll(), kernel
+ * wakes it up with sysfs_notify() on every USB device state change.
+ * current_speed is read again with each change of state.
+ */
+
+#include <stddef.h>
+#include <glib.h>
+
+#define GD_UDC_CLASS_PATH "/sys/class/udc"
+
+/* number of transitions kept for each UDC */
+#define GD_UDC_STATE_LOG_LEN 64
+
+struct gd_udc_state;
+
+/**
+ * @brief USB speed, ordered like in kernel
+ */
+enum gd_usb_speed {
+	GD_USB_SPEED_UNKNOWN,
+	GD_USB_SPEED_LOW,
+	GD_USB_SPEED_FULL,
+	GD_USB_SPEED_HIGH,
+	GD_USB_SPEED_WIRELESS,
+	GD_USB_SPEED_SUPER,
+	GD_USB_SPEED_SUPER_PLUS
+};
+
+/**
+ * @brief Convert speed read from sysfs, eg. high-speed
+ * @param speed Speed string
+ * @return Speed or GD_USB_SPEED_UNKNOWN if not recognized
+ */
+enum gd_usb_speed gd_usb_speed_from_str(const char *speed);
+
+/**
+ * @brief Read attribute of UDC from sysfs
+ * @param udc Name of UDC
+ * @param attr Name of attribute, eg. maximum_speed
+ * @param buf Buffer for value, trailing new line is removed
+ * @param len Size of buffer
+ * @return 0 on success, gd_error on failure
+ */
+int gd_udc_read_attr(const char *udc, const char *attr, char *buf, size_t len);
+
+/**
+ * @brief Write attribute of UDC in sysfs
+ * @param udc Name of UDC
+ * @param attr Name of attribute, eg. soft_connect
+ * @param value Value to be written
+ * @return 0 on success, gd_error on failure
+ */
+int gd_udc_write_attr(const char *udc, const char *attr, const char *value);
+
+/**
+ * @brief Start watching state of UDC
+ * @param udc Name of UDC
+ * @param changed Called after state or current speed has changed
+ * @param user_data Passed to changed
+ * @return State handle or NULL if state can't be watched
+ */
+struct gd_udc_state *gd_udc_state_watch(const char *udc,
+					void (*changed)(gpointer user_data),
+					gpointer user_data);
+
+/**
+ * @brief Stop watching and free state
+ * @param st State handle, may be NULL
+ */
+void gd_udc_state_free(struct gd_udc_state *st);
+
+/**
+ * @brief Find watched state of UDC
+ * @param udc Name of UDC
+ * @return State handle or NULL if UDC is not watched
+ */
+struct gd_udc_state *gd_udc_state_lookup(const char *udc);
+
+/**
+ * @brief Get notified about changes of state
+ * @details Adding the same listener twice has no effect.
+ * Listeners are dropped together with state.
+ * @param st State handle
+ * @param changed Called after state or current speed has changed
+ * @param user_data Passed to changed
+ */
+void gd_udc_state_add_listener(struct gd_udc_state *st,
+			       void (*changed)(gpointer user_data),
+			       gpointer user_data);
+
+/**
+ * @brief Remove listener from all UDCs
+ * @details Caller doesn't have to keep state, which may be gone
+ * already together with its UDC
+ * @param changed Callback given to gd_udc_state_add_listener()
+ * @param user_data Data given to gd_udc_state_add_listener()
+ */
+void gd_udc_state_remove_listener(void (*changed)(gpointer user_data),
+				  gpointer user_data);
+
+/**
+ * @brief Get last seen state, eg. configured or suspended
+ */
+const char *gd_udc_state_get_state(struct gd_udc_state *st);
+
+/**
+ * @brief Get speed read with last state change, eg. high-speed
+ */
+const char *gd_udc_state_get_speed(struct gd_udc_state *st);
+
+/**
+ * @brief Put event which is not a state change into log
+ * @details Used to mark bind of gadget, so time of enumeration
+ * can be taken directly from log
+ * @param st State handle
+ * @param event Name of event, logged in place of state
+ */
+void gd_udc_state_mark(struct gd_udc_state *st, const char *event);
+
+/**
+ * @brief Get log of transitions
+ * @param st State handle
+ * @return Floating GVariant of type a(xss): monotonic time in
+ * microseconds, state and speed, oldest first
+ */
+GVariant *gd_udc_state_get_log(struct gd_udc_state *st);
+
+#endif /* GADGETD_UDC_STATE_H */
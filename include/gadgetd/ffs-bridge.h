@@ -0,0 +1 @@
+../ffs-bridge.h
\ No newline at end of file
@@ -0,0 +1 @@
+../ffs-buf-pool.h
\ No newline at end of file
@@ -0,0 +1 @@
+../ffs-dmabuf.h
\ No newline at end of file
@@ -0,0 +1 @@
+../ffs-ep-queue.h
\ No newline at end of file
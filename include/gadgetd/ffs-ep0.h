@@ -0,0 +1 @@
+../ffs-ep0.h
\ No newline at end of file
@@ -0,0 +1 @@
+../ffs-workers.h
\ No newline at end of file
@@ -6,10 +6,15 @@ Summary:        USB gadget daemon
 Group:          Base/Device Management
 Source0:        gadgetd-%{version}.tar.gz
 Source1001:     gadgetd.manifest
+# io_uring endpoint queue of libffs-daemon is built only with liburing
+%bcond_without  liburing
 BuildRequires:  cmake
 BuildRequires:  pkg-config
 BuildRequires:  pkgconfig(glib-2.0)
 BuildRequires:  pkgconfig(libusbg)
+%if %{with liburing}
+BuildRequires:  pkgconfig(liburing)
+%endif
 
 %description
 Gadgetd is a tool for USB gadget management.
@@ -43,7 +48,8 @@ ffs services
 %setup -q
 cp %{SOURCE1001} .
 
-cmake . -DSUPPORT_FFS_LEGACY_API=1 -DBUILD_EXAMPLES=1
+cmake . -DSUPPORT_FFS_LEGACY_API=1 -DBUILD_EXAMPLES=1 \
+      %{!?with_liburing:-DWITHOUT_LIBURING=1}
 
 %build
 make
@@ -71,10 +77,23 @@ make
 
 %files -n libffs-daemon-devel
 /usr/local/include/gadgetd/ffs-daemon.h
+/usr/local/include/gadgetd/ffs-buf-pool.h
+/usr/local/include/gadgetd/ffs-bridge.h
+/usr/local/include/gadgetd/ffs-ep0.h
+/usr/local/include/gadgetd/ffs-dmabuf.h
+/usr/local/include/gadgetd/ffs-workers.h
+%if %{with liburing}
+/usr/local/include/gadgetd/ffs-ep-queue.h
+%endif
 /usr/local/lib/libffs-daemon.so
 
 %files -n libffs-daemon-examples
 /usr/local/bin/ffs-host-example
+/usr/local/bin/ffs-host-bench
 /usr/local/bin/ffs-service-example
+/usr/local/bin/ffs-bridge-bench
+/usr/local/bin/ffs-bench-service
+/usr/local/bin/udc-bind-bench
 /etc/gadgetd/functions.d/ffs.sample.example
+/etc/gadgetd/functions.d/ffs-bench.sample.example
 
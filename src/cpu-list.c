@@ -0,0 +1,59 @@
+/*
+ * cpu-list.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE /* for cpu sets */
+#include <errno.h>
+#include <stdlib.h>
+
+#include "cpu-list.h"
+
+int
+cpu_list_parse(const char *list, cpu_set_t *set)
+{
+	char *end;
+	long first, last;
+
+	CPU_ZERO(set);
+	while (*list) {
+		first = strtol(list, &end, 10);
+		if (end == list || first < 0)
+			return -EINVAL;
+
+		last = first;
+		if (*end == '-') {
+			list = end + 1;
+			last = strtol(list, &end, 10);
+			if (end == list || last < first)
+				return -EINVAL;
+		}
+
+		if (last >= CPU_SETSIZE)
+			return -EINVAL;
+
+		for (; first <= last; ++first)
+			CPU_SET(first, set);
+
+		if (*end == ',')
+			++end;
+		else if (*end)
+			return -EINVAL;
+		list = end;
+	}
+
+	return CPU_COUNT(set) ? 0 : -EINVAL;
+}
@@ -0,0 +1,205 @@
+/*
+ * gadgetd-ffs-function-iface.c
+ * Copyright(c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0(the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <usbg/usbg.h>
+#include <stdio.h>
+#include <gio/gio.h>
+#include <gadgetd-common.h>
+
+#include <gadgetd-gdbus-codegen.h>
+#include <gadgetd-ffs-func.h>
+#include <dbus-function-ifaces/gadgetd-ffs-function-iface.h>
+
+#include <string.h>
+#ifdef G_OS_UNIX
+#  include <gio/gunixfdlist.h>
+#endif
+
+struct _FunctionFfsAttrs
+{
+	GadgetdFunctionFfsAttrsSkeleton parent_instance;
+
+	GadgetdFunctionObject *function_object;
+};
+
+struct _FunctionFfsAttrsClass
+{
+	GadgetdFunctionFfsAttrsSkeletonClass parent_class;
+};
+
+enum
+{
+	PROP_0,
+	PROP_FFS_PID,
+	PROP_FFS_STATE,
+	PROP_FFS_RESTART_COUNT,
+	PROP_FFS_RESTART_LATENCY,
+	PROP_FFS_IDLE_STOP_COUNT,
+	PROP_FFS_FUNC_OBJECT,
+} prop_ffs_attrs;
+
+/**
+ * @brief G_DEFINE_TYPE_WITH_CODE
+ * @details A convenience macro for type implementations. Similar to G_DEFINE_TYPE(), but allows
+ * to insert custom code into the *_get_type() function,
+ * @see G_DEFINE_TYPE()
+ */
+G_DEFINE_TYPE_WITH_CODE(FunctionFfsAttrs, function_ffs_attrs, GADGETD_TYPE_FUNCTION_FFS_ATTRS_SKELETON,
+			 G_IMPLEMENT_INTERFACE(GADGETD_TYPE_FUNCTION_FFS_ATTRS, NULL));
+
+/**
+ * @brief function ffs attrs set property function
+ * @param[in] object a GObject
+ * @param[in] property_id numeric id under which the property was registered with
+ * @param[in] value a new GValue for the property
+ * @param[in] pspec the GParamSpec structure describing the property
+ * @see GObjectSetPropertyFunc()
+ */
+static void
+function_ffs_attrs_set_property(GObject      *object,
+				guint         property_id,
+				const GValue *value,
+				GParamSpec   *pspec)
+{
+	FunctionFfsAttrs *ffs_attrs = FUNCTION_FFS_ATTRS(object);
+
+	switch(property_id) {
+	case PROP_FFS_FUNC_OBJECT:
+		g_assert(ffs_attrs->function_object == NULL);
+		ffs_attrs->function_object = g_value_get_object(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+		break;
+	}
+}
+
+/**
+ * @brief function ffs attrs get property.
+ * @details  generic Getter for all properties of this type
+ * @param[in] object a GObject
+ * @param[in] property_id numeric id under which the property was registered with
+ * @param[in] value a GValue to return the property value in
+ * @param[in] pspec the GParamSpec structure describing the property
+ * @see GObjectGetPropertyFunc()
+ */
+static void
+function_ffs_attrs_get_property(GObject    *object,
+				guint       property_id,
+				GValue     *value,
+				GParamSpec *pspec)
+{
+	FunctionFfsAttrs *ffs_attrs = FUNCTION_FFS_ATTRS(object);
+	struct gd_function *func;
+	struct gd_ffs_func *ffs;
+
+	func = gadgetd_function_object_get_function(ffs_attrs->function_object);
+	if (func == NULL) {
+		ERROR("Cant get function");
+		return;
+	}
+
+	ffs = container_of(func, struct gd_ffs_func, func);
+
+	switch(property_id) {
+	case PROP_FFS_PID:
+		g_value_set_int(value, ffs->pid);
+		break;
+	case PROP_FFS_STATE:
+		g_value_set_string(value, gd_ffs_instance_state_name(ffs->state));
+		break;
+	case PROP_FFS_RESTART_COUNT:
+		g_value_set_uint(value, ffs->restart_count);
+		break;
+	case PROP_FFS_RESTART_LATENCY:
+		g_value_set_uint64(value, ffs->restart_latency);
+		break;
+	case PROP_FFS_IDLE_STOP_COUNT:
+		g_value_set_uint(value, ffs->idle_stop_count);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+		break;
+	}
+}
+
+/**
+ * @brief function ffs attrs class init
+ * @param[in] klass FunctionFfsAttrsClass
+ */
+static void
+function_ffs_attrs_class_init(FunctionFfsAttrsClass *klass)
+{
+	GObjectClass *gobject_class;
+
+	gobject_class = G_OBJECT_CLASS(klass);
+	gobject_class->set_property = function_ffs_attrs_set_property;
+	gobject_class->get_property = function_ffs_attrs_get_property;
+
+	g_object_class_override_property(gobject_class,
+					PROP_FFS_PID,
+					"pid");
+	g_object_class_override_property(gobject_class,
+					PROP_FFS_STATE,
+					"state");
+	g_object_class_override_property(gobject_class,
+					PROP_FFS_RESTART_COUNT,
+					"restart-count");
+	g_object_class_override_property(gobject_class,
+					PROP_FFS_RESTART_LATENCY,
+					"restart-latency");
+	g_object_class_override_property(gobject_class,
+					PROP_FFS_IDLE_STOP_COUNT,
+					"idle-stop-count");
+
+	g_object_class_install_property(gobject_class,
+                                   PROP_FFS_FUNC_OBJECT,
+                                   g_param_spec_object("function-object",
+                                                        "function-object",
+                                                        "function object",
+                                                        GADGETD_TYPE_FUNCTION_OBJECT,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * @brief function ffs attrs new
+ * @param[in] function_object GadgetdFunctionObject of ffs function
+ * @return #FunctionFfsAttrs object.
+ */
+FunctionFfsAttrs *
+function_ffs_attrs_new(GadgetdFunctionObject *function_object)
+{
+	g_return_val_if_fail(function_object != NULL, NULL);
+	FunctionFfsAttrs *object;
+
+	object = g_object_new(FUNCTION_TYPE_FFS_ATTRS,
+			     "function-object", function_object,
+			      NULL);
+	return object;
+}
+
+/**
+ * @brief function ffs attrs init
+ */
+static void
+function_ffs_attrs_init(FunctionFfsAttrs *ffs_attrs)
+{
+	/* noop */
+}
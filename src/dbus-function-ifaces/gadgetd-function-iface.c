@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <gio/gio.h>
 #include <gadgetd-common.h>
+#include <gadgetd-function-attrs.h>
 
 #include <gadgetd-gdbus-codegen.h>
 #include <dbus-function-ifaces/gadgetd-function-iface.h>
@@ -48,6 +49,10 @@ enum
 	PROP_FUNC_PTR,
 } prop_func_attrs;
 
+static const char func_attrs_iface[] = "org.usb.device.Function.Attrs";
+
+static void function_attrs_iface_init(GadgetdFunctionAttrsIface *iface);
+
 /**
  * @brief G_DEFINE_TYPE_WITH_CODE
  * @details A convenience macro for type implementations. Similar to G_DEFINE_TYPE(), but allows
@@ -55,7 +60,8 @@ enum
  * @see G_DEFINE_TYPE()
  */
 G_DEFINE_TYPE_WITH_CODE(FunctionAttrs, function_attrs, GADGETD_TYPE_FUNCTION_ATTRS_SKELETON,
-			 G_IMPLEMENT_INTERFACE(GADGETD_TYPE_FUNCTION_ATTRS, NULL));
+			 G_IMPLEMENT_INTERFACE(GADGETD_TYPE_FUNCTION_ATTRS,
+						function_attrs_iface_init));
 
 /**
  * @brief function attrs set property function
@@ -176,3 +182,72 @@ function_attrs_init(FunctionAttrs *func_attrs)
 	/* noop */
 }
 
+/**
+ * @brief handle get all
+ * @param[in] object
+ * @param[in] invocation
+ * @return true if metod handled
+ */
+static gboolean
+handle_get_all(GadgetdFunctionAttrs  *object,
+	       GDBusMethodInvocation *invocation)
+{
+	FunctionAttrs *func_attrs = FUNCTION_ATTRS(object);
+	GVariant *attrs;
+	gint g_ret;
+
+	g_ret = gd_function_get_all_attrs(func_attrs->func, &attrs);
+	if (g_ret != GD_SUCCESS) {
+		ERROR("Unable to read attributes of %s", func_attrs->func->instance);
+		g_dbus_method_invocation_return_dbus_error(invocation,
+				func_attrs_iface,
+				"Unable to read attributes");
+		return TRUE;
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+					      g_variant_new_tuple(&attrs, 1));
+	return TRUE;
+}
+
+/**
+ * @brief handle set many
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] attrs attributes to be set
+ * @return true if metod handled
+ */
+static gboolean
+handle_set_many(GadgetdFunctionAttrs  *object,
+		GDBusMethodInvocation *invocation,
+		GVariant              *attrs)
+{
+	FunctionAttrs *func_attrs = FUNCTION_ATTRS(object);
+	const gchar *msg = NULL;
+	gint g_ret;
+
+	g_ret = gd_function_set_attrs(func_attrs->func, attrs, &msg);
+	if (g_ret != GD_SUCCESS) {
+		ERROR("%s", msg);
+		g_dbus_method_invocation_return_dbus_error(invocation,
+				func_attrs_iface,
+				msg);
+		return TRUE;
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+					      g_variant_new("(b)", TRUE));
+	return TRUE;
+}
+
+/**
+ * @brief function attrs iface init
+ * @param[in] iface GadgetdFunctionAttrsIface
+ */
+static void
+function_attrs_iface_init(GadgetdFunctionAttrsIface *iface)
+{
+	iface->handle_get_all  = handle_get_all;
+	iface->handle_set_many = handle_set_many;
+}
+
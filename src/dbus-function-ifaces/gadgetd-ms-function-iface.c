@@ -0,0 +1,417 @@
+/*
+ * gadgetd-ms-function-iface.c
+ * Copyright(c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0(the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <usbg/usbg.h>
+#include <stdio.h>
+#include <gio/gio.h>
+#include <gadgetd-common.h>
+#include <gadgetd-mass-storage.h>
+
+#include <gadgetd-gdbus-codegen.h>
+#include <dbus-function-ifaces/gadgetd-ms-function-iface.h>
+
+#include <string.h>
+#ifdef G_OS_UNIX
+#  include <gio/gunixfdlist.h>
+#endif
+
+struct _FunctionMassStorage
+{
+	GadgetdFunctionMassStorageSkeleton parent_instance;
+
+	GadgetdFunctionObject *function_object;
+};
+
+struct _FunctionMassStorageClass
+{
+	GadgetdFunctionMassStorageSkeletonClass parent_class;
+};
+
+enum
+{
+	PROP_0,
+	PROP_MS_LUNS,
+	PROP_MS_STALL,
+	PROP_MS_NUM_BUFFERS,
+	PROP_MS_FUNC_OBJECT,
+} prop_mass_storage;
+
+static const char ms_iface[] = "org.usb.device.Function.MassStorage";
+
+static void function_mass_storage_iface_init(GadgetdFunctionMassStorageIface *iface);
+
+/**
+ * @brief G_DEFINE_TYPE_WITH_CODE
+ * @details A convenience macro for type implementations. Similar to G_DEFINE_TYPE(), but allows
+ * to insert custom code into the *_get_type() function,
+ * @see G_DEFINE_TYPE()
+ */
+G_DEFINE_TYPE_WITH_CODE(FunctionMassStorage, function_mass_storage, GADGETD_TYPE_FUNCTION_MASS_STORAGE_SKELETON,
+			 G_IMPLEMENT_INTERFACE(GADGETD_TYPE_FUNCTION_MASS_STORAGE,
+						function_mass_storage_iface_init));
+
+/**
+ * @brief function mass storage set property function
+ * @param[in] object a GObject
+ * @param[in] property_id numeric id under which the property was registered with
+ * @param[in] value a new GValue for the property
+ * @param[in] pspec the GParamSpec structure describing the property
+ * @see GObjectSetPropertyFunc()
+ */
+static void
+function_mass_storage_set_property(GObject      *object,
+				   guint         property_id,
+				   const GValue *value,
+				   GParamSpec   *pspec)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+
+	switch(property_id) {
+	case PROP_MS_FUNC_OBJECT:
+		g_assert(ms->function_object == NULL);
+		ms->function_object = g_value_get_object(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+		break;
+	}
+}
+
+static struct gd_function *
+function_mass_storage_get_function(FunctionMassStorage *ms)
+{
+	g_return_val_if_fail(FUNCTION_IS_MASS_STORAGE(ms), NULL);
+	return gadgetd_function_object_get_function(ms->function_object);
+}
+
+/**
+ * @brief function mass storage get property.
+ * @details  generic Getter for all properties of this type
+ * @param[in] object a GObject
+ * @param[in] property_id numeric id under which the property was registered with
+ * @param[in] value a GValue to return the property value in
+ * @param[in] pspec the GParamSpec structure describing the property
+ * @see GObjectGetPropertyFunc()
+ */
+static void
+function_mass_storage_get_property(GObject    *object,
+				   guint       property_id,
+				   GValue     *value,
+				   GParamSpec *pspec)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+	struct gd_function *func;
+	GVariantBuilder builder;
+	GArray *luns;
+	gint val = 0;
+	guint i;
+
+	func = function_mass_storage_get_function(ms);
+	if (func == NULL) {
+		ERROR("Cant get function");
+		return;
+	}
+
+	switch(property_id) {
+	case PROP_MS_LUNS:
+		g_variant_builder_init(&builder, G_VARIANT_TYPE("au"));
+		if (gd_ms_list_luns(func, &luns) == GD_SUCCESS) {
+			for (i = 0; i < luns->len; ++i)
+				g_variant_builder_add(&builder, "u",
+						      g_array_index(luns, guint, i));
+			g_array_free(luns, TRUE);
+		}
+		g_value_set_variant(value, g_variant_builder_end(&builder));
+		break;
+	case PROP_MS_STALL:
+		gd_ms_get_attr(func, "stall", &val);
+		g_value_set_boolean(value, val != 0);
+		break;
+	case PROP_MS_NUM_BUFFERS:
+		/* -1 if kernel doesn't expose it */
+		if (gd_ms_get_attr(func, "num_buffers", &val) != GD_SUCCESS)
+			val = -1;
+		g_value_set_int(value, val);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+		break;
+	}
+}
+
+/**
+ * @brief function mass storage finalize
+ * @param[in] object GObject
+ */
+static void
+function_mass_storage_finalize(GObject *object)
+{
+	if (G_OBJECT_CLASS(function_mass_storage_parent_class)->finalize != NULL)
+		G_OBJECT_CLASS(function_mass_storage_parent_class)->finalize(object);
+}
+
+/**
+ * @brief function mass storage class init
+ * @param[in] klass FunctionMassStorageClass
+ */
+static void
+function_mass_storage_class_init(FunctionMassStorageClass *klass)
+{
+	GObjectClass *gobject_class;
+
+	gobject_class = G_OBJECT_CLASS(klass);
+	gobject_class->set_property = function_mass_storage_set_property;
+	gobject_class->get_property = function_mass_storage_get_property;
+	gobject_class->finalize = function_mass_storage_finalize;
+
+	g_object_class_override_property(gobject_class,
+					PROP_MS_LUNS,
+					"luns");
+	g_object_class_override_property(gobject_class,
+					PROP_MS_STALL,
+					"stall");
+	g_object_class_override_property(gobject_class,
+					PROP_MS_NUM_BUFFERS,
+					"num-buffers");
+
+	g_object_class_install_property(gobject_class,
+                                   PROP_MS_FUNC_OBJECT,
+                                   g_param_spec_object("function-object",
+                                                        "function-object",
+                                                        "function object",
+                                                        GADGETD_TYPE_FUNCTION_OBJECT,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * @brief function mass storage new
+ * @param[in] function_object GadgetdFunctionObject
+ * @return #FunctionMassStorage object.
+ */
+FunctionMassStorage *
+function_mass_storage_new(GadgetdFunctionObject *function_object)
+{
+	g_return_val_if_fail(function_object != NULL, NULL);
+	FunctionMassStorage *object;
+
+	object = g_object_new(FUNCTION_TYPE_MASS_STORAGE,
+			     "function-object", function_object,
+			      NULL);
+	return object;
+}
+
+/**
+ * @brief function mass storage init
+ */
+static void
+function_mass_storage_init(FunctionMassStorage *ms)
+{
+	/* noop */
+}
+
+/**
+ * @brief return result of method
+ * @param[in] invocation
+ * @param[in] g_ret gd_error returned by mass storage call
+ * @param[in] msg error string set by mass storage call
+ * @return true, method is always handled
+ */
+static gboolean
+function_mass_storage_return(GDBusMethodInvocation *invocation,
+			     gint g_ret, const gchar *msg)
+{
+	if (g_ret != GD_SUCCESS) {
+		ERROR("%s", msg);
+		g_dbus_method_invocation_return_dbus_error(invocation,
+				ms_iface,
+				msg);
+		return TRUE;
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+					      g_variant_new("(b)", TRUE));
+	return TRUE;
+}
+
+/**
+ * @brief handle add lun
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] lun number of new LUN
+ * @return true if metod handled
+ */
+static gboolean
+handle_add_lun(GadgetdFunctionMassStorage *object,
+	       GDBusMethodInvocation      *invocation,
+	       guint                       lun)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+	const gchar *msg = NULL;
+	gint g_ret;
+
+	g_ret = gd_ms_add_lun(function_mass_storage_get_function(ms), lun, &msg);
+	if (g_ret == GD_SUCCESS)
+		g_object_notify(G_OBJECT(object), "luns");
+
+	return function_mass_storage_return(invocation, g_ret, msg);
+}
+
+/**
+ * @brief handle remove lun
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] lun number of LUN
+ * @return true if metod handled
+ */
+static gboolean
+handle_remove_lun(GadgetdFunctionMassStorage *object,
+		  GDBusMethodInvocation      *invocation,
+		  guint                       lun)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+	const gchar *msg = NULL;
+	gint g_ret;
+
+	g_ret = gd_ms_rm_lun(function_mass_storage_get_function(ms), lun, &msg);
+	if (g_ret == GD_SUCCESS)
+		g_object_notify(G_OBJECT(object), "luns");
+
+	return function_mass_storage_return(invocation, g_ret, msg);
+}
+
+/**
+ * @brief handle set lun attrs
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] lun number of LUN
+ * @param[in] attrs attributes to be set
+ * @return true if metod handled
+ */
+static gboolean
+handle_set_lun_attrs(GadgetdFunctionMassStorage *object,
+		     GDBusMethodInvocation      *invocation,
+		     guint                       lun,
+		     GVariant                   *attrs)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+	const gchar *msg = NULL;
+	gint g_ret;
+
+	g_ret = gd_ms_set_lun_attrs(function_mass_storage_get_function(ms),
+				    lun, attrs, &msg);
+
+	return function_mass_storage_return(invocation, g_ret, msg);
+}
+
+/**
+ * @brief handle get lun attrs
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] lun number of LUN
+ * @return true if metod handled
+ */
+static gboolean
+handle_get_lun_attrs(GadgetdFunctionMassStorage *object,
+		     GDBusMethodInvocation      *invocation,
+		     guint                       lun)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+	GVariant *attrs;
+	gint g_ret;
+
+	g_ret = gd_ms_get_lun_attrs(function_mass_storage_get_function(ms),
+				    lun, &attrs);
+	if (g_ret != GD_SUCCESS) {
+		ERROR("Unable to get attributes of lun %u", lun);
+		g_dbus_method_invocation_return_dbus_error(invocation,
+				ms_iface,
+				"Unable to get LUN attributes");
+		return TRUE;
+	}
+
+	g_dbus_method_invocation_return_value(invocation,
+					      g_variant_new_tuple(&attrs, 1));
+	return TRUE;
+}
+
+/**
+ * @brief handle set attrs
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] attrs function attributes to be set
+ * @return true if metod handled
+ */
+static gboolean
+handle_set_attrs(GadgetdFunctionMassStorage *object,
+		 GDBusMethodInvocation      *invocation,
+		 GVariant                   *attrs)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+	const gchar *msg = NULL;
+	gint g_ret;
+
+	g_ret = gd_ms_set_attrs(function_mass_storage_get_function(ms),
+				attrs, &msg);
+	if (g_ret == GD_SUCCESS) {
+		g_object_notify(G_OBJECT(object), "stall");
+		g_object_notify(G_OBJECT(object), "num-buffers");
+	}
+
+	return function_mass_storage_return(invocation, g_ret, msg);
+}
+
+/**
+ * @brief handle swap media
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] lun number of LUN
+ * @param[in] file new backing file
+ * @return true if metod handled
+ */
+static gboolean
+handle_swap_media(GadgetdFunctionMassStorage *object,
+		  GDBusMethodInvocation      *invocation,
+		  guint                       lun,
+		  const gchar                *file)
+{
+	FunctionMassStorage *ms = FUNCTION_MASS_STORAGE(object);
+	const gchar *msg = NULL;
+	gint g_ret;
+
+	g_ret = gd_ms_swap_media(function_mass_storage_get_function(ms),
+				 lun, file, &msg);
+
+	return function_mass_storage_return(invocation, g_ret, msg);
+}
+
+/**
+ * @brief function mass storage iface init
+ * @param[in] iface GadgetdFunctionMassStorageIface
+ */
+static void
+function_mass_storage_iface_init(GadgetdFunctionMassStorageIface *iface)
+{
+	iface->handle_add_lun       = handle_add_lun;
+	iface->handle_remove_lun    = handle_remove_lun;
+	iface->handle_set_lun_attrs = handle_set_lun_attrs;
+	iface->handle_get_lun_attrs = handle_get_lun_attrs;
+	iface->handle_set_attrs     = handle_set_attrs;
+	iface->handle_swap_media    = handle_swap_media;
+}
@@ -0,0 +1,335 @@
+/*
+ * gadgetd-net-function-iface.c
+ * Copyright(c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0(the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <usbg/usbg.h>
+#include <stdio.h>
+#include <netinet/ether.h>
+#include <gio/gio.h>
+#include <gadgetd-common.h>
+#include <gadgetd-net-tuning.h>
+
+#include <gadgetd-gdbus-codegen.h>
+#include <dbus-function-ifaces/gadgetd-net-function-iface.h>
+
+#include <string.h>
+#ifdef G_OS_UNIX
+#  include <gio/gunixfdlist.h>
+#endif
+
+struct _FunctionNetAttrs
+{
+	GadgetdFunctionNetAttrsSkeleton parent_instance;
+
+	GadgetdFunctionObject *function_object;
+};
+
+struct _FunctionNetAttrsClass
+{
+	GadgetdFunctionNetAttrsSkeletonClass parent_class;
+};
+
+enum
+{
+	PROP_0,
+	PROP_NET_DEV_ADDR,
+	PROP_NET_HOST_ADDR,
+	PROP_NET_QMULT,
+	PROP_NET_IFNAME,
+	PROP_NET_RPS_CPUS,
+	PROP_NET_XPS_CPUS,
+	PROP_NET_RPS_FLOW_CNT,
+	PROP_NET_IRQ_CPUS,
+	PROP_NET_FUNC_OBJECT,
+} prop_net_attrs;
+
+static const char net_attrs_iface[] = "org.usb.device.Function.NetAttrs";
+
+static void function_net_attrs_iface_init(GadgetdFunctionNetAttrsIface *iface);
+
+/**
+ * @brief G_DEFINE_TYPE_WITH_CODE
+ * @details A convenience macro for type implementations. Similar to G_DEFINE_TYPE(), but allows
+ * to insert custom code into the *_get_type() function,
+ * @see G_DEFINE_TYPE()
+ */
+G_DEFINE_TYPE_WITH_CODE(FunctionNetAttrs, function_net_attrs, GADGETD_TYPE_FUNCTION_NET_ATTRS_SKELETON,
+			 G_IMPLEMENT_INTERFACE(GADGETD_TYPE_FUNCTION_NET_ATTRS,
+						function_net_attrs_iface_init));
+
+/**
+ * @brief function net attrs set property function
+ * @param[in] object a GObject
+ * @param[in] property_id numeric id under which the property was registered with
+ * @param[in] value a new GValue for the property
+ * @param[in] pspec the GParamSpec structure describing the property
+ * @see GObjectSetPropertyFunc()
+ */
+static void
+function_net_attrs_set_property(GObject      *object,
+				guint         property_id,
+				const GValue *value,
+				GParamSpec   *pspec)
+{
+	FunctionNetAttrs *net_attrs = FUNCTION_NET_ATTRS(object);
+
+	switch(property_id) {
+	case PROP_NET_FUNC_OBJECT:
+		g_assert(net_attrs->function_object == NULL);
+		net_attrs->function_object = g_value_get_object(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+		break;
+	}
+}
+
+static GadgetdFunctionObject *
+function_net_attrs_get_function_object(FunctionNetAttrs *net_attrs)
+{
+	g_return_val_if_fail(FUNCTION_IS_NET_ATTRS(net_attrs), NULL);
+	return net_attrs->function_object;
+}
+
+/**
+ * @brief function net attrs get property.
+ * @details  generic Getter for all properties of this type
+ * @param[in] object a GObject
+ * @param[in] property_id numeric id under which the property was registered with
+ * @param[in] value a GValue to return the property value in
+ * @param[in] pspec the GParamSpec structure describing the property
+ * @see GObjectGetPropertyFunc()
+ */
+static void
+function_net_attrs_get_property(GObject    *object,
+				guint       property_id,
+				GValue     *value,
+				GParamSpec *pspec)
+{
+	gint usbg_ret = USBG_SUCCESS;
+	FunctionNetAttrs *net_attrs = FUNCTION_NET_ATTRS(object);
+	GadgetdFunctionObject *function_object;
+	struct gd_function *func;
+	const struct gd_net_steering *steering;
+	usbg_function *f;
+	usbg_function_attrs f_attrs;
+	char addr[18];
+
+	function_object = function_net_attrs_get_function_object(net_attrs);
+
+	func = gadgetd_function_object_get_function(function_object);
+	steering = gd_net_get_steering(func);
+
+	switch(property_id) {
+	case PROP_NET_RPS_CPUS:
+		g_value_set_string(value, steering->rps_cpus ? steering->rps_cpus : "");
+		return;
+	case PROP_NET_XPS_CPUS:
+		g_value_set_string(value, steering->xps_cpus ? steering->xps_cpus : "");
+		return;
+	case PROP_NET_RPS_FLOW_CNT:
+		g_value_set_int(value, steering->rps_flow_cnt);
+		return;
+	case PROP_NET_IRQ_CPUS:
+		g_value_set_string(value, steering->irq_cpus ? steering->irq_cpus : "");
+		return;
+	}
+
+	f = func->f;
+
+	if (f == NULL) {
+		ERROR("Cant get function by name");
+		return;
+	}
+
+	usbg_ret = usbg_get_function_attrs(f, &f_attrs);
+	if (usbg_ret != USBG_SUCCESS) {
+		ERROR("Cant get function attributes");
+		return;
+	}
+
+	switch(property_id) {
+	case PROP_NET_DEV_ADDR:
+		g_value_set_string(value, ether_ntoa_r(&f_attrs.net.dev_addr, addr));
+		break;
+	case PROP_NET_HOST_ADDR:
+		g_value_set_string(value, ether_ntoa_r(&f_attrs.net.host_addr, addr));
+		break;
+	case PROP_NET_QMULT:
+		g_value_set_int(value, f_attrs.net.qmult);
+		break;
+	case PROP_NET_IFNAME:
+		g_value_set_string(value, f_attrs.net.ifname);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+		break;
+	}
+}
+
+/**
+ * @brief function net attrs finalize
+ * @param[in] object GObject
+ */
+static void
+function_net_attrs_finalize(GObject *object)
+{
+	if (G_OBJECT_CLASS(function_net_attrs_parent_class)->finalize != NULL)
+		G_OBJECT_CLASS(function_net_attrs_parent_class)->finalize(object);
+}
+
+/**
+ * @brief function net attrs class init
+ * @param[in] klass FunctionNetAttrsClass
+ */
+static void
+function_net_attrs_class_init(FunctionNetAttrsClass *klass)
+{
+	GObjectClass *gobject_class;
+
+	gobject_class = G_OBJECT_CLASS(klass);
+	gobject_class->set_property = function_net_attrs_set_property;
+	gobject_class->get_property = function_net_attrs_get_property;
+	gobject_class->finalize = function_net_attrs_finalize;
+
+	g_object_class_override_property(gobject_class,
+					PROP_NET_DEV_ADDR,
+					"dev-addr");
+	g_object_class_override_property(gobject_class,
+					PROP_NET_HOST_ADDR,
+					"host-addr");
+	g_object_class_override_property(gobject_class,
+					PROP_NET_QMULT,
+					"qmult");
+	g_object_class_override_property(gobject_class,
+					PROP_NET_IFNAME,
+					"ifname");
+	g_object_class_override_property(gobject_class,
+					PROP_NET_RPS_CPUS,
+					"rps-cpus");
+	g_object_class_override_property(gobject_class,
+					PROP_NET_XPS_CPUS,
+					"xps-cpus");
+	g_object_class_override_property(gobject_class,
+					PROP_NET_RPS_FLOW_CNT,
+					"rps-flow-cnt");
+	g_object_class_override_property(gobject_class,
+					PROP_NET_IRQ_CPUS,
+					"irq-cpus");
+
+	g_object_class_install_property(gobject_class,
+                                   PROP_NET_FUNC_OBJECT,
+                                   g_param_spec_object("function-object",
+                                                        "function-object",
+                                                        "function object",
+                                                        GADGETD_TYPE_FUNCTION_OBJECT,
+                                                        G_PARAM_READABLE |
+                                                        G_PARAM_WRITABLE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * @brief function net attrs new
+ * @param[in] function_object GadgetdFunctionObject
+ * @return #FunctionNetAttrs object.
+ */
+FunctionNetAttrs *
+function_net_attrs_new(GadgetdFunctionObject *function_object)
+{
+	g_return_val_if_fail(function_object != NULL, NULL);
+	FunctionNetAttrs *object;
+
+	object = g_object_new(FUNCTION_TYPE_NET_ATTRS,
+			     "function-object", function_object,
+			      NULL);
+	return object;
+}
+
+/**
+ * @brief function net attrs init
+ */
+static void
+function_net_attrs_init(FunctionNetAttrs *net_attrs)
+{
+	/* noop */
+}
+
+/**
+ * @brief handle set steering
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] rps_cpus CPU list for receive packet steering
+ * @param[in] xps_cpus CPU list for transmit packet steering
+ * @param[in] rps_flow_cnt flow table size of each receive queue
+ * @param[in] irq_cpus CPU list for interrupt of UDC
+ * @return true if metod handled
+ */
+static gboolean
+handle_set_steering(GadgetdFunctionNetAttrs *object,
+		    GDBusMethodInvocation   *invocation,
+		    const gchar             *rps_cpus,
+		    const gchar             *xps_cpus,
+		    gint                     rps_flow_cnt,
+		    const gchar             *irq_cpus)
+{
+	FunctionNetAttrs *net_attrs = FUNCTION_NET_ATTRS(object);
+	struct gd_function *func;
+	const gchar *msg;
+	gint g_ret;
+
+	func = gadgetd_function_object_get_function(net_attrs->function_object);
+	if (func == NULL) {
+		msg = "Failed to get function";
+		goto error;
+	}
+
+	g_ret = gd_net_set_steering(func, rps_cpus, xps_cpus, rps_flow_cnt,
+				    irq_cpus);
+	if (g_ret == GD_ERROR_BAD_VALUE) {
+		msg = "Invalid CPU list";
+		goto error;
+	} else if (g_ret != GD_SUCCESS) {
+		msg = "Failed to apply steering";
+		goto error;
+	}
+
+	g_object_notify(G_OBJECT(object), "rps-cpus");
+	g_object_notify(G_OBJECT(object), "xps-cpus");
+	g_object_notify(G_OBJECT(object), "rps-flow-cnt");
+	g_object_notify(G_OBJECT(object), "irq-cpus");
+
+	g_dbus_method_invocation_return_value(invocation,
+					      g_variant_new("(b)", TRUE));
+	return TRUE;
+error:
+	ERROR("%s", msg);
+	g_dbus_method_invocation_return_dbus_error(invocation,
+			net_attrs_iface,
+			msg);
+
+	return TRUE;
+}
+
+/**
+ * @brief function net attrs iface init
+ * @param[in] iface GadgetdFunctionNetAttrsIface
+ */
+static void
+function_net_attrs_iface_init(GadgetdFunctionNetAttrsIface *iface)
+{
+	iface->handle_set_steering = handle_set_steering;
+}
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <gio/gio.h>
 #include <gadgetd-common.h>
+#include <gadgetd-serial-tuning.h>
 
 #include <gadgetd-gdbus-codegen.h>
 #include <dbus-function-ifaces/gadgetd-serial-function-iface.h>
@@ -33,6 +34,11 @@ struct _FunctionSerialAttrs
 	GadgetdFunctionSerialAttrsSkeleton parent_instance;
 
 	GadgetdFunctionObject *function_object;
+
+	/* port number doesn't change while function exists */
+	gboolean attrs_cached;
+	usbg_f_serial_attrs attrs;
+	gchar tty_path[32];
 };
 
 struct _FunctionSerialAttrsClass
@@ -44,6 +50,7 @@ enum
 {
 	PROP_0,
 	PROP_SERIAL_PORTNUM,
+	PROP_SERIAL_TTY_PATH,
 	PROP_SERIAL_FUNC_OBJECT,
 } prop_serial_attrs;
 
@@ -91,44 +98,72 @@ function_serial_attrs_get_function_object(FunctionSerialAttrs *serial_attrs)
 }
 
 /**
- * @brief function serial attrs get property.
- * @details  generic Getter for all properties of this type
- * @param[in] object a GObject
- * @param[in] property_id numeric id under which the property was registered with
- * @param[in] value a GValue to return the property value in
- * @param[in] pspec the GParamSpec structure describing the property
- * @see GObjectGetPropertyFunc()
+ * @brief Read function attributes from configfs on first use
+ * @param[in] serial_attrs FunctionSerialAttrs
+ * @return GD_SUCCESS on success, gd_error otherwise
  */
-static void
-function_serial_attrs_get_property(GObject    *object,
-				 guint       property_id,
-				 GValue     *value,
-				 GParamSpec *pspec)
+static gint
+function_serial_attrs_cache(FunctionSerialAttrs *serial_attrs)
 {
 	gint usbg_ret = USBG_SUCCESS;
-	FunctionSerialAttrs *serial_attrs = FUNCTION_SERIAL_ATTRS(object);
 	GadgetdFunctionObject *function_object;
 	usbg_function *f;
 	usbg_function_attrs f_attrs;
 
+	if (serial_attrs->attrs_cached)
+		return GD_SUCCESS;
+
 	function_object = function_serial_attrs_get_function_object(serial_attrs);
 
 	f = gadgetd_function_object_get_function(function_object)->f;
 
 	if (f == NULL) {
 		ERROR("Cant get function by name");
-		return;
+		return GD_ERROR_NOT_FOUND;
 	}
 
 	usbg_ret = usbg_get_function_attrs(f, &f_attrs);
 	if (usbg_ret != USBG_SUCCESS) {
 		ERROR("Cant get function attributes");
-		return;
+		return GD_ERROR_OTHER_ERROR;
 	}
 
+	serial_attrs->attrs = f_attrs.serial;
+	if (gd_serial_tty_path(f_attrs.serial.port_num, serial_attrs->tty_path,
+			       sizeof(serial_attrs->tty_path)) != GD_SUCCESS)
+		serial_attrs->tty_path[0] = '\0';
+
+	serial_attrs->attrs_cached = TRUE;
+
+	return GD_SUCCESS;
+}
+
+/**
+ * @brief function serial attrs get property.
+ * @details  generic Getter for all properties of this type
+ * @param[in] object a GObject
+ * @param[in] property_id numeric id under which the property was registered with
+ * @param[in] value a GValue to return the property value in
+ * @param[in] pspec the GParamSpec structure describing the property
+ * @see GObjectGetPropertyFunc()
+ */
+static void
+function_serial_attrs_get_property(GObject    *object,
+				 guint       property_id,
+				 GValue     *value,
+				 GParamSpec *pspec)
+{
+	FunctionSerialAttrs *serial_attrs = FUNCTION_SERIAL_ATTRS(object);
+
+	if (function_serial_attrs_cache(serial_attrs) != GD_SUCCESS)
+		return;
+
 	switch(property_id) {
 	case PROP_SERIAL_PORTNUM:
-		g_value_set_int(value, f_attrs.serial.port_num);
+		g_value_set_int(value, serial_attrs->attrs.port_num);
+		break;
+	case PROP_SERIAL_TTY_PATH:
+		g_value_set_string(value, serial_attrs->tty_path);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -164,6 +199,9 @@ function_serial_attrs_class_init(FunctionSerialAttrsClass *klass)
 	g_object_class_override_property(gobject_class,
 					PROP_SERIAL_PORTNUM,
 					"port-num");
+	g_object_class_override_property(gobject_class,
+					PROP_SERIAL_TTY_PATH,
+					"tty-path");
 
 	g_object_class_install_property(gobject_class,
                                    PROP_SERIAL_FUNC_OBJECT,
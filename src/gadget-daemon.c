@@ -28,6 +28,8 @@
 #include <gadget-daemon.h>
 #include <gadget-manager.h>
 #include <gadgetd-udc-object.h>
+#include <gadgetd-udc-monitor.h>
+#include <gadgetd-bind-executor.h>
 
 #include <string.h>
 #ifdef G_OS_UNIX
@@ -188,8 +190,6 @@ gadget_daemon_constructed(GObject *object)
 	GadgetDaemon *daemon = GADGET_DAEMON(object);
 	GadgetdGadgetManager *gadget_manager;
 	GDBusConnection *connection;
-	GadgetdUdcObject *udc_object;
-	GList *l;
 
 	daemon->object_manager = g_dbus_object_manager_server_new(gadgetd_path);
 
@@ -205,12 +205,9 @@ gadget_daemon_constructed(GObject *object)
 					 gadgetd_path,
 					 NULL);
 
-	/* create dbus udc objects */
-	for (l = gd_udcs; l != NULL; l = l->next) {
-		udc_object = gadgetd_udc_object_new((usbg_udc *)(l->data), daemon);
-		g_dbus_object_manager_server_export(gadget_daemon_get_object_manager(daemon),
-					    G_DBUS_OBJECT_SKELETON(udc_object));
-	}
+	/* create dbus udc objects and follow their hotplug */
+	if (gd_udc_monitor_start(daemon) != GD_SUCCESS)
+		ERROR("Unable to watch udc hotplug");
 
 	if (G_OBJECT_CLASS(gadget_daemon_parent_class)->constructed != NULL)
 		G_OBJECT_CLASS(gadget_daemon_parent_class)->constructed(object);
@@ -225,6 +222,8 @@ gadget_daemon_finalize(GObject *object)
 {
 	GadgetDaemon *daemon = GADGET_DAEMON(object);
 
+	gd_udc_monitor_stop();
+	gd_bind_executor_shutdown();
 	g_object_unref(daemon->connection);
 
 	if (G_OBJECT_CLASS(gadget_daemon_parent_class)->finalize != NULL)
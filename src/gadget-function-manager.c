@@ -326,9 +326,66 @@ handle_remove_function(GadgetdGadgetFunctionManager	*object,
 			GDBusMethodInvocation		*invocation,
 			const gchar			*function_path)
 {
-	/* TODO add remove function handler */
+	const gchar *msg = NULL;
+	GadgetFunctionManager *func_manager = GADGET_FUNCTION_MANAGER(object);
+	GDBusObjectManagerServer *object_manager;
+	GDBusObject *dbus_object;
+	GadgetDaemon *daemon;
+	struct gd_function *func;
+	gint ret;
+
 	INFO("remove function handler");
 
+	daemon = gadget_function_manager_get_daemon(func_manager);
+	if (daemon == NULL) {
+		msg = "Failed to get daemon";
+		goto err;
+	}
+
+	object_manager = gadget_daemon_get_object_manager(daemon);
+	if (object_manager == NULL) {
+		msg = "Failed to get object manager";
+		goto err;
+	}
+
+	if (!g_str_has_prefix(function_path, func_manager->gadget_path)) {
+		msg = "Function does not belong to this gadget";
+		goto err;
+	}
+
+	dbus_object = g_dbus_object_manager_get_object(
+				G_DBUS_OBJECT_MANAGER(object_manager),
+				function_path);
+	if (dbus_object == NULL || !GADGETD_IS_FUNCTION_OBJECT(dbus_object)) {
+		msg = "Failed to find function";
+		goto err_unref;
+	}
+
+	func = gadgetd_function_object_get_function(GADGETD_FUNCTION_OBJECT(dbus_object));
+	if (func == NULL) {
+		msg = "Failed to get function";
+		goto err_unref;
+	}
+
+	ret = gd_remove_function(func, &msg);
+	if (ret != GD_SUCCESS)
+		goto err_unref;
+
+	g_dbus_object_manager_server_unexport(object_manager, function_path);
+	g_object_unref(dbus_object);
+
+	g_dbus_method_invocation_return_value(invocation,
+					      g_variant_new("(b)", TRUE));
+	return TRUE;
+
+err_unref:
+	if (dbus_object != NULL)
+		g_object_unref(dbus_object);
+err:
+	ERROR("%s", msg);
+	g_dbus_method_invocation_return_dbus_error(invocation,
+			func_manager_iface,
+			msg);
 	return TRUE;
 }
 
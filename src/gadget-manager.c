@@ -30,6 +30,12 @@
 #include <gadgetd-common.h>
 #include <gadgetd-gadget-object.h>
 #include <gadgetd-core.h>
+#include <gadgetd-udc-object.h>
+#include <gadgetd-udc-iface.h>
+#include <gadgetd-udc-state.h>
+#include <gadgetd-bind-executor.h>
+#include <gadgetd-functions.h>
+#include <gadgetd-udc-connect.h>
 
 typedef struct _GadgetManagerClass   GadgetManagerClass;
 
@@ -398,6 +404,500 @@ error:
 	return TRUE;
 }
 
+/**
+ * @brief state of single entry of BindMany or UnbindMany
+ */
+struct gd_bind_entry {
+	GadgetdUdcObject *udc_obj;
+	struct gd_gadget *gadget;
+	const gchar *gadget_path;
+	const gchar *msg;
+	gint job;
+};
+
+/**
+ * @brief get udc object by path
+ * @param[in] object_manager object manager of daemon
+ * @param[in] path object path of udc
+ * @return udc object owned by object manager or NULL
+ */
+static GadgetdUdcObject *
+gd_get_udc_object(GDBusObjectManager *object_manager, const gchar *path)
+{
+	GDBusObject *obj;
+
+	obj = g_dbus_object_manager_get_object(object_manager, path);
+	if (obj == NULL)
+		return NULL;
+
+	/* object is still referenced by object manager */
+	g_object_unref(obj);
+	if (!GADGETD_IS_UDC_OBJECT(obj))
+		return NULL;
+
+	return GADGETD_UDC_OBJECT(obj);
+}
+
+/**
+ * @brief check if udc is used by earlier entry
+ * @param[in] entries entries of request
+ * @param[in] n number of earlier entries
+ * @param[in] u udc to be checked
+ * @return TRUE if udc is already used
+ */
+static gboolean
+gd_bind_entries_use_udc(struct gd_bind_entry *entries, gint n, usbg_udc *u)
+{
+	gint i;
+
+	for (i = 0; i < n; ++i)
+		if (entries[i].udc_obj != NULL
+		    && gadgetd_udc_object_get_udc(entries[i].udc_obj) == u)
+			return TRUE;
+
+	return FALSE;
+}
+
+/**
+ * @brief build result of BindMany or UnbindMany
+ * @param[in] entries entries of request
+ * @param[in] n number of entries
+ * @return GVariant of type a(bs)
+ */
+static GVariant *
+gd_bind_entries_result(struct gd_bind_entry *entries, gint n)
+{
+	GVariantBuilder builder;
+	gint i;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(bs)"));
+	for (i = 0; i < n; ++i) {
+		if (entries[i].msg != NULL)
+			ERROR("%s", entries[i].msg);
+		g_variant_builder_add(&builder, "(bs)", entries[i].msg == NULL,
+				      entries[i].msg ? entries[i].msg : "");
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+/**
+ * @brief bind many gadgets handler
+ * @details Binds are run in parallel, each gadget and udc
+ * may be used only once in request
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] bindings array of gadget path and udc path pairs
+ * @return true if metod handled
+ */
+static gboolean
+handle_bind_many(GadgetdGadgetManager	*object,
+		 GDBusMethodInvocation	*invocation,
+		 GVariant		*bindings)
+{
+	struct gd_bind_entry *entries = NULL;
+	struct gd_bind_job *jobs = NULL;
+	GadgetDaemon *daemon;
+	GDBusObjectManager *object_manager;
+	GVariantIter iter;
+	const gchar *gadget_path;
+	const gchar *udc_path;
+	const gchar *msg = NULL;
+	usbg_udc *u;
+	usbg_udc *bound;
+	gint n, n_jobs = 0;
+	gint i, j;
+
+	INFO("bind many handler");
+
+	daemon = gadget_manager_get_daemon(GADGET_MANAGER(object));
+	if (daemon == NULL) {
+		msg = "Failed to get daemon";
+		goto error;
+	}
+
+	object_manager = G_DBUS_OBJECT_MANAGER(gadget_daemon_get_object_manager(daemon));
+	if (object_manager == NULL) {
+		msg = "Failed to get object manager";
+		goto error;
+	}
+
+	n = g_variant_n_children(bindings);
+	entries = g_new0(struct gd_bind_entry, n);
+	jobs = g_new0(struct gd_bind_job, n);
+
+	/* libusbg is not thread safe, everything but bind is done here */
+	i = 0;
+	g_variant_iter_init(&iter, bindings);
+	while (g_variant_iter_next(&iter, "(&o&o)", &gadget_path, &udc_path)) {
+		struct gd_bind_entry *e = &entries[i++];
+
+		e->job = -1;
+		e->gadget_path = gadget_path;
+
+		e->udc_obj = gd_get_udc_object(object_manager, udc_path);
+		if (e->udc_obj == NULL) {
+			e->msg = "Failed to get udc object";
+			continue;
+		}
+
+		u = gadgetd_udc_object_get_udc(e->udc_obj);
+		if (gd_bind_entries_use_udc(entries, i - 1, u)) {
+			e->udc_obj = NULL;
+			e->msg = "UDC used more than once";
+			continue;
+		}
+
+		for (j = 0; j < i - 1; ++j)
+			if (entries[j].job >= 0
+			    && g_strcmp0(entries[j].gadget_path, gadget_path) == 0)
+				break;
+		if (j < i - 1) {
+			e->msg = "Gadget used more than once";
+			continue;
+		}
+
+		if (gd_udc_prepare_enable(e->udc_obj, gadget_path, &e->gadget,
+					  &e->msg) != GD_SUCCESS)
+			continue;
+
+		e->job = 0;
+	}
+
+	for (i = 0; i < n; ++i) {
+		struct gd_bind_entry *e = &entries[i];
+
+		if (e->job < 0)
+			continue;
+
+		/* bind also updates udc to which gadget was bound before */
+		u = gadgetd_udc_object_get_udc(e->udc_obj);
+		bound = usbg_get_gadget_udc(e->gadget->g);
+		if (bound != NULL && bound != u
+		    && gd_bind_entries_use_udc(entries, n, bound)) {
+			e->msg = "Gadget is bound to UDC used in this request";
+			e->job = -1;
+			continue;
+		}
+
+		e->job = n_jobs;
+		jobs[n_jobs].g = e->gadget->g;
+		jobs[n_jobs].u = u;
+		jobs[n_jobs].enable = 1;
+		++n_jobs;
+	}
+
+	/* gadgets are prepared already, so failure is reported for each
+	   of them, just like failure of usbg_enable_gadget() */
+	if (gd_bind_executor_run(jobs, n_jobs, config.udc.bind_threads)
+	    != GD_SUCCESS) {
+		for (i = 0; i < n; ++i)
+			if (entries[i].job >= 0)
+				entries[i].msg = "Failed to run bind";
+		goto out;
+	}
+
+	for (i = 0; i < n; ++i) {
+		struct gd_bind_entry *e = &entries[i];
+
+		if (e->job < 0)
+			continue;
+
+		INFO("bind of %s took %" G_GINT64_FORMAT " us", e->gadget_path,
+		     jobs[e->job].usec);
+
+		if (jobs[e->job].usbg_ret != USBG_SUCCESS) {
+			e->msg = "Failed to enable gadget";
+			continue;
+		}
+
+		gd_udc_finish_enable(e->udc_obj, e->gadget, e->gadget_path,
+				     &e->msg);
+	}
+
+out:
+	g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(@a(bs))", gd_bind_entries_result(entries, n)));
+
+	g_free(entries);
+	g_free(jobs);
+	return TRUE;
+error:
+	ERROR("%s", msg);
+	g_dbus_method_invocation_return_dbus_error(invocation,
+			manager_iface,
+			msg);
+
+	g_free(entries);
+	g_free(jobs);
+	return TRUE;
+}
+
+/**
+ * @brief unbind many gadgets handler
+ * @details Unbinds are run in parallel
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] udc_paths udcs from which gadgets should be unbound
+ * @return true if metod handled
+ */
+static gboolean
+handle_unbind_many(GadgetdGadgetManager	*object,
+		   GDBusMethodInvocation	*invocation,
+		   const gchar *const		*udc_paths)
+{
+	struct gd_bind_entry *entries = NULL;
+	struct gd_bind_job *jobs = NULL;
+	GadgetDaemon *daemon;
+	GDBusObjectManager *object_manager;
+	struct gd_udc_state *st;
+	const gchar *msg = NULL;
+	usbg_gadget *g;
+	usbg_udc *u;
+	gint n, n_jobs = 0;
+	gint i;
+
+	INFO("unbind many handler");
+
+	daemon = gadget_manager_get_daemon(GADGET_MANAGER(object));
+	if (daemon == NULL) {
+		msg = "Failed to get daemon";
+		goto error;
+	}
+
+	object_manager = G_DBUS_OBJECT_MANAGER(gadget_daemon_get_object_manager(daemon));
+	if (object_manager == NULL) {
+		msg = "Failed to get object manager";
+		goto error;
+	}
+
+	n = g_strv_length((gchar **)udc_paths);
+	entries = g_new0(struct gd_bind_entry, n);
+	jobs = g_new0(struct gd_bind_job, n);
+
+	for (i = 0; i < n; ++i) {
+		struct gd_bind_entry *e = &entries[i];
+
+		e->job = -1;
+		e->udc_obj = gd_get_udc_object(object_manager, udc_paths[i]);
+		if (e->udc_obj == NULL) {
+			e->msg = "Failed to get udc object";
+			continue;
+		}
+
+		u = gadgetd_udc_object_get_udc(e->udc_obj);
+		if (gd_bind_entries_use_udc(entries, i, u)) {
+			e->udc_obj = NULL;
+			e->msg = "UDC used more than once";
+			continue;
+		}
+
+		g = usbg_get_udc_gadget(u);
+		if (g == NULL) {
+			e->msg = "No gadget enabled";
+			continue;
+		}
+
+		e->job = n_jobs;
+		jobs[n_jobs].g = g;
+		jobs[n_jobs].u = u;
+		jobs[n_jobs].enable = 0;
+		++n_jobs;
+	}
+
+	/* reported for each entry, just like failure of bind */
+	if (gd_bind_executor_run(jobs, n_jobs, config.udc.bind_threads)
+	    != GD_SUCCESS) {
+		for (i = 0; i < n; ++i)
+			if (entries[i].job >= 0)
+				entries[i].msg = "Failed to run unbind";
+		goto out;
+	}
+
+	for (i = 0; i < n; ++i) {
+		struct gd_bind_entry *e = &entries[i];
+
+		if (e->job < 0)
+			continue;
+
+		if (jobs[e->job].usbg_ret != USBG_SUCCESS) {
+			e->msg = "Failed to disable gadget";
+			continue;
+		}
+
+		gadgetd_udc_object_set_enabled_gadget_path(e->udc_obj, NULL);
+		gd_udc_connect_cancel(usbg_get_udc_name(jobs[e->job].u));
+		st = gadgetd_udc_object_get_state(e->udc_obj);
+		if (st != NULL)
+			gd_udc_state_mark(st, "unbind");
+	}
+
+out:
+	g_dbus_method_invocation_return_value(invocation,
+			g_variant_new("(@a(bs))", gd_bind_entries_result(entries, n)));
+
+	g_free(entries);
+	g_free(jobs);
+	return TRUE;
+error:
+	ERROR("%s", msg);
+	g_dbus_method_invocation_return_dbus_error(invocation,
+			manager_iface,
+			msg);
+
+	g_free(entries);
+	g_free(jobs);
+	return TRUE;
+}
+
+/**
+ * @brief get max speed of udc
+ * @param[in] u udc
+ * @return enum gd_usb_speed, GD_USB_SPEED_UNKNOWN if not available
+ */
+static gint
+gd_udc_max_speed(usbg_udc *u)
+{
+	gchar speed[32];
+
+	if (gd_udc_read_attr(usbg_get_udc_name(u), "maximum_speed", speed,
+			     sizeof(speed)) != GD_SUCCESS)
+		return GD_USB_SPEED_UNKNOWN;
+
+	return gd_usb_speed_from_str(speed);
+}
+
+/**
+ * @brief enable gadget on best udc handler
+ * @details Chooses free udc with the lowest max speed which is
+ * still enough for all functions of gadget, so faster udcs are
+ * left for gadgets which need them. Gadget which is already bound
+ * to fast enough udc stays there, gadget bound to too slow udc is
+ * disabled on it before it is enabled on the chosen one.
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] gadget_path path of gadget to be enabled
+ * @return true if metod handled
+ */
+static gboolean
+handle_enable_gadget_best(GadgetdGadgetManager	*object,
+			  GDBusMethodInvocation	*invocation,
+			  const gchar		*gadget_path)
+{
+	GadgetDaemon *daemon;
+	GDBusObjectManager *object_manager;
+	GDBusObject *obj;
+	GadgetdUdcObject *best = NULL;
+	GadgetdUdcObject *current = NULL;
+	struct gd_gadget *gd_gadget;
+	const gchar *udc_path = NULL;
+	const gchar *msg = NULL;
+	usbg_gadget *bound;
+	GList *objects;
+	GList *l;
+	gint required;
+	gint speed;
+	gint best_speed = 0;
+
+	INFO("enable gadget best handler");
+
+	daemon = gadget_manager_get_daemon(GADGET_MANAGER(object));
+	if (daemon == NULL) {
+		msg = "Failed to get daemon";
+		goto error;
+	}
+
+	object_manager = G_DBUS_OBJECT_MANAGER(gadget_daemon_get_object_manager(daemon));
+	if (object_manager == NULL) {
+		msg = "Failed to get object manager";
+		goto error;
+	}
+
+	obj = g_dbus_object_manager_get_object(object_manager, gadget_path);
+	if (obj == NULL) {
+		msg = "Failed to get gadget object";
+		goto error;
+	}
+	/* object is still referenced by object manager */
+	g_object_unref(obj);
+	if (!GADGETD_IS_GADGET_OBJECT(obj)) {
+		msg = "Failed to get gadget object";
+		goto error;
+	}
+
+	gd_gadget = gadgetd_gadget_object_get_gadget(GADGETD_GADGET_OBJECT(obj));
+	if (gd_gadget == NULL) {
+		msg = "Failed to get gadget";
+		goto error;
+	}
+
+	required = gd_gadget_required_speed(gd_gadget);
+
+	objects = g_dbus_object_manager_get_objects(object_manager);
+	for (l = objects; l != NULL; l = l->next) {
+		GadgetdUdcObject *udc_obj;
+		usbg_udc *u;
+
+		if (!GADGETD_IS_UDC_OBJECT(l->data))
+			continue;
+
+		udc_obj = GADGETD_UDC_OBJECT(l->data);
+		u = gadgetd_udc_object_get_udc(udc_obj);
+
+		/* udc to which this gadget is already bound is also free */
+		bound = usbg_get_udc_gadget(u);
+		if (bound != NULL && bound != gd_gadget->g)
+			continue;
+
+		if (bound != NULL)
+			current = udc_obj;
+
+		speed = gd_udc_max_speed(u);
+		if (speed < required)
+			continue;
+
+		/* moving bound gadget would disconnect host for nothing */
+		if (bound != NULL) {
+			best = udc_obj;
+			break;
+		}
+
+		if (best == NULL || speed < best_speed) {
+			best = udc_obj;
+			best_speed = speed;
+		}
+	}
+
+	if (best != NULL) {
+		udc_path = g_dbus_object_get_object_path(G_DBUS_OBJECT(best));
+		/* gadget bound to too slow udc has to be unbound first */
+		if (best != current &&
+		    (current == NULL ||
+		     gd_udc_disable_gadget(current, &msg) == GD_SUCCESS))
+			gd_udc_enable_gadget(best, gadget_path, &msg);
+	} else {
+		msg = "No free UDC supports required speed";
+	}
+
+	/* object manager keeps udc objects alive */
+	g_list_foreach(objects, (GFunc)g_object_unref, NULL);
+	g_list_free(objects);
+	if (msg != NULL)
+		goto error;
+
+	g_dbus_method_invocation_return_value(invocation,
+				      g_variant_new("(o)", udc_path));
+
+	return TRUE;
+error:
+	ERROR("%s", msg);
+	g_dbus_method_invocation_return_dbus_error(invocation,
+			manager_iface,
+			msg);
+
+	return TRUE;
+}
+
 /**
  * @brief gadget manager iface init
  * @param[in] iface GadgetdGadgetManagerIface
@@ -409,4 +909,7 @@ gadget_manager_iface_init(GadgetdGadgetManagerIface *iface)
 	iface->handle_remove_gadget = handle_remove_gadget;
 	iface->handle_find_gadget_by_name = handle_find_gadget_by_name;
 	iface->handle_list_available_functions = handle_list_available_functions;
+	iface->handle_bind_many = handle_bind_many;
+	iface->handle_unbind_many = handle_unbind_many;
+	iface->handle_enable_gadget_best = handle_enable_gadget_best;
 }
@@ -0,0 +1,160 @@
+/*
+ * gadgetd-bind-executor.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <gadgetd-bind-executor.h>
+#include <gadgetd-common.h>
+
+struct gd_bind_batch {
+	GMutex lock;
+	GCond done;
+	int pending;
+};
+
+struct gd_bind_task {
+	struct gd_bind_job *job;
+	struct gd_bind_batch *batch;
+};
+
+static GThreadPool *bind_pool;
+
+static void
+gd_bind_job_run(struct gd_bind_job *job)
+{
+	gint64 start;
+
+	start = g_get_monotonic_time();
+	if (job->enable)
+		job->usbg_ret = usbg_enable_gadget(job->g, job->u);
+	else
+		job->usbg_ret = usbg_disable_gadget(job->g);
+	job->usec = g_get_monotonic_time() - start;
+}
+
+static void
+gd_bind_worker(gpointer data, gpointer user_data)
+{
+	struct gd_bind_task *task = data;
+	struct gd_bind_batch *batch = task->batch;
+
+	gd_bind_job_run(task->job);
+
+	g_mutex_lock(&batch->lock);
+	if (--batch->pending == 0)
+		g_cond_signal(&batch->done);
+	g_mutex_unlock(&batch->lock);
+}
+
+static int
+gd_bind_pool_get(int max_threads)
+{
+	GError *error = NULL;
+
+	if (bind_pool == NULL) {
+		bind_pool = g_thread_pool_new(gd_bind_worker, NULL, max_threads,
+					      FALSE, &error);
+		if (bind_pool == NULL) {
+			ERROR("Unable to create bind threads: %s",
+			      error ? error->message : "");
+			g_clear_error(&error);
+			return GD_ERROR_OTHER_ERROR;
+		}
+		return GD_SUCCESS;
+	}
+
+	if (g_thread_pool_get_max_threads(bind_pool) != max_threads
+	    && !g_thread_pool_set_max_threads(bind_pool, max_threads, &error)) {
+		ERROR("Unable to resize bind threads: %s",
+		      error ? error->message : "");
+		g_clear_error(&error);
+		/* old size is still usable */
+	}
+
+	return GD_SUCCESS;
+}
+
+int
+gd_bind_executor_run(struct gd_bind_job *jobs, int n_jobs, int max_threads)
+{
+	struct gd_bind_batch batch;
+	struct gd_bind_task *tasks;
+	GError *error = NULL;
+	int i;
+	int ret;
+
+	if (n_jobs <= 0)
+		return GD_SUCCESS;
+
+	if (max_threads <= 0) {
+		max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (max_threads <= 0)
+			max_threads = 1;
+	}
+	if (max_threads > n_jobs)
+		max_threads = n_jobs;
+
+	/* nothing to gain from thread switch */
+	if (max_threads == 1) {
+		for (i = 0; i < n_jobs; ++i)
+			gd_bind_job_run(&jobs[i]);
+		return GD_SUCCESS;
+	}
+
+	ret = gd_bind_pool_get(max_threads);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	tasks = g_new(struct gd_bind_task, n_jobs);
+	g_mutex_init(&batch.lock);
+	g_cond_init(&batch.done);
+	batch.pending = n_jobs;
+
+	for (i = 0; i < n_jobs; ++i) {
+		tasks[i].job = &jobs[i];
+		tasks[i].batch = &batch;
+		if (!g_thread_pool_push(bind_pool, &tasks[i], &error)) {
+			/* run it here, batch must be completed anyway */
+			ERROR("Unable to queue bind job: %s",
+			      error ? error->message : "");
+			g_clear_error(&error);
+			gd_bind_worker(&tasks[i], NULL);
+		}
+	}
+
+	g_mutex_lock(&batch.lock);
+	while (batch.pending > 0)
+		g_cond_wait(&batch.done, &batch.lock);
+	g_mutex_unlock(&batch.lock);
+
+	g_cond_clear(&batch.done);
+	g_mutex_clear(&batch.lock);
+	g_free(tasks);
+
+	return GD_SUCCESS;
+}
+
+void
+gd_bind_executor_shutdown(void)
+{
+	if (bind_pool == NULL)
+		return;
+
+	g_thread_pool_free(bind_pool, FALSE, TRUE);
+	bind_pool = NULL;
+}
@@ -32,6 +32,9 @@ gd_error gd_translate_error(int error)
 	case EINVAL:
 		ret = GD_ERROR_INVALID_PARAM;
 		break;
+	case EBUSY:
+		ret = GD_ERROR_BUSY;
+		break;
 	case EDQUOT:
 	case EACCES:
 	case ENOENT:
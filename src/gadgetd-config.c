@@ -44,6 +44,7 @@
 
 typedef enum {
 	O_CONFIGFS_MOUNT_POINT,
+	O_FFS_MOUNT_ROOT,
 	O_BCD_USB,
 	O_BDEVICE_CLASS,
 	O_BDEVICE_SUB_CLASS,
@@ -56,6 +57,26 @@ typedef enum {
 	O_MANUFACTURER,
 	O_PRODUCT_NAME,
 	O_GD_CONFIGURATION,
+	O_NET_QMULT,
+	O_NET_MTU,
+	O_NET_TXQUEUELEN,
+	O_NET_GRO,
+	O_NET_GSO,
+	O_NET_QDISC,
+	O_NET_RPS_CPUS,
+	O_NET_XPS_CPUS,
+	O_NET_RPS_FLOW_CNT,
+	O_NET_IRQ_CPUS,
+	O_SERIAL_RAW,
+	O_SERIAL_VMIN,
+	O_SERIAL_VTIME,
+	O_SERIAL_CONSOLE,
+	O_UDC_HOTPLUG,
+	O_UDC_DEFAULT_GADGET,
+	O_UDC_DEFAULT_UDC,
+	O_UDC_BIND_THREADS,
+	O_UDC_CONNECT_WAIT,
+	O_UDC_CONNECT_TIMEOUT,
 	O_BAD_OPTION
 } op_code;
 
@@ -69,6 +90,7 @@ gadgetd_parse_opcode(const char *cp, const char *filename, int linenum)
 		op_code opcode;
 	} config_op[] = {
 		{ "configfs_mount_point", O_CONFIGFS_MOUNT_POINT},
+		{ "ffs_mount_root", O_FFS_MOUNT_ROOT},
 		{ "bcdusb", O_BCD_USB},
 		{ "bdeviceclass", O_BDEVICE_CLASS},
 		{ "bdevicesubclass", O_BDEVICE_SUB_CLASS},
@@ -81,6 +103,26 @@ gadgetd_parse_opcode(const char *cp, const char *filename, int linenum)
 		{ "product_name", O_PRODUCT_NAME},
 		{ "manufacturer", O_MANUFACTURER},
 		{ "gd_configuration", O_GD_CONFIGURATION},
+		{ "net_qmult", O_NET_QMULT},
+		{ "net_mtu", O_NET_MTU},
+		{ "net_txqueuelen", O_NET_TXQUEUELEN},
+		{ "net_gro", O_NET_GRO},
+		{ "net_gso", O_NET_GSO},
+		{ "net_qdisc", O_NET_QDISC},
+		{ "net_rps_cpus", O_NET_RPS_CPUS},
+		{ "net_xps_cpus", O_NET_XPS_CPUS},
+		{ "net_rps_flow_cnt", O_NET_RPS_FLOW_CNT},
+		{ "net_irq_cpus", O_NET_IRQ_CPUS},
+		{ "serial_raw", O_SERIAL_RAW},
+		{ "serial_vmin", O_SERIAL_VMIN},
+		{ "serial_vtime", O_SERIAL_VTIME},
+		{ "serial_console", O_SERIAL_CONSOLE},
+		{ "udc_hotplug", O_UDC_HOTPLUG},
+		{ "udc_default_gadget", O_UDC_DEFAULT_GADGET},
+		{ "udc_default_udc", O_UDC_DEFAULT_UDC},
+		{ "udc_bind_threads", O_UDC_BIND_THREADS},
+		{ "udc_connect_wait", O_UDC_CONNECT_WAIT},
+		{ "udc_connect_timeout", O_UDC_CONNECT_TIMEOUT},
 		{ NULL, O_BAD_OPTION}
 	};
 
@@ -182,6 +224,75 @@ out:
 	return g_ret;
 }
 
+static int
+gd_parse_int_value(char *s, int *intptr)
+{
+	long value;
+	char *endofnmb, *arg;
+	int g_ret = GD_SUCCESS;
+
+	arg = strdelim(&s);
+	if (!arg || *arg == '\0') {
+		g_ret = GD_ERROR_BAD_VALUE;
+		goto out;
+	}
+	value = strtol(arg, &endofnmb, 0);
+	if (value < 0 || value > INT_MAX){
+		g_ret = GD_ERROR_BAD_VALUE;
+		goto out;
+	}
+	if (*endofnmb != '\0') {
+		g_ret = GD_ERROR_BAD_VALUE;
+		goto out;
+	}
+	*intptr = value;
+	g_ret = GD_SUCCESS;
+out:
+	return g_ret;
+}
+
+/* termios control characters are cc_t, which is unsigned char */
+static int
+gd_parse_cc_value(char *s, int *intptr)
+{
+	int value;
+	int g_ret;
+
+	g_ret = gd_parse_int_value(s, &value);
+	if (g_ret != GD_SUCCESS)
+		return g_ret;
+
+	if (value > 255)
+		return GD_ERROR_BAD_VALUE;
+
+	*intptr = value;
+	return GD_SUCCESS;
+}
+
+static int
+gd_parse_bool_value(char *s, int *intptr)
+{
+	char *arg;
+	int g_ret = GD_SUCCESS;
+
+	arg = strdelim(&s);
+	if (!arg || *arg == '\0') {
+		g_ret = GD_ERROR_BAD_VALUE;
+		goto out;
+	}
+	if (strcasecmp(arg, "on") == 0 || strcasecmp(arg, "yes") == 0
+	    || strcmp(arg, "1") == 0) {
+		*intptr = 1;
+	} else if (strcasecmp(arg, "off") == 0 || strcasecmp(arg, "no") == 0
+		   || strcmp(arg, "0") == 0) {
+		*intptr = 0;
+	} else {
+		g_ret = GD_ERROR_BAD_VALUE;
+	}
+out:
+	return g_ret;
+}
+
 static int
 gd_skip_keyword(char *keyword)
 {
@@ -205,6 +316,9 @@ gd_read_config_line(struct gd_config *pconfig, usbg_gadget_attrs *g_attrs,
 	uint8_t *uint8ptr = NULL;
 	char *charptr = NULL;
 	char **charptr2 = NULL;
+	int *intptr = NULL;
+	int *ccptr = NULL;
+	int *boolptr = NULL;
 
 	len = strlen(line);
 	if (line[len - 1]  != '\n') {
@@ -246,6 +360,9 @@ gd_read_config_line(struct gd_config *pconfig, usbg_gadget_attrs *g_attrs,
 	case O_CONFIGFS_MOUNT_POINT:
 		charptr2 = &pconfig->configfs_mnt;
 		break;
+	case O_FFS_MOUNT_ROOT:
+		charptr2 = &pconfig->ffs_mount_root;
+		break;
 	case O_BCD_USB:
 		uint16ptr = &g_attrs->bcdUSB;
 		break;
@@ -270,6 +387,66 @@ gd_read_config_line(struct gd_config *pconfig, usbg_gadget_attrs *g_attrs,
 	case O_ID_PRODUCT:
 		uint16ptr = &g_attrs->idProduct;
 		break;
+	case O_NET_QMULT:
+		intptr = &pconfig->net.qmult;
+		break;
+	case O_NET_MTU:
+		intptr = &pconfig->net.mtu;
+		break;
+	case O_NET_TXQUEUELEN:
+		intptr = &pconfig->net.txqueuelen;
+		break;
+	case O_NET_GRO:
+		boolptr = &pconfig->net.gro;
+		break;
+	case O_NET_GSO:
+		boolptr = &pconfig->net.gso;
+		break;
+	case O_NET_QDISC:
+		charptr2 = &pconfig->net.qdisc;
+		break;
+	case O_NET_RPS_CPUS:
+		charptr2 = &pconfig->net.steering.rps_cpus;
+		break;
+	case O_NET_XPS_CPUS:
+		charptr2 = &pconfig->net.steering.xps_cpus;
+		break;
+	case O_NET_RPS_FLOW_CNT:
+		intptr = &pconfig->net.steering.rps_flow_cnt;
+		break;
+	case O_NET_IRQ_CPUS:
+		charptr2 = &pconfig->net.steering.irq_cpus;
+		break;
+	case O_SERIAL_RAW:
+		boolptr = &pconfig->serial.raw;
+		break;
+	case O_SERIAL_VMIN:
+		ccptr = &pconfig->serial.vmin;
+		break;
+	case O_SERIAL_VTIME:
+		ccptr = &pconfig->serial.vtime;
+		break;
+	case O_SERIAL_CONSOLE:
+		charptr2 = &pconfig->serial.console;
+		break;
+	case O_UDC_HOTPLUG:
+		boolptr = &pconfig->udc.hotplug;
+		break;
+	case O_UDC_DEFAULT_GADGET:
+		charptr2 = &pconfig->udc.default_gadget;
+		break;
+	case O_UDC_DEFAULT_UDC:
+		charptr2 = &pconfig->udc.default_udc;
+		break;
+	case O_UDC_BIND_THREADS:
+		intptr = &pconfig->udc.bind_threads;
+		break;
+	case O_UDC_CONNECT_WAIT:
+		charptr2 = &pconfig->udc.connect_wait;
+		break;
+	case O_UDC_CONNECT_TIMEOUT:
+		intptr = &pconfig->udc.connect_timeout;
+		break;
 	default:
 		break;
 		ERROR("unnknown eror %d", opcode);
@@ -296,7 +473,27 @@ gd_read_config_line(struct gd_config *pconfig, usbg_gadget_attrs *g_attrs,
 			ERROR("bad value in file %.100s at line %d, expected char[%d]",
 				filename, linenum, USBG_MAX_STR_LENGTH);
 	}
+	else if (intptr) {
+		g_ret = gd_parse_int_value(s, intptr);
+		if(g_ret != 0)
+			ERROR("bad value in file %.100s at line %d, expected number",
+				filename, linenum);
+	}
+	else if (ccptr) {
+		g_ret = gd_parse_cc_value(s, ccptr);
+		if(g_ret != 0)
+			ERROR("bad value in file %.100s at line %d, expected 0-255",
+				filename, linenum);
+	}
+	else if (boolptr) {
+		g_ret = gd_parse_bool_value(s, boolptr);
+		if(g_ret != 0)
+			ERROR("bad value in file %.100s at line %d, expected on/off",
+				filename, linenum);
+	}
 	else if (charptr2) {
+		free(*charptr2);
+		*charptr2 = NULL;
 		g_ret = gd_parse_str_value(s, charptr2) ;
 		if(g_ret != 0)
 			ERROR("bad value in file %.100s at line %d",
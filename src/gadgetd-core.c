@@ -324,3 +324,28 @@ out:
 	return ret;
 }
 
+int
+gd_remove_function(struct gd_function *f, const gchar **error)
+{
+	struct gd_function_type *type;
+	int usbg_ret;
+	int ret;
+
+	type = gd_lookup_function_type(f->type);
+	if (!type) {
+		*error = "Type not found";
+		ret = GD_ERROR_NOT_FOUND;
+		goto out;
+	}
+
+	usbg_ret = type->rm_instance(f);
+	if (usbg_ret != USBG_SUCCESS) {
+		*error = usbg_error_name(usbg_ret);
+		ret = GD_ERROR_OTHER_ERROR;
+		goto out;
+	}
+
+	ret = GD_SUCCESS;
+out:
+	return ret;
+}
@@ -15,11 +15,15 @@
  * limitations under the License.
  */
 
-#define _GNU_SOURCE /* for asprintf */
+#define _GNU_SOURCE /* for asprintf and cpu sets */
 #include <sys/mount.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
 #include <linux/limits.h>
 #include <endian.h>
 #include <stdlib.h>
@@ -29,9 +33,13 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
-#include <assert.h>
+#include <time.h>
+#include <sched.h>
+#include <grp.h>
+#include <signal.h>
 
 #include "gadgetd-ffs-func.h"
+#include "gadgetd-config.h"
 #include "common.h"
 
 struct gd_ffs_func_type *
@@ -66,13 +74,17 @@ gd_unref_gd_ffs_func_type(struct gd_ffs_func_type *srv)
 static char *
 mount_ffs_instance(const char *service, const char *name)
 {
-	/* currently hardcoded, should be configurable.
-	   Assume that this directory exist */
-	static const char *prefix = "/tmp/gadgetd/";
+	const char *prefix = config.ffs_mount_root;
 	int ret;
 	char service_dir[PATH_MAX];
 	char *mount_dir = NULL;
 
+	ret = mkdir(prefix, S_IRWXU|S_IRWXG|S_IRWXO);
+	if (ret != 0 && errno != EEXIST) {
+		ERRNO("Unable to create ffs mount root");
+		goto error_out;
+	}
+
 	ret = snprintf(service_dir, sizeof(service_dir), "%s/%s",
 		       prefix, service);
 	if (ret < 0 || ret >= sizeof(service_dir))
@@ -97,6 +109,7 @@ mount_ffs_instance(const char *service, const char *name)
 	ret = mount(name, mount_dir, "functionfs", 0, NULL);
 	if (ret) {
 		ERRNO("Unable to mount ffs instance");
+		rmdir(mount_dir);
 		goto error;
 	}
 
@@ -166,34 +179,87 @@ umount_ffs_instance(char *path)
 }
 
 int
-gd_ffs_prepare_instance(struct gd_ffs_func_type *srv, struct gd_ffs_func *func)
+gd_ffs_mount_instance(struct gd_ffs_func_type *srv, struct gd_ffs_func *func)
 {
-	char ep0_file[PATH_MAX];
-	int ret = 0;
-
 	if (!srv || !func)
-		goto out;
+		return GD_ERROR_INVALID_PARAM;
 
 	func->service = gd_ref_gd_ffs_func_type(srv);
 	if (!func->service)
-		goto out;
+		return GD_ERROR_OTHER_ERROR;
 
 	func->mount_dir = mount_ffs_instance(srv->reg_type.name,
 					     usbg_get_function_instance(func->func.f));
-	if (!func->mount_dir)
-		goto err_unref;
+	if (!func->mount_dir) {
+		gd_unref_gd_ffs_func_type(func->service);
+		func->service = NULL;
+		return GD_ERROR_OTHER_ERROR;
+	}
+
+	func->ep0_fd = -1;
+	func->event_fd = -1;
+	func->state = FFS_INSTANCE_POOLED;
+
+	return GD_SUCCESS;
+}
+
+/*
+ * Descriptors are shared by all instances of service but
+ * eventfd has to be created for each instance and its number
+ * placed in the header just after flags.
+ */
+static int
+write_descriptors(struct gd_ffs_func *func)
+{
+	struct gd_ffs_func_type *srv = func->service;
+	uint32_t *header;
+	void *desc;
+	int ret;
+
+	if (!(srv->ffs_flags & FUNCTIONFS_EVENTFD))
+		return write(func->ep0_fd, srv->desc, srv->desc_size);
+
+	/* Passed only to service of this instance, see shift_fds() */
+	func->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (func->event_fd < 0)
+		return -1;
+
+	desc = malloc(srv->desc_size);
+	if (!desc)
+		return -1;
+
+	memcpy(desc, srv->desc, srv->desc_size);
+	/* magic, length, flags, eventfd */
+	header = desc;
+	header[3] = htole32(func->event_fd);
+
+	ret = write(func->ep0_fd, desc, srv->desc_size);
+	free(desc);
+
+	return ret;
+}
+
+int
+gd_ffs_open_instance(struct gd_ffs_func *func)
+{
+	char ep0_file[PATH_MAX];
+	int ret = 0;
+
+	if (!func || func->state != FFS_INSTANCE_POOLED)
+		return GD_ERROR_INVALID_PARAM;
 
 	ret = snprintf(ep0_file, sizeof(ep0_file), "%s/ep0", func->mount_dir);
 	if (ret < 0 || ret >= sizeof(ep0_file))
-		goto err_umount;
+		return GD_ERROR_PATH_TOO_LONG;
 
 	func->ep0_fd = open(ep0_file, O_RDWR);
-	if (func->ep0_fd < 0)
-		goto err_umount;
+	if (func->ep0_fd < 0) {
+		ERRNO("Unable to open ep0");
+		return GD_ERROR_OTHER_ERROR;
+	}
 
 	/* Write descriptors */
-	ret = write(func->ep0_fd, func->service->desc,
-		    func->service->desc_size);
+	ret = write_descriptors(func);
 	if (ret < 0) {
 		ERRNO("Unable to write descriptors");
 		goto err_close;
@@ -208,26 +274,144 @@ gd_ffs_prepare_instance(struct gd_ffs_func_type *srv, struct gd_ffs_func *func)
 
 	func->state = FFS_INSTANCE_READY;
 
-out:
 	return GD_SUCCESS;
 
 err_close:
 	close(func->ep0_fd);
 	func->ep0_fd = -1;
-err_umount:
+	if (func->event_fd >= 0) {
+		close(func->event_fd);
+		func->event_fd = -1;
+	}
+	return GD_ERROR_OTHER_ERROR;
+}
+
+/* monotonic time in microseconds */
+static gint64
+ffs_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Service is only asked to exit here, waiting for it would block
+ * main loop. It is reaped by its child watch, which moves instance
+ * from FFS_INSTANCE_STOPPING to stop_state.
+ */
+static int
+terminate_service(struct gd_ffs_func *func, enum ffs_instance_state stop_state)
+{
+	if (func->pid <= 0)
+		return 0;
+
+	/* Even if it is already a zombie, it has to be reaped */
+	if (kill(func->pid, SIGTERM) < 0 && errno != ESRCH) {
+		ERRNO("Unable to terminate service %d", func->pid);
+		return -1;
+	}
+
+	func->state = FFS_INSTANCE_STOPPING;
+	func->stop_state = stop_state;
+
+	return 1;
+}
+
+int
+gd_ffs_kill_instance(struct gd_ffs_func *func)
+{
+	if (!func || func->state != FFS_INSTANCE_STOPPING || func->pid <= 0)
+		return -1;
+
+	INFO("FFS service %d did not exit, killing it", func->pid);
+	return kill(func->pid, SIGKILL);
+}
+
+int
+gd_ffs_service_reaped(struct gd_ffs_func *func)
+{
+	if (!func || func->state != FFS_INSTANCE_STOPPING)
+		return -1;
+
+	func->pid = 0;
+	func->exit_time = ffs_now();
+	func->state = func->stop_state;
+
+	return 0;
+}
+
+int
+gd_ffs_stop_instance(struct gd_ffs_func *func)
+{
+	int ret;
+
+	if (!func)
+		return -1;
+
+	/* Service has to release all endpoints before kernel allows
+	   to write new descriptors, so instance is pooled only after
+	   service is reaped */
+	ret = terminate_service(func, FFS_INSTANCE_POOLED);
+	if (ret <= 0) {
+		func->pid = 0;
+		func->state = FFS_INSTANCE_POOLED;
+	}
+
+	/* Last close of ep0 makes functionfs wait for descriptors again */
+	if (func->ep0_fd >= 0) {
+		close(func->ep0_fd);
+		func->ep0_fd = -1;
+	}
+
+	if (func->event_fd >= 0) {
+		close(func->event_fd);
+		func->event_fd = -1;
+	}
+
+	func->restart_backoff = 0;
+
+	return ret > 0;
+}
+
+void
+gd_ffs_release_instance(struct gd_ffs_func *func)
+{
+	if (!func)
+		return;
+
 	umount_ffs_instance(func->mount_dir);
 	free(func->mount_dir);
-err_unref:
+	func->mount_dir = NULL;
+
 	gd_unref_gd_ffs_func_type(func->service);
-	return GD_ERROR_OTHER_ERROR;
+	func->service = NULL;
+}
+
+int
+gd_ffs_prepare_instance(struct gd_ffs_func_type *srv, struct gd_ffs_func *func)
+{
+	int ret;
+
+	ret = gd_ffs_mount_instance(srv, func);
+	if (ret != GD_SUCCESS)
+		goto out;
+
+	ret = gd_ffs_open_instance(func);
+	if (ret != GD_SUCCESS)
+		gd_ffs_release_instance(func);
+out:
+	return ret;
 }
 
 static char **
 prepare_args(struct gd_ffs_func *inst)
 {
 	char **args;
-	int size = 2;
+	int size = 2 + inst->service->exec_args_size;
 	int i = 0;
+	int j;
 
 	args = calloc(size, sizeof(char *));
 	if (!args)
@@ -239,6 +423,12 @@ prepare_args(struct gd_ffs_func *inst)
 	if (!args[i++])
 		goto error;
 
+	for (j = 0; j < inst->service->exec_args_size; ++j) {
+		args[i] = strdup(inst->service->exec_args[j]);
+		if (!args[i++])
+			goto error;
+	}
+
 	args[i] = NULL;
 out:
 	return args;
@@ -258,11 +448,11 @@ prepare_environ(struct gd_ffs_func *inst, int n_fds)
 	int event;
 	int ret;
 	char **envp = NULL;
-	int size = 4;
+	int size = 6;
 	int i = 0;
 
-	/* Max number of usb endpoints is 32 */
-	if (n_fds > 32)
+	/* Max number of usb endpoints is 32, plus eventfd */
+	if (n_fds > 33)
 		goto out;
 
 	envp = calloc(size, sizeof(char*));
@@ -283,6 +473,20 @@ prepare_environ(struct gd_ffs_func *inst, int n_fds)
 	if (ret < 0)
 		goto error;
 
+	if (inst->event_fd >= 0) {
+		envp[i] = strdup("FFS_EVENTFD=1");
+		if (!envp[i++])
+			goto error;
+	}
+
+	/* Memory locks are not inherited through exec so ask
+	   the service to lock itself */
+	if (inst->service->mlock) {
+		envp[i] = strdup("MLOCKALL=1");
+		if (!envp[i++])
+			goto error;
+	}
+
 	envp[i++] = NULL;
 out:
 	return envp;
@@ -308,9 +512,17 @@ shift_fds(int *pattern, int n_fds)
 		for (i = start; i < n_fds; ++i) {
 			int fd;
 
-			if (pattern[i] == i + 3)
+			/* Descriptor in place has to survive exec */
+			if (pattern[i] == i + 3) {
+				ret = fcntl(pattern[i], F_SETFD, 0);
+				if (ret < 0) {
+					ret = -errno;
+					goto out;
+				}
 				continue;
+			}
 
+			/* F_DUPFD clears close-on-exec flag of new descriptor */
 			fd = fcntl(pattern[i], F_DUPFD, i + 3);
 			if (fd < 0) {
 				ret = -errno;
@@ -499,7 +711,8 @@ prepare_fds_table(struct gd_ffs_func *inst, int **fdsp)
 	if (ep_nmb < 0)
 		goto error;
 
-	fds = calloc(ep_nmb + 1, sizeof(int));
+	/* eventfd is passed after all endpoints */
+	fds = calloc(ep_nmb + 2, sizeof(int));
 	if (!fds)
 		goto free_ep;
 
@@ -521,6 +734,11 @@ prepare_fds_table(struct gd_ffs_func *inst, int **fdsp)
 
 	*fdsp = fds;
 
+	if (inst->event_fd >= 0) {
+		fds[ep_nmb + 1] = inst->event_fd;
+		return ep_nmb + 2;
+	}
+
 	/* add 1 for ep0 */
 	return ep_nmb + 1;
 
@@ -538,6 +756,117 @@ error:
 	return -1;
 }
 
+static int
+join_cgroup(const char *dir)
+{
+	char path[PATH_MAX];
+	int fd, ret;
+
+	ret = snprintf(path, sizeof(path), "%s/cgroup.procs", dir);
+	if (ret < 0 || ret >= sizeof(path))
+		return -ENAMETOOLONG;
+
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	/* 0 means the writing process itself */
+	ret = write(fd, "0", 1);
+	ret = ret < 0 ? -errno : 0;
+	close(fd);
+
+	return ret;
+}
+
+/* Applies placement and credentials of service to current process */
+static int
+apply_service_policy(struct gd_ffs_func_type *srv)
+{
+	struct sched_param param;
+	struct rlimit rl;
+	cpu_set_t cpus;
+	int i, ret;
+
+	if (srv->cgroup_dir) {
+		ret = join_cgroup(srv->cgroup_dir);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (srv->cpu_affinity_size) {
+		CPU_ZERO(&cpus);
+		for (i = 0; i < srv->cpu_affinity_size; ++i)
+			CPU_SET(srv->cpu_affinity[i], &cpus);
+
+		ret = sched_setaffinity(0, sizeof(cpus), &cpus);
+		if (ret < 0)
+			return -errno;
+	}
+
+	if (srv->sched_policy >= 0) {
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = srv->sched_priority;
+		ret = sched_setscheduler(0, srv->sched_policy, &param);
+		if (ret < 0)
+			return -errno;
+	}
+
+	if (srv->nice) {
+		ret = setpriority(PRIO_PROCESS, 0, srv->nice);
+		if (ret < 0)
+			return -errno;
+	}
+
+	if (srv->ioprio) {
+		/* 1 is IOPRIO_WHO_PROCESS, glibc has no wrapper for this */
+		ret = syscall(SYS_ioprio_set, 1, 0, srv->ioprio);
+		if (ret < 0)
+			return -errno;
+	}
+
+	if (srv->mlock) {
+		rl.rlim_cur = rl.rlim_max = RLIM_INFINITY;
+		ret = setrlimit(RLIMIT_MEMLOCK, &rl);
+		if (ret < 0)
+			return -errno;
+	}
+
+	if (srv->chroot_dir) {
+		ret = chroot(srv->chroot_dir);
+		if (ret < 0)
+			return -errno;
+
+		ret = chdir("/");
+		if (ret < 0)
+			return -errno;
+	}
+
+	if (srv->work_dir) {
+		ret = chdir(srv->work_dir);
+		if (ret < 0)
+			return -errno;
+	}
+
+	/* Drop privileges at the very end */
+	if (srv->group_id != (gid_t)-1) {
+		ret = setgroups(0, NULL);
+		if (ret < 0)
+			return -errno;
+
+		ret = setgid(srv->group_id);
+		if (ret < 0)
+			return -errno;
+	}
+
+	if (srv->user_id != (uid_t)-1) {
+		ret = setuid(srv->user_id);
+		if (ret < 0)
+			return -errno;
+	}
+
+	return 0;
+}
+
 static int
 setup_child(struct gd_ffs_func *inst)
 {
@@ -558,6 +887,13 @@ setup_child(struct gd_ffs_func *inst)
 	if (ret < 0)
 		goto err_fds;
 
+	ret = apply_service_policy(inst->service);
+	if (ret < 0) {
+		errno = -ret;
+		ERRNO("Unable to apply service policy");
+		goto err_fds;
+	}
+
 	args = prepare_args(inst);
 	if (!args)
 		goto err_fds;
@@ -586,8 +922,15 @@ err:
 static int
 run_ffs_instance(struct gd_ffs_func *inst)
 {
+	uint64_t cnt;
 	int ret;
 
+	/* Drop events counted while gadgetd was waiting for activation,
+	   eventfd is nonblocking so EAGAIN just means there were none */
+	if (inst->event_fd >= 0 &&
+	    read(inst->event_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+		ERRNO("Unable to reset eventfd of ffs instance");
+
 	ret = fork();
 
 	if (ret == 0) {
@@ -597,6 +940,7 @@ run_ffs_instance(struct gd_ffs_func *inst)
 	} else if (likely(ret > 0)) {
 		inst->pid = ret;
 		inst->state = FFS_INSTANCE_RUNNING;
+		inst->start_time = ffs_now();
 		/* We don't close our descriptor to keep gadget alive
 		 *  even when ffs damon has been killed. This allows
 		 *  gadget with many functions to be operational for some
@@ -626,16 +970,28 @@ gd_ffs_received_event(struct gd_ffs_func *inst,
 	case FUNCTIONFS_ENABLE:
 		inst->state = FFS_INSTANCE_ENABLED;
 		break;
-
+	case FUNCTIONFS_DISABLE:
+		inst->state = FFS_INSTANCE_BOUND;
+		break;
+	case FUNCTIONFS_SETUP:
+	case FUNCTIONFS_SUSPEND:
+	case FUNCTIONFS_RESUME:
+		/* Don't change the state of function */
+		break;
 	default:
-		/* Other events should not appear here */
-		assert(0);
+		ERROR("Unknown ffs event %d", type);
+		ret = 0;
+		goto out;
 	}
 
 	/* Check if we should run the service */
-	if (type == inst->service->activation_event) {
+	if (type == inst->service->activation_event ||
+	    (inst->idle_stopped && (type == FUNCTIONFS_ENABLE ||
+				    type == FUNCTIONFS_RESUME))) {
 		INFO("Received sutable event. Running ffs instance.");
 		ret = run_ffs_instance(inst);
+		if (ret > 0)
+			inst->idle_stopped = 0;
 	} else {
 		ret = 0;
 	}
@@ -643,6 +999,140 @@ out:
 	return ret;
 }
 
+int
+gd_ffs_udc_state_idle(const char *udc_state)
+{
+	return !udc_state || strcmp(udc_state, "configured") != 0;
+}
+
+int
+gd_ffs_idle_stop_instance(struct gd_ffs_func *inst, const char *udc_state)
+{
+	enum ffs_instance_state state;
+
+	if (!inst || inst->state != FFS_INSTANCE_RUNNING || inst->pid <= 0)
+		return -1;
+
+	/* Service consumed ep0 events so the state has to be
+	   guessed from what UDC reports */
+	if (!udc_state)
+		state = FFS_INSTANCE_READY;
+	else if (strcmp(udc_state, "suspended") == 0)
+		state = FFS_INSTANCE_ENABLED;
+	else
+		state = FFS_INSTANCE_BOUND;
+
+	INFO("FFS service %d idle, stopping it", inst->pid);
+	if (terminate_service(inst, state) < 0)
+		return -1;
+
+	inst->restart_backoff = 0;
+	inst->idle_stopped = 1;
+	++(inst->idle_stop_count);
+
+	return 0;
+}
+
+int
+gd_ffs_service_exited(struct gd_ffs_func *inst, int status)
+{
+	struct gd_ffs_func_type *srv;
+	int failed;
+	int delay;
+	int i;
+
+	if (!inst || inst->state != FFS_INSTANCE_RUNNING)
+		return -1;
+
+	srv = inst->service;
+	failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	if (WIFSIGNALED(status))
+		INFO("FFS service %d killed by signal %d", inst->pid,
+		     WTERMSIG(status));
+	else
+		INFO("FFS service %d exited with status %d", inst->pid,
+		     WEXITSTATUS(status));
+
+	inst->pid = 0;
+	inst->exit_time = ffs_now();
+	inst->state = FFS_INSTANCE_READY;
+
+	if (srv->restart_policy == FFS_RESTART_NO ||
+	    (srv->restart_policy == FFS_RESTART_ON_FAILURE && !failed))
+		return -1;
+
+	/* Service which was running long enough is treated as healthy */
+	if (inst->exit_time - inst->start_time >=
+	    (gint64)srv->restart_max_delay * 1000)
+		inst->restart_backoff = 0;
+
+	if (srv->restart_limit && inst->restart_backoff >= srv->restart_limit) {
+		ERROR("FFS service %s restarted too many times. Giving up.",
+		      srv->reg_type.name);
+		inst->restart_backoff = 0;
+		return -1;
+	}
+
+	delay = srv->restart_delay;
+	for (i = 0; i < inst->restart_backoff && delay < srv->restart_max_delay;
+	     ++i)
+		delay *= 2;
+
+	if (delay > srv->restart_max_delay)
+		delay = srv->restart_max_delay;
+
+	++(inst->restart_backoff);
+	/* Keep the state so no event will be consumed by gadgetd
+	   while waiting for restart */
+	inst->state = FFS_INSTANCE_RUNNING;
+
+	return delay;
+}
+
+int
+gd_ffs_restart_instance(struct gd_ffs_func *inst)
+{
+	gint64 restart_time;
+	int ret;
+
+	if (!inst || inst->pid)
+		return -1;
+
+	/* backoff delay is policy, not cost of restart */
+	restart_time = ffs_now();
+	ret = run_ffs_instance(inst);
+	if (ret < 0) {
+		ERRNO("Unable to restart ffs service");
+		inst->state = FFS_INSTANCE_READY;
+		return ret;
+	}
+
+	++(inst->restart_count);
+	inst->restart_latency = inst->start_time - restart_time;
+	INFO("FFS service restarted. PID: %d, latency %lld us", inst->pid,
+	     (long long)inst->restart_latency);
+
+	return ret;
+}
+
+const char *
+gd_ffs_instance_state_name(enum ffs_instance_state state)
+{
+	static const char *const names[] = {
+		[FFS_INSTANCE_READY] = "ready",
+		[FFS_INSTANCE_BOUND] = "bound",
+		[FFS_INSTANCE_ENABLED] = "enabled",
+		[FFS_INSTANCE_RUNNING] = "running",
+		[FFS_INSTANCE_POOLED] = "pooled",
+		[FFS_INSTANCE_STOPPING] = "stopping",
+	};
+
+	if (state < 0 || state >= ARRAY_SIZE(names))
+		return "unknown";
+
+	return names[state];
+}
+
 int
 gd_ffs_fill_desc(struct gd_ffs_func_type *srv, struct ffs_desc_per_seed *desc,
 		 int desc_mask)
@@ -650,13 +1140,13 @@ gd_ffs_fill_desc(struct gd_ffs_func_type *srv, struct ffs_desc_per_seed *desc,
 #ifdef __FFS_LEGACY_API_SUPPORT
 	struct usb_functionfs_descs_head *header;
 #else
+	/* Header is followed by eventfd if requested and
+	   count for each speed set in flags */
 	struct {
 		__le32 magic;
 		__le32 length;
 		__le32 flags;
-		__le32 fs_count;
-		__le32 hs_count;
-	} *header;
+	} __attribute__ ((__packed__)) *header;
 #endif
 	int size = sizeof(*header);
 	int ret = 0, i = 0, j = 0;
@@ -668,6 +1158,8 @@ gd_ffs_fill_desc(struct gd_ffs_func_type *srv, struct ffs_desc_per_seed *desc,
 
 #ifndef __FFS_LEGACY_API_SUPPORT
 	size += j*sizeof(__le32);
+	if (srv->ffs_flags & FUNCTIONFS_EVENTFD)
+		size += sizeof(__le32);
 #endif
 
 	/* TODO: what if srv->desc != NULL ? */
@@ -678,6 +1170,7 @@ gd_ffs_fill_desc(struct gd_ffs_func_type *srv, struct ffs_desc_per_seed *desc,
 	}
 	srv->desc = pos;
 	srv->desc_size = size;
+	srv->desc_mask = desc_mask;
 
 	/* Fill header of functionfs descriptors */
 	header = pos;
@@ -692,14 +1185,20 @@ gd_ffs_fill_desc(struct gd_ffs_func_type *srv, struct ffs_desc_per_seed *desc,
 	pos += sizeof(*header);
 #else
 	header->magic = htole32(FUNCTIONFS_DESCRIPTORS_MAGIC_V2);
+	header->flags = htole32(desc_mask | srv->ffs_flags);
+	pos += sizeof(*header);
+	/* Real eventfd is set for each instance when writing descriptors */
+	if (srv->ffs_flags & FUNCTIONFS_EVENTFD) {
+		*(__le32*)pos = htole32(-1);
+		pos += sizeof(__le32);
+	}
 	for (i = FFS_USB_FULL_SPEED; i < FFS_USB_TERMINATOR; i = i << 1)
 		if (i & desc_mask) {
-			header->flags &= i;
-			*(__le32*)(pos + sizeof(*header) + sizeof(__le32)*j) =
+			*(__le32*)(pos + sizeof(__le32)*j) =
 				htole32(desc[j].desc_count);
 			++j;
 		}
-	pos += sizeof(*header) + sizeof(__le32)*j;
+	pos += sizeof(__le32)*j;
 #endif
 
 	/* Fill endpoint descriptors */
@@ -721,6 +1220,7 @@ gd_ffs_put_desc(struct gd_ffs_func_type *srv)
 	free(srv->desc);
 	srv->desc = NULL;
 	srv->desc_size = -1;
+	srv->desc_mask = 0;
 }
 
 int
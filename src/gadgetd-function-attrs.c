@@ -0,0 +1,303 @@
+/*
+ * gadgetd-function-attrs.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <gadgetd-function-attrs.h>
+#include <gadgetd-config.h>
+#include <gadgetd-common.h>
+
+/* configfs attribute is at most one page */
+#define GD_ATTR_MAX_LEN 4096
+
+struct gd_attr_info {
+	gchar *name;
+	gboolean readable;
+	gboolean writable;
+};
+
+/* function type name -> GPtrArray of struct gd_attr_info */
+static GHashTable *attr_cache;
+
+int
+gd_function_configfs_path(struct gd_function *f, char *buf, size_t len)
+{
+	int ret;
+
+	ret = snprintf(buf, len, "%s/usb_gadget/%s/functions/%s.%s",
+		       config.configfs_mnt,
+		       usbg_get_gadget_name(f->parent->g),
+		       usbg_get_function_type_str(usbg_get_function_type(f->f)),
+		       usbg_get_function_instance(f->f));
+	if (ret < 0 || (size_t)ret >= len)
+		return GD_ERROR_PATH_TOO_LONG;
+
+	return GD_SUCCESS;
+}
+
+static void
+gd_attr_info_free(gpointer p)
+{
+	struct gd_attr_info *info = p;
+
+	g_free(info->name);
+	g_free(info);
+}
+
+static int
+gd_discover_attrs(const char *dir_path, GPtrArray **attrs)
+{
+	char path[PATH_MAX];
+	struct gd_attr_info *info;
+	struct dirent *d;
+	struct stat st;
+	GPtrArray *arr;
+	DIR *dir;
+
+	dir = opendir(dir_path);
+	if (dir == NULL)
+		return gd_translate_error(errno);
+
+	arr = g_ptr_array_new_with_free_func(gd_attr_info_free);
+	while ((d = readdir(dir)) != NULL) {
+		if (d->d_name[0] == '.')
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dir_path, d->d_name);
+		if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+			continue;
+
+		info = g_malloc(sizeof(*info));
+		info->name = g_strdup(d->d_name);
+		info->readable = (st.st_mode & S_IRUSR) != 0;
+		info->writable = (st.st_mode & S_IWUSR) != 0;
+		g_ptr_array_add(arr, info);
+	}
+	closedir(dir);
+
+	*attrs = arr;
+	return GD_SUCCESS;
+}
+
+static int
+gd_lookup_attrs(struct gd_function *f, const char *dir_path,
+		GPtrArray **attrs)
+{
+	GPtrArray *arr;
+	int ret;
+
+	if (attr_cache == NULL)
+		attr_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+						   g_free,
+						   (GDestroyNotify)g_ptr_array_unref);
+
+	arr = g_hash_table_lookup(attr_cache, f->type);
+	if (arr == NULL) {
+		ret = gd_discover_attrs(dir_path, &arr);
+		if (ret != GD_SUCCESS)
+			return ret;
+		g_hash_table_insert(attr_cache, g_strdup(f->type), arr);
+	}
+
+	*attrs = arr;
+	return GD_SUCCESS;
+}
+
+static struct gd_attr_info *
+gd_find_attr(GPtrArray *attrs, const gchar *name)
+{
+	struct gd_attr_info *info;
+	guint i;
+
+	for (i = 0; i < attrs->len; ++i) {
+		info = g_ptr_array_index(attrs, i);
+		if (strcmp(info->name, name) == 0)
+			return info;
+	}
+
+	return NULL;
+}
+
+int
+gd_function_get_all_attrs(struct gd_function *f, GVariant **attrs)
+{
+	char dir_path[PATH_MAX];
+	char path[PATH_MAX];
+	char buf[GD_ATTR_MAX_LEN + 1];
+	struct gd_attr_info *info;
+	GVariantBuilder builder;
+	GPtrArray *arr;
+	ssize_t n;
+	guint i;
+	int fd;
+	int ret;
+
+	ret = gd_function_configfs_path(f, dir_path, sizeof(dir_path));
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	ret = gd_lookup_attrs(f, dir_path, &arr);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	for (i = 0; i < arr->len; ++i) {
+		info = g_ptr_array_index(arr, i);
+		if (!info->readable)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dir_path, info->name);
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			continue;
+		n = read(fd, buf, GD_ATTR_MAX_LEN);
+		close(fd);
+		if (n < 0)
+			continue;
+
+		buf[n] = '\0';
+		if (n > 0 && buf[n - 1] == '\n')
+			buf[n - 1] = '\0';
+
+		g_variant_builder_add(&builder, "{sv}", info->name,
+				      g_variant_new_string(buf));
+	}
+
+	*attrs = g_variant_builder_end(&builder);
+	return GD_SUCCESS;
+}
+
+static gchar *
+gd_attr_value_to_str(GVariant *value)
+{
+	const GVariantType *type = g_variant_get_type(value);
+
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_STRING))
+		return g_variant_dup_string(value, NULL);
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_BOOLEAN))
+		return g_strdup(g_variant_get_boolean(value) ? "1" : "0");
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTE))
+		return g_strdup_printf("%u", g_variant_get_byte(value));
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT16))
+		return g_strdup_printf("%u", g_variant_get_uint16(value));
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_INT16))
+		return g_strdup_printf("%d", g_variant_get_int16(value));
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT32))
+		return g_strdup_printf("%u", g_variant_get_uint32(value));
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_INT32))
+		return g_strdup_printf("%d", g_variant_get_int32(value));
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT64))
+		return g_strdup_printf("%" G_GUINT64_FORMAT,
+				       g_variant_get_uint64(value));
+	if (g_variant_type_equal(type, G_VARIANT_TYPE_INT64))
+		return g_strdup_printf("%" G_GINT64_FORMAT,
+				       g_variant_get_int64(value));
+
+	return NULL;
+}
+
+int
+gd_function_set_attrs(struct gd_function *f, GVariant *attrs,
+		      const gchar **error)
+{
+	char dir_path[PATH_MAX];
+	char path[PATH_MAX];
+	struct gd_attr_info *info;
+	GVariantIter iter;
+	GVariant *value;
+	const gchar *key;
+	GPtrArray *arr;
+	GPtrArray *names;
+	GPtrArray *values;
+	guint i;
+	gchar *str;
+	int fd;
+	int ret;
+
+	ret = gd_function_configfs_path(f, dir_path, sizeof(dir_path));
+	if (ret != GD_SUCCESS) {
+		*error = "Path too long";
+		return ret;
+	}
+
+	ret = gd_lookup_attrs(f, dir_path, &arr);
+	if (ret != GD_SUCCESS) {
+		*error = "Unable to list attributes";
+		return ret;
+	}
+
+	names = g_ptr_array_new();
+	values = g_ptr_array_new_with_free_func(g_free);
+
+	g_variant_iter_init(&iter, attrs);
+	while (g_variant_iter_next(&iter, "{&sv}", &key, &value)) {
+		info = gd_find_attr(arr, key);
+		str = info && info->writable ? gd_attr_value_to_str(value) : NULL;
+		g_variant_unref(value);
+
+		if (info == NULL || !info->writable) {
+			ERROR("Attribute %s of %s is not writable", key, f->type);
+			*error = info ? "Attribute is read only" : "Unknown attribute";
+			ret = GD_ERROR_INVALID_PARAM;
+			goto out;
+		}
+
+		if (str == NULL) {
+			*error = "Bad type of value";
+			ret = GD_ERROR_INVALID_PARAM;
+			goto out;
+		}
+
+		g_ptr_array_add(names, info->name);
+		g_ptr_array_add(values, str);
+	}
+
+	for (i = 0; i < names->len; ++i) {
+		snprintf(path, sizeof(path), "%s/%s", dir_path,
+			 (gchar *)g_ptr_array_index(names, i));
+		str = g_ptr_array_index(values, i);
+
+		fd = open(path, O_WRONLY);
+		if (fd < 0) {
+			ret = gd_translate_error(errno);
+		} else {
+			/* NUL is written too, so empty value still reaches kernel */
+			if (write(fd, str, strlen(str) + 1) < 0)
+				ret = gd_translate_error(errno);
+			close(fd);
+		}
+
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to write %s of %s",
+			      (gchar *)g_ptr_array_index(names, i), f->instance);
+			*error = "Unable to write attribute";
+			goto out;
+		}
+	}
+
+out:
+	g_ptr_array_free(names, TRUE);
+	g_ptr_array_free(values, TRUE);
+	return ret;
+}
@@ -28,6 +28,9 @@
 #include <gadgetd-common.h>
 #include <gadget-function-manager.h>
 #include <dbus-function-ifaces/gadgetd-serial-function-iface.h>
+#include <dbus-function-ifaces/gadgetd-net-function-iface.h>
+#include <dbus-function-ifaces/gadgetd-ms-function-iface.h>
+#include <dbus-function-ifaces/gadgetd-ffs-function-iface.h>
 #include <dbus-function-ifaces/gadgetd-function-iface.h>
 
 typedef struct _GadgetdFunctionObjectClass   GadgetdFunctionObjectClass;
@@ -40,6 +43,9 @@ struct _GadgetdFunctionObject
 	gchar *function_path;
 
 	FunctionSerialAttrs *f_serial_attrs_iface;
+	FunctionNetAttrs *f_net_attrs_iface;
+	FunctionMassStorage *f_ms_iface;
+	FunctionFfsAttrs *f_ffs_attrs_iface;
 	FunctionAttrs *f_attrs_iface;
 };
 
@@ -72,6 +78,15 @@ gadgetd_function_object_finalize(GObject *object)
 	if (function_object->f_serial_attrs_iface != NULL)
 		g_object_unref(function_object->f_serial_attrs_iface);
 
+	if (function_object->f_net_attrs_iface != NULL)
+		g_object_unref(function_object->f_net_attrs_iface);
+
+	if (function_object->f_ms_iface != NULL)
+		g_object_unref(function_object->f_ms_iface);
+
+	if (function_object->f_ffs_attrs_iface != NULL)
+		g_object_unref(function_object->f_ffs_attrs_iface);
+
 	if (function_object->f_attrs_iface != NULL)
 		g_object_unref(function_object->f_attrs_iface);
 
@@ -179,7 +194,10 @@ gadgetd_function_object_add_interface(int group, GadgetdFunctionObject *function
 		break;
 
 	case FUNC_GROUP_NET:
-		ERROR("Function interface not implemented");
+		function_object->f_net_attrs_iface = function_net_attrs_new(function_object);
+
+		get_iface(G_OBJECT(function_object), FUNCTION_TYPE_NET_ATTRS,
+			  &function_object->f_net_attrs_iface);
 		break;
 
 	case FUNC_GROUP_PHONET:
@@ -187,7 +205,17 @@ gadgetd_function_object_add_interface(int group, GadgetdFunctionObject *function
 		break;
 
 	case FUNC_GROUP_FFS:
-		ERROR("Function interface not implemented");
+		function_object->f_ffs_attrs_iface = function_ffs_attrs_new(function_object);
+
+		get_iface(G_OBJECT(function_object), FUNCTION_TYPE_FFS_ATTRS,
+			  &function_object->f_ffs_attrs_iface);
+		break;
+
+	case FUNC_GROUP_MASS_STORAGE:
+		function_object->f_ms_iface = function_mass_storage_new(function_object);
+
+		get_iface(G_OBJECT(function_object), FUNCTION_TYPE_MASS_STORAGE,
+			  &function_object->f_ms_iface);
 		break;
 
 	default:
@@ -17,10 +17,15 @@
 
 #include <glib-unix.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "gadgetd-core-func.h"
 #include "gadgetd-introspection.h"
 #include "gadgetd-ffs-func.h"
+#include "gadgetd-net-tuning.h"
+#include "gadgetd-udc-state.h"
+#include "gadgetd-udc-connect.h"
 
 struct gd_kernel_func_type {
 	int func_type;
@@ -47,6 +52,7 @@ gd_create_kernel_func(struct gd_gadget *g,
 
 	func->instance = g_strdup(instance);
 	func->type = g_strdup(t->name);
+	func->net_steering = NULL;
 
 	if (!func->instance || !func->type) {
 		ret = USBG_ERROR_NO_MEM;
@@ -87,6 +93,7 @@ gd_rm_kernel_func(struct gd_function *f)
 		goto out;
 
 	f->parent->funcs = g_list_remove(f->parent->funcs, f);
+	gd_net_steering_free(f->net_steering);
 	g_free(f->instance);
 	g_free(f->type);
 	g_free(f);
@@ -130,6 +137,9 @@ gd_determine_function_group(int type)
 	case F_FFS:
 		group = FUNC_GROUP_FFS;
 		break;
+	case F_MASS_STORAGE:
+		group = FUNC_GROUP_MASS_STORAGE;
+		break;
 	default:
 		group = FUNC_GROUP_OTHER;
 	}
@@ -249,6 +259,13 @@ gd_ffs_func_source_finalize(GSource *source)
 #endif /* GLIB_CHECK_VERSION() */
 /* ************************************************************************* */
 
+static void gd_ffs_watch_ep0(struct gd_ffs_func *func);
+static void gd_ffs_watch_child(struct gd_ffs_func *func);
+static void gd_ffs_watch_udc(struct gd_ffs_func *func);
+static void gd_ffs_unwatch_udc(struct gd_ffs_func *func);
+static void gd_ffs_watch_stop(struct gd_ffs_func *func);
+static void gd_ffs_destroy_instance(struct gd_ffs_func *func);
+
 gboolean gd_ffs_read_event(gint fd, GIOCondition condition, gpointer user_data)
 {
 	struct gd_ffs_func *func = (typeof(func)) user_data;
@@ -268,8 +285,19 @@ gboolean gd_ffs_read_event(gint fd, GIOCondition condition, gpointer user_data)
 	}
 		INFO("Event %d", event.type);
 	ret = gd_ffs_received_event(func, event.type);
+	if (ret == 0 && event.type == FUNCTIONFS_SETUP) {
+		/* There is no service to handle this request so halt ep0
+		   by doing transfer in the opposite direction */
+		if (event.u.setup.bRequestType & USB_DIR_IN)
+			ret = read(func->ep0_fd, NULL, 0);
+		else
+			ret = write(func->ep0_fd, NULL, 0);
+		ret = 0;
+	}
+
 	if (ret > 0) {
 		INFO("FFS service started. PID: %d", func->pid);
+		gd_ffs_watch_child(func);
 	} else if (ret < 0) {
 		ERROR("Error while processing FFS event");
 	} else {
@@ -278,123 +306,641 @@ gboolean gd_ffs_read_event(gint fd, GIOCondition condition, gpointer user_data)
 	}
 
 out:
+	/* gadget held disconnected may be waiting for this instance */
+	gd_udc_connect_check();
+
+	if (!poll_again)
+		func->ep0_watch = 0;
 	return poll_again;
 }
 
+static gboolean
+gd_ffs_restart_service(gpointer user_data)
+{
+	struct gd_ffs_func *func = (typeof(func)) user_data;
+	int ret;
+
+	func->restart_timer = 0;
+
+	ret = gd_ffs_restart_instance(func);
+	if (ret > 0)
+		gd_ffs_watch_child(func);
+	else
+		gd_ffs_watch_ep0(func);
+
+	gd_udc_connect_check();
+
+	return FALSE;
+}
+
+static void
+gd_ffs_child_exited(GPid pid, gint status, gpointer user_data)
+{
+	struct gd_ffs_func *func = (typeof(func)) user_data;
+	int delay;
+
+	func->child_watch = 0;
+	g_spawn_close_pid(pid);
+	gd_ffs_unwatch_udc(func);
+
+	if (func->state == FFS_INSTANCE_STOPPING) {
+		if (func->kill_timer) {
+			g_source_remove(func->kill_timer);
+			func->kill_timer = 0;
+		}
+
+		gd_ffs_service_reaped(func);
+		if (func->destroy_pending) {
+			gd_ffs_destroy_instance(func);
+		} else if (func->state != FFS_INSTANCE_POOLED) {
+			/* stopped due to idle, ep0 is ours again */
+			gd_ffs_watch_ep0(func);
+			gd_udc_connect_check();
+		}
+		return;
+	}
+
+	delay = gd_ffs_service_exited(func, status);
+	if (delay >= 0) {
+		INFO("Restarting FFS service in %d ms", delay);
+		func->restart_timer = g_timeout_add(delay,
+						    gd_ffs_restart_service,
+						    func);
+	} else {
+		/* Service is gone for good, so gadgetd takes care of
+		 * ep0 events once again until next activation event */
+		gd_ffs_watch_ep0(func);
+	}
+}
+
+static void
+gd_ffs_watch_child(struct gd_ffs_func *func)
+{
+	func->child_watch = g_child_watch_add(func->pid, gd_ffs_child_exited,
+					      func);
+	gd_ffs_watch_udc(func);
+}
+
+static gboolean
+gd_ffs_kill_service(gpointer user_data)
+{
+	struct gd_ffs_func *func = (typeof(func)) user_data;
+
+	func->kill_timer = 0;
+	gd_ffs_kill_instance(func);
+
+	/* child watch is still there to reap it */
+	return FALSE;
+}
+
+/* Stopping service is reaped by child watch, if it ignores
+ * SIGTERM for too long it is killed */
+static void
+gd_ffs_watch_stop(struct gd_ffs_func *func)
+{
+	if (!func->child_watch)
+		func->child_watch = g_child_watch_add(func->pid,
+						      gd_ffs_child_exited,
+						      func);
+	if (!func->kill_timer)
+		func->kill_timer = g_timeout_add(FFS_SERVICE_STOP_TIMEOUT,
+						 gd_ffs_kill_service, func);
+}
+
+static guint
+gd_ffs_fd_add(gint fd, GIOCondition condition,
+	      gboolean (*callback)(gint, GIOCondition, gpointer),
+	      gpointer user_data)
+{
+	/* For glib >= 2.36 this one should be used: */
+#if (GLIB_CHECK_VERSION(2, 36, 0))
+	return g_unix_fd_add(fd, condition, (GUnixFDSourceFunc)callback,
+			     user_data);
+#else
+	   /* For glib < 2.36 use our own event source */
+	   static GSourceFuncs source_funcs = {
+		   .prepare = gd_ffs_func_source_prepare,
+		   .check = gd_ffs_func_source_check,
+		   .dispatch = gd_ffs_func_source_dispatch,
+		   .finalize = gd_ffs_func_source_finalize,
+	   };
+	   struct gd_ffs_func_source *src;
+	   GSource *source;
+	   guint id;
+
+	   source = g_source_new(&source_funcs, sizeof(*src));
+	   src = (struct gd_ffs_func_source *) source;
+	   src->pfd.fd = fd;
+	   src->pfd.events = condition;
+	   src->pfd.revents = 0;
+	   g_source_add_poll(source, &(src->pfd));
+	   g_source_set_callback(source, (GSourceFunc)callback,
+				 user_data, NULL);
+	   id = g_source_attach(source, NULL);
+	   g_source_unref(source);
+
+	   return id;
+#endif /* GLIB_CHECK_VERSION */
+}
+
+static void
+gd_ffs_watch_ep0(struct gd_ffs_func *func)
+{
+	func->ep0_watch = gd_ffs_fd_add(func->ep0_fd, G_IO_IN,
+					gd_ffs_read_event, func);
+}
+
+/* Returns last seen state of UDC to which gadget is bound,
+ * NULL if gadget is not bound or state is unknown */
+static const char *
+gd_ffs_udc_state(struct gd_ffs_func *func)
+{
+	struct gd_udc_state *st;
+	usbg_udc *u;
+
+	u = usbg_get_gadget_udc(func->func.parent->g);
+	if (!u)
+		return NULL;
+
+	st = gd_udc_state_lookup(usbg_get_udc_name(u));
+	return st ? gd_udc_state_get_state(st) : NULL;
+}
+
+static gboolean
+gd_ffs_idle_stop(gpointer user_data)
+{
+	struct gd_ffs_func *func = (typeof(func)) user_data;
+	const char *state;
+
+	func->idle_timer = 0;
+
+	state = gd_ffs_udc_state(func);
+	if (!gd_ffs_udc_state_idle(state))
+		return FALSE;
+
+	/* ep0 is watched again once the service is reaped */
+	if (gd_ffs_idle_stop_instance(func, state) == 0) {
+		gd_ffs_unwatch_udc(func);
+		gd_ffs_watch_stop(func);
+	}
+
+	return FALSE;
+}
+
+static void
+gd_ffs_check_idle(struct gd_ffs_func *func)
+{
+	const char *state;
+	int idle;
+
+	state = gd_ffs_udc_state(func);
+	idle = gd_ffs_udc_state_idle(state);
+
+	if (idle && !func->idle_timer) {
+		func->idle_timer = g_timeout_add(func->service->idle_stop,
+						 gd_ffs_idle_stop, func);
+	} else if (!idle && func->idle_timer) {
+		g_source_remove(func->idle_timer);
+		func->idle_timer = 0;
+	}
+}
+
+static void
+gd_ffs_udc_state_changed(gpointer user_data)
+{
+	struct gd_ffs_func *func = (typeof(func)) user_data;
+
+	gd_ffs_check_idle(func);
+}
+
+/* While service is running it consumes all ep0 events, so host
+ * activity is tracked using state of UDC, which is already watched
+ * for its D-Bus object */
+static void
+gd_ffs_watch_udc(struct gd_ffs_func *func)
+{
+	struct gd_udc_state *st = NULL;
+	usbg_udc *u;
+
+	if (func->service->idle_stop <= 0)
+		return;
+
+	u = usbg_get_gadget_udc(func->func.parent->g);
+	if (u) {
+		st = gd_udc_state_lookup(usbg_get_udc_name(u));
+		if (!st)
+			ERROR("State of UDC %s is not watched",
+			      usbg_get_udc_name(u));
+	}
+
+	if (st)
+		gd_udc_state_add_listener(st, gd_ffs_udc_state_changed, func);
+
+	gd_ffs_check_idle(func);
+}
+
+static void
+gd_ffs_unwatch_udc(struct gd_ffs_func *func)
+{
+	gd_udc_state_remove_listener(gd_ffs_udc_state_changed, func);
+
+	if (func->idle_timer) {
+		g_source_remove(func->idle_timer);
+		func->idle_timer = 0;
+	}
+}
+
+static void
+gd_ffs_unwatch(struct gd_ffs_func *func)
+{
+	if (func->ep0_watch) {
+		g_source_remove(func->ep0_watch);
+		func->ep0_watch = 0;
+	}
+
+	if (func->child_watch) {
+		g_source_remove(func->child_watch);
+		func->child_watch = 0;
+	}
+
+	if (func->restart_timer) {
+		g_source_remove(func->restart_timer);
+		func->restart_timer = 0;
+	}
+
+	if (func->kill_timer) {
+		g_source_remove(func->kill_timer);
+		func->kill_timer = 0;
+	}
+
+	gd_ffs_unwatch_udc(func);
+}
+
+/* Creates usbg function and mounts it without writing descriptors */
 static int
-gd_create_ffs_func(struct gd_gadget *g, struct gd_function_type *t,
-		   const char *instance, struct gd_function **function)
+gd_ffs_new_instance(struct gd_gadget *g, struct gd_ffs_func_type *type,
+		    const char *usbg_instance_name, struct gd_ffs_func **funcp)
 {
-	struct gd_ffs_func_type *type;
+	struct gd_ffs_func *func;
+	struct gd_function *f;
 	int usbg_ret;
 	int ret;
-	struct gd_ffs_func *func = NULL;
-	struct gd_function *f;
-	const char *instance_prefix;
-	char _cleanup_free_ *usbg_instance_name;
 
-	type = container_of(t, struct gd_ffs_func_type, reg_type);
-	func = g_malloc(sizeof(*func));
-	if (!func) {
+	func = g_malloc0(sizeof(*func));
+	if (!func)
+		return USBG_ERROR_NO_MEM;
+
+	f = &(func->func);
+	func->ep0_fd = -1;
+	f->type = g_strdup(type->reg_type.name);
+	if (!f->type) {
 		ret = USBG_ERROR_NO_MEM;
-		goto out;
+		goto error;
 	}
 
-	f = &(func->func);
-	f->instance = g_strdup(instance);
-	f->type = g_strdup(t->name);
+	usbg_ret = usbg_create_function(g->g, F_FFS,
+					usbg_instance_name, NULL, &(f->f));
+	if (usbg_ret != USBG_SUCCESS) {
+		ret = usbg_ret;
+		goto error;
+	}
 
-	if (!f->instance || !f->type) {
-		ret = USBG_ERROR_NO_MEM;
+	ret = gd_ffs_mount_instance(type, func);
+	if (ret != GD_SUCCESS) {
+		usbg_rm_function(f->f, USBG_RM_RECURSE);
+		ret = USBG_ERROR_OTHER_ERROR;
 		goto error;
 	}
 
+	f->parent = g;
+	f->function_group = type->reg_type.function_group;
+	*funcp = func;
+
+	return USBG_SUCCESS;
+
+error:
+	g_free(f->type);
+	g_free(func);
+	return ret;
+}
+
+static void
+gd_ffs_destroy_instance(struct gd_ffs_func *func)
+{
+	struct gd_function *f = &(func->func);
+
+	if (gd_ffs_stop_instance(func) > 0) {
+		/* Mount is busy until service exits */
+		func->destroy_pending = 1;
+		gd_ffs_watch_stop(func);
+		return;
+	}
+
+	/* Umount first, otherwise kernel would leave orphaned mount */
+	gd_ffs_release_instance(func);
+	usbg_rm_function(f->f, USBG_RM_RECURSE);
+
+	g_free(f->instance);
+	g_free(f->type);
+	g_free(func);
+}
+
+/* Removes function from all configs of its gadget */
+static int
+gd_ffs_unlink_instance(struct gd_ffs_func *func)
+{
+	usbg_config *c;
+	usbg_binding *b, *next;
+	int usbg_ret = USBG_SUCCESS;
+
+	usbg_for_each_config(c, func->func.parent->g) {
+		for (b = usbg_get_first_binding(c); b; b = next) {
+			next = usbg_get_next_binding(b);
+			if (usbg_get_binding_target(b) != func->func.f)
+				continue;
+
+			usbg_ret = usbg_rm_binding(b);
+			if (usbg_ret != USBG_SUCCESS)
+				goto out;
+		}
+	}
+out:
+	return usbg_ret;
+}
+
+static int
+gd_ffs_pool_count(struct gd_ffs_func_type *type, struct gd_gadget *g)
+{
+	struct gd_ffs_func *func;
+	GList *l;
+	int n = 0;
+
+	for (l = type->pool; l; l = l->next) {
+		func = l->data;
+		if (func->func.parent == g)
+			++n;
+	}
+
+	return n;
+}
+
+static struct gd_ffs_func *
+gd_ffs_pool_claim(struct gd_ffs_func_type *type, struct gd_gadget *g)
+{
+	struct gd_ffs_func *func;
+	GList *l;
+
+	for (l = type->pool; l; l = l->next) {
+		func = l->data;
+		/* service of removed function may still be exiting */
+		if (func->func.parent == g
+		    && func->state == FFS_INSTANCE_POOLED) {
+			type->pool = g_list_delete_link(type->pool, l);
+			return func;
+		}
+	}
+
+	return NULL;
+}
+
+/* Pooled instances are not bound to instance name given by user
+ * so they get their own one, unique within service type */
+static gchar *
+gd_ffs_pool_instance_name(struct gd_ffs_func_type *type, const char *prefix)
+{
+	return g_strdup_printf("%s.pool%d", prefix, type->pool_seq++);
+}
+
+struct gd_ffs_pool_refill {
+	struct gd_ffs_func_type *type;
+	struct gd_gadget *g;
+	guint source;
+};
+
+/* refills waiting for idle, cancelled when their gadget goes away */
+static GList *pool_refills;
+
+/* registered ffs types, their pools are searched on gadget cleanup */
+static GList *ffs_types;
+
+static void
+gd_ffs_pool_refill_free(gpointer data)
+{
+	pool_refills = g_list_remove(pool_refills, data);
+	g_free(data);
+}
+
+static gboolean
+gd_ffs_pool_refill(gpointer user_data)
+{
+	struct gd_ffs_pool_refill *refill = user_data;
+	struct gd_ffs_func_type *type = refill->type;
+	struct gd_ffs_func *func;
+	const char *prefix;
+	gchar *name;
+	int ret;
+
+	prefix = strchr(type->reg_type.name, '.') + 1;
+
+	while (gd_ffs_pool_count(type, refill->g) < type->pool_size) {
+		name = gd_ffs_pool_instance_name(type, prefix);
+		if (!name)
+			break;
+
+		ret = gd_ffs_new_instance(refill->g, type, name, &func);
+		g_free(name);
+		if (ret != USBG_SUCCESS) {
+			INFO("Unable to fill pool of %s", type->reg_type.name);
+			break;
+		}
+
+		type->pool = g_list_append(type->pool, func);
+	}
+
+	return FALSE;
+}
+
+/* Pool is refilled from idle so caller of CreateFunction
+ * does not wait for mounts of spare instances */
+static void
+gd_ffs_schedule_pool_refill(struct gd_ffs_func_type *type,
+			    struct gd_gadget *g)
+{
+	struct gd_ffs_pool_refill *refill;
+	GList *l;
+
+	/* One pending refill per gadget fills the whole pool */
+	for (l = pool_refills; l; l = l->next) {
+		refill = l->data;
+		if (refill->type == type && refill->g == g)
+			return;
+	}
+
+	refill = g_malloc(sizeof(*refill));
+	if (!refill)
+		return;
+
+	refill->type = type;
+	refill->g = g;
+	refill->source = g_idle_add_full(G_PRIORITY_LOW, gd_ffs_pool_refill,
+					 refill, gd_ffs_pool_refill_free);
+	pool_refills = g_list_prepend(pool_refills, refill);
+}
+
+void
+gd_ffs_gadget_cleanup(struct gd_gadget *g)
+{
+	struct gd_ffs_pool_refill *refill;
+	struct gd_ffs_func_type *type;
+	struct gd_ffs_func *func;
+	GList *l, *next, *t;
+
+	for (l = pool_refills; l; l = next) {
+		next = l->next;
+		refill = l->data;
+		/* destroy notify drops it from the list */
+		if (refill->g == g)
+			g_source_remove(refill->source);
+	}
+
+	for (t = ffs_types; t; t = t->next) {
+		type = t->data;
+		for (l = type->pool; l; l = next) {
+			next = l->next;
+			func = l->data;
+			if (func->func.parent != g)
+				continue;
+
+			type->pool = g_list_delete_link(type->pool, l);
+			gd_ffs_destroy_instance(func);
+		}
+	}
+}
+
+static int
+gd_create_ffs_func(struct gd_gadget *g, struct gd_function_type *t,
+		   const char *instance, struct gd_function **function)
+{
+	struct gd_ffs_func_type *type;
+	int ret;
+	struct gd_ffs_func *func = NULL;
+	struct gd_function *f;
+	const char *instance_prefix;
+	char _cleanup_free_ *usbg_instance_name = NULL;
+
+	type = container_of(t, struct gd_ffs_func_type, reg_type);
+
 	instance_prefix = strchr(t->name, '.');
 	if (!instance_prefix) {
 		ret = USBG_ERROR_OTHER_ERROR;
-		goto error;
+		goto out;
 	}
 
 	++instance_prefix;
-	usbg_instance_name = g_strdup_printf("%s.%s", instance_prefix, instance);
-	if (!usbg_instance_name) {
-		ret = USBG_ERROR_NO_MEM;
-		goto error;
+	if (type->pool_size > 0) {
+		func = gd_ffs_pool_claim(type, g);
+		if (!func)
+			usbg_instance_name = gd_ffs_pool_instance_name(type,
+							instance_prefix);
+	} else {
+		usbg_instance_name = g_strdup_printf("%s.%s", instance_prefix,
+						     instance);
 	}
 
-	usbg_ret = usbg_create_function(g->g, F_FFS,
-					usbg_instance_name, NULL, &(f->f));
-	if (usbg_ret != USBG_SUCCESS) {
-		ret = usbg_ret;
+	if (!func) {
+		if (!usbg_instance_name) {
+			ret = USBG_ERROR_NO_MEM;
+			goto out;
+		}
+
+		ret = gd_ffs_new_instance(g, type, usbg_instance_name, &func);
+		if (ret != USBG_SUCCESS)
+			goto out;
+	}
+
+	f = &(func->func);
+	f->instance = g_strdup(instance);
+	if (!f->instance) {
+		ret = USBG_ERROR_NO_MEM;
 		goto error;
 	}
 
-	ret = gd_ffs_prepare_instance(type, func);
-	if (ret) {
-		usbg_rm_function(f->f, USBG_RM_RECURSE);
+	/* Instance is already mounted so only descriptors
+	   and strings have to be written */
+	ret = gd_ffs_open_instance(func);
+	if (ret != GD_SUCCESS) {
+		ret = USBG_ERROR_OTHER_ERROR;
 		goto error;
 	}
 
 	*function = f;
-	f->parent = g;
-	f->function_group = t->function_group;
 	g->funcs = g_list_append(g->funcs, f);
 	ret = GD_SUCCESS;
 
 	/* add to poll */
-	/* Currently value is ignored but it should be stored in gd_ffs_func */
+	gd_ffs_watch_ep0(func);
 
-	/* For glib >= 2.36 this one should be used: */
-#if (GLIB_CHECK_VERSION(2, 36, 0))
-	g_unix_fd_add(func->ep0_fd, G_IO_IN,
-		      (GUnixFDSourceFunc)gd_ffs_read_event, func);
-#else
-	   /* For glib < 2.36 use our own event source */
-	   {
-		   static GSourceFuncs source_funcs = {
-			   .prepare = gd_ffs_func_source_prepare,
-			   .check = gd_ffs_func_source_check,
-			   .dispatch = gd_ffs_func_source_dispatch,
-			   .finalize = gd_ffs_func_source_finalize,
-		   };
-		   struct gd_ffs_func_source *src;
-		   GSource *source;
-
-		   source = g_source_new(&source_funcs, sizeof(*src));
-		   src = (struct gd_ffs_func_source *) source;
-		   src->pfd.fd = func->ep0_fd;
-		   src->pfd.events = G_IO_IN;
-		   src->pfd.revents = 0;
-		   g_source_add_poll(source, &(src->pfd));
-		   g_source_set_callback(source, (GSourceFunc)gd_ffs_read_event,
-					 func, NULL);
-		   /* collect id from this function */
-		   g_source_attach(source, NULL);
-		   g_source_unref(source);
-	   }
-#endif /* GLIB_CHECK_VERSION */
+	if (type->pool_size > 0)
+		gd_ffs_schedule_pool_refill(type, g);
 out:
 	return ret;
 error:
-	g_free(f->instance);
-	g_free(f->type);
-	g_free(f);
+	gd_ffs_destroy_instance(func);
 	return ret;
 }
 
 static int
 gd_rm_ffs_func(struct gd_function *f)
 {
-	ERROR("Not implemented yet");
-	return 0;
+	struct gd_ffs_func *func;
+	struct gd_ffs_func_type *type;
+	struct gd_gadget *g = f->parent;
+	int usbg_ret;
+
+	func = container_of(f, struct gd_ffs_func, func);
+	type = func->service;
+
+	gd_ffs_unwatch(func);
+	if (gd_ffs_stop_instance(func) > 0)
+		gd_ffs_watch_stop(func);
+	g->funcs = g_list_remove(g->funcs, f);
+
+	if (gd_ffs_pool_count(type, g) < type->pool_size) {
+		/* Keep usbg function and mount, just make sure
+		   that function is not visible in any config */
+		usbg_ret = gd_ffs_unlink_instance(func);
+		if (usbg_ret == USBG_SUCCESS) {
+			g_free(f->instance);
+			f->instance = NULL;
+			type->pool = g_list_append(type->pool, func);
+			goto out;
+		}
+	}
+
+	gd_ffs_destroy_instance(func);
+	usbg_ret = USBG_SUCCESS;
+out:
+	return usbg_ret;
 }
 
 static int
 gd_cleanup_ffs_func_type(struct gd_function_type *t)
 {
 	struct gd_ffs_func_type *type;
+	struct gd_ffs_pool_refill *refill;
+	GList *l, *next;
 
 	type = container_of(t, struct gd_ffs_func_type, reg_type);
+	ffs_types = g_list_remove(ffs_types, type);
+	for (l = pool_refills; l; l = next) {
+		next = l->next;
+		refill = l->data;
+		if (refill->type == type)
+			g_source_remove(refill->source);
+	}
+	/* Each pooled instance keeps reference to type */
+	g_list_free_full(type->pool, (GDestroyNotify)gd_ffs_destroy_instance);
+	type->pool = NULL;
 	gd_unref_gd_ffs_func_type(type);
 	return 0;
 }
@@ -426,6 +972,7 @@ gd_register_user_funcs()
 			t->cleanup(t);
 			goto error;
 		}
+		ffs_types = g_list_append(ffs_types, t);
 		/* We don't free type because it will be freed
 		 * while unregistering function type or on exit
 		 */
@@ -464,3 +1011,43 @@ gd_init_functions()
 	return ret;
 }
 
+static int
+gd_ffs_required_speed(struct gd_ffs_func *func)
+{
+	int mask = func->service->desc_mask;
+
+#ifndef __FFS_LEGACY_API_SUPPORT
+	if (mask & FFS_USB_SUPER_SPEED)
+		return GD_USB_SPEED_SUPER;
+#endif
+	if (mask & FFS_USB_HIGH_SPEED)
+		return GD_USB_SPEED_HIGH;
+	if (mask & FFS_USB_FULL_SPEED)
+		return GD_USB_SPEED_FULL;
+
+	return GD_USB_SPEED_UNKNOWN;
+}
+
+int
+gd_gadget_required_speed(struct gd_gadget *g)
+{
+	struct gd_function *f;
+	GList *l;
+	int speed = GD_USB_SPEED_UNKNOWN;
+	int fspeed;
+
+	for (l = g->funcs; l != NULL; l = l->next) {
+		f = l->data;
+		if (f->function_group == FUNC_GROUP_FFS)
+			fspeed = gd_ffs_required_speed(
+				container_of(f, struct gd_ffs_func, func));
+		else
+			/* kernel functions work at any speed */
+			fspeed = GD_USB_SPEED_FULL;
+
+		if (fspeed > speed)
+			speed = fspeed;
+	}
+
+	return speed;
+}
@@ -29,6 +29,7 @@
 #include <gadget-descriptors.h>
 #include <gadget-function-manager.h>
 #include <gadget-config-manager.h>
+#include <gadgetd-functions.h>
 
 typedef struct _GadgetdGadgetObjectClass   GadgetdGadgetObjectClass;
 
@@ -73,6 +74,9 @@ gadgetd_gadget_object_finalize(GObject *object)
 
 	g_free(gadget_object->gadget_path);
 
+	/* pool refill and pooled instances point to gadget */
+	if (gadget_object->gadget != NULL)
+		gd_ffs_gadget_cleanup(gadget_object->gadget);
 	g_free(gadget_object->gadget);
 
 	if (gadget_object->g_strings_iface != NULL)
@@ -15,10 +15,14 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE /* for SCHED_BATCH and SCHED_IDLE */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
+#include <endian.h>
+#include <sched.h>
 #include <sys/param.h>
 #include <sys/utsname.h>
 #include <sys/stat.h>
@@ -34,6 +38,7 @@
 #include <gadgetd-create.h>
 #include <gadgetd-common.h>
 #include <gadgetd-introspection.h>
+#include <cpu-list.h>
 
 #include <glib.h>
 
@@ -607,13 +612,15 @@ gd_lookup_desc_attributes(config_setting_t *root, __u8 *att)
 		tmp = gd_parse_flags(buff, &res, gd_desc_translate_attribute);
 		if (tmp < 0)
 			return tmp;
-		if (res < 0 || res > UCHAR_MAX)
-			return GD_ERROR_INVALID_PARAM;
-		*att = (__u8) res;
 	} else {
 		ERROR("bmAttributes must be string or number");
+		return GD_ERROR_BAD_VALUE;
 	}
 
+	if (res < 0 || res > UCHAR_MAX)
+		return GD_ERROR_INVALID_PARAM;
+	*att = (__u8) res;
+
 	return GD_SUCCESS;
 }
 
@@ -836,6 +843,453 @@ gd_ffs_lookup_options(config_setting_t *root, int *opt)
 	return GD_SUCCESS;
 }
 
+static int
+gd_ffs_add_cpu(struct gd_ffs_func_type *srv, int cpu, int ncpus)
+{
+	int *tmp;
+
+	if (cpu < 0 || cpu >= ncpus) {
+		ERROR("cpu_affinity: cpu %d out of range", cpu);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	tmp = realloc(srv->cpu_affinity,
+		      (srv->cpu_affinity_size + 1) * sizeof(*tmp));
+	if (tmp == NULL)
+		return GD_ERROR_NO_MEM;
+
+	tmp[srv->cpu_affinity_size++] = cpu;
+	srv->cpu_affinity = tmp;
+
+	return GD_SUCCESS;
+}
+
+/* Accepts array of cpu numbers or cpu list string like "0-3,6" */
+static int
+gd_ffs_lookup_cpu_affinity(config_setting_t *root, struct gd_ffs_func_type *srv)
+{
+	config_setting_t *node;
+	cpu_set_t set;
+	int ncpus;
+	int cpu;
+	int i, len;
+	int tmp;
+
+	node = config_setting_get_member(root, "cpu_affinity");
+	if (node == NULL)
+		return GD_ERROR_NOT_DEFINED;
+
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpus <= 0)
+		return GD_ERROR_OTHER_ERROR;
+
+	if (config_setting_is_array(node) == CONFIG_TRUE) {
+		len = config_setting_length(node);
+		for (i = 0; i < len; i++) {
+			tmp = gd_setting_get_int(config_setting_get_elem(node, i),
+						 &cpu);
+			if (tmp < 0)
+				return tmp;
+			tmp = gd_ffs_add_cpu(srv, cpu, ncpus);
+			if (tmp < 0)
+				return tmp;
+		}
+	} else if (config_setting_type(node) == CONFIG_TYPE_STRING) {
+		if (cpu_list_parse(config_setting_get_string(node), &set) < 0)
+			goto bad_list;
+
+		for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+			if (!CPU_ISSET(cpu, &set))
+				continue;
+			tmp = gd_ffs_add_cpu(srv, cpu, ncpus);
+			if (tmp < 0)
+				return tmp;
+		}
+	} else {
+		ERROR("cpu_affinity must be array or string");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	if (srv->cpu_affinity_size == 0) {
+		ERROR("cpu_affinity is empty");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	return GD_SUCCESS;
+
+bad_list:
+	ERROR("%s:%d: Invalid cpu list",
+		config_setting_source_file(node),
+		config_setting_source_line(node));
+	return GD_ERROR_BAD_VALUE;
+}
+
+static int
+gd_ffs_lookup_sched(config_setting_t *root, struct gd_ffs_func_type *srv)
+{
+	const char *buff;
+	config_setting_t *node;
+	int min, max;
+	int tmp;
+	static struct gd_named_const keys[] = {
+		DECLARE_ELEMENT(SCHED_OTHER),
+		DECLARE_ELEMENT(SCHED_BATCH),
+		DECLARE_ELEMENT(SCHED_IDLE),
+		DECLARE_ELEMENT(SCHED_FIFO),
+		DECLARE_ELEMENT(SCHED_RR),
+		DECLARE_END()
+	};
+
+	node = config_setting_get_member(root, "sched_policy");
+	if (node == NULL) {
+		if (config_setting_get_member(root, "sched_priority") != NULL) {
+			ERROR("sched_priority requires sched_policy");
+			return GD_ERROR_BAD_VALUE;
+		}
+		return GD_ERROR_NOT_DEFINED;
+	}
+
+	tmp = gd_setting_get_string(node, &buff);
+	if (tmp < 0)
+		return tmp;
+
+	tmp = gd_get_const_value(buff, strlen(buff), keys, &srv->sched_policy);
+	if (tmp < 0) {
+		ERROR("%s:%d: Unknown scheduling policy %s",
+			config_setting_source_file(node),
+			config_setting_source_line(node), buff);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	srv->sched_priority = 0;
+	node = config_setting_get_member(root, "sched_priority");
+	if (node != NULL) {
+		tmp = gd_setting_get_int(node, &srv->sched_priority);
+		if (tmp < 0)
+			return tmp;
+	}
+
+	min = sched_get_priority_min(srv->sched_policy);
+	max = sched_get_priority_max(srv->sched_policy);
+	if (srv->sched_priority < min || srv->sched_priority > max) {
+		ERROR("sched_priority for %s must be in range <%d, %d>",
+		      buff, min, max);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_nice(config_setting_t *root, int *nice)
+{
+	config_setting_t *node;
+	int tmp;
+
+	node = config_setting_get_member(root, "nice");
+	if (node == NULL)
+		return GD_ERROR_NOT_DEFINED;
+
+	tmp = gd_setting_get_int(node, nice);
+	if (tmp < 0)
+		return tmp;
+
+	if (*nice < -20 || *nice > 19) {
+		ERROR("nice must be in range <-20, 19>");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_ioprio(config_setting_t *root, int *ioprio)
+{
+	const char *buff;
+	config_setting_t *node;
+	int class;
+	int data = 4;
+	int tmp;
+
+	node = config_setting_get_member(root, "ioprio_class");
+	if (node == NULL) {
+		if (config_setting_get_member(root, "ioprio") != NULL) {
+			ERROR("ioprio requires ioprio_class");
+			return GD_ERROR_BAD_VALUE;
+		}
+		return GD_ERROR_NOT_DEFINED;
+	}
+
+	tmp = gd_setting_get_string(node, &buff);
+	if (tmp < 0)
+		return tmp;
+
+	if (strcmp(buff, "realtime") == 0) {
+		class = FFS_IOPRIO_CLASS_RT;
+	} else if (strcmp(buff, "best-effort") == 0) {
+		class = FFS_IOPRIO_CLASS_BE;
+	} else if (strcmp(buff, "idle") == 0) {
+		class = FFS_IOPRIO_CLASS_IDLE;
+		data = 0;
+	} else {
+		ERROR("%s:%d: Unknown io scheduling class %s",
+			config_setting_source_file(node),
+			config_setting_source_line(node), buff);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	node = config_setting_get_member(root, "ioprio");
+	if (node != NULL) {
+		tmp = gd_setting_get_int(node, &data);
+		if (tmp < 0)
+			return tmp;
+	}
+
+	if (data < 0 || data > 7) {
+		ERROR("ioprio must be in range <0, 7>");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	*ioprio = FFS_IOPRIO_VALUE(class, data);
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_cgroup(config_setting_t *root, char **dir)
+{
+	char procs[PATH_MAX];
+	int tmp;
+
+	tmp = gd_ffs_lookup_dir(root, "cgroup", dir);
+	if (tmp < 0)
+		return tmp;
+
+	tmp = snprintf(procs, sizeof(procs), "%s/cgroup.procs", *dir);
+	if (tmp >= sizeof(procs)) {
+		ERROR("path too long");
+		return GD_ERROR_PATH_TOO_LONG;
+	}
+
+	if (access(procs, W_OK) != 0) {
+		ERROR("%s is not a writable cgroup v2 directory", *dir);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_ffs_flags(config_setting_t *root, int *flags)
+{
+	config_setting_t *node;
+	const char *buff;
+	int i, len;
+	int flag;
+	int tmp;
+	static struct gd_named_const keys[] = {
+		DECLARE_ELEMENT(FUNCTIONFS_EVENTFD),
+		DECLARE_ELEMENT(FUNCTIONFS_ALL_CTRL_RECIP),
+		DECLARE_ELEMENT(FUNCTIONFS_CONFIG0_SETUP),
+		DECLARE_END()
+	};
+
+	node = config_setting_get_member(root, "ffs_flags");
+	if (node == NULL)
+		return GD_ERROR_NOT_DEFINED;
+
+#ifdef __FFS_LEGACY_API_SUPPORT
+	ERROR("%s:%d: ffs_flags requires functionfs v2 API",
+		config_setting_source_file(node),
+		config_setting_source_line(node));
+	return GD_ERROR_NOT_SUPPORTED;
+#endif
+
+	if (config_setting_is_array(node) == CONFIG_FALSE) {
+		ERROR("%s:%d: ffs_flags: expected array",
+			config_setting_source_file(node),
+			config_setting_source_line(node));
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	len = config_setting_length(node);
+	for (i = 0; i < len; i++) {
+		tmp = gd_setting_get_string(config_setting_get_elem(node, i),
+					    &buff);
+		if (tmp < 0)
+			return tmp;
+
+		tmp = gd_get_const_value(buff, strlen(buff), keys, &flag);
+		if (tmp < 0) {
+			ERROR("%s:%d: Unknown functionfs flag %s",
+				config_setting_source_file(node),
+				config_setting_source_line(node), buff);
+			return GD_ERROR_BAD_VALUE;
+		}
+
+		*flags |= flag;
+	}
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_args(config_setting_t *root, struct gd_ffs_func_type *srv)
+{
+	config_setting_t *node;
+	const char *buff;
+	int i, len;
+	int tmp;
+
+	node = config_setting_get_member(root, "args");
+	if (node == NULL)
+		return GD_ERROR_NOT_DEFINED;
+
+	if (config_setting_is_array(node) == CONFIG_FALSE) {
+		ERROR("%s:%d: args: expected array",
+			config_setting_source_file(node),
+			config_setting_source_line(node));
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	len = config_setting_length(node);
+	srv->exec_args = calloc(len + 1, sizeof(*srv->exec_args));
+	if (srv->exec_args == NULL)
+		return GD_ERROR_NO_MEM;
+
+	for (i = 0; i < len; i++) {
+		tmp = gd_setting_get_string(config_setting_get_elem(node, i),
+					    &buff);
+		if (tmp < 0)
+			return tmp;
+
+		srv->exec_args[i] = strdup(buff);
+		if (srv->exec_args[i] == NULL)
+			return GD_ERROR_NO_MEM;
+		srv->exec_args_size++;
+	}
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_idle_stop(config_setting_t *root, int *idle_stop)
+{
+	config_setting_t *node;
+	int tmp;
+
+	node = config_setting_get_member(root, "idle_stop");
+	if (node == NULL)
+		return GD_ERROR_NOT_DEFINED;
+
+	tmp = gd_setting_get_int(node, idle_stop);
+	if (tmp < 0)
+		return tmp;
+
+	if (*idle_stop < 0) {
+		ERROR("idle_stop must not be negative");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_pool(config_setting_t *root, struct gd_ffs_func_type *srv)
+{
+	config_setting_t *node;
+	int tmp;
+
+	srv->pool_size = 0;
+
+	node = config_setting_get_member(root, "pool_size");
+	if (node == NULL)
+		return GD_SUCCESS;
+
+	tmp = gd_setting_get_int(node, &srv->pool_size);
+	if (tmp < 0)
+		return tmp;
+
+	if (srv->pool_size < 0) {
+		ERROR("pool_size must not be negative");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	/* Pooled instances hold a reference to service just like
+	   active ones, so without allow_multiple an instance pooled
+	   for one gadget would keep service away from all others */
+	if (srv->pool_size > 0 &&
+	    !(srv->options & FFS_SERVICE_ALLOW_MULTIPLE)) {
+		INFO("Service does not allow multiple instances, pool disabled");
+		srv->pool_size = 0;
+	}
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ffs_lookup_restart(config_setting_t *root, struct gd_ffs_func_type *srv)
+{
+	const char *buff;
+	config_setting_t *node;
+	int tmp;
+
+	srv->restart_policy = FFS_RESTART_NO;
+	srv->restart_delay = FFS_RESTART_DELAY_DEFAULT;
+	srv->restart_max_delay = FFS_RESTART_MAX_DELAY_DEFAULT;
+	srv->restart_limit = 0;
+
+	node = config_setting_get_member(root, "restart");
+	if (node == NULL)
+		return GD_SUCCESS;
+
+	tmp = gd_setting_get_string(node, &buff);
+	if (tmp < 0)
+		return tmp;
+
+	if (strcmp(buff, "no") == 0) {
+		srv->restart_policy = FFS_RESTART_NO;
+	} else if (strcmp(buff, "on-failure") == 0) {
+		srv->restart_policy = FFS_RESTART_ON_FAILURE;
+	} else if (strcmp(buff, "always") == 0) {
+		srv->restart_policy = FFS_RESTART_ALWAYS;
+	} else {
+		ERROR("%s:%d: Unsupported restart policy %s",
+			config_setting_source_file(node),
+			config_setting_source_line(node), buff);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	node = config_setting_get_member(root, "restart_delay");
+	if (node != NULL) {
+		tmp = gd_setting_get_int(node, &srv->restart_delay);
+		if (tmp < 0)
+			return tmp;
+	}
+
+	node = config_setting_get_member(root, "restart_max_delay");
+	if (node != NULL) {
+		tmp = gd_setting_get_int(node, &srv->restart_max_delay);
+		if (tmp < 0)
+			return tmp;
+	}
+
+	node = config_setting_get_member(root, "restart_limit");
+	if (node != NULL) {
+		tmp = gd_setting_get_int(node, &srv->restart_limit);
+		if (tmp < 0)
+			return tmp;
+	}
+
+	if (srv->restart_delay <= 0 || srv->restart_limit < 0 ||
+	    srv->restart_max_delay < srv->restart_delay) {
+		ERROR("Invalid restart delay or limit");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	return GD_SUCCESS;
+}
+
 static int
 gd_ffs_fill_str_config(config_setting_t *root, struct gd_ffs_func_type *srv)
 {
@@ -1079,6 +1533,20 @@ gd_ffs_parse_ep_desc_no_audio(config_setting_t *root,
 	if (tmp < 0)
 		return tmp;
 
+	/* 0 leaves choice of packet size to UDC driver */
+	node = config_setting_get_member(root, "wMaxPacketSize");
+	if (node != NULL) {
+		tmp = gd_setting_get_int(node, &res);
+		if (tmp < 0)
+			return tmp;
+
+		if (res > USHRT_MAX || res < 0) {
+			ERROR("wMaxPacketSize out of range");
+			return GD_ERROR_BAD_VALUE;
+		}
+		desc->wMaxPacketSize = htole16(res);
+	}
+
 	node = config_setting_get_member(root, "direction");
 	if (node == NULL) {
 		ERROR("direction not defined");
@@ -1101,8 +1569,178 @@ gd_ffs_parse_ep_desc_no_audio(config_setting_t *root,
 	return GD_SUCCESS;
 }
 
+/* Checks if wMaxPacketSize is legal for given speed */
+static int
+gd_ffs_check_ep_desc(struct usb_endpoint_descriptor_no_audio *desc, int speed)
+{
+	int xfer = desc->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK;
+	int maxp = le16toh(desc->wMaxPacketSize) & USB_ENDPOINT_MAXP_MASK;
+	int mult = (le16toh(desc->wMaxPacketSize) >> 11) & 0x3;
+	int max;
+
+	if (desc->wMaxPacketSize == 0)
+		return GD_SUCCESS;
+
+	/* Bits 12:11 are meaningful only for high speed periodic endpoints */
+	if (mult && (speed != FFS_USB_HIGH_SPEED || mult > 2 ||
+		     xfer == USB_ENDPOINT_XFER_BULK ||
+		     xfer == USB_ENDPOINT_XFER_CONTROL)) {
+		ERROR("ep%d: additional transactions not allowed",
+		      desc->bEndpointAddress & USB_ENDPOINT_NUMBER_MASK);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	switch (speed) {
+	case FFS_USB_FULL_SPEED:
+		if (xfer == USB_ENDPOINT_XFER_ISOC)
+			max = 1023;
+		else
+			max = 64;
+
+		if ((xfer == USB_ENDPOINT_XFER_BULK ||
+		     xfer == USB_ENDPOINT_XFER_CONTROL) &&
+		    (maxp < 8 || (maxp & (maxp - 1))))
+			goto bad_size;
+		break;
+	case FFS_USB_HIGH_SPEED:
+		if (xfer == USB_ENDPOINT_XFER_BULK && maxp != 512)
+			goto bad_size;
+		max = xfer == USB_ENDPOINT_XFER_CONTROL ? 64 : 1024;
+		break;
+#ifndef __FFS_LEGACY_API_SUPPORT
+	case FFS_USB_SUPER_SPEED:
+		if (xfer == USB_ENDPOINT_XFER_BULK && maxp != 1024)
+			goto bad_size;
+		max = xfer == USB_ENDPOINT_XFER_CONTROL ? 512 : 1024;
+		break;
+#endif
+	default:
+		return GD_ERROR_INVALID_PARAM;
+	}
+
+	if (maxp > max)
+		goto bad_size;
+
+	return GD_SUCCESS;
+
+bad_size:
+	ERROR("ep%d: wMaxPacketSize %d is not legal for this speed",
+	      desc->bEndpointAddress & USB_ENDPOINT_NUMBER_MASK, maxp);
+	return GD_ERROR_BAD_VALUE;
+}
+
+#ifndef __FFS_LEGACY_API_SUPPORT
+static int
+gd_ffs_lookup_comp_value(config_setting_t *root, const char *name,
+			 int min, int max, int *val)
+{
+	config_setting_t *node;
+	int tmp;
+
+	node = config_setting_get_member(root, name);
+	if (node == NULL)
+		return GD_ERROR_NOT_DEFINED;
+
+	tmp = gd_setting_get_int(node, val);
+	if (tmp < 0)
+		return tmp;
+
+	if (*val < min || *val > max) {
+		ERROR("%s must be in range <%d, %d>", name, min, max);
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	return GD_SUCCESS;
+}
+
+/* Companion has to describe endpoint which directly precedes it */
 static int
-gd_ffs_fill_desc_list(config_setting_t *list, struct ffs_desc_per_seed *desc)
+gd_ffs_parse_ss_ep_comp_desc(config_setting_t *root,
+	struct usb_ss_ep_comp_descriptor *desc,
+	struct usb_endpoint_descriptor_no_audio *ep)
+{
+	int xfer = ep->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK;
+	int maxp = le16toh(ep->wMaxPacketSize) & USB_ENDPOINT_MAXP_MASK;
+	int periodic = xfer == USB_ENDPOINT_XFER_INT ||
+		xfer == USB_ENDPOINT_XFER_ISOC;
+	int burst = 0, streams = 0, mult = 0, bpi = 0, max_bpi;
+	int tmp;
+
+	desc->bLength = USB_DT_SS_EP_COMP_SIZE;
+	desc->bDescriptorType = USB_DT_SS_ENDPOINT_COMP;
+
+	tmp = gd_ffs_lookup_comp_value(root, "bMaxBurst", 0, 15, &burst);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		return tmp;
+
+	if (burst && xfer == USB_ENDPOINT_XFER_CONTROL) {
+		ERROR("Control endpoints can not burst");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	/* Bursts of periodic endpoints are made of full packets only */
+	if (burst && periodic && maxp && maxp != 1024) {
+		ERROR("Bursting periodic endpoint requires wMaxPacketSize 1024");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	/* Number of streams is stored as power of two */
+	tmp = gd_ffs_lookup_comp_value(root, "max_streams", 0, 1 << 16,
+				       &streams);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		return tmp;
+
+	if (streams > 1) {
+		if (xfer != USB_ENDPOINT_XFER_BULK) {
+			ERROR("Only bulk endpoints support streams");
+			return GD_ERROR_BAD_VALUE;
+		}
+
+		if (streams & (streams - 1)) {
+			ERROR("max_streams must be power of two");
+			return GD_ERROR_BAD_VALUE;
+		}
+
+		desc->bmAttributes = ffs(streams) - 1;
+	}
+
+	tmp = gd_ffs_lookup_comp_value(root, "mult", 0, 2, &mult);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		return tmp;
+
+	if (mult) {
+		if (xfer != USB_ENDPOINT_XFER_ISOC) {
+			ERROR("mult is allowed only for isochronous endpoints");
+			return GD_ERROR_BAD_VALUE;
+		}
+
+		desc->bmAttributes = mult;
+	}
+
+	max_bpi = (mult + 1) * (burst + 1) * (maxp ? maxp : 1024);
+	tmp = gd_ffs_lookup_comp_value(root, "wBytesPerInterval", 0, max_bpi,
+				       &bpi);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		return tmp;
+
+	if (tmp == GD_ERROR_NOT_DEFINED && periodic && maxp)
+		bpi = max_bpi;
+
+	if (bpi && !periodic) {
+		ERROR("wBytesPerInterval is allowed only for periodic endpoints");
+		return GD_ERROR_BAD_VALUE;
+	}
+
+	desc->bMaxBurst = burst;
+	desc->wBytesPerInterval = htole16(bpi);
+
+	return GD_SUCCESS;
+}
+#endif /* __FFS_LEGACY_API_SUPPORT */
+
+static int
+gd_ffs_fill_desc_list(config_setting_t *list, struct ffs_desc_per_seed *desc,
+		      int speed)
 {
 	int len;
 	char *pos;
@@ -1110,8 +1748,11 @@ gd_ffs_fill_desc_list(config_setting_t *list, struct ffs_desc_per_seed *desc)
 	int tmp;
 	const char *buff;
 	config_setting_t *group;
-	struct usb_interface_descriptor *inter;
-	struct usb_endpoint_descriptor_no_audio *ep;
+	struct usb_interface_descriptor *inter = NULL;
+	struct usb_endpoint_descriptor_no_audio *ep = NULL;
+#ifndef __FFS_LEGACY_API_SUPPORT
+	struct usb_ss_ep_comp_descriptor *comp;
+#endif
 	int j = 0;
 
 	len = config_setting_length(list);
@@ -1135,6 +1776,11 @@ gd_ffs_fill_desc_list(config_setting_t *list, struct ffs_desc_per_seed *desc)
 			desc->desc_size += sizeof(*inter);
 		else if (strcmp(buff, "EP_NO_AUDIO_DESC") == 0)
 			desc->desc_size += sizeof(*ep);
+#ifndef __FFS_LEGACY_API_SUPPORT
+		else if (strcmp(buff, "SS_EP_COMP_DESC") == 0 &&
+			 speed == FFS_USB_SUPER_SPEED)
+			desc->desc_size += sizeof(*comp);
+#endif
 		else {
 			ERROR("%s descriptor type unsupported", buff);
 			return GD_ERROR_NOT_SUPPORTED;
@@ -1153,6 +1799,19 @@ gd_ffs_fill_desc_list(config_setting_t *list, struct ffs_desc_per_seed *desc)
 	for (i = 0; i < len; i++) {
 		group = config_setting_get_elem(list, i);
 		tmp = config_setting_lookup_string(group, "type", &buff);
+
+#ifndef __FFS_LEGACY_API_SUPPORT
+		/* Each super speed endpoint must be followed by companion */
+		if (speed == FFS_USB_SUPER_SPEED && ep &&
+		    strcmp(buff, "SS_EP_COMP_DESC") != 0) {
+			ERROR("%s:%d SS_EP_COMP_DESC expected",
+				config_setting_source_file(group),
+				config_setting_source_line(group));
+			tmp = GD_ERROR_BAD_VALUE;
+			goto out;
+		}
+#endif
+
 		if (strcmp(buff, "INTERFACE_DESC") == 0) {
 			inter = (struct usb_interface_descriptor *)pos;
 			tmp = gd_ffs_parse_interface_desc(group, inter);
@@ -1162,15 +1821,49 @@ gd_ffs_fill_desc_list(config_setting_t *list, struct ffs_desc_per_seed *desc)
 			inter->bInterfaceNumber = j++;
 			pos += sizeof(*inter);
 		} else if (strcmp(buff, "EP_NO_AUDIO_DESC") == 0) {
+			if (!inter) {
+				ERROR("Endpoint defined before interface");
+				tmp = GD_ERROR_BAD_VALUE;
+				goto out;
+			}
 			ep = (struct usb_endpoint_descriptor_no_audio *)pos;
 			tmp = gd_ffs_parse_ep_desc_no_audio(group, ep);
+			if (tmp < 0)
+				goto out;
+			tmp = gd_ffs_check_ep_desc(ep, speed);
 			if (tmp < 0)
 				goto out;
 			inter->bNumEndpoints++;
 			pos += sizeof(*ep);
+			continue;
+		}
+#ifndef __FFS_LEGACY_API_SUPPORT
+		else if (strcmp(buff, "SS_EP_COMP_DESC") == 0) {
+			if (!ep) {
+				ERROR("%s:%d SS_EP_COMP_DESC must follow endpoint",
+					config_setting_source_file(group),
+					config_setting_source_line(group));
+				tmp = GD_ERROR_BAD_VALUE;
+				goto out;
+			}
+			comp = (struct usb_ss_ep_comp_descriptor *)pos;
+			tmp = gd_ffs_parse_ss_ep_comp_desc(group, comp, ep);
+			if (tmp < 0)
+				goto out;
+			pos += sizeof(*comp);
 		}
+#endif
+		ep = NULL;
 	}
 
+#ifndef __FFS_LEGACY_API_SUPPORT
+	if (speed == FFS_USB_SUPER_SPEED && ep) {
+		ERROR("Last endpoint has no SS_EP_COMP_DESC");
+		tmp = GD_ERROR_BAD_VALUE;
+		goto out;
+	}
+#endif
+
 	return GD_SUCCESS;
 out:
 	free(desc->desc);
@@ -1182,10 +1875,12 @@ gd_ffs_fill_desc_config(config_setting_t *root, struct gd_ffs_func_type *srv)
 {
 	config_setting_t *fs_desc;
 	config_setting_t *hs_desc;
+	config_setting_t *ss_desc;
 	config_setting_t *group;
-	struct ffs_desc_per_seed desc[2];
+	struct ffs_desc_per_seed desc[3];
 	int tmp;
 	int mask = 0;
+	int n = 0;
 	int ret;
 
 	group = config_setting_get_member(root, "descriptors");
@@ -1212,11 +1907,12 @@ gd_ffs_fill_desc_config(config_setting_t *root, struct gd_ffs_func_type *srv)
 		return GD_ERROR_BAD_VALUE;
 	}
 
-	tmp = gd_ffs_fill_desc_list(fs_desc, &desc[0]);
+	tmp = gd_ffs_fill_desc_list(fs_desc, &desc[n], FFS_USB_FULL_SPEED);
 	if (tmp < 0)
 		return tmp;
 
 	mask |= FFS_USB_FULL_SPEED;
+	++n;
 
 	hs_desc = config_setting_get_member(group, "hs_desc");
 	if (hs_desc != NULL) {
@@ -1224,34 +1920,70 @@ gd_ffs_fill_desc_config(config_setting_t *root, struct gd_ffs_func_type *srv)
 			ERROR("%s:%d hs_desc: expected list",
 				config_setting_source_file(hs_desc),
 				config_setting_source_line(hs_desc));
-			return GD_ERROR_BAD_VALUE;
+			tmp = GD_ERROR_BAD_VALUE;
+			goto out;
 		}
-		tmp = gd_ffs_fill_desc_list(hs_desc, &desc[1]);
+		tmp = gd_ffs_fill_desc_list(hs_desc, &desc[n], FFS_USB_HIGH_SPEED);
 		if (tmp < 0)
-			return tmp;
+			goto out;
 		mask |= FFS_USB_HIGH_SPEED;
+		++n;
+	}
+
+	ss_desc = config_setting_get_member(group, "ss_desc");
+	if (ss_desc != NULL) {
+#ifdef __FFS_LEGACY_API_SUPPORT
+		INFO("ss_desc requires functionfs v2 API, ignoring");
+#else
+		if (config_setting_is_list(ss_desc) == CONFIG_FALSE) {
+			ERROR("%s:%d ss_desc: expected list",
+				config_setting_source_file(ss_desc),
+				config_setting_source_line(ss_desc));
+			tmp = GD_ERROR_BAD_VALUE;
+			goto out;
+		}
+		tmp = gd_ffs_fill_desc_list(ss_desc, &desc[n], FFS_USB_SUPER_SPEED);
+		if (tmp < 0)
+			goto out;
+		mask |= FFS_USB_SUPER_SPEED;
+		++n;
+#endif
 	}
 
 	ret = gd_ffs_fill_desc(srv, desc, mask);
 	if (ret) {
 		ERROR("Unable to fill descriptors");
-		return GD_ERROR_OTHER_ERROR;
+		tmp = GD_ERROR_OTHER_ERROR;
+		goto out;
 	}
 
-	return GD_SUCCESS;
+	tmp = GD_SUCCESS;
+out:
+	/* descriptors has been copied to service */
+	while (n)
+		free(desc[--n].desc);
+
+	return tmp;
 }
 
 static void
 gd_gd_ffs_func_type_cleanup(struct gd_ffs_func_type *srv)
 {
+	int i;
+
 	if (srv == NULL)
 		return;
 	gd_ffs_put_desc(srv);
 	gd_ffs_put_str(srv);
 	free((char *)srv->reg_type.name);
 	free(srv->exec_path);
+	for (i = 0; i < srv->exec_args_size; ++i)
+		free(srv->exec_args[i]);
+	free(srv->exec_args);
 	free(srv->work_dir);
 	free(srv->chroot_dir);
+	free(srv->cpu_affinity);
+	free(srv->cgroup_dir);
 }
 
 static void
@@ -1267,6 +1999,7 @@ gd_read_gd_ffs_func_type(const char *path, struct gd_ffs_func_type *srv,
 {
 	config_t cfg;
 	config_setting_t *root;
+	config_setting_t *node;
 	int tmp;
 	const char *base;
 
@@ -1308,6 +2041,12 @@ gd_read_gd_ffs_func_type(const char *path, struct gd_ffs_func_type *srv,
 	tmp = gd_ffs_lookup_file(root, "exec", &srv->exec_path);
 	if (tmp < 0)
 		goto out;
+	tmp = gd_ffs_lookup_args(root, srv);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
+	srv->user_id = (uid_t)-1;
+	srv->group_id = (gid_t)-1;
+	srv->sched_policy = -1;
 	tmp = gd_ffs_lookup_dir(root, "working_dir", &srv->work_dir);
 	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
 		goto out;
@@ -1320,9 +2059,43 @@ gd_read_gd_ffs_func_type(const char *path, struct gd_ffs_func_type *srv,
 	tmp = gd_ffs_lookup_dir(root, "chroot_to", &srv->chroot_dir);
 	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
 		goto out;
+	tmp = gd_ffs_lookup_cpu_affinity(root, srv);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
+	tmp = gd_ffs_lookup_sched(root, srv);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
+	tmp = gd_ffs_lookup_nice(root, &srv->nice);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
+	tmp = gd_ffs_lookup_ioprio(root, &srv->ioprio);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
+	tmp = gd_ffs_lookup_cgroup(root, &srv->cgroup_dir);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
+	node = config_setting_get_member(root, "mlockall");
+	if (node != NULL) {
+		tmp = gd_setting_get_bool(node, &srv->mlock);
+		if (tmp < 0)
+			goto out;
+	}
 	tmp = gd_ffs_lookup_options(root, &srv->options);
 	if (tmp < 0)
 		goto out;
+	tmp = gd_ffs_lookup_restart(root, srv);
+	if (tmp < 0)
+		goto out;
+	tmp = gd_ffs_lookup_pool(root, srv);
+	if (tmp < 0)
+		goto out;
+	tmp = gd_ffs_lookup_idle_stop(root, &srv->idle_stop);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
+	/* Flags are needed to build descriptors header */
+	tmp = gd_ffs_lookup_ffs_flags(root, &srv->ffs_flags);
+	if (tmp < 0 && tmp != GD_ERROR_NOT_DEFINED)
+		goto out;
 	tmp = gd_ffs_fill_desc_config(root, srv);
 	if (tmp < 0)
 		goto out;
@@ -1402,7 +2175,7 @@ gd_read_gd_ffs_func_types_from_dir(const char *path, struct gd_ffs_func_type ***
 
 		strncpy(filepath + pathlen, namelist[i]->d_name, namelen + 1);
 
-		srv = malloc(sizeof(*srv));
+		srv = calloc(1, sizeof(*srv));
 		if (srv == NULL) {
 			tmp = GD_ERROR_NO_MEM;
 			goto out;
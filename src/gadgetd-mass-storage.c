@@ -0,0 +1,464 @@
+/*
+ * gadgetd-mass-storage.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <gadgetd-mass-storage.h>
+#include <gadgetd-function-attrs.h>
+#include <gadgetd-common.h>
+
+static const char *lun_bool_attrs[] = {
+	"ro", "removable", "cdrom", "nofua", NULL
+};
+
+static gboolean
+gd_ms_is_lun_bool_attr(const char *name)
+{
+	const char **n;
+
+	for (n = lun_bool_attrs; *n; ++n)
+		if (strcmp(name, *n) == 0)
+			return TRUE;
+
+	return FALSE;
+}
+
+/* lun below 0 for function directory, attr NULL for directory itself */
+static int
+gd_ms_path(struct gd_function *f, gint lun, const char *attr,
+	   char *buf, size_t len)
+{
+	size_t pos;
+	int ret;
+
+	ret = gd_function_configfs_path(f, buf, len);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	pos = strlen(buf);
+	if (lun < 0)
+		ret = snprintf(buf + pos, len - pos, "%s%s",
+			       attr ? "/" : "", attr ? attr : "");
+	else
+		ret = snprintf(buf + pos, len - pos, "/lun.%d%s%s", lun,
+			       attr ? "/" : "", attr ? attr : "");
+
+	if (ret < 0 || (size_t)ret >= len - pos)
+		return GD_ERROR_PATH_TOO_LONG;
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ms_write(struct gd_function *f, gint lun, const char *attr,
+	    const char *value)
+{
+	char path[PATH_MAX];
+	int fd;
+	ssize_t ret;
+	int g_ret;
+
+	g_ret = gd_ms_path(f, lun, attr, path, sizeof(path));
+	if (g_ret != GD_SUCCESS)
+		return g_ret;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return errno == ENOENT ? GD_ERROR_NOT_FOUND
+			: gd_translate_error(errno);
+
+	/* NUL is written too, so empty value still reaches kernel */
+	ret = write(fd, value, strlen(value) + 1);
+	g_ret = ret < 0 ? gd_translate_error(errno) : GD_SUCCESS;
+	if (ret < 0 && errno == EBUSY)
+		g_ret = GD_ERROR_EXIST;
+
+	close(fd);
+	return g_ret;
+}
+
+static int
+gd_ms_read(struct gd_function *f, gint lun, const char *attr,
+	   char *buf, size_t len)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+	size_t n;
+	int g_ret;
+
+	g_ret = gd_ms_path(f, lun, attr, path, sizeof(path));
+	if (g_ret != GD_SUCCESS)
+		return g_ret;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return errno == ENOENT ? GD_ERROR_NOT_FOUND
+			: gd_translate_error(errno);
+
+	n = fread(buf, 1, len - 1, fp);
+	fclose(fp);
+
+	buf[n] = '\0';
+	if (n > 0 && buf[n - 1] == '\n')
+		buf[n - 1] = '\0';
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_ms_check(struct gd_function *f, guint lun, const gchar **error)
+{
+	if (f->function_group != FUNC_GROUP_MASS_STORAGE) {
+		*error = "Not a mass storage function";
+		return GD_ERROR_INVALID_PARAM;
+	}
+
+	if (lun >= GD_MS_MAX_LUNS) {
+		*error = "LUN out of range";
+		return GD_ERROR_INVALID_PARAM;
+	}
+
+	return GD_SUCCESS;
+}
+
+int
+gd_ms_add_lun(struct gd_function *f, guint lun, const gchar **error)
+{
+	char path[PATH_MAX];
+	int ret;
+
+	ret = gd_ms_check(f, lun, error);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	ret = gd_ms_path(f, lun, NULL, path, sizeof(path));
+	if (ret != GD_SUCCESS) {
+		*error = "Path too long";
+		return ret;
+	}
+
+	if (mkdir(path, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0) {
+		*error = errno == EEXIST ? "LUN already exists"
+			: errno == EBUSY ? "Gadget is enabled"
+			: "Unable to create LUN";
+		return errno == EEXIST ? GD_ERROR_EXIST
+			: gd_translate_error(errno);
+	}
+
+	return GD_SUCCESS;
+}
+
+int
+gd_ms_rm_lun(struct gd_function *f, guint lun, const gchar **error)
+{
+	char path[PATH_MAX];
+	int ret;
+
+	ret = gd_ms_check(f, lun, error);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	if (lun == 0) {
+		*error = "LUN 0 can't be removed";
+		return GD_ERROR_INVALID_PARAM;
+	}
+
+	/*
+	 * Kernel does not refuse removal of LUN of bound gadget, it
+	 * unbinds the whole gadget instead, behind our back.
+	 */
+	if (usbg_get_gadget_udc(f->parent->g) != NULL) {
+		*error = "Gadget is enabled";
+		return GD_ERROR_BUSY;
+	}
+
+	ret = gd_ms_path(f, lun, NULL, path, sizeof(path));
+	if (ret != GD_SUCCESS) {
+		*error = "Path too long";
+		return ret;
+	}
+
+	if (rmdir(path) < 0) {
+		*error = errno == ENOENT ? "LUN not found"
+			: "Unable to remove LUN";
+		return errno == ENOENT ? GD_ERROR_NOT_FOUND
+			: gd_translate_error(errno);
+	}
+
+	return GD_SUCCESS;
+}
+
+static gint
+gd_ms_lun_cmp(gconstpointer a, gconstpointer b)
+{
+	guint l = *(const guint *)a;
+	guint r = *(const guint *)b;
+
+	return l < r ? -1 : l > r;
+}
+
+int
+gd_ms_list_luns(struct gd_function *f, GArray **luns)
+{
+	char path[PATH_MAX];
+	DIR *dir;
+	struct dirent *d;
+	GArray *arr;
+	guint lun;
+	int ret;
+
+	ret = gd_ms_path(f, -1, NULL, path, sizeof(path));
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	dir = opendir(path);
+	if (dir == NULL)
+		return gd_translate_error(errno);
+
+	arr = g_array_new(FALSE, FALSE, sizeof(guint));
+	while ((d = readdir(dir)) != NULL) {
+		if (sscanf(d->d_name, "lun.%u", &lun) == 1)
+			g_array_append_val(arr, lun);
+	}
+	closedir(dir);
+
+	g_array_sort(arr, gd_ms_lun_cmp);
+	*luns = arr;
+
+	return GD_SUCCESS;
+}
+
+/* Host may lock medium, only forced_eject ignores the lock */
+static int
+gd_ms_eject(struct gd_function *f, guint lun, gboolean force)
+{
+	int ret = GD_ERROR_NOT_FOUND;
+
+	if (force)
+		ret = gd_ms_write(f, lun, "forced_eject", "1");
+
+	/* kernels before forced_eject can eject only unlocked medium */
+	if (ret == GD_ERROR_NOT_FOUND)
+		ret = gd_ms_write(f, lun, "file", "");
+
+	return ret;
+}
+
+int
+gd_ms_set_lun_attrs(struct gd_function *f, guint lun, GVariant *attrs,
+		    const gchar **error)
+{
+	GVariantIter iter;
+	GVariant *value;
+	const gchar *key;
+	const gchar *file = NULL;
+	const char **name;
+	gboolean reopen = FALSE;
+	gboolean val;
+	int ret;
+
+	ret = gd_ms_check(f, lun, error);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	/* validate everything before touching configfs */
+	g_variant_iter_init(&iter, attrs);
+	while (g_variant_iter_next(&iter, "{&sv}", &key, &value)) {
+		if (strcmp(key, "file") == 0) {
+			ret = g_variant_is_of_type(value, G_VARIANT_TYPE_STRING)
+				? GD_SUCCESS : GD_ERROR_BAD_VALUE;
+		} else if (gd_ms_is_lun_bool_attr(key)) {
+			ret = g_variant_is_of_type(value, G_VARIANT_TYPE_BOOLEAN)
+				? GD_SUCCESS : GD_ERROR_BAD_VALUE;
+			if (strcmp(key, "ro") == 0 || strcmp(key, "cdrom") == 0)
+				reopen = TRUE;
+		} else {
+			ret = GD_ERROR_NOT_FOUND;
+		}
+		g_variant_unref(value);
+
+		if (ret != GD_SUCCESS) {
+			*error = ret == GD_ERROR_NOT_FOUND ? "Unknown attribute"
+				: "Bad type of value";
+			return GD_ERROR_INVALID_PARAM;
+		}
+	}
+
+	g_variant_lookup(attrs, "file", "&s", &file);
+
+	/* ro and cdrom can't be changed while medium is loaded */
+	if (file != NULL && reopen) {
+		ret = gd_ms_eject(f, lun, FALSE);
+		if (ret != GD_SUCCESS) {
+			*error = "Unable to eject medium";
+			return ret;
+		}
+	}
+
+	for (name = lun_bool_attrs; *name; ++name) {
+		if (!g_variant_lookup(attrs, *name, "b", &val))
+			continue;
+
+		ret = gd_ms_write(f, lun, *name, val ? "1" : "0");
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set %s of lun %u", *name, lun);
+			*error = ret == GD_ERROR_EXIST ? "Medium is loaded"
+				: "Unable to set attribute";
+			return ret;
+		}
+	}
+
+	if (file != NULL) {
+		ret = gd_ms_write(f, lun, "file", file);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set file of lun %u", lun);
+			*error = ret == GD_ERROR_EXIST ? "Medium is locked by host"
+				: "Unable to open file";
+			return ret;
+		}
+	}
+
+	return GD_SUCCESS;
+}
+
+int
+gd_ms_get_lun_attrs(struct gd_function *f, guint lun, GVariant **attrs)
+{
+	GVariantBuilder builder;
+	char buf[PATH_MAX];
+	const char **name;
+	const gchar *error;
+	int ret;
+
+	ret = gd_ms_check(f, lun, &error);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	ret = gd_ms_read(f, lun, "file", buf, sizeof(buf));
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&builder, "{sv}", "file", g_variant_new_string(buf));
+
+	for (name = lun_bool_attrs; *name; ++name) {
+		/* attribute may be missing in older kernels */
+		if (gd_ms_read(f, lun, *name, buf, sizeof(buf)) != GD_SUCCESS)
+			continue;
+		g_variant_builder_add(&builder, "{sv}", *name,
+				      g_variant_new_boolean(atoi(buf) != 0));
+	}
+
+	*attrs = g_variant_builder_end(&builder);
+	return GD_SUCCESS;
+}
+
+int
+gd_ms_set_attrs(struct gd_function *f, GVariant *attrs, const gchar **error)
+{
+	GVariantIter iter;
+	GVariant *value;
+	const gchar *key;
+	char buf[16];
+	int ret = GD_SUCCESS;
+
+	ret = gd_ms_check(f, 0, error);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	g_variant_iter_init(&iter, attrs);
+	while (g_variant_iter_next(&iter, "{&sv}", &key, &value)) {
+		if (strcmp(key, "stall") == 0
+		    && g_variant_is_of_type(value, G_VARIANT_TYPE_BOOLEAN)) {
+			snprintf(buf, sizeof(buf), "%d",
+				 g_variant_get_boolean(value));
+		} else if (strcmp(key, "num_buffers") == 0
+			   && g_variant_is_of_type(value, G_VARIANT_TYPE_UINT32)) {
+			snprintf(buf, sizeof(buf), "%u",
+				 g_variant_get_uint32(value));
+		} else {
+			g_variant_unref(value);
+			*error = "Unknown attribute or bad type of value";
+			return GD_ERROR_INVALID_PARAM;
+		}
+		g_variant_unref(value);
+
+		ret = gd_ms_write(f, -1, key, buf);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set %s of %s", key, f->instance);
+			*error = ret == GD_ERROR_NOT_FOUND ? "Attribute not supported by kernel"
+				: ret == GD_ERROR_EXIST ? "Gadget is enabled"
+				: "Unable to set attribute";
+			return ret;
+		}
+	}
+
+	return GD_SUCCESS;
+}
+
+int
+gd_ms_get_attr(struct gd_function *f, const gchar *name, gint *val)
+{
+	char buf[16];
+	int ret;
+
+	ret = gd_ms_read(f, -1, name, buf, sizeof(buf));
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	*val = atoi(buf);
+	return GD_SUCCESS;
+}
+
+int
+gd_ms_swap_media(struct gd_function *f, guint lun, const gchar *file,
+		 const gchar **error)
+{
+	int ret;
+
+	ret = gd_ms_check(f, lun, error);
+	if (ret != GD_SUCCESS)
+		return ret;
+
+	ret = gd_ms_eject(f, lun, TRUE);
+	if (ret != GD_SUCCESS) {
+		ERROR("Unable to eject medium of lun %u", lun);
+		*error = ret == GD_ERROR_EXIST ? "Medium is locked by host"
+			: "Unable to eject medium";
+		return ret;
+	}
+
+	if (file == NULL || *file == '\0')
+		return GD_SUCCESS;
+
+	ret = gd_ms_write(f, lun, "file", file);
+	if (ret != GD_SUCCESS) {
+		ERROR("Unable to open %s as lun %u", file, lun);
+		*error = "Unable to open file";
+		return ret;
+	}
+
+	return GD_SUCCESS;
+}
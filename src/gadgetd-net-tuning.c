@@ -0,0 +1,677 @@
+/*
+ * gadgetd-net-tuning.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE /* for cpu sets */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+
+#include <gadgetd-net-tuning.h>
+#include <gadgetd-config.h>
+#include <gadgetd-common.h>
+#include <cpu-list.h>
+
+int
+gd_net_is_net_function(usbg_function *f)
+{
+	switch (usbg_get_function_type(f)) {
+	case F_ECM:
+	case F_SUBSET:
+	case F_NCM:
+	case F_EEM:
+	case F_RNDIS:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int
+gd_net_prepare_gadget(usbg_gadget *g)
+{
+	usbg_function *f;
+	int usbg_ret;
+	int g_ret = GD_SUCCESS;
+
+	if (config.net.qmult < 0)
+		return GD_SUCCESS;
+
+	usbg_for_each_function(f, g) {
+		if (!gd_net_is_net_function(f))
+			continue;
+
+		usbg_ret = usbg_set_net_qmult(f, config.net.qmult);
+		if (usbg_ret != USBG_SUCCESS) {
+			ERROR("Unable to set qmult of %s: %s",
+			      usbg_get_function_instance(f),
+			      usbg_strerror(usbg_ret));
+			g_ret = GD_ERROR_OTHER_ERROR;
+		}
+	}
+
+	return g_ret;
+}
+
+static int
+gd_net_set_ifreq(int sock, const char *ifname, unsigned long req,
+		 struct ifreq *ifr)
+{
+	strncpy(ifr->ifr_name, ifname, IFNAMSIZ - 1);
+	ifr->ifr_name[IFNAMSIZ - 1] = '\0';
+
+	if (ioctl(sock, req, ifr) < 0)
+		return gd_translate_error(errno);
+
+	return GD_SUCCESS;
+}
+
+static int
+gd_net_set_offload(int sock, const char *ifname, __u32 cmd, int on)
+{
+	struct ifreq ifr;
+	struct ethtool_value eval;
+
+	memset(&ifr, 0, sizeof(ifr));
+	eval.cmd = cmd;
+	eval.data = on;
+	ifr.ifr_data = (void *)&eval;
+
+	return gd_net_set_ifreq(sock, ifname, SIOCETHTOOL, &ifr);
+}
+
+/*
+  Replaces root qdisc with given kind using default parameters,
+  same as "tc qdisc replace dev <ifname> root <kind>".
+ */
+static int
+gd_net_set_qdisc(const char *ifname, const char *kind)
+{
+	struct {
+		struct nlmsghdr n;
+		struct tcmsg t;
+		char buf[64];
+	} req;
+	struct {
+		struct nlmsghdr n;
+		struct nlmsgerr e;
+	} ack;
+	struct sockaddr_nl sa;
+	struct rtattr *rta;
+	size_t kind_len;
+	unsigned idx;
+	int sock;
+	int ret;
+	int g_ret = GD_ERROR_OTHER_ERROR;
+
+	idx = if_nametoindex(ifname);
+	if (idx == 0)
+		return GD_ERROR_NOT_FOUND;
+
+	kind_len = strlen(kind) + 1;
+	if (RTA_SPACE(kind_len) > sizeof(req.buf))
+		return GD_ERROR_INVALID_PARAM;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(req.t));
+	req.n.nlmsg_type = RTM_NEWQDISC;
+	req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE | NLM_F_REPLACE;
+	req.t.tcm_family = AF_UNSPEC;
+	req.t.tcm_ifindex = idx;
+	req.t.tcm_parent = TC_H_ROOT;
+
+	rta = (struct rtattr *)((char *)&req + NLMSG_ALIGN(req.n.nlmsg_len));
+	rta->rta_type = TCA_KIND;
+	rta->rta_len = RTA_LENGTH(kind_len);
+	memcpy(RTA_DATA(rta), kind, kind_len);
+	req.n.nlmsg_len = NLMSG_ALIGN(req.n.nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (sock < 0)
+		return gd_translate_error(errno);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+
+	ret = sendto(sock, &req, req.n.nlmsg_len, 0,
+		     (struct sockaddr *)&sa, sizeof(sa));
+	if (ret < 0) {
+		g_ret = gd_translate_error(errno);
+		goto out;
+	}
+
+	ret = recv(sock, &ack, sizeof(ack), 0);
+	if (ret < 0) {
+		g_ret = gd_translate_error(errno);
+		goto out;
+	}
+
+	if (ret < (int)sizeof(ack) || ack.n.nlmsg_type != NLMSG_ERROR)
+		goto out;
+
+	g_ret = ack.e.error == 0 ? GD_SUCCESS : gd_translate_error(-ack.e.error);
+out:
+	close(sock);
+	return g_ret;
+}
+
+int
+gd_net_tune_netdev(const char *ifname)
+{
+	struct ifreq ifr;
+	int sock;
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sock < 0) {
+		ERROR("Unable to open socket");
+		return gd_translate_error(errno);
+	}
+
+	if (config.net.mtu >= 0) {
+		memset(&ifr, 0, sizeof(ifr));
+		ifr.ifr_mtu = config.net.mtu;
+		ret = gd_net_set_ifreq(sock, ifname, SIOCSIFMTU, &ifr);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set mtu of %s", ifname);
+			g_ret = ret;
+		}
+	}
+
+	if (config.net.txqueuelen >= 0) {
+		memset(&ifr, 0, sizeof(ifr));
+		ifr.ifr_qlen = config.net.txqueuelen;
+		ret = gd_net_set_ifreq(sock, ifname, SIOCSIFTXQLEN, &ifr);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set txqueuelen of %s", ifname);
+			g_ret = ret;
+		}
+	}
+
+	if (config.net.gro >= 0) {
+		ret = gd_net_set_offload(sock, ifname, ETHTOOL_SGRO, config.net.gro);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set gro of %s", ifname);
+			g_ret = ret;
+		}
+	}
+
+	if (config.net.gso >= 0) {
+		ret = gd_net_set_offload(sock, ifname, ETHTOOL_SGSO, config.net.gso);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set gso of %s", ifname);
+			g_ret = ret;
+		}
+	}
+
+	close(sock);
+
+	if (config.net.qdisc != NULL) {
+		ret = gd_net_set_qdisc(ifname, config.net.qdisc);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set qdisc %s on %s", config.net.qdisc,
+			      ifname);
+			g_ret = ret;
+		}
+	}
+
+	return g_ret;
+}
+
+/* Up to 1024 CPUs, as 32 bit words of sysfs cpumask format */
+#define GD_NET_MASK_WORDS (CPU_SETSIZE / 32)
+
+/* Formats CPU list as mask for rps_cpus and xps_cpus, eg. "3,0000000f" */
+static int
+gd_net_cpus_to_mask(const char *cpus, char *buf, size_t len)
+{
+	uint32_t mask[GD_NET_MASK_WORDS];
+	cpu_set_t set;
+	int top;
+	int i;
+	size_t pos;
+
+	if (cpu_list_parse(cpus, &set) < 0)
+		return GD_ERROR_BAD_VALUE;
+
+	memset(mask, 0, sizeof(mask));
+	for (i = 0; i < CPU_SETSIZE; ++i)
+		if (CPU_ISSET(i, &set))
+			mask[i / 32] |= 1U << (i % 32);
+
+	for (top = GD_NET_MASK_WORDS - 1; top > 0 && mask[top] == 0; --top)
+		;
+
+	pos = snprintf(buf, len, "%x", mask[top]);
+	for (i = top - 1; i >= 0 && pos < len; --i)
+		pos += snprintf(buf + pos, len - pos, ",%08x", mask[i]);
+
+	return pos < len ? GD_SUCCESS : GD_ERROR_PATH_TOO_LONG;
+}
+
+static int
+gd_net_write_attr(const char *path, const char *value)
+{
+	FILE *fp;
+	int ret = GD_SUCCESS;
+
+	fp = fopen(path, "w");
+	if (fp == NULL)
+		return gd_translate_error(errno);
+
+	if (fputs(value, fp) < 0)
+		ret = gd_translate_error(errno);
+	if (fclose(fp) != 0 && ret == GD_SUCCESS)
+		ret = gd_translate_error(errno);
+
+	return ret;
+}
+
+/*
+  Writes value to attribute of each rx-N or tx-N queue of interface.
+  Returns number of queues or gd_error.
+ */
+static int
+gd_net_write_queues(const char *ifname, const char *prefix,
+		    const char *attr, const char *value)
+{
+	char path[PATH_MAX];
+	DIR *dir;
+	struct dirent *d;
+	int n = 0;
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/queues", ifname);
+	dir = opendir(path);
+	if (dir == NULL)
+		return gd_translate_error(errno);
+
+	while ((d = readdir(dir)) != NULL) {
+		if (strncmp(d->d_name, prefix, strlen(prefix)) != 0)
+			continue;
+
+		snprintf(path, sizeof(path), "/sys/class/net/%s/queues/%s/%s",
+			 ifname, d->d_name, attr);
+		ret = gd_net_write_attr(path, value);
+		if (ret != GD_SUCCESS)
+			g_ret = ret;
+		++n;
+	}
+
+	closedir(dir);
+	return g_ret == GD_SUCCESS ? n : g_ret;
+}
+
+/* Global RFS table has to hold flows of all rx queues */
+static void
+gd_net_grow_sock_flow_entries(long entries)
+{
+	static const char path[] = "/proc/sys/net/core/rps_sock_flow_entries";
+	char buf[32];
+	FILE *fp;
+	long cur = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return;
+	if (fscanf(fp, "%ld", &cur) != 1)
+		cur = 0;
+	fclose(fp);
+
+	if (cur >= entries)
+		return;
+
+	snprintf(buf, sizeof(buf), "%ld", entries);
+	if (gd_net_write_attr(path, buf) != GD_SUCCESS)
+		ERROR("Unable to set rps_sock_flow_entries");
+}
+
+static int
+gd_net_apply_steering(const char *ifname, const struct gd_net_steering *s)
+{
+	char mask[GD_NET_MASK_WORDS * 9 + 1];
+	char buf[32];
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	if (s->rps_cpus != NULL) {
+		ret = gd_net_cpus_to_mask(s->rps_cpus, mask, sizeof(mask));
+		if (ret == GD_SUCCESS)
+			ret = gd_net_write_queues(ifname, "rx-", "rps_cpus", mask);
+		if (ret < 0) {
+			ERROR("Unable to set rps_cpus %s on %s", s->rps_cpus,
+			      ifname);
+			g_ret = ret;
+		}
+	}
+
+	if (s->xps_cpus != NULL) {
+		ret = gd_net_cpus_to_mask(s->xps_cpus, mask, sizeof(mask));
+		if (ret == GD_SUCCESS)
+			ret = gd_net_write_queues(ifname, "tx-", "xps_cpus", mask);
+		if (ret < 0) {
+			ERROR("Unable to set xps_cpus %s on %s", s->xps_cpus,
+			      ifname);
+			g_ret = ret;
+		}
+	}
+
+	if (s->rps_flow_cnt >= 0) {
+		snprintf(buf, sizeof(buf), "%d", s->rps_flow_cnt);
+		ret = gd_net_write_queues(ifname, "rx-", "rps_flow_cnt", buf);
+		if (ret < 0) {
+			ERROR("Unable to set rps_flow_cnt on %s", ifname);
+			g_ret = ret;
+		} else {
+			gd_net_grow_sock_flow_entries((long)s->rps_flow_cnt * ret);
+		}
+	}
+
+	return g_ret;
+}
+
+static int
+gd_net_set_irq_cpus(int irq, const char *cpus)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq);
+	return gd_net_write_attr(path, cpus);
+}
+
+/*
+  Checks if line of /proc/interrupts names given device. Names of devices
+  sharing the interrupt are listed at the end of line, separated by commas.
+ */
+static int
+gd_net_irq_has_name(const char *line, const char *name)
+{
+	size_t name_len = strlen(name);
+	size_t len;
+
+	for (line += strspn(line, " \t\n,"); *line != '\0';
+	     line += len, line += strspn(line, " \t\n,")) {
+		len = strcspn(line, " \t\n,");
+		if (len == name_len && strncmp(line, name, len) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+  Finds interrupts of UDC. PCI controllers expose them in sysfs,
+  for platform devices /proc/interrupts is searched for device name.
+  Returns number of interrupts found.
+ */
+static int
+gd_net_find_udc_irqs(usbg_udc *u, int *irqs, int max)
+{
+	char path[PATH_MAX];
+	char dev[PATH_MAX];
+	char line[512];
+	const char *dev_name;
+	DIR *dir;
+	struct dirent *d;
+	FILE *fp;
+	int n = 0;
+	int irq;
+
+	snprintf(path, sizeof(path), "/sys/class/udc/%s/device",
+		 usbg_get_udc_name(u));
+	if (realpath(path, dev) == NULL)
+		return 0;
+
+	snprintf(path, sizeof(path), "%s/msi_irqs", dev);
+	dir = opendir(path);
+	if (dir != NULL) {
+		while ((d = readdir(dir)) != NULL && n < max) {
+			if (sscanf(d->d_name, "%d", &irq) == 1)
+				irqs[n++] = irq;
+		}
+		closedir(dir);
+		if (n > 0)
+			return n;
+	}
+
+	snprintf(path, sizeof(path), "%s/irq", dev);
+	fp = fopen(path, "r");
+	if (fp != NULL) {
+		if (fscanf(fp, "%d", &irq) == 1 && irq > 0)
+			irqs[n++] = irq;
+		fclose(fp);
+		if (n > 0)
+			return n;
+	}
+
+	dev_name = strrchr(dev, '/');
+	dev_name = dev_name ? dev_name + 1 : dev;
+
+	fp = fopen("/proc/interrupts", "r");
+	if (fp == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), fp) != NULL && n < max) {
+		if (sscanf(line, " %d:", &irq) != 1)
+			continue;
+		if (gd_net_irq_has_name(line, dev_name)
+		    || gd_net_irq_has_name(line, usbg_get_udc_name(u)))
+			irqs[n++] = irq;
+	}
+	fclose(fp);
+
+	return n;
+}
+
+static int
+gd_net_steer_udc_irq(usbg_udc *u, const char *cpus)
+{
+	cpu_set_t set;
+	int irqs[8];
+	int n;
+	int i;
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	if (cpu_list_parse(cpus, &set) < 0)
+		return GD_ERROR_BAD_VALUE;
+
+	n = gd_net_find_udc_irqs(u, irqs, sizeof(irqs)/sizeof(irqs[0]));
+	if (n == 0)
+		return GD_ERROR_NOT_FOUND;
+
+	for (i = 0; i < n; ++i) {
+		INFO("setting affinity of irq %d to %s", irqs[i], cpus);
+		ret = gd_net_set_irq_cpus(irqs[i], cpus);
+		if (ret != GD_SUCCESS)
+			g_ret = ret;
+	}
+
+	return g_ret;
+}
+
+const struct gd_net_steering *
+gd_net_get_steering(struct gd_function *f)
+{
+	return f->net_steering ? f->net_steering : &config.net.steering;
+}
+
+void
+gd_net_steering_free(struct gd_net_steering *s)
+{
+	if (s == NULL)
+		return;
+
+	free(s->rps_cpus);
+	free(s->xps_cpus);
+	free(s->irq_cpus);
+	free(s);
+}
+
+/* Empty list means default from config */
+static int
+gd_net_dup_cpus(const char *cpus, const char *def, char **out)
+{
+	cpu_set_t set;
+
+	if (cpus == NULL || *cpus == '\0')
+		cpus = def;
+
+	*out = NULL;
+	if (cpus == NULL)
+		return GD_SUCCESS;
+
+	if (cpu_list_parse(cpus, &set) < 0)
+		return GD_ERROR_BAD_VALUE;
+
+	*out = strdup(cpus);
+	return *out ? GD_SUCCESS : GD_ERROR_NO_MEM;
+}
+
+static int
+gd_net_get_ifname(struct gd_function *f, char *ifname, size_t len)
+{
+	usbg_function_attrs f_attrs;
+	int usbg_ret;
+
+	usbg_ret = usbg_get_function_attrs(f->f, &f_attrs);
+	if (usbg_ret != USBG_SUCCESS || f_attrs.net.ifname[0] == '\0')
+		return GD_ERROR_NOT_FOUND;
+
+	snprintf(ifname, len, "%s", f_attrs.net.ifname);
+	return GD_SUCCESS;
+}
+
+int
+gd_net_set_steering(struct gd_function *f, const char *rps_cpus,
+		    const char *xps_cpus, int rps_flow_cnt,
+		    const char *irq_cpus)
+{
+	const struct gd_net_steering *def = &config.net.steering;
+	struct gd_net_steering *s;
+	char ifname[IFNAMSIZ];
+	usbg_udc *u;
+	int ret;
+
+	if (f->function_group != FUNC_GROUP_NET)
+		return GD_ERROR_NOT_SUPPORTED;
+
+	s = calloc(1, sizeof(*s));
+	if (s == NULL)
+		return GD_ERROR_NO_MEM;
+
+	ret = gd_net_dup_cpus(rps_cpus, def->rps_cpus, &s->rps_cpus);
+	if (ret != GD_SUCCESS)
+		goto error;
+
+	ret = gd_net_dup_cpus(xps_cpus, def->xps_cpus, &s->xps_cpus);
+	if (ret != GD_SUCCESS)
+		goto error;
+
+	ret = gd_net_dup_cpus(irq_cpus, def->irq_cpus, &s->irq_cpus);
+	if (ret != GD_SUCCESS)
+		goto error;
+
+	s->rps_flow_cnt = rps_flow_cnt >= 0 ? rps_flow_cnt : def->rps_flow_cnt;
+
+	/* apply now if gadget is enabled, otherwise on next enable */
+	u = usbg_get_gadget_udc(f->parent->g);
+	if (u != NULL && gd_net_get_ifname(f, ifname, sizeof(ifname)) == GD_SUCCESS) {
+		ret = gd_net_apply_steering(ifname, s);
+		if (ret != GD_SUCCESS)
+			goto error;
+
+		if (s->irq_cpus != NULL
+		    && gd_net_steer_udc_irq(u, s->irq_cpus) != GD_SUCCESS)
+			ERROR("Unable to set irq affinity of %s",
+			      usbg_get_udc_name(u));
+	}
+
+	/* store only policy which was accepted by interface */
+	gd_net_steering_free(f->net_steering);
+	f->net_steering = s;
+
+	return GD_SUCCESS;
+error:
+	gd_net_steering_free(s);
+	return ret;
+}
+
+int
+gd_net_tune_gadget(struct gd_gadget *g, usbg_udc *u)
+{
+	struct gd_function *f;
+	const struct gd_net_steering *s;
+	const char *irq_cpus = NULL;
+	char ifname[IFNAMSIZ];
+	GList *l;
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	for (l = g_list_first(g->funcs); l; l = g_list_next(l)) {
+		f = l->data;
+		if (f->function_group != FUNC_GROUP_NET)
+			continue;
+
+		ret = gd_net_get_ifname(f, ifname, sizeof(ifname));
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to get interface of %s", f->instance);
+			g_ret = ret;
+			continue;
+		}
+
+		INFO("tuning network interface %s", ifname);
+
+		ret = gd_net_tune_netdev(ifname);
+		if (ret != GD_SUCCESS)
+			g_ret = ret;
+
+		s = gd_net_get_steering(f);
+		ret = gd_net_apply_steering(ifname, s);
+		if (ret != GD_SUCCESS)
+			g_ret = ret;
+
+		/* there is one interrupt for all functions, first one wins */
+		if (irq_cpus == NULL)
+			irq_cpus = s->irq_cpus;
+	}
+
+	if (irq_cpus != NULL) {
+		ret = gd_net_steer_udc_irq(u, irq_cpus);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to set irq affinity of %s",
+			      usbg_get_udc_name(u));
+			g_ret = ret;
+		}
+	}
+
+	return g_ret;
+}
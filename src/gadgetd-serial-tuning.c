@@ -0,0 +1,181 @@
+/*
+ * gadgetd-serial-tuning.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <termios.h>
+
+#include <gadgetd-serial-tuning.h>
+#include <gadgetd-config.h>
+#include <gadgetd-function-attrs.h>
+#include <gadgetd-common.h>
+
+int
+gd_serial_tty_path(int port_num, char *path, size_t len)
+{
+	int ret;
+
+	if (port_num < 0)
+		return GD_ERROR_NOT_FOUND;
+
+	ret = snprintf(path, len, "/dev/ttyGS%d", port_num);
+	if (ret < 0 || (size_t)ret >= len)
+		return GD_ERROR_PATH_TOO_LONG;
+
+	return GD_SUCCESS;
+}
+
+/*
+  Console is set through configfs attribute of function,
+  libusbg does not know it.
+ */
+static int
+gd_serial_set_console(struct gd_function *f, int enable)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	ret = gd_function_configfs_path(f, path, sizeof(path) - sizeof("/console"));
+	if (ret != GD_SUCCESS)
+		return ret;
+	strcat(path, "/console");
+
+	fp = fopen(path, "w");
+	if (fp == NULL)
+		return gd_translate_error(errno);
+
+	if (fprintf(fp, "%d", enable) < 0)
+		g_ret = gd_translate_error(errno);
+	if (fclose(fp) != 0 && g_ret == GD_SUCCESS)
+		g_ret = gd_translate_error(errno);
+
+	return g_ret;
+}
+
+int
+gd_serial_prepare_gadget(struct gd_gadget *g)
+{
+	struct gd_function *f;
+	GList *l;
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	if (config.serial.console == NULL)
+		return GD_SUCCESS;
+
+	for (l = g_list_first(g->funcs); l; l = g_list_next(l)) {
+		f = l->data;
+		if (f->function_group != FUNC_GROUP_SERIAL
+		    || strcmp(f->instance, config.serial.console) != 0)
+			continue;
+
+		ret = gd_serial_set_console(f, 1);
+		if (ret != GD_SUCCESS) {
+			ERROR("Unable to enable console on %s", f->instance);
+			g_ret = ret;
+		}
+	}
+
+	return g_ret;
+}
+
+int
+gd_serial_tune_tty(const char *path)
+{
+	struct termios tio;
+	int fd;
+	int g_ret = GD_SUCCESS;
+
+	if (config.serial.raw < 0 && config.serial.vmin < 0
+	    && config.serial.vtime < 0)
+		return GD_SUCCESS;
+
+	/* don't wait for carrier, host may be not connected yet */
+	fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		ERROR("Unable to open %s", path);
+		return gd_translate_error(errno);
+	}
+
+	if (tcgetattr(fd, &tio) < 0) {
+		ERROR("Unable to get attributes of %s", path);
+		g_ret = gd_translate_error(errno);
+		goto out;
+	}
+
+	if (config.serial.raw > 0)
+		cfmakeraw(&tio);
+	if (config.serial.vmin >= 0)
+		tio.c_cc[VMIN] = config.serial.vmin;
+	if (config.serial.vtime >= 0)
+		tio.c_cc[VTIME] = config.serial.vtime;
+
+	if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+		ERROR("Unable to set attributes of %s", path);
+		g_ret = gd_translate_error(errno);
+	}
+
+out:
+	close(fd);
+	return g_ret;
+}
+
+int
+gd_serial_tune_gadget(struct gd_gadget *g)
+{
+	struct gd_function *f;
+	usbg_function_attrs f_attrs;
+	char path[32];
+	GList *l;
+	int usbg_ret;
+	int ret;
+	int g_ret = GD_SUCCESS;
+
+	for (l = g_list_first(g->funcs); l; l = g_list_next(l)) {
+		f = l->data;
+		if (f->function_group != FUNC_GROUP_SERIAL)
+			continue;
+
+		usbg_ret = usbg_get_function_attrs(f->f, &f_attrs);
+		if (usbg_ret != USBG_SUCCESS) {
+			ERROR("Unable to get port of %s", f->instance);
+			g_ret = GD_ERROR_OTHER_ERROR;
+			continue;
+		}
+
+		ret = gd_serial_tty_path(f_attrs.serial.port_num, path,
+					 sizeof(path));
+		if (ret != GD_SUCCESS) {
+			g_ret = ret;
+			continue;
+		}
+
+		INFO("tuning serial port %s", path);
+
+		ret = gd_serial_tune_tty(path);
+		if (ret != GD_SUCCESS)
+			g_ret = ret;
+	}
+
+	return g_ret;
+}
@@ -0,0 +1,212 @@
+/*
+ * gadgetd-udc-connect.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <gadgetd-udc-connect.h>
+#include <gadgetd-ffs-func.h>
+#include <gadgetd-config.h>
+#include <gadgetd-common.h>
+
+/* used if udc_connect_timeout is not given, in ms */
+#define GD_UDC_CONNECT_TIMEOUT 2000
+
+enum gd_connect_wait {
+	GD_CONNECT_WAIT_NONE,
+	/* services activated by bind are running */
+	GD_CONNECT_WAIT_RUNNING
+};
+
+struct gd_udc_connect {
+	gchar *udc;
+	struct gd_gadget *g;
+	struct gd_udc_state *st;
+	guint timer;
+	gint64 start;
+};
+
+/* gadgets held disconnected, list of struct gd_udc_connect */
+static GList *held;
+
+static enum gd_connect_wait
+gd_udc_connect_wait(void)
+{
+	const char *wait = config.udc.connect_wait;
+
+	/*
+	 * Gadget with ffs functions can be bound only after descriptors
+	 * of all instances have been written and FUNCTIONFS_BIND is
+	 * queued during bind, so instances are ready as soon as gadget
+	 * is connected. Holding would only add a reconnect.
+	 */
+	if (wait == NULL || strcmp(wait, "none") == 0 ||
+	    strcmp(wait, "ready") == 0)
+		return GD_CONNECT_WAIT_NONE;
+	if (strcmp(wait, "running") == 0)
+		return GD_CONNECT_WAIT_RUNNING;
+
+	ERROR("Unknown udc_connect_wait %s, not waiting", wait);
+	return GD_CONNECT_WAIT_NONE;
+}
+
+static gboolean
+gd_udc_connect_ready(struct gd_gadget *g)
+{
+	struct gd_ffs_func *inst;
+	struct gd_function *f;
+	GList *l;
+
+	for (l = g->funcs; l != NULL; l = l->next) {
+		f = l->data;
+		if (f->function_group != FUNC_GROUP_FFS)
+			continue;
+
+		inst = container_of(f, struct gd_ffs_func, func);
+
+		/* Descriptors are always written before bind, so instance
+		   is ready only after it has seen FUNCTIONFS_BIND. Running
+		   service consumes events, it is ready once started. */
+		switch (inst->state) {
+		case FFS_INSTANCE_BOUND:
+		case FFS_INSTANCE_ENABLED:
+		case FFS_INSTANCE_RUNNING:
+			break;
+		default:
+			return FALSE;
+		}
+
+		/* other services can't start before host configures gadget */
+		if (inst->service->activation_event == FUNCTIONFS_BIND
+		    && inst->state != FFS_INSTANCE_RUNNING)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+gd_udc_connect_free(struct gd_udc_connect *c)
+{
+	if (c->timer != 0)
+		g_source_remove(c->timer);
+
+	held = g_list_remove(held, c);
+	g_free(c->udc);
+	g_free(c);
+}
+
+/* drop everything held for this udc or this gadget */
+static void
+gd_udc_connect_drop(const char *udc, struct gd_gadget *g)
+{
+	struct gd_udc_connect *c;
+	GList *l, *next;
+
+	for (l = held; l != NULL; l = next) {
+		next = l->next;
+		c = l->data;
+		if (strcmp(c->udc, udc) == 0 || c->g == g)
+			gd_udc_connect_free(c);
+	}
+}
+
+static void
+gd_udc_connect_finish(struct gd_udc_connect *c, const char *reason)
+{
+	int ret;
+
+	ret = gd_udc_write_attr(c->udc, "soft_connect", "connect");
+	if (ret != GD_SUCCESS)
+		ERROR("Unable to connect %s", c->udc);
+	else
+		INFO("%s connected (%s) after %" G_GINT64_FORMAT " us", c->udc,
+		     reason, g_get_monotonic_time() - c->start);
+
+	if (c->st != NULL)
+		gd_udc_state_mark(c->st, "connect");
+
+	gd_udc_connect_free(c);
+}
+
+static gboolean
+gd_udc_connect_timeout(gpointer user_data)
+{
+	struct gd_udc_connect *c = user_data;
+
+	c->timer = 0;
+	gd_udc_connect_finish(c, "timeout");
+
+	return FALSE;
+}
+
+int
+gd_udc_connect_hold(const char *udc, struct gd_gadget *g,
+		    struct gd_udc_state *st)
+{
+	struct gd_udc_connect *c;
+	int timeout;
+	int ret;
+
+	/* gadget may have been moved from udc where it was held */
+	gd_udc_connect_drop(udc, g);
+
+	if (gd_udc_connect_wait() == GD_CONNECT_WAIT_NONE ||
+	    gd_udc_connect_ready(g))
+		return GD_SUCCESS;
+
+	ret = gd_udc_write_attr(udc, "soft_connect", "disconnect");
+	if (ret != GD_SUCCESS) {
+		ERROR("Unable to disconnect %s, staging skipped", udc);
+		return ret;
+	}
+
+	timeout = config.udc.connect_timeout;
+	if (timeout < 0)
+		timeout = GD_UDC_CONNECT_TIMEOUT;
+
+	c = g_malloc0(sizeof(*c));
+	c->udc = g_strdup(udc);
+	c->g = g;
+	c->st = st;
+	c->start = g_get_monotonic_time();
+	c->timer = g_timeout_add(timeout, gd_udc_connect_timeout, c);
+	held = g_list_append(held, c);
+
+	INFO("%s held disconnected until ffs services are running", udc);
+
+	return GD_SUCCESS;
+}
+
+void
+gd_udc_connect_check(void)
+{
+	struct gd_udc_connect *c;
+	GList *l, *next;
+
+	for (l = held; l != NULL; l = next) {
+		next = l->next;
+		c = l->data;
+		if (gd_udc_connect_ready(c->g))
+			gd_udc_connect_finish(c, "running");
+	}
+}
+
+void
+gd_udc_connect_cancel(const char *udc)
+{
+	gd_udc_connect_drop(udc, NULL);
+}
@@ -25,6 +25,10 @@
 #include <gadgetd-core.h>
 #include <gadgetd-udc-object.h>
 #include <gadgetd-gadget-object.h>
+#include <gadgetd-net-tuning.h>
+#include <gadgetd-serial-tuning.h>
+#include <gadgetd-udc-state.h>
+#include <gadgetd-udc-connect.h>
 
 #include <string.h>
 #ifdef G_OS_UNIX
@@ -48,7 +52,10 @@ enum
 	PROP_0,
 	PROP_UDC_NAME,
 	PROP_UDC_OBJ,
-	PROP_UDC_ENABLED_GD
+	PROP_UDC_ENABLED_GD,
+	PROP_UDC_STATE,
+	PROP_UDC_CURRENT_SPEED,
+	PROP_UDC_MAX_SPEED
 } prop_config_iface;
 
 static const char udc_iface[] = "org.usb.device.UDC";
@@ -104,6 +111,8 @@ gadgetd_udc_device_get_property(GObject *object, guint property_id, GValue *valu
 {
 	GadgetdUDCDevice *udc_device = GADGETD_UDC_DEVICE(object);
 	const gchar *name = NULL;
+	struct gd_udc_state *st;
+	char speed[32];
 	usbg_udc *u;
 	gchar *path;
 	usbg_gadget *g;
@@ -129,6 +138,20 @@ gadgetd_udc_device_get_property(GObject *object, guint property_id, GValue *valu
 		}
 		g_value_set_string(value, path);
 		break;
+	case PROP_UDC_STATE:
+		st = gadgetd_udc_object_get_state(udc_device->udc_obj);
+		g_value_set_string(value, st ? gd_udc_state_get_state(st) : "");
+		break;
+	case PROP_UDC_CURRENT_SPEED:
+		st = gadgetd_udc_object_get_state(udc_device->udc_obj);
+		g_value_set_string(value, st ? gd_udc_state_get_speed(st) : "");
+		break;
+	case PROP_UDC_MAX_SPEED:
+		if (gd_udc_read_attr(usbg_get_udc_name(u), "maximum_speed",
+				     speed, sizeof(speed)) != GD_SUCCESS)
+			speed[0] = '\0';
+		g_value_set_string(value, speed);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
 		break;
@@ -153,6 +176,15 @@ gadgetd_udc_device_class_init(GadgetdUDCDeviceClass *klass)
 	g_object_class_override_property(gobject_class,
 					 PROP_UDC_ENABLED_GD,
 					 "enabled-gadget");
+	g_object_class_override_property(gobject_class,
+					 PROP_UDC_STATE,
+					 "state");
+	g_object_class_override_property(gobject_class,
+					 PROP_UDC_CURRENT_SPEED,
+					 "current-speed");
+	g_object_class_override_property(gobject_class,
+					 PROP_UDC_MAX_SPEED,
+					 "max-speed");
 	g_object_class_install_property(gobject_class,
                                    PROP_UDC_OBJ,
                                    g_param_spec_object("udc-object",
@@ -192,75 +224,198 @@ gadgetd_udc_device_init(GadgetdUDCDevice *gadgetd_udc_)
 }
 
 /**
- * @brief handle enable gadget
- * @param[in] object
- * @param[in] invocation
- * @param[in] gadget_path
- * @return true if metod handled
+ * @brief Emit PropertiesChanged for connection state of udc
+ * @details Properties are not stored in skeleton, so it is not
+ * able to emit the signal on its own
+ * @param[in] udc_device GadgetdUDCDevice
  */
-static gboolean
-handle_enable_gadget(GadgetdUDC               *object,
-			GDBusMethodInvocation *invocation,
-			const gchar           *gadget_path)
+void
+gadgetd_udc_device_state_changed(GadgetdUDCDevice *udc_device)
+{
+	GDBusInterfaceSkeleton *skeleton = G_DBUS_INTERFACE_SKELETON(udc_device);
+	GVariantBuilder builder;
+	GVariantBuilder invalidated_builder;
+	GDBusConnection *connection;
+	struct gd_udc_state *st;
+	const gchar *path;
+
+	st = gadgetd_udc_object_get_state(udc_device->udc_obj);
+	if (st == NULL)
+		return;
+
+	INFO("udc state %s, speed %s", gd_udc_state_get_state(st),
+	     gd_udc_state_get_speed(st));
+
+	connection = g_dbus_interface_skeleton_get_connection(skeleton);
+	path = g_dbus_interface_skeleton_get_object_path(skeleton);
+	/* not exported yet */
+	if (connection == NULL || path == NULL)
+		return;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&builder, "{sv}", "state",
+			      g_variant_new_string(gd_udc_state_get_state(st)));
+	g_variant_builder_add(&builder, "{sv}", "current_speed",
+			      g_variant_new_string(gd_udc_state_get_speed(st)));
+	g_variant_builder_init(&invalidated_builder, G_VARIANT_TYPE("as"));
+
+	g_dbus_connection_emit_signal(connection, NULL, path,
+				      "org.freedesktop.DBus.Properties",
+				      "PropertiesChanged",
+				      g_variant_new("(sa{sv}as)", udc_iface,
+						    &builder, &invalidated_builder),
+				      NULL);
+}
+
+/**
+ * @brief prepare gadget to be enabled on udc
+ * @details Looks up gadget and applies settings which must be set
+ * before bind. Gadget is not bound yet.
+ * @param[in] udc_obj udc on which gadget should be enabled
+ * @param[in] gadget_path path of gadget object
+ * @param[out] gadget gadget to be bound
+ * @param[out] msg error description, valid only on failure
+ * @return GD_SUCCESS if success, gd_error otherwise
+ */
+gint
+gd_udc_prepare_enable(GadgetdUdcObject *udc_obj, const gchar *gadget_path,
+		      struct gd_gadget **gadget, const gchar **msg)
 {
-	GadgetdUDCDevice *udc_device = GADGETD_UDC_DEVICE(object);
-	gint usbg_ret = USBG_SUCCESS;
-	GVariant *result;
-	const gchar *msg;
 	GadgetDaemon *daemon;
 	GDBusObjectManager *object_manager;
 	GadgetdGadgetObject *gadget_object;
 	struct gd_gadget *gd_gadget;
-	usbg_udc *u;
-	gint g_ret = 0;
 
-	INFO("enable gadget handler");
-
-	daemon = gadgetd_udc_object_get_daemon(udc_device->udc_obj);
+	daemon = gadgetd_udc_object_get_daemon(udc_obj);
 	if (daemon == NULL) {
-		msg = "Failed to get daemon";
-		goto error;
+		*msg = "Failed to get daemon";
+		return GD_ERROR_OTHER_ERROR;
 	}
 
 	object_manager = G_DBUS_OBJECT_MANAGER(gadget_daemon_get_object_manager(daemon));
 	if (object_manager == NULL) {
-		msg = "Failed to get object manager";
-		goto error;
+		*msg = "Failed to get object manager";
+		return GD_ERROR_OTHER_ERROR;
 	}
 
 	gadget_object = GADGETD_GADGET_OBJECT(g_dbus_object_manager_get_object(object_manager,
 									       gadget_path));
 	if (gadget_object == NULL) {
-		msg = "Failed to get gadget object";
-		goto error;
+		*msg = "Failed to get gadget object";
+		return GD_ERROR_NOT_FOUND;
 	}
 
 	gd_gadget = gadgetd_gadget_object_get_gadget(gadget_object);
 	if (gd_gadget == NULL) {
-		msg = "Failed to get gadget";
-		goto error;
+		*msg = "Failed to get gadget";
+		return GD_ERROR_OTHER_ERROR;
 	}
 
-	u = gadgetd_udc_object_get_udc(udc_device->udc_obj);
-	if (u == NULL) {
-		msg = "Failed to get udc";
-		goto error;
+	if (gadgetd_udc_object_get_udc(udc_obj) == NULL) {
+		*msg = "Failed to get udc";
+		return GD_ERROR_OTHER_ERROR;
 	}
 
-	usbg_ret = usbg_enable_gadget(gd_gadget->g, u);
-	if (usbg_ret != USBG_SUCCESS) {
-		msg = "Failed to enable gadget";
-		goto error;
-	}
+	/* tuning is best effort, gadget is enabled anyway */
+	gd_net_prepare_gadget(gd_gadget->g);
+	gd_serial_prepare_gadget(gd_gadget);
 
-	g_ret = gadgetd_udc_object_set_enabled_gadget_path(udc_device->udc_obj, gadget_path);
+	*gadget = gd_gadget;
+	return GD_SUCCESS;
+}
+
+/**
+ * @brief finish enable of gadget after it was bound to udc
+ * @param[in] udc_obj udc on which gadget has been enabled
+ * @param[in] gd_gadget gadget returned by gd_udc_prepare_enable()
+ * @param[in] gadget_path path of gadget object
+ * @param[out] msg error description, valid only on failure
+ * @return GD_SUCCESS if success, gd_error otherwise
+ */
+gint
+gd_udc_finish_enable(GadgetdUdcObject *udc_obj, struct gd_gadget *gd_gadget,
+		     const gchar *gadget_path, const gchar **msg)
+{
+	struct gd_udc_state *st;
+	gint g_ret = 0;
+
+	/* only successful binds are logged, enumeration starts here */
+	st = gadgetd_udc_object_get_state(udc_obj);
+	if (st != NULL)
+		gd_udc_state_mark(st, "bind");
+
+	g_ret = gadgetd_udc_object_set_enabled_gadget_path(udc_obj, gadget_path);
 	if (g_ret != 0) {
-		msg = "Cant set enabled gadget path, gadget will not be enabled";
+		*msg = "Cant set enabled gadget path, gadget will not be enabled";
 		/* we can't handle possible errors so we ignore them */
 		usbg_disable_gadget(gd_gadget->g);
-		goto error;
+		return g_ret;
 	}
 
+	/* best effort, gadget is connected at once if this fails */
+	gd_udc_connect_hold(usbg_get_udc_name(gadgetd_udc_object_get_udc(udc_obj)),
+			    gd_gadget, gadgetd_udc_object_get_state(udc_obj));
+
+	gd_net_tune_gadget(gd_gadget, gadgetd_udc_object_get_udc(udc_obj));
+	gd_serial_tune_gadget(gd_gadget);
+
+	return GD_SUCCESS;
+}
+
+/**
+ * @brief enable gadget on udc
+ * @details Used by EnableGadget method and to rebind default gadget
+ * when its udc appears again
+ * @param[in] udc_obj udc on which gadget should be enabled
+ * @param[in] gadget_path path of gadget object
+ * @param[out] msg error description, valid only on failure
+ * @return GD_SUCCESS if success, gd_error otherwise
+ */
+gint
+gd_udc_enable_gadget(GadgetdUdcObject *udc_obj, const gchar *gadget_path,
+		     const gchar **msg)
+{
+	gint usbg_ret = USBG_SUCCESS;
+	struct gd_gadget *gd_gadget;
+	gint g_ret = 0;
+
+	g_ret = gd_udc_prepare_enable(udc_obj, gadget_path, &gd_gadget, msg);
+	if (g_ret != GD_SUCCESS)
+		return g_ret;
+
+	usbg_ret = usbg_enable_gadget(gd_gadget->g,
+				      gadgetd_udc_object_get_udc(udc_obj));
+	if (usbg_ret != USBG_SUCCESS) {
+		*msg = "Failed to enable gadget";
+		return GD_ERROR_OTHER_ERROR;
+	}
+
+	return gd_udc_finish_enable(udc_obj, gd_gadget, gadget_path, msg);
+}
+
+/**
+ * @brief handle enable gadget
+ * @param[in] object
+ * @param[in] invocation
+ * @param[in] gadget_path
+ * @return true if metod handled
+ */
+static gboolean
+handle_enable_gadget(GadgetdUDC               *object,
+			GDBusMethodInvocation *invocation,
+			const gchar           *gadget_path)
+{
+	GadgetdUDCDevice *udc_device = GADGETD_UDC_DEVICE(object);
+	GVariant *result;
+	const gchar *msg;
+	gint g_ret;
+
+	INFO("enable gadget handler");
+
+	g_ret = gd_udc_enable_gadget(udc_device->udc_obj, gadget_path, &msg);
+	if (g_ret != GD_SUCCESS)
+		goto error;
+
 	result = g_variant_new("(b)", TRUE);
 	g_dbus_method_invocation_return_value(invocation, result);
 
@@ -274,6 +429,51 @@ error:
 	return TRUE;
 }
 
+/**
+ * @brief disable gadget enabled on udc
+ * @details Used by DisableGadget method and to move gadget to another
+ * udc
+ * @param[in] udc_obj udc on which gadget is enabled
+ * @param[out] msg error description, valid only on failure
+ * @return GD_SUCCESS if success, gd_error otherwise
+ */
+gint
+gd_udc_disable_gadget(GadgetdUdcObject *udc_obj, const gchar **msg)
+{
+	gint usbg_ret = USBG_SUCCESS;
+	struct gd_udc_state *st;
+	usbg_udc *u;
+	usbg_gadget *g;
+
+	u = gadgetd_udc_object_get_udc(udc_obj);
+	if (u == NULL) {
+		*msg = "Failed to get udc";
+		return GD_ERROR_OTHER_ERROR;
+	}
+
+	g = usbg_get_udc_gadget(u);
+	if (g == NULL) {
+		*msg = "No gadget enabled";
+		return GD_ERROR_NOT_FOUND;
+	}
+
+	usbg_ret = usbg_disable_gadget(g);
+	if (usbg_ret != USBG_SUCCESS) {
+		*msg = "Failed to disable gadget";
+		return GD_ERROR_OTHER_ERROR;
+	}
+
+	gd_udc_connect_cancel(usbg_get_udc_name(u));
+
+	st = gadgetd_udc_object_get_state(udc_obj);
+	if (st != NULL)
+		gd_udc_state_mark(st, "unbind");
+
+	gadgetd_udc_object_set_enabled_gadget_path(udc_obj, NULL);
+
+	return GD_SUCCESS;
+}
+
 /**
  * @brief handle disable gadget
  * @param[in] object
@@ -286,37 +486,52 @@ handle_disable_gadget(GadgetdUDC            *object,
 		      GDBusMethodInvocation *invocation)
 {
 	GadgetdUDCDevice *udc_device = GADGETD_UDC_DEVICE(object);
-	gint usbg_ret = USBG_SUCCESS;
 	GVariant *result;
 	const gchar *msg;
-	usbg_udc *u;
-	usbg_gadget *g;
+	gint g_ret;
 
 	INFO("disable gadget handler");
 
-	u = gadgetd_udc_object_get_udc(udc_device->udc_obj);
-	if (u == NULL) {
-		msg = "Failed to get udc";
+	g_ret = gd_udc_disable_gadget(udc_device->udc_obj, &msg);
+	if (g_ret != GD_SUCCESS)
 		goto error;
-	}
 
-	g = usbg_get_udc_gadget(u);
-	if (g == NULL) {
-		msg = "No gadget enabled";
-		goto error;
-	}
+	result = g_variant_new("(b)", TRUE);
+	g_dbus_method_invocation_return_value(invocation, result);
 
-	usbg_ret = usbg_disable_gadget(g);
-	if (usbg_ret != USBG_SUCCESS) {
-		msg = "Failed to disable gadget";
-		goto error;
-	}
+	return TRUE;
+error:
+	ERROR("%s", msg);
+	g_dbus_method_invocation_return_dbus_error(invocation,
+			udc_iface,
+			msg);
 
-	gadgetd_udc_object_set_enabled_gadget_path(udc_device->udc_obj, NULL);
+	return TRUE;
+}
 
-	result = g_variant_new("(b)", TRUE);
-	g_dbus_method_invocation_return_value(invocation, result);
+/**
+ * @brief handle get transitions
+ * @param[in] object
+ * @param[in] invocation
+ * @return true if metod handled
+ */
+static gboolean
+handle_get_transitions(GadgetdUDC            *object,
+		       GDBusMethodInvocation *invocation)
+{
+	GadgetdUDCDevice *udc_device = GADGETD_UDC_DEVICE(object);
+	struct gd_udc_state *st;
+	const gchar *msg;
+
+	st = gadgetd_udc_object_get_state(udc_device->udc_obj);
+	if (st == NULL) {
+		msg = "State of udc is not watched";
+		goto error;
+	}
 
+	g_dbus_method_invocation_return_value(invocation,
+					      g_variant_new("(@a(xss))",
+							    gd_udc_state_get_log(st)));
 	return TRUE;
 error:
 	ERROR("%s", msg);
@@ -336,5 +551,6 @@ gadgetd_udc_device_iface_init(GadgetdUDCIface *iface)
 {
 	iface->handle_enable_gadget  = handle_enable_gadget;
 	iface->handle_disable_gadget = handle_disable_gadget;
+	iface->handle_get_transitions = handle_get_transitions;
 }
 
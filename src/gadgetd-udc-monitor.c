@@ -0,0 +1,376 @@
+/*
+ * gadgetd-udc-monitor.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include <gio/gio.h>
+#include <usbg/usbg.h>
+
+#include <gadgetd-udc-monitor.h>
+#include <gadgetd-udc-object.h>
+#include <gadgetd-udc-iface.h>
+#include <gadgetd-udc-state.h>
+#include <gadgetd-udc-connect.h>
+#include <gadgetd-config.h>
+#include <gadgetd-common.h>
+
+/* single uevent is limited by kernel to 2048 bytes of environment */
+#define GD_UEVENT_BUF_LEN 8192
+
+static GadgetDaemon *monitor_daemon;
+
+/* udc name -> GadgetdUdcObject */
+static GHashTable *udc_objects;
+
+/* usbg states created for udcs which appeared after start */
+static GList *udc_states;
+
+static int uevent_fd = -1;
+static guint uevent_watch;
+
+static void
+gd_udc_export(usbg_udc *u)
+{
+	GadgetdUdcObject *udc_object;
+
+	udc_object = gadgetd_udc_object_new(u, monitor_daemon);
+	if (udc_object == NULL) {
+		ERROR("Unable to create udc object");
+		return;
+	}
+
+	g_dbus_object_manager_server_export(gadget_daemon_get_object_manager(monitor_daemon),
+					    G_DBUS_OBJECT_SKELETON(udc_object));
+	g_hash_table_insert(udc_objects, g_strdup(usbg_get_udc_name(u)),
+			    udc_object);
+}
+
+/*
+  libusbg reads list of udcs only in usbg_init(), so udc which
+  was not present at start is taken from new state. Gadgets of
+  that state are never used, ctx.state still owns all of them.
+  Each udc is looked up in states created earlier first, so udc
+  which comes and goes on role switch reuses its usbg_udc.
+ */
+static usbg_udc *
+gd_udc_lookup(const char *name)
+{
+	usbg_state *s;
+	usbg_udc *u;
+	GList *l;
+	int usbg_ret;
+
+	u = usbg_get_udc(ctx.state, name);
+	if (u != NULL)
+		return u;
+
+	for (l = udc_states; l != NULL; l = l->next) {
+		u = usbg_get_udc((usbg_state *)l->data, name);
+		if (u != NULL)
+			return u;
+	}
+
+	usbg_ret = usbg_init(config.configfs_mnt, &s);
+	if (usbg_ret != USBG_SUCCESS) {
+		ERROR("Error: %s: %s", usbg_error_name(usbg_ret),
+		      usbg_strerror(usbg_ret));
+		return NULL;
+	}
+
+	u = usbg_get_udc(s, name);
+	if (u == NULL) {
+		usbg_cleanup(s);
+		return NULL;
+	}
+
+	udc_states = g_list_append(udc_states, s);
+	return u;
+}
+
+static void
+gd_udc_rebind_default(GadgetdUdcObject *udc_object, const char *name)
+{
+	gchar _cleanup_g_free_ *path = NULL;
+	const gchar *msg;
+	gint g_ret;
+
+	if (config.udc.default_gadget == NULL)
+		return;
+
+	if (config.udc.default_udc != NULL
+	    && strcmp(config.udc.default_udc, name) != 0)
+		return;
+
+	path = g_strdup_printf("%s/%s", gadgetd_path, config.udc.default_gadget);
+	if (path == NULL || !g_variant_is_object_path(path)) {
+		ERROR("Invalid default gadget name %s", config.udc.default_gadget);
+		return;
+	}
+
+	g_ret = gd_udc_enable_gadget(udc_object, path, &msg);
+	if (g_ret == GD_ERROR_NOT_FOUND) {
+		/* default gadget has not been created yet */
+		return;
+	} else if (g_ret != GD_SUCCESS) {
+		ERROR("Unable to enable %s on %s: %s",
+		      config.udc.default_gadget, name, msg);
+		return;
+	}
+
+	INFO("default gadget %s enabled on %s", config.udc.default_gadget, name);
+}
+
+static void
+gd_udc_added(const char *name)
+{
+	GadgetdUdcObject *udc_object;
+	usbg_udc *u;
+
+	if (g_hash_table_lookup(udc_objects, name) != NULL)
+		return;
+
+	u = gd_udc_lookup(name);
+	if (u == NULL) {
+		ERROR("Unable to find udc %s", name);
+		return;
+	}
+
+	INFO("udc %s added", name);
+
+	if (g_list_find(gd_udcs, u) == NULL)
+		gd_udcs = g_list_append(gd_udcs, u);
+
+	gd_udc_export(u);
+
+	udc_object = g_hash_table_lookup(udc_objects, name);
+	if (udc_object != NULL)
+		gd_udc_rebind_default(udc_object, name);
+}
+
+static void
+gd_udc_removed(const char *name)
+{
+	GadgetdUdcObject *udc_object;
+	const gchar *path;
+
+	udc_object = g_hash_table_lookup(udc_objects, name);
+	if (udc_object == NULL)
+		return;
+
+	INFO("udc %s removed", name);
+	gd_udc_connect_cancel(name);
+
+	path = g_dbus_object_get_object_path(G_DBUS_OBJECT(udc_object));
+	g_dbus_object_manager_server_unexport(gadget_daemon_get_object_manager(monitor_daemon),
+					      path);
+
+	/* usbg_udc stays in its state, it will be reused if udc comes back */
+	gd_udcs = g_list_remove(gd_udcs, gadgetd_udc_object_get_udc(udc_object));
+	g_hash_table_remove(udc_objects, name);
+}
+
+static void
+gd_udc_rescan(void)
+{
+	struct dirent *d;
+	DIR *dir;
+
+	dir = opendir(GD_UDC_CLASS_PATH);
+	if (dir == NULL)
+		return;
+
+	while ((d = readdir(dir)) != NULL) {
+		if (d->d_name[0] == '.')
+			continue;
+		gd_udc_added(d->d_name);
+	}
+	closedir(dir);
+}
+
+static gboolean
+gd_udc_read_uevent(GIOChannel *channel, GIOCondition condition,
+		   gpointer user_data)
+{
+	char buf[GD_UEVENT_BUF_LEN];
+	struct sockaddr_nl addr;
+	socklen_t addr_len = sizeof(addr);
+	const char *action = NULL;
+	const char *subsystem = NULL;
+	const char *devpath = NULL;
+	const char *name;
+	ssize_t len;
+	char *p;
+
+	if (condition & ~G_IO_IN) {
+		ERROR("Unexpected event received from uevent socket");
+		uevent_watch = 0;
+		return FALSE;
+	}
+
+	len = recvfrom(uevent_fd, buf, sizeof(buf) - 1, 0,
+		       (struct sockaddr *)&addr, &addr_len);
+	if (len < 0) {
+		/* some events were lost, at least pick up new udcs */
+		if (errno == ENOBUFS)
+			gd_udc_rescan();
+		else if (errno != EAGAIN && errno != EINTR)
+			ERROR("Unable to read uevent: %s", strerror(errno));
+		return TRUE;
+	}
+
+	/* accept only messages sent by kernel */
+	if (addr.nl_pid != 0)
+		return TRUE;
+
+	buf[len] = '\0';
+
+	/* header "action@devpath" is followed by NUL separated KEY=value */
+	for (p = buf + strlen(buf) + 1; p < buf + len; p += strlen(p) + 1) {
+		if (strncmp(p, "ACTION=", 7) == 0)
+			action = p + 7;
+		else if (strncmp(p, "SUBSYSTEM=", 10) == 0)
+			subsystem = p + 10;
+		else if (strncmp(p, "DEVPATH=", 8) == 0)
+			devpath = p + 8;
+	}
+
+	if (action == NULL || subsystem == NULL || devpath == NULL
+	    || strcmp(subsystem, "udc") != 0)
+		return TRUE;
+
+	name = strrchr(devpath, '/');
+	name = name ? name + 1 : devpath;
+	if (*name == '\0')
+		return TRUE;
+
+	if (strcmp(action, "add") == 0)
+		gd_udc_added(name);
+	else if (strcmp(action, "remove") == 0)
+		gd_udc_removed(name);
+
+	return TRUE;
+}
+
+static int
+gd_udc_watch_uevents(void)
+{
+	struct sockaddr_nl addr;
+	GIOChannel *channel;
+	int g_ret;
+
+	uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			   NETLINK_KOBJECT_UEVENT);
+	if (uevent_fd < 0) {
+		ERROR("Unable to open uevent socket");
+		return gd_translate_error(errno);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_pid = 0;
+	/* group of events sent by kernel, not rebroadcasted by udev */
+	addr.nl_groups = 1;
+
+	if (bind(uevent_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		ERROR("Unable to bind uevent socket");
+		g_ret = gd_translate_error(errno);
+		close(uevent_fd);
+		uevent_fd = -1;
+		return g_ret;
+	}
+
+	channel = g_io_channel_unix_new(uevent_fd);
+	uevent_watch = g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+				      gd_udc_read_uevent, NULL);
+	g_io_channel_unref(channel);
+
+	return GD_SUCCESS;
+}
+
+int
+gd_udc_monitor_start(GadgetDaemon *daemon)
+{
+	GList *l;
+	int g_ret;
+
+	monitor_daemon = daemon;
+	udc_objects = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    g_free, g_object_unref);
+
+	/* create dbus udc objects */
+	for (l = gd_udcs; l != NULL; l = l->next)
+		gd_udc_export((usbg_udc *)(l->data));
+
+	if (config.udc.hotplug == 0)
+		return GD_SUCCESS;
+
+	g_ret = gd_udc_watch_uevents();
+	if (g_ret != GD_SUCCESS)
+		return g_ret;
+
+	/* catch udcs which appeared since gd_udcs was filled */
+	gd_udc_rescan();
+
+	return GD_SUCCESS;
+}
+
+static gboolean
+gd_udc_state_in_use(usbg_state *s)
+{
+	usbg_udc *u;
+
+	usbg_for_each_udc(u, s)
+		if (usbg_get_udc_gadget(u) != NULL)
+			return TRUE;
+
+	return FALSE;
+}
+
+void
+gd_udc_monitor_stop(void)
+{
+	GList *l, *next;
+
+	if (uevent_watch != 0)
+		g_source_remove(uevent_watch);
+	uevent_watch = 0;
+
+	if (uevent_fd >= 0)
+		close(uevent_fd);
+	uevent_fd = -1;
+
+	if (udc_objects != NULL)
+		g_hash_table_destroy(udc_objects);
+	udc_objects = NULL;
+
+	/* gadgets of ctx.state may be bound to udcs of other states,
+	   such states have to live as long as ctx.state does */
+	for (l = udc_states; l != NULL; l = next) {
+		next = l->next;
+		if (gd_udc_state_in_use(l->data))
+			continue;
+
+		usbg_cleanup((usbg_state *)l->data);
+		udc_states = g_list_delete_link(udc_states, l);
+	}
+}
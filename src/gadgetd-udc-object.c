@@ -28,6 +28,7 @@
 #include <gadgetd-gdbus-codegen.h>
 #include <gadgetd-common.h>
 #include <gadgetd-udc-iface.h>
+#include <gadgetd-udc-state.h>
 
 typedef struct _GadgetdUdcObjectClass   GadgetdUdcObjectClass;
 
@@ -38,6 +39,9 @@ struct _GadgetdUdcObject
 
 	gchar *enabled_gadget_path;
 	usbg_udc *u;
+
+	GadgetdUDCDevice *udc_iface;
+	struct gd_udc_state *state;
 };
 
 struct _GadgetdUdcObjectClass
@@ -167,6 +171,30 @@ gadgetd_udc_object_set_enabled_gadget_path(GadgetdUdcObject *object, const gchar
 	return GD_SUCCESS;
 }
 
+/**
+ * @brief Gets the connection state of udc
+ * @param[in] object GadgetdUdcObject
+ * @return state, NULL if it can't be watched
+ */
+struct gd_udc_state *
+gadgetd_udc_object_get_state(GadgetdUdcObject *object)
+{
+	g_return_val_if_fail(GADGETD_IS_UDC_OBJECT(object), NULL);
+	return object->state;
+}
+
+/**
+ * @brief called when connection state of udc has changed
+ * @param[in] user_data GadgetdUdcObject
+ */
+static void
+gadgetd_udc_object_state_changed(gpointer user_data)
+{
+	GadgetdUdcObject *udc_object = user_data;
+
+	gadgetd_udc_device_state_changed(udc_object->udc_iface);
+}
+
 /**
  * @brief gadgetd udc object init
  * @param[in] object GadgetdUdcObject
@@ -208,6 +236,13 @@ gadgetd_udc_object_constructed(GObject *object)
 	udc_iface = gadgetd_udc_device_new(udc_object);
 
 	get_iface(G_OBJECT(udc_object),GADGETD_TYPE_UDC_DEVICE, &udc_iface);
+	udc_object->udc_iface = udc_iface;
+
+	udc_object->state = gd_udc_state_watch(udc_name,
+					       gadgetd_udc_object_state_changed,
+					       udc_object);
+	if (udc_object->state == NULL)
+		ERROR("Unable to watch state of %s", udc_name);
 
 	if (path != NULL && g_variant_is_object_path(path) && udc_object != NULL)
 		g_dbus_object_skeleton_set_object_path(G_DBUS_OBJECT_SKELETON(udc_object), path);
@@ -228,6 +263,9 @@ gadgetd_udc_object_finalize(GObject *object)
 	GadgetdUdcObject *udc_object = GADGETD_UDC_OBJECT(object);
 
 	g_free(udc_object->enabled_gadget_path);
+	gd_udc_state_free(udc_object->state);
+	if (udc_object->udc_iface != NULL)
+		g_object_unref(udc_object->udc_iface);
 
 	if (G_OBJECT_CLASS(gadgetd_udc_object_parent_class)->finalize != NULL)
 		G_OBJECT_CLASS(gadgetd_udc_object_parent_class)->finalize(object);
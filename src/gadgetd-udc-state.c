@@ -0,0 +1,377 @@
+/*
+ * gadgetd-udc-state.c
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include <gadgetd-udc-state.h>
+#include <gadgetd-common.h>
+
+/* longest value is "unauthenticated" */
+#define GD_UDC_ATTR_LEN 32
+
+struct gd_udc_transition {
+	gint64 time;
+	gchar *state;
+	gchar *speed;
+};
+
+struct gd_udc_listener {
+	void (*changed)(gpointer user_data);
+	gpointer user_data;
+};
+
+struct gd_udc_state {
+	gchar *udc;
+	int fd;
+	guint watch;
+	gchar state[GD_UDC_ATTR_LEN];
+	gchar speed[GD_UDC_ATTR_LEN];
+	GQueue *log;
+	void (*changed)(gpointer user_data);
+	gpointer user_data;
+	/* list of struct gd_udc_listener */
+	GList *listeners;
+};
+
+/* all watched UDCs, so that state is read only once for each of them */
+static GList *gd_udc_states;
+
+static int
+gd_udc_read_fd(int fd, char *buf, size_t len)
+{
+	ssize_t n;
+
+	/* sysfs poll is armed again only by read from the beginning */
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		return gd_translate_error(errno);
+
+	n = read(fd, buf, len - 1);
+	if (n < 0)
+		return gd_translate_error(errno);
+
+	buf[n] = '\0';
+	if (n > 0 && buf[n - 1] == '\n')
+		buf[n - 1] = '\0';
+
+	return GD_SUCCESS;
+}
+
+int
+gd_udc_read_attr(const char *udc, const char *attr, char *buf, size_t len)
+{
+	char path[PATH_MAX];
+	int fd;
+	int ret;
+
+	ret = snprintf(path, sizeof(path), GD_UDC_CLASS_PATH "/%s/%s", udc, attr);
+	if (ret < 0 || (size_t)ret >= sizeof(path))
+		return GD_ERROR_PATH_TOO_LONG;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return gd_translate_error(errno);
+
+	ret = gd_udc_read_fd(fd, buf, len);
+	close(fd);
+
+	return ret;
+}
+
+int
+gd_udc_write_attr(const char *udc, const char *attr, const char *value)
+{
+	char path[PATH_MAX];
+	size_t len = strlen(value);
+	ssize_t n;
+	int fd;
+	int ret;
+
+	ret = snprintf(path, sizeof(path), GD_UDC_CLASS_PATH "/%s/%s", udc, attr);
+	if (ret < 0 || (size_t)ret >= sizeof(path))
+		return GD_ERROR_PATH_TOO_LONG;
+
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return gd_translate_error(errno);
+
+	n = write(fd, value, len);
+	ret = n < 0 ? gd_translate_error(errno) : GD_SUCCESS;
+	close(fd);
+
+	return ret;
+}
+
+enum gd_usb_speed
+gd_usb_speed_from_str(const char *speed)
+{
+	static const struct {
+		const char *name;
+		enum gd_usb_speed speed;
+	} speeds[] = {
+		{ "low-speed", GD_USB_SPEED_LOW },
+		{ "full-speed", GD_USB_SPEED_FULL },
+		{ "high-speed", GD_USB_SPEED_HIGH },
+		{ "wireless", GD_USB_SPEED_WIRELESS },
+		{ "super-speed", GD_USB_SPEED_SUPER },
+		{ "super-speed-plus", GD_USB_SPEED_SUPER_PLUS },
+	};
+	int i;
+
+	for (i = 0; i < G_N_ELEMENTS(speeds); ++i)
+		if (strcmp(speed, speeds[i].name) == 0)
+			return speeds[i].speed;
+
+	return GD_USB_SPEED_UNKNOWN;
+}
+
+static void
+gd_udc_transition_free(gpointer p)
+{
+	struct gd_udc_transition *t = p;
+
+	g_free(t->state);
+	g_free(t->speed);
+	g_free(t);
+}
+
+static void
+gd_udc_state_log(struct gd_udc_state *st, const char *state)
+{
+	struct gd_udc_transition *t;
+
+	t = g_malloc(sizeof(*t));
+	t->time = g_get_monotonic_time();
+	t->state = g_strdup(state);
+	t->speed = g_strdup(st->speed);
+	g_queue_push_tail(st->log, t);
+
+	if (g_queue_get_length(st->log) > GD_UDC_STATE_LOG_LEN)
+		gd_udc_transition_free(g_queue_pop_head(st->log));
+}
+
+static gboolean
+gd_udc_state_event(GIOChannel *channel, GIOCondition condition,
+		   gpointer user_data)
+{
+	struct gd_udc_state *st = user_data;
+	struct gd_udc_listener *listener;
+	char state[GD_UDC_ATTR_LEN];
+	char speed[GD_UDC_ATTR_LEN];
+	GList *l, *next;
+	int ret;
+
+	/* POLLERR together with POLLPRI is how sysfs reports change */
+	ret = gd_udc_read_fd(st->fd, state, sizeof(state));
+	if (ret != GD_SUCCESS) {
+		/* udc is gone, monitor removes its object */
+		st->watch = 0;
+		return FALSE;
+	}
+
+	if (gd_udc_read_attr(st->udc, "current_speed", speed, sizeof(speed))
+	    != GD_SUCCESS)
+		speed[0] = '\0';
+
+	/* several notifications may be merged into single wakeup */
+	if (strcmp(state, st->state) == 0 && strcmp(speed, st->speed) == 0)
+		return TRUE;
+
+	g_strlcpy(st->state, state, sizeof(st->state));
+	g_strlcpy(st->speed, speed, sizeof(st->speed));
+	gd_udc_state_log(st, st->state);
+
+	if (st->changed)
+		st->changed(st->user_data);
+
+	/* listener may remove itself */
+	for (l = st->listeners; l != NULL; l = next) {
+		next = l->next;
+		listener = l->data;
+		listener->changed(listener->user_data);
+	}
+
+	return TRUE;
+}
+
+struct gd_udc_state *
+gd_udc_state_watch(const char *udc, void (*changed)(gpointer user_data),
+		   gpointer user_data)
+{
+	struct gd_udc_state *st;
+	GIOChannel *channel;
+	char path[PATH_MAX];
+	int ret;
+
+	ret = snprintf(path, sizeof(path), GD_UDC_CLASS_PATH "/%s/state", udc);
+	if (ret < 0 || (size_t)ret >= sizeof(path))
+		return NULL;
+
+	st = g_malloc0(sizeof(*st));
+	st->udc = g_strdup(udc);
+	st->changed = changed;
+	st->user_data = user_data;
+	st->log = g_queue_new();
+
+	st->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (st->fd < 0) {
+		ERROR("Unable to open %s", path);
+		goto err;
+	}
+
+	/* initial read arms poll */
+	ret = gd_udc_read_fd(st->fd, st->state, sizeof(st->state));
+	if (ret != GD_SUCCESS) {
+		ERROR("Unable to read %s", path);
+		goto err;
+	}
+
+	if (gd_udc_read_attr(udc, "current_speed", st->speed, sizeof(st->speed))
+	    != GD_SUCCESS)
+		st->speed[0] = '\0';
+
+	gd_udc_state_log(st, st->state);
+
+	channel = g_io_channel_unix_new(st->fd);
+	st->watch = g_io_add_watch(channel, G_IO_PRI | G_IO_ERR,
+				   gd_udc_state_event, st);
+	g_io_channel_unref(channel);
+
+	gd_udc_states = g_list_append(gd_udc_states, st);
+
+	return st;
+err:
+	gd_udc_state_free(st);
+	return NULL;
+}
+
+void
+gd_udc_state_free(struct gd_udc_state *st)
+{
+	if (st == NULL)
+		return;
+
+	gd_udc_states = g_list_remove(gd_udc_states, st);
+	g_list_free_full(st->listeners, g_free);
+
+	if (st->watch != 0)
+		g_source_remove(st->watch);
+	if (st->fd >= 0)
+		close(st->fd);
+
+	g_queue_free_full(st->log, gd_udc_transition_free);
+	g_free(st->udc);
+	g_free(st);
+}
+
+struct gd_udc_state *
+gd_udc_state_lookup(const char *udc)
+{
+	struct gd_udc_state *st;
+	GList *l;
+
+	for (l = gd_udc_states; l != NULL; l = l->next) {
+		st = l->data;
+		if (strcmp(st->udc, udc) == 0)
+			return st;
+	}
+
+	return NULL;
+}
+
+void
+gd_udc_state_add_listener(struct gd_udc_state *st,
+			  void (*changed)(gpointer user_data),
+			  gpointer user_data)
+{
+	struct gd_udc_listener *listener;
+	GList *l;
+
+	for (l = st->listeners; l != NULL; l = l->next) {
+		listener = l->data;
+		if (listener->changed == changed
+		    && listener->user_data == user_data)
+			return;
+	}
+
+	listener = g_malloc(sizeof(*listener));
+	listener->changed = changed;
+	listener->user_data = user_data;
+	st->listeners = g_list_append(st->listeners, listener);
+}
+
+void
+gd_udc_state_remove_listener(void (*changed)(gpointer user_data),
+			     gpointer user_data)
+{
+	struct gd_udc_listener *listener;
+	struct gd_udc_state *st;
+	GList *l, *m, *next;
+
+	for (l = gd_udc_states; l != NULL; l = l->next) {
+		st = l->data;
+		for (m = st->listeners; m != NULL; m = next) {
+			next = m->next;
+			listener = m->data;
+			if (listener->changed != changed
+			    || listener->user_data != user_data)
+				continue;
+
+			st->listeners = g_list_delete_link(st->listeners, m);
+			g_free(listener);
+		}
+	}
+}
+
+const char *
+gd_udc_state_get_state(struct gd_udc_state *st)
+{
+	return st->state;
+}
+
+const char *
+gd_udc_state_get_speed(struct gd_udc_state *st)
+{
+	return st->speed;
+}
+
+void
+gd_udc_state_mark(struct gd_udc_state *st, const char *event)
+{
+	gd_udc_state_log(st, event);
+}
+
+GVariant *
+gd_udc_state_get_log(struct gd_udc_state *st)
+{
+	struct gd_udc_transition *t;
+	GVariantBuilder builder;
+	GList *l;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(xss)"));
+	for (l = st->log->head; l != NULL; l = l->next) {
+		t = l->data;
+		g_variant_builder_add(&builder, "(xss)", t->time, t->state,
+				      t->speed);
+	}
+
+	return g_variant_builder_end(&builder);
+}
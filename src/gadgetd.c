@@ -38,6 +38,7 @@
 /* default path for config file */
 #define CONFIG_FILE	 "/etc/gadgetd/gadgetd.config"
 #define CONFIGFS_MNT	 "/sys/kernel/config"
+#define FFS_MOUNT_ROOT	 "/tmp/gadgetd"
 
 struct gd_config config;
 struct gd_context ctx;
@@ -89,6 +90,15 @@ gd_free_config(struct gd_config *config)
 	free(config->cfg_strs);
 	free(config->gd_config_file_path);
 	free(config->configfs_mnt);
+	free(config->ffs_mount_root);
+	free(config->net.qdisc);
+	free(config->net.steering.rps_cpus);
+	free(config->net.steering.xps_cpus);
+	free(config->net.steering.irq_cpus);
+	free(config->serial.console);
+	free(config->udc.default_gadget);
+	free(config->udc.default_udc);
+	free(config->udc.connect_wait);
 }
 
 static int
@@ -111,6 +121,27 @@ init_config_attrs(struct gd_config *pconfig)
 
 	pconfig->gd_config_file_path = NULL;
 	pconfig->configfs_mnt = NULL;
+	pconfig->ffs_mount_root = NULL;
+	pconfig->net.qmult = -1;
+	pconfig->net.mtu = -1;
+	pconfig->net.txqueuelen = -1;
+	pconfig->net.gro = -1;
+	pconfig->net.gso = -1;
+	pconfig->net.qdisc = NULL;
+	pconfig->net.steering.rps_cpus = NULL;
+	pconfig->net.steering.xps_cpus = NULL;
+	pconfig->net.steering.rps_flow_cnt = -1;
+	pconfig->net.steering.irq_cpus = NULL;
+	pconfig->serial.raw = -1;
+	pconfig->serial.vmin = -1;
+	pconfig->serial.vtime = -1;
+	pconfig->serial.console = NULL;
+	pconfig->udc.hotplug = -1;
+	pconfig->udc.default_gadget = NULL;
+	pconfig->udc.default_udc = NULL;
+	pconfig->udc.bind_threads = -1;
+	pconfig->udc.connect_wait = NULL;
+	pconfig->udc.connect_timeout = -1;
 
 	return g_ret;
 }
@@ -135,6 +166,10 @@ gd_read_config(int argc, char * const argv[], struct gd_config *pconfig)
 		pconfig->configfs_mnt = strdup(CONFIGFS_MNT);
 	}
 
+	if (pconfig->ffs_mount_root == NULL){
+		pconfig->ffs_mount_root = strdup(FFS_MOUNT_ROOT);
+	}
+
 	return g_ret;
 }
 
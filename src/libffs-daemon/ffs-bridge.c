@@ -0,0 +1,481 @@
+/*
+ * ffs-bridge.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE /* for splice() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ffs-bridge.h"
+#include "ffs-daemon-internal.h"
+
+struct bridge {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int done;
+	int ret;
+};
+
+/* One direction of the bridge */
+struct pump {
+	int src;
+	int dst;
+	/* dst is IN endpoint */
+	int to_host;
+	/* src is OUT endpoint, so 0 means zero length packet */
+	int from_host;
+	const struct gd_bridge_config *cfg;
+	struct bridge *b;
+
+	uint64_t bytes;
+	int spliced;
+};
+
+struct copy_buf {
+	char *data;
+	/* number of bytes, 0 means end of file */
+	size_t len;
+	int full;
+};
+
+/* State shared by reader and writer of copy mode */
+struct copy_state {
+	struct pump *p;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct copy_buf bufs[2];
+	pthread_t writer;
+	int writer_running;
+};
+
+static void
+bridge_finish(struct bridge *b, int ret)
+{
+	pthread_mutex_lock(&b->lock);
+	if (!b->done) {
+		b->done = 1;
+		b->ret = ret;
+	}
+	pthread_cond_signal(&b->cond);
+	pthread_mutex_unlock(&b->lock);
+}
+
+static void
+unlock_mutex(void *lock)
+{
+	pthread_mutex_unlock(lock);
+}
+
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Host finishes transfer on short packet, so if chunk ends on
+ * packet boundary and there is nothing more to send it has to
+ * be terminated with zero length packet.
+ */
+static int
+send_zlp(struct pump *p, size_t len)
+{
+	const struct gd_bridge_config *cfg = p->cfg;
+	char dummy;
+	int ret;
+
+	if (!p->to_host || !(cfg->flags & GD_BRIDGE_ZLP) ||
+	    !cfg->max_packet || !len || len % cfg->max_packet ||
+	    len >= cfg->buf_len)
+		return 0;
+
+	do {
+		ret = write(p->dst, &dummy, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret < 0 ? -errno : 0;
+}
+
+static void *
+copy_writer(void *data)
+{
+	struct copy_state *s = data;
+	struct pump *p = s->p;
+	struct copy_buf *buf;
+	int i = 0;
+	int ret;
+
+	while (1) {
+		buf = &s->bufs[i];
+
+		pthread_mutex_lock(&s->lock);
+		pthread_cleanup_push(unlock_mutex, &s->lock);
+		while (!buf->full)
+			pthread_cond_wait(&s->cond, &s->lock);
+		pthread_cleanup_pop(1);
+
+		if (!buf->len) {
+			ret = 0;
+			break;
+		}
+
+		ret = write_all(p->dst, buf->data, buf->len);
+		if (ret == 0)
+			ret = send_zlp(p, buf->len);
+		if (ret < 0)
+			break;
+
+		p->bytes += buf->len;
+
+		pthread_mutex_lock(&s->lock);
+		buf->full = 0;
+		pthread_cond_signal(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+
+		i ^= 1;
+	}
+
+	bridge_finish(p->b, ret);
+	return NULL;
+}
+
+static void
+copy_cleanup(void *data)
+{
+	struct copy_state *s = data;
+
+	if (s->writer_running) {
+		pthread_cancel(s->writer);
+		pthread_join(s->writer, NULL);
+	}
+
+	free(s->bufs[0].data);
+	free(s->bufs[1].data);
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->lock);
+}
+
+/* Double buffered read/write, used when splice is not available */
+static int
+pump_copy(struct pump *p)
+{
+	struct copy_state s;
+	struct copy_buf *buf;
+	size_t buf_len = p->cfg->buf_len;
+	ssize_t len;
+	int i = 0;
+	int ret = 0;
+
+	memset(&s, 0, sizeof(s));
+	s.p = p;
+	pthread_mutex_init(&s.lock, NULL);
+	pthread_cond_init(&s.cond, NULL);
+
+	pthread_cleanup_push(copy_cleanup, &s);
+
+	s.bufs[0].data = malloc(buf_len);
+	s.bufs[1].data = malloc(buf_len);
+	if (!s.bufs[0].data || !s.bufs[1].data) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = pthread_create(&s.writer, NULL, copy_writer, &s);
+	if (ret) {
+		ret = -ret;
+		goto out;
+	}
+	s.writer_running = 1;
+
+	while (1) {
+		buf = &s.bufs[i];
+
+		pthread_mutex_lock(&s.lock);
+		pthread_cleanup_push(unlock_mutex, &s.lock);
+		while (buf->full)
+			pthread_cond_wait(&s.cond, &s.lock);
+		pthread_cleanup_pop(1);
+
+		len = read(p->src, buf->data, buf_len);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+
+		/* Zero length packet only terminates transfer */
+		if (len == 0 && p->from_host)
+			continue;
+
+		pthread_mutex_lock(&s.lock);
+		buf->len = len;
+		buf->full = 1;
+		pthread_cond_signal(&s.cond);
+		pthread_mutex_unlock(&s.lock);
+
+		/* Writer finishes the bridge after writing all data */
+		if (len == 0)
+			break;
+
+		i ^= 1;
+	}
+
+	if (ret == 0) {
+		pthread_join(s.writer, NULL);
+		s.writer_running = 0;
+	}
+
+out:
+	pthread_cleanup_pop(1);
+	return ret;
+}
+
+static void
+close_pipe(void *data)
+{
+	int *fds = data;
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+/*
+ * Moves data which has been spliced to pipe into dst. Returns 0 on
+ * success, 1 if dst does not support splice, in which case data left
+ * in pipe has been copied, or negative errno code.
+ */
+static int
+drain_pipe(struct pump *p, int pipe_rd, size_t len)
+{
+	char *buf;
+	ssize_t ret;
+	size_t left = len;
+
+	while (left > 0) {
+		ret = splice(pipe_rd, NULL, p->dst, NULL, left,
+			     SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EINVAL && errno != ENOSYS)
+				return -errno;
+			break;
+		}
+
+		left -= ret;
+	}
+
+	if (left == 0)
+		return send_zlp(p, len);
+
+	/*
+	 * dst does not support splice, eg. function fs endpoint, so copy
+	 * the rest at once to keep transfer boundary and let the caller
+	 * switch to copy mode.
+	 */
+	buf = malloc(left);
+	if (!buf)
+		return -ENOMEM;
+
+	pthread_cleanup_push(free, buf);
+	ret = read(pipe_rd, buf, left);
+	if (ret == (ssize_t)left)
+		ret = write_all(p->dst, buf, left);
+	else
+		ret = ret < 0 ? -errno : -EIO;
+	pthread_cleanup_pop(1);
+
+	if (ret == 0)
+		ret = send_zlp(p, len);
+
+	return ret < 0 ? ret : 1;
+}
+
+/*
+ * Returns 0 on end of file, 1 if splice is not supported by src
+ * or dst and data should be copied, or negative errno code.
+ */
+static int
+pump_splice(struct pump *p)
+{
+	int fds[2];
+	ssize_t len;
+	int ret = 0;
+
+	if (pipe2(fds, O_CLOEXEC) < 0)
+		return -errno;
+
+	/* Pipe limits amount of data moved at once */
+	fcntl(fds[1], F_SETPIPE_SZ, p->cfg->buf_len);
+
+	pthread_cleanup_push(close_pipe, fds);
+
+	while (1) {
+		len = splice(p->src, NULL, fds[1], NULL, p->cfg->buf_len,
+			     SPLICE_F_MOVE);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EINVAL || errno == ENOSYS)
+				ret = 1;
+			else
+				ret = -errno;
+			break;
+		}
+
+		if (len == 0) {
+			if (p->from_host)
+				continue;
+			break;
+		}
+
+		ret = drain_pipe(p, fds[0], len);
+		if (ret < 0)
+			break;
+
+		p->bytes += len;
+		if (ret == 1)
+			break;
+	}
+
+	pthread_cleanup_pop(1);
+
+	if (ret == 0)
+		p->spliced = 1;
+
+	return ret;
+}
+
+static void *
+pump_run(void *data)
+{
+	struct pump *p = data;
+	int ret = 1;
+
+	if (!(p->cfg->flags & GD_BRIDGE_NO_SPLICE))
+		ret = pump_splice(p);
+
+	if (ret == 1) {
+		p->spliced = 0;
+		ret = pump_copy(p);
+		/* In copy mode writer reports end of data */
+		if (ret == 0)
+			return NULL;
+	}
+
+	bridge_finish(p->b, ret);
+	return NULL;
+}
+
+_gd_export_ int
+gd_bridge_run(const struct gd_bridge_config *cfg,
+	      struct gd_bridge_stats *stats)
+{
+	struct bridge b;
+	struct pump pumps[2];
+	pthread_t threads[2];
+	int n = 0;
+	int i, ret;
+
+	if (!cfg || !cfg->buf_len ||
+	    (cfg->ep_in < 0 && cfg->ep_out < 0) ||
+	    (cfg->ep_in >= 0 && cfg->rd_fd < 0) ||
+	    (cfg->ep_out >= 0 && cfg->wr_fd < 0) ||
+	    ((cfg->flags & GD_BRIDGE_ZLP) && !cfg->max_packet))
+		return -EINVAL;
+
+	memset(&b, 0, sizeof(b));
+	memset(pumps, 0, sizeof(pumps));
+	pthread_mutex_init(&b.lock, NULL);
+	pthread_cond_init(&b.cond, NULL);
+
+	if (cfg->ep_in >= 0) {
+		pumps[n].src = cfg->rd_fd;
+		pumps[n].dst = cfg->ep_in;
+		pumps[n].to_host = 1;
+		pumps[n].cfg = cfg;
+		pumps[n].b = &b;
+		++n;
+	}
+
+	if (cfg->ep_out >= 0) {
+		pumps[n].src = cfg->ep_out;
+		pumps[n].dst = cfg->wr_fd;
+		pumps[n].from_host = 1;
+		pumps[n].cfg = cfg;
+		pumps[n].b = &b;
+		++n;
+	}
+
+	for (i = 0; i < n; ++i) {
+		ret = pthread_create(&threads[i], NULL, pump_run, &pumps[i]);
+		if (ret) {
+			bridge_finish(&b, -ret);
+			n = i;
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&b.lock);
+	while (!b.done)
+		pthread_cond_wait(&b.cond, &b.lock);
+	ret = b.ret;
+	pthread_mutex_unlock(&b.lock);
+
+	/* Other direction is usually blocked in read, so interrupt it */
+	for (i = 0; i < n; ++i) {
+		pthread_cancel(threads[i]);
+		pthread_join(threads[i], NULL);
+	}
+
+	if (stats) {
+		memset(stats, 0, sizeof(*stats));
+		for (i = 0; i < 2; ++i) {
+			if (pumps[i].to_host) {
+				stats->to_host = pumps[i].bytes;
+				stats->to_host_spliced = pumps[i].spliced;
+			} else if (pumps[i].from_host) {
+				stats->from_host = pumps[i].bytes;
+				stats->from_host_spliced = pumps[i].spliced;
+			}
+		}
+	}
+
+	pthread_cond_destroy(&b.cond);
+	pthread_mutex_destroy(&b.lock);
+
+	return ret;
+}
@@ -0,0 +1,249 @@
+/*
+ * ffs-buf-pool.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "ffs-buf-pool.h"
+#include "ffs-daemon-internal.h"
+
+#define BUF_POOL_CACHELINE	64
+#define BUF_POOL_HUGEPAGE	(2 * 1024 * 1024)
+#define BUF_POOL_NONE		UINT32_MAX
+
+#define ALIGN_UP(x, a)		(((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+struct gd_buf_pool {
+	char *region;
+	size_t region_len;
+	int locked;
+
+	size_t buf_len;
+	/* distance between starts of two consecutive buffers */
+	size_t stride;
+	unsigned n_bufs;
+
+	/* index of next free buffer for each buffer */
+	uint32_t *next;
+	/*
+	 * Top of free list. Lower half is index of first free buffer,
+	 * upper half is a tag incremented on each change to avoid ABA.
+	 */
+	uint64_t head;
+};
+
+static inline uint64_t
+make_head(uint64_t old, uint32_t idx)
+{
+	return (((old >> 32) + 1) << 32) | idx;
+}
+
+static void *
+map_region(size_t *len, int flags)
+{
+	void *region;
+	size_t huge_len;
+
+	if (flags & GD_BUF_POOL_HUGEPAGE) {
+		huge_len = ALIGN_UP(*len, BUF_POOL_HUGEPAGE);
+		region = mmap(NULL, huge_len, PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+			      -1, 0);
+		if (region != MAP_FAILED) {
+			*len = huge_len;
+			return region;
+		}
+	}
+
+	region = mmap(NULL, *len, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED)
+		return NULL;
+
+	/* No reserved huge pages, so ask for transparent ones */
+	if (flags & GD_BUF_POOL_HUGEPAGE)
+		madvise(region, *len, MADV_HUGEPAGE);
+
+	return region;
+}
+
+_gd_export_ struct gd_buf_pool *
+gd_buf_pool_new(size_t max_packet, unsigned packets, unsigned n_bufs,
+		int flags)
+{
+	struct gd_buf_pool *pool;
+	long page_size;
+	unsigned i;
+	int ret;
+
+	if (!max_packet || !packets || !n_bufs || n_bufs >= BUF_POOL_NONE) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		page_size = 4096;
+
+	pool->buf_len = max_packet * packets;
+	pool->n_bufs = n_bufs;
+	/* Large buffers start on page boundary which is preferred by
+	   most UDCs for DMA, small ones only avoid false sharing */
+	if (pool->buf_len >= page_size)
+		pool->stride = ALIGN_UP(pool->buf_len, page_size);
+	else
+		pool->stride = ALIGN_UP(pool->buf_len, BUF_POOL_CACHELINE);
+
+	pool->next = calloc(n_bufs, sizeof(*pool->next));
+	if (!pool->next) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	pool->region_len = ALIGN_UP(pool->stride * n_bufs, page_size);
+	pool->region = map_region(&pool->region_len, flags);
+	if (!pool->region) {
+		ret = -errno;
+		goto err_free;
+	}
+
+	if (flags & GD_BUF_POOL_MLOCK) {
+		ret = mlock(pool->region, pool->region_len);
+		if (ret < 0) {
+			ret = -errno;
+			goto err_unmap;
+		}
+		pool->locked = 1;
+	}
+
+	for (i = 0; i < n_bufs; ++i)
+		pool->next[i] = i + 1 < n_bufs ? i + 1 : BUF_POOL_NONE;
+	pool->head = 0;
+
+	return pool;
+
+err_unmap:
+	munmap(pool->region, pool->region_len);
+err_free:
+	free(pool->next);
+	free(pool);
+	errno = -ret;
+	return NULL;
+}
+
+_gd_export_ void
+gd_buf_pool_free(struct gd_buf_pool *pool)
+{
+	if (!pool)
+		return;
+
+	if (pool->locked)
+		munlock(pool->region, pool->region_len);
+	munmap(pool->region, pool->region_len);
+	free(pool->next);
+	free(pool);
+}
+
+_gd_export_ void *
+gd_buf_pool_get(struct gd_buf_pool *pool)
+{
+	uint64_t old, new;
+	uint32_t idx, next;
+
+	if (!pool)
+		return NULL;
+
+	old = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+	do {
+		idx = (uint32_t)old;
+		if (idx == BUF_POOL_NONE)
+			return NULL;
+
+		next = __atomic_load_n(&pool->next[idx], __ATOMIC_RELAXED);
+		new = make_head(old, next);
+	} while (!__atomic_compare_exchange_n(&pool->head, &old, new, 1,
+					      __ATOMIC_ACQ_REL,
+					      __ATOMIC_ACQUIRE));
+
+	return pool->region + (size_t)idx * pool->stride;
+}
+
+_gd_export_ void
+gd_buf_pool_put(struct gd_buf_pool *pool, void *buf)
+{
+	uint64_t old, new;
+	int idx;
+
+	idx = gd_buf_pool_index(pool, buf);
+	if (idx < 0)
+		return;
+
+	old = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(&pool->next[idx], (uint32_t)old,
+				 __ATOMIC_RELAXED);
+		new = make_head(old, idx);
+	} while (!__atomic_compare_exchange_n(&pool->head, &old, new, 1,
+					      __ATOMIC_RELEASE,
+					      __ATOMIC_RELAXED));
+}
+
+_gd_export_ size_t
+gd_buf_pool_buf_len(struct gd_buf_pool *pool)
+{
+	return pool ? pool->buf_len : 0;
+}
+
+_gd_export_ unsigned
+gd_buf_pool_size(struct gd_buf_pool *pool)
+{
+	return pool ? pool->n_bufs : 0;
+}
+
+_gd_export_ int
+gd_buf_pool_index(struct gd_buf_pool *pool, const void *buf)
+{
+	size_t offset;
+
+	if (!pool || (const char *)buf < pool->region)
+		return -EINVAL;
+
+	offset = (const char *)buf - pool->region;
+	if (offset % pool->stride || offset / pool->stride >= pool->n_bufs)
+		return -EINVAL;
+
+	return offset / pool->stride;
+}
+
+_gd_export_ void *
+gd_buf_pool_region(struct gd_buf_pool *pool, size_t *len)
+{
+	if (!pool)
+		return NULL;
+
+	if (len)
+		*len = pool->region_len;
+
+	return pool->region;
+}
@@ -0,0 +1,33 @@
+/*
+ * ffs-daemon-internal.h
+ * Copyright (c) 2012-2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FFS_DAEMON_INTERNAL_H
+#define FFS_DAEMON_INTERNAL_H
+
+#if (__GNUC__ >= 4)
+#  ifdef GD_EXPORT_SYMBOLS
+/* Export symbols */
+#    define _gd_export_ __attribute__ ((visibility("default")))
+#  else
+/* Don't export the symbols */
+#    define _gd_export_ __attribute__ ((visibility("hidden")))
+#  endif
+#else
+#  define _gd_export_
+#endif
+
+#endif /* FFS_DAEMON_INTERNAL_H */
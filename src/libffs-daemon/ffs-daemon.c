@@ -17,24 +17,99 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <endian.h>
 #include <unistd.h>
 #include <fcntl.h>
 
 #include "ffs-daemon.h"
+#include "ffs-daemon-internal.h"
 
-#if (__GNUC__ >= 4)
-#  ifdef GD_EXPORT_SYMBOLS
-/* Export symbols */
-#    define _gd_export_ __attribute__ ((visibility("default")))
-#  else
-/* Don't export the symbols */
-#    define _gd_export_ __attribute__ ((visibility("hidden")))
-#  endif
-#else
-#  define _gd_export_
+/* Older kernel headers may not define endpoint ioctls */
+#ifndef FUNCTIONFS_ENDPOINT_REVMAP
+#define FUNCTIONFS_ENDPOINT_REVMAP	_IO('g', 129)
+#endif
+
+#ifndef FUNCTIONFS_ENDPOINT_DESC
+#define FUNCTIONFS_ENDPOINT_DESC	_IOR('g', 130, \
+					     struct usb_endpoint_descriptor)
 #endif
 
+struct ep_desc_cache {
+	struct usb_endpoint_descriptor desc;
+	/* real address of endpoint or negative errno code */
+	int address;
+	int valid;
+};
+
+/* Passed after endpoints if FUNCTIONFS_EVENTFD has been requested */
+static int ffs_eventfd = -ENOENT;
+
+/* Descriptors of passed endpoints, index 0 is ep0 */
+static struct ep_desc_cache *ep_descs;
+static int ep_descs_nmb;
+
+static int
+query_ep_desc(int ep_fd, struct ep_desc_cache *cache)
+{
+	int ret;
+
+	/* Fails with ENODEV until function is enabled by host */
+	ret = ioctl(ep_fd, FUNCTIONFS_ENDPOINT_DESC, &cache->desc);
+	if (ret < 0)
+		return -errno;
+
+	ret = ioctl(ep_fd, FUNCTIONFS_ENDPOINT_REVMAP);
+	cache->address = ret < 0 ? -errno : ret;
+	cache->valid = 1;
+
+	return 0;
+}
+
+static void
+fill_ep_descs(int n)
+{
+	int i;
+
+	free(ep_descs);
+	ep_descs_nmb = 0;
+
+	ep_descs = calloc(n, sizeof(*ep_descs));
+	if (!ep_descs)
+		return;
+
+	ep_descs_nmb = n;
+	/* ep0 has no descriptor */
+	for (i = 1; i < n; ++i)
+		query_ep_desc(GD_ENDPOINT_FDS_START + i, ep_descs + i);
+}
+
+/* Returns descriptor of endpoint, from cache if possible */
+static int
+get_ep_desc(int ep_fd, struct ep_desc_cache *out)
+{
+	int idx = ep_fd - GD_ENDPOINT_FDS_START;
+	int ret;
+
+	if (ep_fd < 0)
+		return -EBADF;
+
+	if (idx <= 0 || idx >= ep_descs_nmb || !ep_descs)
+		return query_ep_desc(ep_fd, out);
+
+	if (!ep_descs[idx].valid) {
+		ret = query_ep_desc(ep_fd, ep_descs + idx);
+		if (ret < 0)
+			return ret;
+	}
+
+	*out = ep_descs[idx];
+	return 0;
+}
+
 _gd_export_ int
 gd_nmb_of_ep(int unset_environment)
 {
@@ -113,10 +188,20 @@ gd_nmb_of_ep(int unset_environment)
 
         r = (int) val;
 
+        /* Last descriptor is not an endpoint */
+        env = getenv("FFS_EVENTFD");
+        if (env && strcmp(env, "1") == 0 && r > 1) {
+                ffs_eventfd = GD_ENDPOINT_FDS_START + r - 1;
+                --r;
+        }
+
+        fill_ep_descs(r);
+
 finish:
         if (unset_environment) {
                 unsetenv("LISTEN_PID");
                 unsetenv("LISTEN_FDS");
+                unsetenv("FFS_EVENTFD");
         }
 
         return r;
@@ -128,17 +213,86 @@ finish:
 _gd_export_ int
 gd_get_ep_type(int ep_fd)
 {
-	// how to do this?
-	/* Waiting for kernel extension */
-	return 0;
+	struct gd_ep_desc desc;
+	int ret;
+
+	ret = gd_get_ep_desc(ep_fd, &desc);
+	return ret < 0 ? ret : desc.type;
 }
 
 _gd_export_ int
 gd_get_ep_nmb(int ep_fd)
 {
-	/* Currently it's a hack. Kernel ffs will be extended
-	   with ioctls for endpoints */
-	return ep_fd - GD_ENDPOINT_FDS_START;
+	struct ep_desc_cache cache;
+	int ret;
+
+	if (ep_fd == GD_ENDPOINT_FDS_START)
+		return 0;
+
+	/* Address in descriptor is numbered as in function fs */
+	ret = get_ep_desc(ep_fd, &cache);
+	if (ret < 0)
+		return ret;
+
+	return cache.desc.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK;
+}
+
+_gd_export_ int
+gd_get_ep_desc(int ep_fd, struct gd_ep_desc *desc)
+{
+	struct ep_desc_cache cache;
+	int max_packet;
+	int ret;
+
+	if (!desc)
+		return -EINVAL;
+
+	if (ep_fd == GD_ENDPOINT_FDS_START) {
+		memset(desc, 0, sizeof(*desc));
+		desc->type = USB_ENDPOINT_XFER_CONTROL;
+		return 0;
+	}
+
+	ret = get_ep_desc(ep_fd, &cache);
+	if (ret < 0)
+		return ret;
+
+	max_packet = le16toh(cache.desc.wMaxPacketSize);
+
+	desc->address = cache.address;
+	desc->nmb = cache.desc.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK;
+	desc->direction = cache.desc.bEndpointAddress & USB_ENDPOINT_DIR_MASK;
+	desc->type = cache.desc.bmAttributes & USB_ENDPOINT_XFERTYPE_MASK;
+	desc->max_packet = max_packet & 0x7ff;
+	/* additional transactions per microframe of high speed endpoints */
+	desc->mult = ((max_packet >> 11) & 0x3) + 1;
+	desc->interval = cache.desc.bInterval;
+
+	return 0;
+}
+
+_gd_export_ int
+gd_update_ep_descs(void)
+{
+	int i, ret;
+
+	if (!ep_descs)
+		return -EINVAL;
+
+	for (i = 1; i < ep_descs_nmb; ++i) {
+		ep_descs[i].valid = 0;
+		ret = query_ep_desc(GD_ENDPOINT_FDS_START + i, ep_descs + i);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+_gd_export_ int
+gd_get_ffs_eventfd(void)
+{
+	return ffs_eventfd;
 }
 
 _gd_export_ enum usb_functionfs_event_type
@@ -177,3 +331,23 @@ finish:
 	return e;
 }
 
+
+_gd_export_ int
+gd_lock_memory(int unset_environment)
+{
+	const char *env;
+	int r = 0;
+
+	env = getenv("MLOCKALL");
+	if (!env || strcmp(env, "1") != 0)
+		goto finish;
+
+	r = mlockall(MCL_CURRENT | MCL_FUTURE);
+	r = r < 0 ? -errno : 1;
+
+finish:
+	if (unset_environment)
+		unsetenv("MLOCKALL");
+
+	return r;
+}
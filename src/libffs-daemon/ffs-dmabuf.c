@@ -0,0 +1,336 @@
+/*
+ * ffs-dmabuf.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE /* for memfd_create() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-heap.h>
+#include <linux/sync_file.h>
+#include <linux/udmabuf.h>
+#include <linux/usb/functionfs.h>
+
+#include "ffs-dmabuf.h"
+#include "ffs-daemon-internal.h"
+
+/* Function fs DMA-buf interface, missing in older kernel headers */
+#ifndef FUNCTIONFS_DMABUF_ATTACH
+struct usb_ffs_dmabuf_transfer_req {
+	int fd;
+	__u32 flags;
+	__u64 length;
+} __attribute__((packed));
+
+#define FUNCTIONFS_DMABUF_ATTACH	_IOW('g', 131, int)
+#define FUNCTIONFS_DMABUF_DETACH	_IOW('g', 132, int)
+#define FUNCTIONFS_DMABUF_TRANSFER	_IOW('g', 133, \
+					     struct usb_ffs_dmabuf_transfer_req)
+#endif
+
+#ifndef DMA_BUF_IOCTL_EXPORT_SYNC_FILE
+struct dma_buf_export_sync_file {
+	__u32 flags;
+	__s32 fd;
+};
+
+#define DMA_BUF_IOCTL_EXPORT_SYNC_FILE	_IOWR(DMA_BUF_BASE, 2, \
+					      struct dma_buf_export_sync_file)
+#endif
+
+#define DMA_HEAP_SYSTEM		"/dev/dma_heap/system"
+#define UDMABUF_DEV		"/dev/udmabuf"
+
+struct gd_dmabuf {
+	int fd;
+	void *data;
+	size_t len;
+};
+
+static int
+alloc_heap(size_t len)
+{
+	struct dma_heap_allocation_data data;
+	int heap, ret;
+
+	heap = open(DMA_HEAP_SYSTEM, O_RDONLY | O_CLOEXEC);
+	if (heap < 0)
+		return -errno;
+
+	memset(&data, 0, sizeof(data));
+	data.len = len;
+	data.fd_flags = O_RDWR | O_CLOEXEC;
+
+	ret = ioctl(heap, DMA_HEAP_IOCTL_ALLOC, &data);
+	ret = ret < 0 ? -errno : (int)data.fd;
+
+	close(heap);
+	return ret;
+}
+
+static int
+alloc_udmabuf(size_t len)
+{
+	struct udmabuf_create create;
+	int dev, memfd, ret;
+
+	memfd = memfd_create("gd-dmabuf", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (memfd < 0)
+		return -errno;
+
+	/* udmabuf requires that the memfd cannot shrink */
+	if (ftruncate(memfd, len) < 0 ||
+	    fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	dev = open(UDMABUF_DEV, O_RDWR | O_CLOEXEC);
+	if (dev < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	memset(&create, 0, sizeof(create));
+	create.memfd = memfd;
+	create.flags = UDMABUF_FLAGS_CLOEXEC;
+	create.size = len;
+
+	ret = ioctl(dev, UDMABUF_CREATE, &create);
+	if (ret < 0)
+		ret = -errno;
+
+	close(dev);
+out:
+	/* DMA-buf keeps reference to memory */
+	close(memfd);
+	return ret;
+}
+
+_gd_export_ struct gd_dmabuf *
+gd_dmabuf_new(size_t len, enum gd_dmabuf_source src)
+{
+	struct gd_dmabuf *buf;
+	long page_size;
+	int ret;
+
+	if (!len) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	buf = calloc(1, sizeof(*buf));
+	if (!buf)
+		return NULL;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		page_size = 4096;
+	buf->len = (len + page_size - 1) & ~((size_t)page_size - 1);
+
+	switch (src) {
+	case GD_DMABUF_HEAP:
+		ret = alloc_heap(buf->len);
+		break;
+	case GD_DMABUF_UDMABUF:
+		ret = alloc_udmabuf(buf->len);
+		break;
+	default:
+		ret = alloc_heap(buf->len);
+		if (ret < 0)
+			ret = alloc_udmabuf(buf->len);
+		break;
+	}
+
+	if (ret < 0)
+		goto err_free;
+	buf->fd = ret;
+
+	buf->data = mmap(NULL, buf->len, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 buf->fd, 0);
+	if (buf->data == MAP_FAILED) {
+		ret = -errno;
+		goto err_close;
+	}
+
+	return buf;
+
+err_close:
+	close(buf->fd);
+err_free:
+	free(buf);
+	errno = -ret;
+	return NULL;
+}
+
+_gd_export_ void
+gd_dmabuf_free(struct gd_dmabuf *buf)
+{
+	if (!buf)
+		return;
+
+	munmap(buf->data, buf->len);
+	close(buf->fd);
+	free(buf);
+}
+
+_gd_export_ int
+gd_dmabuf_fd(struct gd_dmabuf *buf)
+{
+	return buf ? buf->fd : -EINVAL;
+}
+
+_gd_export_ void *
+gd_dmabuf_data(struct gd_dmabuf *buf)
+{
+	return buf ? buf->data : NULL;
+}
+
+_gd_export_ size_t
+gd_dmabuf_len(struct gd_dmabuf *buf)
+{
+	return buf ? buf->len : 0;
+}
+
+static int
+cpu_sync(struct gd_dmabuf *buf, __u64 flags)
+{
+	struct dma_buf_sync sync;
+	int ret;
+
+	if (!buf)
+		return -EINVAL;
+
+	sync.flags = flags;
+	do {
+		ret = ioctl(buf->fd, DMA_BUF_IOCTL_SYNC, &sync);
+	} while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+
+	return ret < 0 ? -errno : 0;
+}
+
+_gd_export_ int
+gd_dmabuf_cpu_begin(struct gd_dmabuf *buf, int write)
+{
+	return cpu_sync(buf, DMA_BUF_SYNC_START |
+			(write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ));
+}
+
+_gd_export_ int
+gd_dmabuf_cpu_end(struct gd_dmabuf *buf, int write)
+{
+	return cpu_sync(buf, DMA_BUF_SYNC_END |
+			(write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ));
+}
+
+_gd_export_ int
+gd_dmabuf_attach(int ep_fd, struct gd_dmabuf *buf)
+{
+	int ret;
+
+	if (!buf)
+		return -EINVAL;
+
+	ret = ioctl(ep_fd, FUNCTIONFS_DMABUF_ATTACH, &buf->fd);
+	if (ret == 0)
+		return 0;
+
+	/* Unknown ioctl, kernel does not support DMA-buf */
+	if (errno == ENOTTY || errno == EOPNOTSUPP)
+		return -ENOTSUP;
+
+	return -errno;
+}
+
+_gd_export_ int
+gd_dmabuf_detach(int ep_fd, struct gd_dmabuf *buf)
+{
+	if (!buf)
+		return -EINVAL;
+
+	return ioctl(ep_fd, FUNCTIONFS_DMABUF_DETACH, &buf->fd) < 0 ?
+		-errno : 0;
+}
+
+_gd_export_ int
+gd_dmabuf_transfer(int ep_fd, struct gd_dmabuf *buf, size_t len)
+{
+	struct usb_ffs_dmabuf_transfer_req req;
+	struct dma_buf_export_sync_file fence;
+
+	if (!buf || len > buf->len)
+		return -EINVAL;
+
+	memset(&req, 0, sizeof(req));
+	req.fd = buf->fd;
+	req.length = len;
+
+	if (ioctl(ep_fd, FUNCTIONFS_DMABUF_TRANSFER, &req) < 0)
+		return -errno;
+
+	/* Writer has to wait for all fences, including the one just added */
+	memset(&fence, 0, sizeof(fence));
+	fence.flags = DMA_BUF_SYNC_WRITE;
+	fence.fd = -1;
+
+	if (ioctl(buf->fd, DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &fence) < 0)
+		return -errno;
+
+	return fence.fd;
+}
+
+_gd_export_ int
+gd_dmabuf_fence_status(int fence_fd)
+{
+	struct sync_file_info info;
+
+	memset(&info, 0, sizeof(info));
+	if (ioctl(fence_fd, SYNC_IOC_FILE_INFO, &info) < 0)
+		return -errno;
+
+	return info.status;
+}
+
+_gd_export_ int
+gd_dmabuf_fence_wait(int fence_fd, int timeout)
+{
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = fence_fd;
+	pfd.events = POLLIN;
+
+	do {
+		ret = poll(&pfd, 1, timeout);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		return -errno;
+	if (ret == 0)
+		return -ETIME;
+
+	ret = gd_dmabuf_fence_status(fence_fd);
+	return ret < 0 ? ret : 0;
+}
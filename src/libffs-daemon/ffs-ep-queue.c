@@ -0,0 +1,785 @@
+/*
+ * ffs-ep-queue.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <liburing.h>
+
+#include "ffs-ep-queue.h"
+#include "ffs-buf-pool.h"
+#include "ffs-dmabuf.h"
+#include "ffs-daemon-internal.h"
+
+#define EP_QUEUE_ALIGN		4096
+/* how long gd_ep_queue_free() waits for each cancelled request, in ms */
+#define EP_QUEUE_CANCEL_TIMEOUT	1000
+
+struct ep_request {
+	struct gd_ep_request req;
+	int in_flight;
+
+	/* DMA-buf mode only */
+	struct gd_dmabuf *dmabuf;
+	/* fence of transfer in flight */
+	int fence_fd;
+	/* buffer is owned by CPU, between transfers */
+	int cpu_access;
+};
+
+struct ep_queue_ep {
+	int fd;
+	enum gd_ep_direction direction;
+	unsigned depth;
+	size_t buf_len;
+	/* transfers are done with attached DMA-bufs */
+	int dmabuf;
+	struct ep_request *reqs;
+};
+
+struct gd_ep_queue {
+	struct io_uring ring;
+	int n_eps;
+	struct ep_queue_ep *eps;
+
+	/* one registered buffer which holds data of all requests */
+	void *buffers;
+	size_t buffers_len;
+	/* if set, buffers belong to this pool and are not freed here */
+	struct gd_buf_pool *pool;
+
+	int in_flight;
+	int event_fd;
+	int stop;
+
+	gd_ep_complete_fn complete;
+	void *user_data;
+};
+
+static struct io_uring_sqe *
+get_sqe(struct gd_ep_queue *q)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(&q->ring);
+	if (!sqe) {
+		/* Submission queue is full so flush it and try again */
+		io_uring_submit(&q->ring);
+		sqe = io_uring_get_sqe(&q->ring);
+	}
+
+	return sqe;
+}
+
+/*
+ * Transfer is queued by ioctl and its fence is polled by the ring,
+ * so completions of both modes are delivered in the same way.
+ */
+static int
+queue_dmabuf_request(struct gd_ep_queue *q, struct ep_request *r,
+		     struct io_uring_sqe *sqe)
+{
+	struct ep_queue_ep *ep = &q->eps[r->req.ep];
+	int fence;
+
+	if (r->req.buf != gd_dmabuf_data(r->dmabuf)) {
+		fence = -EINVAL;
+		goto err;
+	}
+
+	if (r->cpu_access) {
+		fence = gd_dmabuf_cpu_end(r->dmabuf,
+					  ep->direction == GD_EP_IN);
+		if (fence < 0)
+			goto err;
+		r->cpu_access = 0;
+	}
+
+	fence = gd_dmabuf_transfer(ep->fd, r->dmabuf, r->req.length);
+	if (fence < 0)
+		goto err;
+
+	io_uring_prep_poll_add(sqe, fence, POLLIN);
+	io_uring_sqe_set_data(sqe, r);
+
+	r->fence_fd = fence;
+	r->in_flight = 1;
+	++(q->in_flight);
+
+	return 0;
+
+err:
+	/* sqe has been taken already */
+	io_uring_prep_nop(sqe);
+	io_uring_sqe_set_data(sqe, NULL);
+	return fence;
+}
+
+static void
+complete_dmabuf_request(struct gd_ep_queue *q, struct ep_request *r,
+			int res)
+{
+	struct ep_queue_ep *ep = &q->eps[r->req.ep];
+	int status;
+
+	status = res < 0 ? res : gd_dmabuf_fence_status(r->fence_fd);
+	close(r->fence_fd);
+	r->fence_fd = -1;
+
+	/* Only IN endpoints use DMA-bufs, they send whole request */
+	if (status < 0)
+		r->req.result = status;
+	else if (status == 0)
+		r->req.result = -EIO;
+	else
+		r->req.result = r->req.length;
+
+	if (gd_dmabuf_cpu_begin(r->dmabuf, ep->direction == GD_EP_IN) == 0)
+		r->cpu_access = 1;
+}
+
+static int
+queue_request(struct gd_ep_queue *q, struct ep_request *r)
+{
+	struct ep_queue_ep *ep = &q->eps[r->req.ep];
+	struct io_uring_sqe *sqe;
+
+	if (r->in_flight)
+		return -EBUSY;
+
+	if (r->req.length > ep->buf_len)
+		return -EINVAL;
+
+	/* Buffer may have been exchanged, it must stay in registered area */
+	if (q->pool && gd_buf_pool_index(q->pool, r->req.buf) < 0)
+		return -EINVAL;
+
+	sqe = get_sqe(q);
+	if (!sqe)
+		return -EAGAIN;
+
+	if (ep->dmabuf)
+		return queue_dmabuf_request(q, r, sqe);
+
+	/* Endpoint index is also index of registered file
+	   and all requests use registered buffer 0 */
+	if (ep->direction == GD_EP_IN)
+		io_uring_prep_write_fixed(sqe, r->req.ep, r->req.buf,
+					  r->req.length, 0, 0);
+	else
+		io_uring_prep_read_fixed(sqe, r->req.ep, r->req.buf,
+					 r->req.length, 0, 0);
+
+	sqe->flags |= IOSQE_FIXED_FILE;
+	io_uring_sqe_set_data(sqe, r);
+
+	r->in_flight = 1;
+	++(q->in_flight);
+
+	return 0;
+}
+
+static int
+process_completions(struct gd_ep_queue *q)
+{
+	struct io_uring_cqe *cqe;
+	struct ep_request *r;
+	int n = 0;
+	int ret;
+
+	while (io_uring_peek_cqe(&q->ring, &cqe) == 0) {
+		r = io_uring_cqe_get_data(cqe);
+		/* Cancel requests have no data attached */
+		if (!r) {
+			io_uring_cqe_seen(&q->ring, cqe);
+			continue;
+		}
+
+		if (q->eps[r->req.ep].dmabuf)
+			complete_dmabuf_request(q, r, cqe->res);
+		else
+			r->req.result = cqe->res;
+		r->in_flight = 0;
+		--(q->in_flight);
+		io_uring_cqe_seen(&q->ring, cqe);
+		++n;
+
+		ret = q->complete(q, &r->req, q->user_data);
+		if (ret < 0) {
+			q->stop = 1;
+			return ret;
+		}
+
+		if (ret == GD_EP_REQ_REQUEUE) {
+			ret = queue_request(q, r);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	return n;
+}
+
+static void
+free_dmabufs(struct ep_queue_ep *ep)
+{
+	struct ep_request *r;
+	unsigned j;
+
+	for (j = 0; j < ep->depth; ++j) {
+		r = &ep->reqs[j];
+		if (!r->dmabuf)
+			continue;
+
+		if (r->fence_fd >= 0)
+			close(r->fence_fd);
+		gd_dmabuf_detach(ep->fd, r->dmabuf);
+		gd_dmabuf_free(r->dmabuf);
+		r->dmabuf = NULL;
+		r->req.buf = NULL;
+	}
+
+	ep->dmabuf = 0;
+}
+
+/*
+ * Gives each request its own DMA-buf attached to endpoint.
+ * On failure endpoint is left in ordinary mode.
+ */
+static int
+setup_dmabufs(struct gd_ep_queue *q, int i)
+{
+	struct ep_queue_ep *ep = &q->eps[i];
+	struct ep_request *r;
+	unsigned j;
+	int ret;
+
+	ep->dmabuf = 1;
+	for (j = 0; j < ep->depth; ++j) {
+		r = &ep->reqs[j];
+
+		r->dmabuf = gd_dmabuf_new(ep->buf_len, GD_DMABUF_ANY);
+		if (!r->dmabuf) {
+			ret = -errno;
+			goto err;
+		}
+
+		ret = gd_dmabuf_attach(ep->fd, r->dmabuf);
+		if (ret < 0) {
+			gd_dmabuf_free(r->dmabuf);
+			r->dmabuf = NULL;
+			goto err;
+		}
+
+		ret = gd_dmabuf_cpu_begin(r->dmabuf, ep->direction == GD_EP_IN);
+		r->cpu_access = ret == 0;
+
+		r->req.ep = i;
+		r->req.buf = gd_dmabuf_data(r->dmabuf);
+		r->req.length = ep->buf_len;
+	}
+
+	return 0;
+
+err:
+	free_dmabufs(ep);
+	return ret;
+}
+
+static void
+free_queue(struct gd_ep_queue *q)
+{
+	int i;
+	unsigned j;
+
+	if (q->eps) {
+		for (i = 0; i < q->n_eps; ++i) {
+			if (q->eps[i].dmabuf)
+				free_dmabufs(&q->eps[i]);
+			/* Kernel may still use buffer of request in flight */
+			if (q->pool && q->eps[i].reqs)
+				for (j = 0; j < q->eps[i].depth; ++j)
+					if (!q->eps[i].reqs[j].in_flight)
+						gd_buf_pool_put(q->pool,
+							q->eps[i].reqs[j].req.buf);
+			free(q->eps[i].reqs);
+		}
+	}
+	free(q->eps);
+	if (!q->pool && !q->in_flight)
+		free(q->buffers);
+	free(q);
+}
+
+static struct gd_ep_queue *
+alloc_queue(const struct gd_ep_queue_config *eps, int n_eps,
+	    gd_ep_complete_fn complete, void *user_data)
+{
+	struct gd_ep_queue *q;
+	unsigned j;
+	int i;
+
+	if (!eps || n_eps <= 0 || !complete) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	for (i = 0; i < n_eps; ++i) {
+		if (!eps[i].depth || !eps[i].buf_len) {
+			errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	q = calloc(1, sizeof(*q));
+	if (!q)
+		return NULL;
+
+	q->event_fd = -1;
+	q->complete = complete;
+	q->user_data = user_data;
+	q->n_eps = n_eps;
+
+	q->eps = calloc(n_eps, sizeof(*q->eps));
+	if (!q->eps)
+		goto err;
+
+	for (i = 0; i < n_eps; ++i) {
+		q->eps[i].fd = eps[i].fd;
+		q->eps[i].direction = eps[i].direction;
+		q->eps[i].depth = eps[i].depth;
+		q->eps[i].buf_len = eps[i].buf_len;
+
+		q->eps[i].reqs = calloc(eps[i].depth,
+					sizeof(*q->eps[i].reqs));
+		if (!q->eps[i].reqs)
+			goto err;
+
+		for (j = 0; j < eps[i].depth; ++j)
+			q->eps[i].reqs[j].fence_fd = -1;
+	}
+
+	return q;
+
+err:
+	free_queue(q);
+	errno = ENOMEM;
+	return NULL;
+}
+
+/* Sets up the ring when all request buffers are already assigned */
+static int
+setup_ring(struct gd_ep_queue *q, const struct gd_ep_queue_config *eps)
+{
+	struct iovec iov;
+	unsigned entries = 0;
+	int *fds;
+	int i, ret;
+
+	fds = calloc(q->n_eps, sizeof(*fds));
+	if (!fds)
+		return -ENOMEM;
+
+	for (i = 0; i < q->n_eps; ++i) {
+		fds[i] = eps[i].fd;
+		entries += eps[i].depth;
+	}
+
+	/* room for cancel requests of each endpoint */
+	ret = io_uring_queue_init(entries + q->n_eps, &q->ring, 0);
+	if (ret < 0)
+		goto out;
+
+	/* There is nothing to register if all endpoints use DMA-bufs */
+	if (q->buffers_len) {
+		iov.iov_base = q->buffers;
+		iov.iov_len = q->buffers_len;
+		ret = io_uring_register_buffers(&q->ring, &iov, 1);
+		if (ret < 0)
+			goto err_ring;
+	}
+
+	ret = io_uring_register_files(&q->ring, fds, q->n_eps);
+	if (ret < 0)
+		goto err_ring;
+
+	q->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (q->event_fd < 0) {
+		ret = -errno;
+		goto err_ring;
+	}
+
+	ret = io_uring_register_eventfd(&q->ring, q->event_fd);
+	if (ret < 0)
+		goto err_eventfd;
+
+	ret = 0;
+	goto out;
+
+err_eventfd:
+	close(q->event_fd);
+err_ring:
+	io_uring_queue_exit(&q->ring);
+out:
+	free(fds);
+	return ret;
+}
+
+_gd_export_ struct gd_ep_queue *
+gd_ep_queue_new(const struct gd_ep_queue_config *eps, int n_eps,
+		gd_ep_complete_fn complete, void *user_data)
+{
+	struct gd_ep_queue *q;
+	size_t stride;
+	char *pos;
+	int i, ret;
+	unsigned j;
+
+	q = alloc_queue(eps, n_eps, complete, user_data);
+	if (!q)
+		return NULL;
+
+	/*
+	 * Endpoints which cannot use DMA-bufs silently use the ring. Fence
+	 * does not tell length of short OUT transfer, so only IN endpoints
+	 * use DMA-bufs.
+	 */
+	for (i = 0; i < n_eps; ++i)
+		if ((eps[i].flags & GD_EP_QUEUE_DMABUF) &&
+		    eps[i].direction == GD_EP_IN)
+			setup_dmabufs(q, i);
+
+	/* keep each buffer aligned, some UDCs require this for DMA */
+	for (i = 0; i < n_eps; ++i)
+		if (!q->eps[i].dmabuf)
+			q->buffers_len += eps[i].depth *
+				((eps[i].buf_len + EP_QUEUE_ALIGN - 1) &
+				 ~(size_t)(EP_QUEUE_ALIGN - 1));
+
+	if (q->buffers_len) {
+		ret = posix_memalign(&q->buffers, EP_QUEUE_ALIGN,
+				     q->buffers_len);
+		if (ret) {
+			q->buffers = NULL;
+			ret = -ret;
+			goto err_free;
+		}
+	}
+
+	pos = q->buffers;
+	for (i = 0; i < n_eps; ++i) {
+		if (q->eps[i].dmabuf)
+			continue;
+
+		stride = (q->eps[i].buf_len + EP_QUEUE_ALIGN - 1) &
+			~(size_t)(EP_QUEUE_ALIGN - 1);
+
+		for (j = 0; j < q->eps[i].depth; ++j) {
+			q->eps[i].reqs[j].req.ep = i;
+			q->eps[i].reqs[j].req.buf = pos;
+			q->eps[i].reqs[j].req.length = q->eps[i].buf_len;
+			pos += stride;
+		}
+	}
+
+	ret = setup_ring(q, eps);
+	if (ret < 0)
+		goto err_free;
+
+	return q;
+
+err_free:
+	free_queue(q);
+	errno = -ret;
+	return NULL;
+}
+
+_gd_export_ struct gd_ep_queue *
+gd_ep_queue_new_with_pool(const struct gd_ep_queue_config *eps, int n_eps,
+			  struct gd_buf_pool *pool,
+			  gd_ep_complete_fn complete, void *user_data)
+{
+	struct gd_ep_queue *q;
+	void *buf;
+	int i, ret;
+	unsigned j;
+
+	if (!pool) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	for (i = 0; eps && i < n_eps; ++i) {
+		if (eps[i].buf_len > gd_buf_pool_buf_len(pool)) {
+			errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	q = alloc_queue(eps, n_eps, complete, user_data);
+	if (!q)
+		return NULL;
+
+	q->pool = pool;
+	q->buffers = gd_buf_pool_region(pool, &q->buffers_len);
+
+	for (i = 0; i < n_eps; ++i) {
+		for (j = 0; j < q->eps[i].depth; ++j) {
+			buf = gd_buf_pool_get(pool);
+			if (!buf) {
+				ret = -ENOBUFS;
+				goto err_free;
+			}
+
+			q->eps[i].reqs[j].req.ep = i;
+			q->eps[i].reqs[j].req.buf = buf;
+			q->eps[i].reqs[j].req.length = q->eps[i].buf_len;
+		}
+	}
+
+	ret = setup_ring(q, eps);
+	if (ret < 0)
+		goto err_free;
+
+	return q;
+
+err_free:
+	free_queue(q);
+	errno = -ret;
+	return NULL;
+}
+
+/*
+ * Read or write blocked in function fs endpoint is not cancelled until
+ * endpoint is disabled, so wait only for limited time. Requests which
+ * are still in flight afterwards keep their buffers.
+ */
+static void
+wait_cancelled(struct gd_ep_queue *q)
+{
+	struct __kernel_timespec ts;
+	struct io_uring_cqe *cqe;
+	struct ep_request *r;
+
+	while (q->in_flight > 0) {
+		ts.tv_sec = EP_QUEUE_CANCEL_TIMEOUT / 1000;
+		ts.tv_nsec = (EP_QUEUE_CANCEL_TIMEOUT % 1000) * 1000000;
+		if (io_uring_wait_cqe_timeout(&q->ring, &cqe, &ts) < 0)
+			break;
+
+		r = io_uring_cqe_get_data(cqe);
+		if (r) {
+			r->in_flight = 0;
+			--(q->in_flight);
+		}
+		io_uring_cqe_seen(&q->ring, cqe);
+	}
+}
+
+_gd_export_ void
+gd_ep_queue_free(struct gd_ep_queue *q)
+{
+	if (!q)
+		return;
+
+	/* Kernel may still write to buffers so wait for all requests */
+	if (q->in_flight) {
+		gd_ep_queue_cancel(q, -1);
+		wait_cancelled(q);
+	}
+
+	io_uring_queue_exit(&q->ring);
+	close(q->event_fd);
+
+	free_queue(q);
+}
+
+_gd_export_ struct gd_ep_request *
+gd_ep_queue_request(struct gd_ep_queue *q, int ep, unsigned i)
+{
+	if (!q || ep < 0 || ep >= q->n_eps || i >= q->eps[ep].depth)
+		return NULL;
+
+	return &q->eps[ep].reqs[i].req;
+}
+
+_gd_export_ int
+gd_ep_queue_start(struct gd_ep_queue *q, int ep)
+{
+	int first, last;
+	unsigned j;
+	int i, ret;
+
+	if (!q || ep >= q->n_eps)
+		return -EINVAL;
+
+	first = ep < 0 ? 0 : ep;
+	last = ep < 0 ? q->n_eps - 1 : ep;
+
+	for (i = first; i <= last; ++i) {
+		for (j = 0; j < q->eps[i].depth; ++j) {
+			if (q->eps[i].reqs[j].in_flight)
+				continue;
+
+			ret = queue_request(q, &q->eps[i].reqs[j]);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	ret = io_uring_submit(&q->ring);
+	return ret < 0 ? ret : 0;
+}
+
+_gd_export_ int
+gd_ep_queue_submit(struct gd_ep_queue *q, struct gd_ep_request *req)
+{
+	struct ep_request *r = (struct ep_request *)req;
+	int ret;
+
+	if (!q || !req || req->ep < 0 || req->ep >= q->n_eps)
+		return -EINVAL;
+
+	ret = queue_request(q, r);
+	if (ret < 0)
+		return ret;
+
+	ret = io_uring_submit(&q->ring);
+	return ret < 0 ? ret : 0;
+}
+
+/*
+ * Detaching DMA-buf dequeues its transfers and signals their fences,
+ * then buffer is attached again for next transfers.
+ */
+static void
+cancel_dmabufs(struct ep_queue_ep *ep)
+{
+	struct ep_request *r;
+	unsigned j;
+
+	for (j = 0; j < ep->depth; ++j) {
+		r = &ep->reqs[j];
+		if (!r->in_flight)
+			continue;
+
+		gd_dmabuf_detach(ep->fd, r->dmabuf);
+		gd_dmabuf_attach(ep->fd, r->dmabuf);
+	}
+}
+
+_gd_export_ int
+gd_ep_queue_cancel(struct gd_ep_queue *q, int ep)
+{
+	struct io_uring_sqe *sqe;
+	int first, last;
+	int i, ret;
+
+	if (!q || ep >= q->n_eps)
+		return -EINVAL;
+
+	first = ep < 0 ? 0 : ep;
+	last = ep < 0 ? q->n_eps - 1 : ep;
+
+	for (i = first; i <= last; ++i) {
+		if (q->eps[i].dmabuf) {
+			cancel_dmabufs(&q->eps[i]);
+			continue;
+		}
+
+		sqe = get_sqe(q);
+		if (!sqe)
+			return -EAGAIN;
+
+		io_uring_prep_cancel_fd(sqe, i, IORING_ASYNC_CANCEL_ALL |
+					IORING_ASYNC_CANCEL_FD_FIXED);
+		io_uring_sqe_set_data(sqe, NULL);
+	}
+
+	ret = io_uring_submit(&q->ring);
+	return ret < 0 ? ret : 0;
+}
+
+_gd_export_ int
+gd_ep_queue_in_flight(struct gd_ep_queue *q)
+{
+	return q ? q->in_flight : -EINVAL;
+}
+
+_gd_export_ int
+gd_ep_queue_run(struct gd_ep_queue *q)
+{
+	int ret;
+
+	if (!q)
+		return -EINVAL;
+
+	q->stop = 0;
+	while (!q->stop) {
+		/* Requeued requests are submitted together with waiting */
+		ret = io_uring_submit_and_wait(&q->ring, 1);
+		if (ret < 0 && ret != -EINTR)
+			return ret;
+
+		ret = process_completions(q);
+		if (ret < 0)
+			return ret;
+	}
+
+	ret = io_uring_submit(&q->ring);
+	return ret < 0 ? ret : 0;
+}
+
+_gd_export_ void
+gd_ep_queue_stop(struct gd_ep_queue *q)
+{
+	if (q)
+		q->stop = 1;
+}
+
+_gd_export_ int
+gd_ep_queue_fd(struct gd_ep_queue *q)
+{
+	return q ? q->event_fd : -EINVAL;
+}
+
+_gd_export_ int
+gd_ep_queue_dispatch(struct gd_ep_queue *q)
+{
+	uint64_t cnt;
+	int n, ret;
+
+	if (!q)
+		return -EINVAL;
+
+	/* Just clear the counter, completions are taken from the ring */
+	ret = read(q->event_fd, &cnt, sizeof(cnt));
+	if (ret < 0 && errno != EAGAIN)
+		return -errno;
+
+	n = process_completions(q);
+	if (n < 0)
+		return n;
+
+	ret = io_uring_submit(&q->ring);
+	return ret < 0 ? ret : n;
+}
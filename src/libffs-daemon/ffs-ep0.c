@@ -0,0 +1,523 @@
+/*
+ * ffs-ep0.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <endian.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "ffs-ep0.h"
+#include "ffs-daemon-internal.h"
+
+/* Function fs does not queue more events than this */
+#define EP0_EVENTS_BATCH	8
+#define EP0_EPOLL_BATCH		8
+/* Largest possible wLength */
+#define EP0_BUF_LEN		65535
+
+#define EP0_NMB_EVENTS		(FUNCTIONFS_RESUME + 1)
+
+struct setup_handler {
+	uint8_t bRequestType;
+	uint8_t bRequest;
+	gd_ep0_setup_fn fn;
+	void *user_data;
+	/* used instead of fn if fn is NULL */
+	void *reply;
+	size_t reply_len;
+	struct setup_handler *next;
+};
+
+struct watched_fd {
+	int fd;
+	gd_ep0_fd_fn fn;
+	void *user_data;
+	int removed;
+	struct watched_fd *next;
+};
+
+struct event_handler {
+	gd_ep0_event_fn fn;
+	void *user_data;
+};
+
+struct gd_ep0 {
+	int ep0;
+	int epoll_fd;
+	int stop;
+
+	struct event_handler events[EP0_NMB_EVENTS];
+	/* handlers hashed by bRequest */
+	struct setup_handler *setup[256];
+	struct watched_fd *fds;
+	/* removed during dispatch, freed when it is finished */
+	struct watched_fd *removed;
+
+	/* data stage buffer */
+	char *buf;
+};
+
+static struct setup_handler *
+find_setup_handler(struct gd_ep0 *e, uint8_t bRequestType, uint8_t bRequest,
+		   struct setup_handler ***prev)
+{
+	struct setup_handler **h;
+
+	for (h = &e->setup[bRequest]; *h; h = &(*h)->next) {
+		if ((*h)->bRequestType == bRequestType) {
+			if (prev)
+				*prev = h;
+			return *h;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+free_setup_handler(struct setup_handler *h)
+{
+	free(h->reply);
+	free(h);
+}
+
+static struct setup_handler *
+new_setup_handler(struct gd_ep0 *e, uint8_t bRequestType, uint8_t bRequest)
+{
+	struct setup_handler *h;
+
+	if (find_setup_handler(e, bRequestType, bRequest, NULL)) {
+		errno = EEXIST;
+		return NULL;
+	}
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return NULL;
+
+	h->bRequestType = bRequestType;
+	h->bRequest = bRequest;
+	h->next = e->setup[bRequest];
+	e->setup[bRequest] = h;
+
+	return h;
+}
+
+/*
+ * Function fs stalls control request when data stage is done
+ * in wrong direction.
+ */
+static void
+stall(struct gd_ep0 *e, const struct usb_ctrlrequest *setup)
+{
+	int ret;
+
+	if (setup->bRequestType & USB_DIR_IN)
+		ret = read(e->ep0, NULL, 0);
+	else
+		ret = write(e->ep0, NULL, 0);
+
+	(void)ret;
+}
+
+static int
+handle_setup(struct gd_ep0 *e, const struct usb_ctrlrequest *setup)
+{
+	struct setup_handler *h;
+	size_t len = le16toh(setup->wLength);
+	int in = setup->bRequestType & USB_DIR_IN;
+	ssize_t ret;
+
+	h = find_setup_handler(e, setup->bRequestType, setup->bRequest, NULL);
+	if (!h) {
+		stall(e, setup);
+		return 0;
+	}
+
+	if (!h->fn) {
+		/* Static reply, nothing to compute */
+		if (!in) {
+			stall(e, setup);
+			return 0;
+		}
+
+		ret = write(e->ep0, h->reply,
+			    h->reply_len < len ? h->reply_len : len);
+		return ret < 0 ? -errno : 0;
+	}
+
+	if (in) {
+		ret = h->fn(e, setup, e->buf, len, h->user_data);
+		if (ret < 0) {
+			stall(e, setup);
+			return 0;
+		}
+
+		ret = write(e->ep0, e->buf, (size_t)ret < len ? ret : len);
+		return ret < 0 ? -errno : 0;
+	}
+
+	if (len == 0) {
+		ret = h->fn(e, setup, e->buf, 0, h->user_data);
+		if (ret < 0) {
+			stall(e, setup);
+			return 0;
+		}
+
+		/* Acknowledge with status stage */
+		ret = read(e->ep0, NULL, 0);
+		return ret < 0 ? -errno : 0;
+	}
+
+	/* Data stage of OUT request has to be done before handler */
+	ret = read(e->ep0, e->buf, len);
+	if (ret < 0)
+		return -errno;
+
+	h->fn(e, setup, e->buf, ret, h->user_data);
+	return 0;
+}
+
+static void
+free_removed(struct gd_ep0 *e)
+{
+	struct watched_fd *w, *next;
+
+	for (w = e->removed; w; w = next) {
+		next = w->next;
+		free(w);
+	}
+	e->removed = NULL;
+}
+
+static int
+handle_ep0(struct gd_ep0 *e)
+{
+	struct usb_functionfs_event events[EP0_EVENTS_BATCH];
+	struct event_handler *h;
+	ssize_t ret;
+	int i, n;
+
+	/* All pending events are returned by single read */
+	ret = read(e->ep0, events, sizeof(events));
+	if (ret < 0)
+		return errno == EAGAIN || errno == EINTR ? 0 : -errno;
+
+	n = ret / sizeof(events[0]);
+	for (i = 0; i < n; ++i) {
+		if (events[i].type == FUNCTIONFS_SETUP) {
+			/* Setup is always the last event in batch */
+			ret = handle_setup(e, &events[i].u.setup);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
+
+		if (events[i].type >= EP0_NMB_EVENTS)
+			continue;
+
+		h = &e->events[events[i].type];
+		if (h->fn)
+			h->fn(e, events[i].type, h->user_data);
+	}
+
+	return 0;
+}
+
+_gd_export_ struct gd_ep0 *
+gd_ep0_new(int ep0_fd)
+{
+	struct gd_ep0 *e;
+	struct epoll_event ev;
+	int ret;
+
+	if (ep0_fd < 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return NULL;
+
+	e->ep0 = ep0_fd;
+
+	e->buf = malloc(EP0_BUF_LEN);
+	if (!e->buf) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	e->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (e->epoll_fd < 0) {
+		ret = -errno;
+		goto err_free;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	/* ep0 is recognized by NULL */
+	ev.data.ptr = NULL;
+	if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, ep0_fd, &ev) < 0) {
+		ret = -errno;
+		goto err_epoll;
+	}
+
+	return e;
+
+err_epoll:
+	close(e->epoll_fd);
+err_free:
+	free(e->buf);
+	free(e);
+	errno = -ret;
+	return NULL;
+}
+
+_gd_export_ void
+gd_ep0_free(struct gd_ep0 *e)
+{
+	struct setup_handler *h, *next;
+	struct watched_fd *w, *wnext;
+	int i;
+
+	if (!e)
+		return;
+
+	for (i = 0; i < 256; ++i) {
+		for (h = e->setup[i]; h; h = next) {
+			next = h->next;
+			free_setup_handler(h);
+		}
+	}
+
+	for (w = e->fds; w; w = wnext) {
+		wnext = w->next;
+		free(w);
+	}
+	free_removed(e);
+
+	close(e->epoll_fd);
+	free(e->buf);
+	free(e);
+}
+
+_gd_export_ int
+gd_ep0_set_event_handler(struct gd_ep0 *e,
+			 enum usb_functionfs_event_type type,
+			 gd_ep0_event_fn fn, void *user_data)
+{
+	if (!e || type >= EP0_NMB_EVENTS || type == FUNCTIONFS_SETUP)
+		return -EINVAL;
+
+	e->events[type].fn = fn;
+	e->events[type].user_data = user_data;
+
+	return 0;
+}
+
+_gd_export_ int
+gd_ep0_add_setup_handler(struct gd_ep0 *e, uint8_t bRequestType,
+			 uint8_t bRequest, gd_ep0_setup_fn fn,
+			 void *user_data)
+{
+	struct setup_handler *h;
+
+	if (!e || !fn)
+		return -EINVAL;
+
+	h = new_setup_handler(e, bRequestType, bRequest);
+	if (!h)
+		return -errno;
+
+	h->fn = fn;
+	h->user_data = user_data;
+
+	return 0;
+}
+
+_gd_export_ int
+gd_ep0_add_static_reply(struct gd_ep0 *e, uint8_t bRequestType,
+			uint8_t bRequest, const void *data, size_t len)
+{
+	struct setup_handler *h;
+	void *reply = NULL;
+
+	if (!e || !(bRequestType & USB_DIR_IN) || len > EP0_BUF_LEN ||
+	    (len && !data))
+		return -EINVAL;
+
+	if (len) {
+		reply = malloc(len);
+		if (!reply)
+			return -ENOMEM;
+		memcpy(reply, data, len);
+	}
+
+	h = new_setup_handler(e, bRequestType, bRequest);
+	if (!h) {
+		free(reply);
+		return -errno;
+	}
+
+	h->reply = reply;
+	h->reply_len = len;
+
+	return 0;
+}
+
+_gd_export_ int
+gd_ep0_remove_setup_handler(struct gd_ep0 *e, uint8_t bRequestType,
+			    uint8_t bRequest)
+{
+	struct setup_handler *h, **prev;
+
+	if (!e)
+		return -EINVAL;
+
+	h = find_setup_handler(e, bRequestType, bRequest, &prev);
+	if (!h)
+		return -ENOENT;
+
+	*prev = h->next;
+	free_setup_handler(h);
+
+	return 0;
+}
+
+_gd_export_ int
+gd_ep0_add_fd(struct gd_ep0 *e, int fd, uint32_t events,
+	      gd_ep0_fd_fn fn, void *user_data)
+{
+	struct watched_fd *w;
+	struct epoll_event ev;
+
+	if (!e || fd < 0 || fd == e->ep0 || !fn)
+		return -EINVAL;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+
+	w->fd = fd;
+	w->fn = fn;
+	w->user_data = user_data;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.ptr = w;
+	if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		free(w);
+		return -errno;
+	}
+
+	w->next = e->fds;
+	e->fds = w;
+
+	return 0;
+}
+
+_gd_export_ int
+gd_ep0_remove_fd(struct gd_ep0 *e, int fd)
+{
+	struct watched_fd **w, *tmp;
+
+	if (!e)
+		return -EINVAL;
+
+	for (w = &e->fds; *w; w = &(*w)->next) {
+		if ((*w)->fd != fd)
+			continue;
+
+		epoll_ctl(e->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		tmp = *w;
+		*w = tmp->next;
+		/* Its event may still wait in current batch */
+		tmp->removed = 1;
+		tmp->next = e->removed;
+		e->removed = tmp;
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+static int
+dispatch(struct gd_ep0 *e, int timeout)
+{
+	struct epoll_event evs[EP0_EPOLL_BATCH];
+	struct watched_fd *w;
+	int i, n;
+	int ret = 0;
+
+	n = epoll_wait(e->epoll_fd, evs, EP0_EPOLL_BATCH, timeout);
+	if (n < 0)
+		return errno == EINTR ? 0 : -errno;
+
+	for (i = 0; i < n; ++i) {
+		w = evs[i].data.ptr;
+		if (!w)
+			ret = handle_ep0(e);
+		else if (!w->removed)
+			ret = w->fn(e, w->fd, evs[i].events, w->user_data);
+
+		if (ret < 0)
+			break;
+	}
+
+	free_removed(e);
+	return ret;
+}
+
+_gd_export_ int
+gd_ep0_run(struct gd_ep0 *e)
+{
+	int ret;
+
+	if (!e)
+		return -EINVAL;
+
+	e->stop = 0;
+	while (!e->stop) {
+		ret = dispatch(e, -1);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+_gd_export_ void
+gd_ep0_stop(struct gd_ep0 *e)
+{
+	if (e)
+		e->stop = 1;
+}
+
+_gd_export_ int
+gd_ep0_fd(struct gd_ep0 *e)
+{
+	return e ? e->epoll_fd : -EINVAL;
+}
+
+_gd_export_ int
+gd_ep0_dispatch(struct gd_ep0 *e)
+{
+	return e ? dispatch(e, 0) : -EINVAL;
+}
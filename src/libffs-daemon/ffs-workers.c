@@ -0,0 +1,608 @@
+/*
+ * ffs-workers.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE /* for CPU_SET() and pthread_attr_setaffinity_np() */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "ffs-workers.h"
+#include "ffs-buf-pool.h"
+#include "cpu-list.h"
+#include "ffs-daemon-internal.h"
+
+#define WORKERS_CACHELINE	64
+#define WORKERS_QUEUE_LEN	64
+
+/*
+ * Single producer single consumer ring. Indexes run freely
+ * and are masked on access, each is written by one side only.
+ */
+struct spsc_ring {
+	struct gd_worker_msg *slots;
+	unsigned mask;
+
+	/* written by consumer */
+	unsigned head __attribute__((aligned(WORKERS_CACHELINE)));
+	/* written by producer */
+	unsigned tail __attribute__((aligned(WORKERS_CACHELINE)));
+};
+
+struct worker {
+	struct gd_workers *w;
+	int idx;
+	int fd;
+	enum gd_worker_direction direction;
+	size_t xfer_len;
+	cpu_set_t cpus;
+	int pinned;
+
+	pthread_t thread;
+	int started;
+
+	struct spsc_ring ring;
+	/* signalled to application */
+	int app_fd;
+	/* signalled to worker when it waits */
+	int wake_fd;
+	int waiting;
+
+	int paused;
+	/* buffer held by worker, returned to pool on cancel */
+	void *cur;
+
+	struct gd_worker_stats stats;
+};
+
+struct gd_workers {
+	struct gd_buf_pool *pool;
+	int n_eps;
+	struct worker *eps;
+};
+
+/* Returns number of messages in ring after push or -EAGAIN if full */
+static int
+ring_push(struct spsc_ring *r, const struct gd_worker_msg *msg)
+{
+	unsigned head, tail;
+
+	tail = r->tail;
+	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	if (tail - head > r->mask)
+		return -EAGAIN;
+
+	r->slots[tail & r->mask] = *msg;
+	__atomic_store_n(&r->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+	/* Reread head, so that draining consumer is noticed */
+	head = __atomic_load_n(&r->head, __ATOMIC_SEQ_CST);
+	return tail + 1 - head;
+}
+
+/* Returns number of messages in ring before pop or -EAGAIN if empty */
+static int
+ring_pop(struct spsc_ring *r, struct gd_worker_msg *msg)
+{
+	unsigned head, tail;
+
+	head = r->head;
+	tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	if (head == tail)
+		return -EAGAIN;
+
+	*msg = r->slots[head & r->mask];
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_SEQ_CST);
+
+	tail = __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST);
+	return tail - head;
+}
+
+static int
+ring_empty(struct spsc_ring *r)
+{
+	return __atomic_load_n(&r->head, __ATOMIC_SEQ_CST) ==
+		__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST);
+}
+
+static int
+ring_full(struct spsc_ring *r)
+{
+	return __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) -
+		__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) > r->mask;
+}
+
+static void
+signal_fd(int fd)
+{
+	uint64_t one = 1;
+	ssize_t ret;
+
+	ret = write(fd, &one, sizeof(one));
+	(void)ret;
+}
+
+static void
+clear_fd(int fd)
+{
+	uint64_t cnt;
+	ssize_t ret;
+
+	ret = read(fd, &cnt, sizeof(cnt));
+	(void)ret;
+}
+
+static void
+wake_worker(struct worker *wk)
+{
+	if (__atomic_load_n(&wk->waiting, __ATOMIC_SEQ_CST))
+		signal_fd(wk->wake_fd);
+}
+
+/*
+ * Sleeps until ready() is true or worker is woken up. Flag is set
+ * before ready() is checked, so that wake up cannot be missed.
+ */
+static void
+worker_wait(struct worker *wk, int (*ready)(struct worker *))
+{
+	__atomic_store_n(&wk->waiting, 1, __ATOMIC_SEQ_CST);
+	if (!ready(wk))
+		clear_fd(wk->wake_fd);
+	__atomic_store_n(&wk->waiting, 0, __ATOMIC_SEQ_CST);
+}
+
+static int
+is_resumed(struct worker *wk)
+{
+	return !__atomic_load_n(&wk->paused, __ATOMIC_SEQ_CST);
+}
+
+static int
+has_buffer(struct worker *wk)
+{
+	wk->cur = gd_buf_pool_get(wk->w->pool);
+	return wk->cur != NULL;
+}
+
+static int
+has_room(struct worker *wk)
+{
+	return !ring_full(&wk->ring);
+}
+
+static int
+has_data(struct worker *wk)
+{
+	return !ring_empty(&wk->ring);
+}
+
+static void
+put_cur(void *data)
+{
+	struct worker *wk = data;
+
+	if (wk->cur)
+		gd_buf_pool_put(wk->w->pool, wk->cur);
+	wk->cur = NULL;
+}
+
+static void
+count_transfer(struct worker *wk, ssize_t ret)
+{
+	if (ret < 0) {
+		__atomic_add_fetch(&wk->stats.errors, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&wk->stats.last_error, ret, __ATOMIC_RELAXED);
+		__atomic_store_n(&wk->paused, 1, __ATOMIC_SEQ_CST);
+	} else {
+		__atomic_add_fetch(&wk->stats.bytes, ret, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&wk->stats.transfers, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void
+out_loop(struct worker *wk)
+{
+	struct gd_worker_msg msg;
+	size_t len;
+	ssize_t ret;
+
+	len = wk->xfer_len;
+	if (!len || len > gd_buf_pool_buf_len(wk->w->pool))
+		len = gd_buf_pool_buf_len(wk->w->pool);
+
+	for (;;) {
+		if (!is_resumed(wk)) {
+			worker_wait(wk, is_resumed);
+			continue;
+		}
+
+		if (!wk->cur && !has_buffer(wk)) {
+			worker_wait(wk, has_buffer);
+			continue;
+		}
+
+		ret = read(wk->fd, wk->cur, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0) {
+			ret = -errno;
+			put_cur(wk);
+			msg.buf = NULL;
+			msg.len = 0;
+			msg.error = ret;
+		} else {
+			msg.buf = wk->cur;
+			msg.len = ret;
+			msg.error = 0;
+		}
+		count_transfer(wk, ret);
+
+		/* Buffer stays in cur until queued, so cancel returns it */
+		while ((ret = ring_push(&wk->ring, &msg)) < 0)
+			worker_wait(wk, has_room);
+		wk->cur = NULL;
+
+		/* Application has drained the queue, so it may wait */
+		if (ret == 1)
+			signal_fd(wk->app_fd);
+	}
+}
+
+static void
+in_loop(struct worker *wk)
+{
+	struct gd_worker_msg msg;
+	ssize_t ret;
+
+	for (;;) {
+		if (!is_resumed(wk)) {
+			worker_wait(wk, is_resumed);
+			continue;
+		}
+
+		ret = ring_pop(&wk->ring, &msg);
+		if (ret < 0) {
+			worker_wait(wk, has_data);
+			continue;
+		}
+
+		wk->cur = msg.buf;
+
+		/* Queue was full, so application may wait for room */
+		if (ret > wk->ring.mask)
+			signal_fd(wk->app_fd);
+
+		do {
+			ret = write(wk->fd, msg.buf, msg.len);
+		} while (ret < 0 && errno == EINTR);
+
+		count_transfer(wk, ret < 0 ? -errno : ret);
+
+		/* Release may be cancelled, buffer must not be put twice */
+		wk->cur = NULL;
+		gd_workers_release(wk->w, msg.buf);
+	}
+}
+
+static void *
+worker_thread(void *data)
+{
+	struct worker *wk = data;
+
+	pthread_cleanup_push(put_cur, wk);
+	if (wk->direction == GD_WORKER_OUT)
+		out_loop(wk);
+	else
+		in_loop(wk);
+	pthread_cleanup_pop(1);
+
+	return NULL;
+}
+
+static int
+start_worker(struct worker *wk)
+{
+	pthread_attr_t attr;
+	char name[16];
+	int ret;
+
+	ret = pthread_attr_init(&attr);
+	if (ret)
+		return -ret;
+
+	if (wk->pinned) {
+		ret = pthread_attr_setaffinity_np(&attr, sizeof(wk->cpus),
+						  &wk->cpus);
+		if (ret)
+			goto out;
+	}
+
+	ret = pthread_create(&wk->thread, &attr, worker_thread, wk);
+	if (ret)
+		goto out;
+
+	wk->started = 1;
+	snprintf(name, sizeof(name), "gd-ep%d-%s", wk->idx,
+		 wk->direction == GD_WORKER_IN ? "in" : "out");
+	pthread_setname_np(wk->thread, name);
+
+out:
+	pthread_attr_destroy(&attr);
+	return -ret;
+}
+
+static void
+stop_worker(struct gd_workers *w, struct worker *wk)
+{
+	struct gd_worker_msg msg;
+
+	if (wk->started) {
+		/* Worker may block on endpoint, so it has to be cancelled */
+		pthread_cancel(wk->thread);
+		pthread_join(wk->thread, NULL);
+		wk->started = 0;
+	}
+
+	if (wk->ring.slots)
+		while (ring_pop(&wk->ring, &msg) >= 0)
+			if (msg.buf)
+				gd_buf_pool_put(w->pool, msg.buf);
+
+	free(wk->ring.slots);
+	if (wk->app_fd >= 0)
+		close(wk->app_fd);
+	if (wk->wake_fd >= 0)
+		close(wk->wake_fd);
+}
+
+static int
+init_worker(struct gd_workers *w, int i, const struct gd_worker_config *cfg)
+{
+	struct worker *wk = &w->eps[i];
+	unsigned len;
+	int ret;
+
+	wk->w = w;
+	wk->idx = i;
+	wk->fd = cfg->fd;
+	wk->direction = cfg->direction;
+	wk->xfer_len = cfg->xfer_len;
+
+	if (cfg->cpus) {
+		ret = cpu_list_parse(cfg->cpus, &wk->cpus);
+		if (ret < 0)
+			return ret;
+		wk->pinned = 1;
+	}
+
+	len = cfg->queue_len ? cfg->queue_len : WORKERS_QUEUE_LEN;
+	if (len > 1U << 30)
+		return -EINVAL;
+	for (wk->ring.mask = 1; wk->ring.mask < len; wk->ring.mask <<= 1)
+		;
+
+	wk->ring.slots = calloc(wk->ring.mask, sizeof(*wk->ring.slots));
+	if (!wk->ring.slots)
+		return -ENOMEM;
+	--(wk->ring.mask);
+
+	wk->app_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (wk->app_fd < 0)
+		return -errno;
+
+	wk->wake_fd = eventfd(0, EFD_CLOEXEC);
+	if (wk->wake_fd < 0)
+		return -errno;
+
+	return 0;
+}
+
+_gd_export_ struct gd_workers *
+gd_workers_new(const struct gd_worker_config *eps, int n_eps,
+	       struct gd_buf_pool *pool)
+{
+	struct gd_workers *w;
+	int i, ret;
+
+	if (!eps || n_eps <= 0 || !pool) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	w->pool = pool;
+	w->n_eps = n_eps;
+
+	/* ring indexes have to be on their own cache lines */
+	ret = posix_memalign((void **)&w->eps, WORKERS_CACHELINE,
+			     n_eps * sizeof(*w->eps));
+	if (ret) {
+		free(w);
+		errno = ret;
+		return NULL;
+	}
+
+	memset(w->eps, 0, n_eps * sizeof(*w->eps));
+	for (i = 0; i < n_eps; ++i) {
+		w->eps[i].app_fd = -1;
+		w->eps[i].wake_fd = -1;
+	}
+
+	for (i = 0; i < n_eps; ++i) {
+		ret = init_worker(w, i, &eps[i]);
+		if (ret < 0)
+			goto err;
+	}
+
+	for (i = 0; i < n_eps; ++i) {
+		ret = start_worker(&w->eps[i]);
+		if (ret < 0)
+			goto err;
+	}
+
+	return w;
+
+err:
+	gd_workers_free(w);
+	errno = -ret;
+	return NULL;
+}
+
+_gd_export_ void
+gd_workers_free(struct gd_workers *w)
+{
+	int i;
+
+	if (!w)
+		return;
+
+	for (i = 0; i < w->n_eps; ++i)
+		stop_worker(w, &w->eps[i]);
+
+	free(w->eps);
+	free(w);
+}
+
+static struct worker *
+get_worker(struct gd_workers *w, int ep, enum gd_worker_direction dir)
+{
+	if (!w || ep < 0 || ep >= w->n_eps || w->eps[ep].direction != dir)
+		return NULL;
+
+	return &w->eps[ep];
+}
+
+_gd_export_ int
+gd_workers_send(struct gd_workers *w, int ep, void *buf, size_t len)
+{
+	struct worker *wk = get_worker(w, ep, GD_WORKER_IN);
+	struct gd_worker_msg msg;
+	int ret;
+
+	if (!wk || !buf || len > gd_buf_pool_buf_len(w->pool))
+		return -EINVAL;
+
+	if (__atomic_load_n(&wk->paused, __ATOMIC_SEQ_CST))
+		return __atomic_load_n(&wk->stats.last_error,
+				       __ATOMIC_RELAXED);
+
+	msg.buf = buf;
+	msg.len = len;
+	msg.error = 0;
+
+	ret = ring_push(&wk->ring, &msg);
+	if (ret < 0) {
+		/* Room may have been made before the signal was cleared */
+		clear_fd(wk->app_fd);
+		ret = ring_push(&wk->ring, &msg);
+		if (ret < 0)
+			return ret;
+	}
+
+	wake_worker(wk);
+	return 0;
+}
+
+_gd_export_ int
+gd_workers_recv(struct gd_workers *w, int ep, struct gd_worker_msg *msg)
+{
+	struct worker *wk = get_worker(w, ep, GD_WORKER_OUT);
+	int ret;
+
+	if (!wk || !msg)
+		return -EINVAL;
+
+	ret = ring_pop(&wk->ring, msg);
+	if (ret < 0) {
+		/* Message may have been queued before the signal was cleared */
+		clear_fd(wk->app_fd);
+		ret = ring_pop(&wk->ring, msg);
+		if (ret < 0)
+			return ret;
+	}
+
+	wake_worker(wk);
+	return 0;
+}
+
+_gd_export_ void
+gd_workers_release(struct gd_workers *w, void *buf)
+{
+	int i;
+
+	if (!w || !buf)
+		return;
+
+	gd_buf_pool_put(w->pool, buf);
+
+	for (i = 0; i < w->n_eps; ++i)
+		if (w->eps[i].direction == GD_WORKER_OUT)
+			wake_worker(&w->eps[i]);
+}
+
+_gd_export_ int
+gd_workers_fd(struct gd_workers *w, int ep)
+{
+	if (!w || ep < 0 || ep >= w->n_eps)
+		return -EINVAL;
+
+	return w->eps[ep].app_fd;
+}
+
+_gd_export_ int
+gd_workers_resume(struct gd_workers *w, int ep)
+{
+	struct worker *wk;
+
+	if (!w || ep < 0 || ep >= w->n_eps)
+		return -EINVAL;
+
+	wk = &w->eps[ep];
+	__atomic_store_n(&wk->paused, 0, __ATOMIC_SEQ_CST);
+	wake_worker(wk);
+
+	return 0;
+}
+
+_gd_export_ int
+gd_workers_stats(struct gd_workers *w, int ep, struct gd_worker_stats *stats)
+{
+	struct worker *wk;
+
+	if (!w || ep < 0 || ep >= w->n_eps || !stats)
+		return -EINVAL;
+
+	wk = &w->eps[ep];
+	stats->bytes = __atomic_load_n(&wk->stats.bytes, __ATOMIC_RELAXED);
+	stats->transfers = __atomic_load_n(&wk->stats.transfers,
+					   __ATOMIC_RELAXED);
+	stats->errors = __atomic_load_n(&wk->stats.errors, __ATOMIC_RELAXED);
+	stats->last_error = __atomic_load_n(&wk->stats.last_error,
+					    __ATOMIC_RELAXED);
+
+	return 0;
+}
@@ -0,0 +1,363 @@
+/*
+ * ffs-dmabuf-test.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+  Tests of DMA-buf transfers against mocked ioctls.
+
+  Source of ffs-dmabuf.c is included directly, so that the test sees
+  the same ioctl definitions. Test is linked with --wrap=ioctl and
+  --wrap=open, so every ioctl issued by the library ends up in
+  __wrap_ioctl() which plays the role of function fs, DMA heap and
+  sync file drivers. Buffers are backed by memfd and fences by pipes,
+  so mapping and polling work on real descriptors.
+*/
+
+#include "../src/libffs-daemon/ffs-dmabuf.c"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+int __real_open(const char *path, int flags, ...);
+int __real_ioctl(int fd, unsigned long req, ...);
+
+static struct {
+	/* descriptor of DMA heap device handed out by open() */
+	int heap_fd;
+	/* last buffer allocated from the heap */
+	int buf_fd;
+	/* buffer attached to endpoint, -1 if none */
+	int attached_fd;
+	/* errno returned by next attach, detach, transfer or sync */
+	int attach_err;
+	int transfer_err;
+	int sync_eintr;
+	/* last transfer request and sync flags */
+	int transfers;
+	struct usb_ffs_dmabuf_transfer_req last_req;
+	__u64 last_sync;
+	__u32 last_export;
+	/* fence: read end is given to the caller, write end signals it */
+	int fence_wr;
+	int fence_status;
+} mock;
+
+static int failed;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: check failed: %s\n",	\
+				__FILE__, __LINE__, #cond);		\
+			failed++;					\
+		}							\
+	} while (0)
+
+#define MOCK_EP_FD	1000
+
+int
+__wrap_open(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode;
+
+	if (strcmp(path, DMA_HEAP_SYSTEM) == 0) {
+		mock.heap_fd = memfd_create("mock-heap", MFD_CLOEXEC);
+		return mock.heap_fd;
+	}
+
+	if (strcmp(path, UDMABUF_DEV) == 0) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	va_start(ap, flags);
+	mode = va_arg(ap, mode_t);
+	va_end(ap);
+
+	return __real_open(path, flags, mode);
+}
+
+static int
+mock_fail(int err)
+{
+	errno = err;
+	return -1;
+}
+
+int
+__wrap_ioctl(int fd, unsigned long req, ...)
+{
+	struct dma_heap_allocation_data *alloc;
+	struct usb_ffs_dmabuf_transfer_req *xfer;
+	struct dma_buf_export_sync_file *fence;
+	struct dma_buf_sync *sync;
+	struct sync_file_info *info;
+	int pipefd[2];
+	void *arg;
+	va_list ap;
+
+	va_start(ap, req);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	switch (req) {
+	case DMA_HEAP_IOCTL_ALLOC:
+		if (fd != mock.heap_fd)
+			return mock_fail(EBADF);
+		alloc = arg;
+		mock.buf_fd = memfd_create("mock-dmabuf", MFD_CLOEXEC);
+		if (mock.buf_fd < 0 || ftruncate(mock.buf_fd, alloc->len) < 0)
+			return -1;
+		alloc->fd = mock.buf_fd;
+		return 0;
+
+	case FUNCTIONFS_DMABUF_ATTACH:
+		if (fd != MOCK_EP_FD)
+			return mock_fail(EBADF);
+		if (mock.attach_err)
+			return mock_fail(mock.attach_err);
+		if (mock.attached_fd >= 0)
+			return mock_fail(EBUSY);
+		mock.attached_fd = *(int *)arg;
+		return 0;
+
+	case FUNCTIONFS_DMABUF_DETACH:
+		if (fd != MOCK_EP_FD)
+			return mock_fail(EBADF);
+		if (mock.attached_fd != *(int *)arg)
+			return mock_fail(ENOENT);
+		mock.attached_fd = -1;
+		return 0;
+
+	case FUNCTIONFS_DMABUF_TRANSFER:
+		xfer = arg;
+		mock.transfers++;
+		mock.last_req = *xfer;
+		if (fd != MOCK_EP_FD)
+			return mock_fail(EBADF);
+		if (mock.transfer_err)
+			return mock_fail(mock.transfer_err);
+		if (xfer->fd != mock.attached_fd)
+			return mock_fail(EINVAL);
+		return 0;
+
+	case DMA_BUF_IOCTL_EXPORT_SYNC_FILE:
+		if (fd != mock.buf_fd)
+			return mock_fail(EBADF);
+		fence = arg;
+		mock.last_export = fence->flags;
+		if (pipe2(pipefd, O_CLOEXEC) < 0)
+			return -1;
+		fence->fd = pipefd[0];
+		mock.fence_wr = pipefd[1];
+		mock.fence_status = 0;
+		return 0;
+
+	case DMA_BUF_IOCTL_SYNC:
+		if (fd != mock.buf_fd)
+			return mock_fail(EBADF);
+		if (mock.sync_eintr) {
+			mock.sync_eintr--;
+			return mock_fail(EINTR);
+		}
+		sync = arg;
+		mock.last_sync = sync->flags;
+		return 0;
+
+	case SYNC_IOC_FILE_INFO:
+		info = arg;
+		info->status = mock.fence_status;
+		return 0;
+
+	default:
+		return __real_ioctl(fd, req, arg);
+	}
+}
+
+static void
+mock_reset(void)
+{
+	memset(&mock, 0, sizeof(mock));
+	mock.heap_fd = -1;
+	mock.buf_fd = -1;
+	mock.attached_fd = -1;
+	mock.fence_wr = -1;
+}
+
+static void
+mock_signal_fence(int status)
+{
+	mock.fence_status = status;
+	CHECK(write(mock.fence_wr, "", 1) == 1);
+}
+
+static struct gd_dmabuf *
+test_new(void)
+{
+	struct gd_dmabuf *buf;
+
+	CHECK(gd_dmabuf_new(0, GD_DMABUF_HEAP) == NULL && errno == EINVAL);
+
+	buf = gd_dmabuf_new(100, GD_DMABUF_ANY);
+	CHECK(buf != NULL);
+	if (!buf)
+		return NULL;
+
+	CHECK(gd_dmabuf_fd(buf) == mock.buf_fd);
+	CHECK(gd_dmabuf_len(buf) == (size_t)sysconf(_SC_PAGESIZE));
+	CHECK(gd_dmabuf_data(buf) != NULL);
+	/* Heap descriptor is only needed for allocation */
+	CHECK(fcntl(mock.heap_fd, F_GETFD) < 0 && errno == EBADF);
+
+	memset(gd_dmabuf_data(buf), 0xa5, gd_dmabuf_len(buf));
+
+	return buf;
+}
+
+static void
+test_attach(struct gd_dmabuf *buf)
+{
+	/* Function fs without DMA-buf support does not know the ioctl */
+	mock.attach_err = ENOTTY;
+	CHECK(gd_dmabuf_attach(MOCK_EP_FD, buf) == -ENOTSUP);
+	mock.attach_err = EOPNOTSUPP;
+	CHECK(gd_dmabuf_attach(MOCK_EP_FD, buf) == -ENOTSUP);
+	mock.attach_err = 0;
+	CHECK(mock.attached_fd == -1);
+
+	CHECK(gd_dmabuf_attach(MOCK_EP_FD, NULL) == -EINVAL);
+	CHECK(gd_dmabuf_attach(MOCK_EP_FD, buf) == 0);
+	CHECK(mock.attached_fd == gd_dmabuf_fd(buf));
+
+	/* Other errors are passed to the caller as they are */
+	CHECK(gd_dmabuf_attach(MOCK_EP_FD, buf) == -EBUSY);
+}
+
+static void
+test_cpu_access(struct gd_dmabuf *buf)
+{
+	CHECK(gd_dmabuf_cpu_begin(buf, 1) == 0);
+	CHECK(mock.last_sync == (DMA_BUF_SYNC_START | DMA_BUF_SYNC_RW));
+	CHECK(gd_dmabuf_cpu_end(buf, 0) == 0);
+	CHECK(mock.last_sync == (DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ));
+
+	/* Interrupted sync is restarted */
+	mock.sync_eintr = 2;
+	CHECK(gd_dmabuf_cpu_begin(buf, 0) == 0);
+	CHECK(mock.sync_eintr == 0);
+	CHECK(mock.last_sync == (DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ));
+
+	CHECK(gd_dmabuf_cpu_begin(NULL, 0) == -EINVAL);
+}
+
+static void
+test_transfer(struct gd_dmabuf *buf)
+{
+	int fence;
+
+	/* Length is checked before anything is queued */
+	CHECK(gd_dmabuf_transfer(MOCK_EP_FD, buf,
+				 gd_dmabuf_len(buf) + 1) == -EINVAL);
+	CHECK(gd_dmabuf_transfer(MOCK_EP_FD, NULL, 1) == -EINVAL);
+	CHECK(mock.transfers == 0);
+
+	/* Failed transfer does not export any fence */
+	mock.transfer_err = ESHUTDOWN;
+	CHECK(gd_dmabuf_transfer(MOCK_EP_FD, buf, 64) == -ESHUTDOWN);
+	CHECK(mock.transfers == 1);
+	CHECK(mock.fence_wr == -1);
+	mock.transfer_err = 0;
+
+	fence = gd_dmabuf_transfer(MOCK_EP_FD, buf, 64);
+	CHECK(fence >= 0);
+	CHECK(mock.transfers == 2);
+	CHECK(mock.last_req.fd == gd_dmabuf_fd(buf));
+	CHECK(mock.last_req.length == 64);
+	CHECK(mock.last_req.flags == 0);
+	CHECK(mock.last_export == DMA_BUF_SYNC_WRITE);
+	if (fence < 0)
+		return;
+
+	/* Transfer in progress */
+	CHECK(gd_dmabuf_fence_status(fence) == 0);
+	CHECK(gd_dmabuf_fence_wait(fence, 0) == -ETIME);
+
+	/* Transfer completed */
+	mock_signal_fence(1);
+	CHECK(gd_dmabuf_fence_status(fence) == 1);
+	CHECK(gd_dmabuf_fence_wait(fence, -1) == 0);
+
+	close(fence);
+	close(mock.fence_wr);
+
+	/* Transfer failed, error is reported by the fence */
+	fence = gd_dmabuf_transfer(MOCK_EP_FD, buf, gd_dmabuf_len(buf));
+	CHECK(fence >= 0);
+	CHECK(mock.last_req.length == gd_dmabuf_len(buf));
+	if (fence < 0)
+		return;
+
+	mock_signal_fence(-EPIPE);
+	CHECK(gd_dmabuf_fence_status(fence) == -EPIPE);
+	CHECK(gd_dmabuf_fence_wait(fence, 100) == -EPIPE);
+
+	close(fence);
+	close(mock.fence_wr);
+}
+
+static void
+test_detach(struct gd_dmabuf *buf)
+{
+	CHECK(gd_dmabuf_detach(MOCK_EP_FD, NULL) == -EINVAL);
+	CHECK(gd_dmabuf_detach(MOCK_EP_FD, buf) == 0);
+	CHECK(mock.attached_fd == -1);
+
+	/* Buffer which is not attached cannot be used for transfers */
+	CHECK(gd_dmabuf_detach(MOCK_EP_FD, buf) == -ENOENT);
+	CHECK(gd_dmabuf_transfer(MOCK_EP_FD, buf, 1) == -EINVAL);
+
+	/* and may be attached again */
+	CHECK(gd_dmabuf_attach(MOCK_EP_FD, buf) == 0);
+	CHECK(gd_dmabuf_detach(MOCK_EP_FD, buf) == 0);
+}
+
+int
+main(void)
+{
+	struct gd_dmabuf *buf;
+
+	mock_reset();
+
+	buf = test_new();
+	if (!buf)
+		return 1;
+
+	test_attach(buf);
+	test_cpu_access(buf);
+	test_transfer(buf);
+	test_detach(buf);
+
+	gd_dmabuf_free(buf);
+
+	if (failed) {
+		fprintf(stderr, "%d checks failed\n", failed);
+		return 1;
+	}
+
+	printf("ffs-dmabuf: all checks passed\n");
+	return 0;
+}
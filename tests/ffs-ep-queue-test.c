@@ -0,0 +1,272 @@
+/*
+ * ffs-ep-queue-test.c
+ * Copyright (c) 2014 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+  Tests of io_uring endpoint queue.
+
+  Pipes play the role of endpoints: IN endpoint is write end of a pipe
+  and OUT endpoint is its read end, so transfers, cancellation and
+  freeing of queue with idle OUT endpoint run on a real ring.
+  Test is skipped if io_uring is not available.
+
+  Library sources are compiled into the test, which is linked with
+  --wrap=open, so allocation of DMA-bufs is counted and always fails.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ffs-ep-queue.h"
+
+#define SKIP		77
+#define BUF_LEN		512
+#define DEPTH		2
+
+static int failed;
+/* attempts to open DMA-buf allocator */
+static int dmabuf_allocs;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: check failed: %s\n",	\
+				__FILE__, __LINE__, #cond);		\
+			failed++;					\
+		}							\
+	} while (0)
+
+int __real_open(const char *path, int flags, ...);
+
+int
+__wrap_open(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode;
+
+	if (strcmp(path, "/dev/dma_heap/system") == 0 ||
+	    strcmp(path, "/dev/udmabuf") == 0) {
+		dmabuf_allocs++;
+		errno = ENOENT;
+		return -1;
+	}
+
+	va_start(ap, flags);
+	mode = va_arg(ap, mode_t);
+	va_end(ap);
+
+	return __real_open(path, flags, mode);
+}
+
+struct completions {
+	int n;
+	int result[DEPTH * 2];
+	int ep[DEPTH * 2];
+};
+
+static int
+complete(struct gd_ep_queue *q, struct gd_ep_request *req, void *user_data)
+{
+	struct completions *c = user_data;
+
+	if (c->n < DEPTH * 2) {
+		c->result[c->n] = req->result;
+		c->ep[c->n] = req->ep;
+	}
+	c->n++;
+
+	return GD_EP_REQ_HOLD;
+}
+
+/* Dispatches completions until n of them arrive or a second passes */
+static void
+wait_completions(struct gd_ep_queue *q, struct completions *c, int n)
+{
+	struct pollfd pfd;
+
+	pfd.fd = gd_ep_queue_fd(q);
+	pfd.events = POLLIN;
+
+	while (c->n < n && poll(&pfd, 1, 1000) > 0)
+		CHECK(gd_ep_queue_dispatch(q) >= 0);
+}
+
+static long
+elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000 +
+		(now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static struct gd_ep_queue *
+new_queue(int in_fd, int out_fd, int in_flags, int out_flags,
+	  struct completions *c)
+{
+	struct gd_ep_queue_config eps[2];
+
+	memset(eps, 0, sizeof(eps));
+	eps[0].fd = in_fd;
+	eps[0].direction = GD_EP_IN;
+	eps[0].depth = DEPTH;
+	eps[0].buf_len = BUF_LEN;
+	eps[0].flags = in_flags;
+	eps[1].fd = out_fd;
+	eps[1].direction = GD_EP_OUT;
+	eps[1].depth = DEPTH;
+	eps[1].buf_len = BUF_LEN;
+	eps[1].flags = out_flags;
+
+	memset(c, 0, sizeof(*c));
+	return gd_ep_queue_new(eps, 2, complete, c);
+}
+
+static void
+test_transfer(struct gd_ep_queue *q, struct completions *c)
+{
+	struct gd_ep_request *in, *out;
+
+	in = gd_ep_queue_request(q, 0, 0);
+	out = gd_ep_queue_request(q, 1, 0);
+	CHECK(in != NULL && out != NULL);
+	if (!in || !out)
+		return;
+
+	/* IN request writes to the pipe, OUT request reads it back */
+	memcpy(in->buf, "gadgetd", 7);
+	in->length = 7;
+	CHECK(gd_ep_queue_submit(q, in) == 0);
+	CHECK(gd_ep_queue_submit(q, out) == 0);
+
+	wait_completions(q, c, 2);
+	CHECK(c->n == 2);
+	CHECK(gd_ep_queue_in_flight(q) == 0);
+	CHECK(in->result == 7);
+	/* Short transfer reports number of bytes really transferred */
+	CHECK(out->result == 7);
+	CHECK(memcmp(out->buf, "gadgetd", 7) == 0);
+}
+
+static void
+test_cancel(struct gd_ep_queue *q, struct completions *c)
+{
+	int i;
+
+	/* Nothing is written, so all OUT requests stay in flight */
+	c->n = 0;
+	CHECK(gd_ep_queue_start(q, 1) == 0);
+	CHECK(gd_ep_queue_in_flight(q) == DEPTH);
+
+	CHECK(gd_ep_queue_cancel(q, 1) == 0);
+	wait_completions(q, c, DEPTH);
+
+	CHECK(c->n == DEPTH);
+	CHECK(gd_ep_queue_in_flight(q) == 0);
+	for (i = 0; i < c->n && i < DEPTH; ++i) {
+		CHECK(c->ep[i] == 1);
+		CHECK(c->result[i] < 0);
+	}
+}
+
+static void
+test_free_idle(struct gd_ep_queue *q)
+{
+	struct timespec start;
+
+	/* Free must not wait forever for idle OUT endpoint */
+	CHECK(gd_ep_queue_start(q, 1) == 0);
+	CHECK(gd_ep_queue_in_flight(q) == DEPTH);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	gd_ep_queue_free(q);
+	CHECK(elapsed_ms(&start) < (DEPTH + 1) * 1000);
+}
+
+static void
+test_dmabuf_out(int pipefd[2])
+{
+	struct gd_ep_queue *q;
+	struct gd_ep_request *out;
+	struct completions c;
+
+	/* Fence can't tell length of short OUT transfer, so no DMA-buf */
+	dmabuf_allocs = 0;
+	q = new_queue(pipefd[1], pipefd[0], 0, GD_EP_QUEUE_DMABUF, &c);
+	CHECK(q != NULL);
+	if (!q)
+		return;
+	CHECK(dmabuf_allocs == 0);
+
+	out = gd_ep_queue_request(q, 1, 0);
+	CHECK(out != NULL);
+	if (out) {
+		CHECK(gd_ep_queue_submit(q, out) == 0);
+		CHECK(write(pipefd[1], "short", 5) == 5);
+		wait_completions(q, &c, 1);
+		CHECK(c.n == 1);
+		CHECK(out->result == 5);
+		CHECK(memcmp(out->buf, "short", 5) == 0);
+	}
+	gd_ep_queue_free(q);
+
+	/* IN endpoint still tries DMA-buf and falls back to the ring */
+	q = new_queue(pipefd[1], pipefd[0], GD_EP_QUEUE_DMABUF, 0, &c);
+	CHECK(q != NULL);
+	CHECK(dmabuf_allocs > 0);
+	gd_ep_queue_free(q);
+}
+
+int
+main(void)
+{
+	struct gd_ep_queue *q;
+	struct completions c;
+	int pipefd[2];
+
+	if (pipe(pipefd) < 0)
+		return 1;
+
+	q = new_queue(pipefd[1], pipefd[0], 0, 0, &c);
+	if (!q) {
+		fprintf(stderr, "io_uring not available: %s\n",
+			strerror(errno));
+		return SKIP;
+	}
+
+	test_transfer(q, &c);
+	test_cancel(q, &c);
+	test_free_idle(q);
+	test_dmabuf_out(pipefd);
+
+	close(pipefd[0]);
+	close(pipefd[1]);
+
+	if (failed) {
+		fprintf(stderr, "%d checks failed\n", failed);
+		return 1;
+	}
+
+	printf("ffs-ep-queue: all checks passed\n");
+	return 0;
+}